@@ -2,58 +2,18 @@
 #include <malloc.h>
 #include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "demux.h"
+#include "demux_box.h"
+#include "demux_copy.h"
+#include "demux_schema.h"
+#include "demux_parallel.h"
 
 // 具体看 https://developer.apple.com/library/archive/documentation/QuickTime/QTFF/QTFFChap2/qtff2.html
 
 #pragma pack (4) 
-typedef struct mvhd_box{
-    uint32_t creation_time;
-    uint32_t modification_time;
-    uint32_t timescale;
-    uint32_t duration;
-    uint32_t preferred_rate;
-    uint16_t preferred_volume;
-    uint8_t reserved[10];
-    uint8_t matrix[36];
-    uint32_t preview_time;
-    uint32_t preview_duration;
-    uint32_t poster_time;
-    uint32_t selection_time;
-    uint32_t selection_duration;
-    uint32_t current_time;
-    uint32_t next_track_id;
-}mvhd_box_t;
-
-typedef struct mvhd_extend_box{
-    uint64_t creation_time;
-    uint64_t modification_time;
-    uint32_t timescale;
-    uint64_t duration;
-    uint32_t rate;
-    uint16_t volume;
-    uint32_t reserved[2];
-    uint32_t matrix[9];
-    uint32_t pre_defined[6];
-    uint32_t next_track_id;
-}mvhd_extend_box_t;
-
-typedef struct tkhd_box{
-    uint32_t creation_time;
-    uint32_t modification_time;
-    uint32_t track_id;
-    uint32_t reserved0;
-    uint32_t duration;
-    uint64_t reserved1;
-    uint16_t layer;
-    uint16_t alternate_group;
-    uint16_t volume;
-    uint16_t reserved2;
-    uint8_t matrix[36];
-    uint32_t track_width;
-    uint32_t track_height;
-}tkhd_box_t;
-
 typedef struct hdlr_box{
     uint8_t component_type[4];
     uint8_t component_subtype[4];
@@ -63,25 +23,6 @@ typedef struct hdlr_box{
     uint8_t* component_name;
 }hdlr_box_t;
 
-typedef struct avc1_box{
-    uint8_t reserved[6];
-    uint16_t data_reference_index;
-    uint16_t version;
-    uint16_t revidion_level;
-    uint32_t vendor;
-    uint32_t temporal_quality;
-    uint32_t spatial_quality;
-    uint16_t width;
-    uint16_t height;
-    uint32_t horizonta_resolution;
-    uint32_t vertical_resolution;
-    uint32_t data_size;
-    uint16_t frame_count;
-    uint8_t compressor_name[32];
-    uint16_t depth;
-    uint16_t color_table_id;
-}avc1_box_t;
-
 typedef struct avcC_box{
     uint8_t configuration_version;
     uint8_t avc_profile_indication;
@@ -96,53 +37,10 @@ typedef struct avcC_box{
     uint8_t *picture_parameter_set_nal_unit; // bit(8*pictureParameterSetLength) 
 }avcC_box_t;
 
-typedef struct stsc_box{
-    uint32_t first_chunk;
-    uint32_t samples_per_chunk; 
-    uint32_t sample_description_index;
-}stsc_box_t;
-
-
-typedef struct  video_ctrl{
-    uint32_t i_frame_count;
-    uint32_t* i_frame_num_buf;
-
-    uint32_t chunk_count;
-    uint32_t* chunk_offset_buf;
-    
-    uint32_t stsc_entry_count;
-    stsc_box_t* stsc_box;
-    
-    uint32_t sample_count;
-    uint32_t sample_size;
-    uint32_t* sample_size_buf;
-
-    uint32_t sps_len;
-    int8_t* sps;
-    uint32_t pps_len;
-    int8_t* pps;
-}video_ctrl_t;
-
-video_ctrl_t video_ctrl;
-
 #pragma pack ()
 
 #define DEMUX_MVHD_CREATETIME_OFFSET 2082844800
-
-static int demux_open_file(char* file_path, FILE** fp){
-    if(file_path == NULL){
-        printf("file_path NULL\n");
-        return -1;
-    }
-
-    *fp = fopen(file_path, "r+");
-    if(*fp == NULL){
-        printf("file_path NULL\n");
-        return -1;
-    }
-
-    return 0;
-}
+#define DEMUX_OUTPUT_MAX_IOV 64
 
 static int demux_parse_func_regsistor(demux_ctrl_t* demux_ctrl, const char* box_type, DEMUX_BOX_PARSE func){
     demux_parse_func_info_t* demux_parse_func_info =
@@ -163,9 +61,9 @@ static int demux_parse_func_regsistor(demux_ctrl_t* demux_ctrl, const char* box_
     return 0;
 }
 
-static int demux_read_big_endian_data(FILE* fp, uint8_t* dest, uint32_t size){
-    if(fp == NULL || size == 0){
-        printf("file_path [%p], body_size[%d]\n", fp, size);
+static int demux_read_big_endian_data(demux_io_t* io, uint8_t* dest, uint32_t size){
+    if(io == NULL || size == 0){
+        printf("file_path [%p], body_size[%d]\n", io, size);
         return -1;
     }
     
@@ -173,7 +71,7 @@ static int demux_read_big_endian_data(FILE* fp, uint8_t* dest, uint32_t size){
     int32_t i = 0;
 
     for(i = (size - 1);i >= 0;i--){
-        read_size = fread(&dest[i], sizeof(uint8_t), 1, fp);
+        read_size = demux_io_read(io, &dest[i], 1);
         if(read_size < 1){
             printf("read big endian data failed, read_size[%d]\n", read_size);
             return -1;
@@ -183,16 +81,16 @@ static int demux_read_big_endian_data(FILE* fp, uint8_t* dest, uint32_t size){
     return 0;
 }
 
-static int demux_read_small_endian_data(FILE* fp, uint8_t* dest, uint32_t size){
-    if(fp == NULL || size == 0){
-        printf("file_path [%p], body_size[%d]\n", fp, size);
+static int demux_read_small_endian_data(demux_io_t* io, uint8_t* dest, uint32_t size){
+    if(io == NULL || size == 0){
+        printf("file_path [%p], body_size[%d]\n", io, size);
         return -1;
     }
     
     int32_t read_size = 0;
     int32_t i = 0;
 
-    read_size = fread(dest, sizeof(uint8_t), size, fp);
+    read_size = demux_io_read(io, dest, size);
     if(read_size < size){
         printf("read small endian data failed, read_size[%d]\n", read_size);
         return -1;
@@ -201,7 +99,71 @@ static int demux_read_small_endian_data(FILE* fp, uint8_t* dest, uint32_t size){
     return 0;
 }
 
-static int demux_parse_ftyp_box(FILE* fp, uint64_t body_size){
+/* 定长box一次读入: 读min(max_len, body_size)字节, 返回读到的长度 */
+static int64_t demux_read_fixed_body(demux_io_t* io, uint8_t* buf, uint64_t max_len, uint64_t body_size){
+    uint64_t len = body_size < max_len ? body_size : max_len;
+
+    if(demux_io_read(io, buf, len) != (int64_t)len){
+        printf("read fixed body failed, len[%lu]\n", len);
+        return -1;
+    }
+
+    return len;
+}
+
+#define DEMUX_TABLE_READ_ENTRIES 4096
+
+/* 按块读入count个大端整数, 边读边压缩, 压缩后的大小计入alloc_bytes */
+static int demux_read_pack_table(demux_ctrl_t* demux_ctrl, demux_io_t* io, demux_pack_t* pack, uint32_t count, uint32_t entry_size){
+    uint8_t buf[DEMUX_TABLE_READ_ENTRIES * sizeof(uint64_t)];
+    const uint8_t* p = NULL;
+    uint32_t n = 0;
+    uint32_t i = 0;
+    uint64_t value = 0;
+
+    if(demux_pack_init(pack) < 0){
+        return -1;
+    }
+
+    while(count > 0){
+        n = count < DEMUX_TABLE_READ_ENTRIES ? count : DEMUX_TABLE_READ_ENTRIES;
+        if(demux_io_read(io, buf, n * entry_size) != n * entry_size){
+            printf("read table failed, %u entries left\n", count);
+            return -1;
+        }
+        for(i = 0, p = buf;i < n;i++, p += entry_size){
+            value = (entry_size == sizeof(uint64_t)) ? demux_get_be64(p) : demux_get_be32(p);
+            if(demux_pack_append(pack, value) < 0){
+                return -1;
+            }
+        }
+        count -= n;
+    }
+    if(demux_pack_finish(pack) < 0){
+        return -1;
+    }
+    demux_stats_alloc(&demux_ctrl->stats, demux_pack_bytes(pack));
+
+    return 0;
+}
+
+/* stts/ctts的表项都是两个32位大端数, 整块读入后原地转成本机字节序 */
+static int demux_read_pair_table(demux_io_t* io, uint32_t* table, uint32_t count){
+    uint64_t len = (uint64_t)count * 2 * sizeof(uint32_t);
+    uint64_t i = 0;
+
+    if(demux_io_read(io, (uint8_t*)table, len) != (int64_t)len){
+        printf("read table failed, count[%u]\n", count);
+        return -1;
+    }
+    for(i = 0;i < (uint64_t)count * 2;i++){
+        table[i] = demux_get_be32((const uint8_t*)&table[i]);
+    }
+
+    return 0;
+}
+
+static int demux_parse_ftyp_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
     int read_size = 0;
     char major_brand[4+1] = {0};
     uint32_t minor_version = 0;
@@ -210,19 +172,19 @@ static int demux_parse_ftyp_box(FILE* fp, uint64_t body_size){
 
     printf("start parse ftyp box\n");
 
-    if(fp == NULL){
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
-    read_size = fread((uint8_t*)major_brand, sizeof(uint8_t), FYTP_BOX_MAJOR_BRAND_BYTE, fp);
+    read_size = demux_io_read(io, (uint8_t*)major_brand, FYTP_BOX_MAJOR_BRAND_BYTE);
     if(read_size < FYTP_BOX_MAJOR_BRAND_BYTE){
         printf("read major_brand failed, read_size[%d]\n", read_size);
         return -1;
     }
     printf("major_brand[%s]\n", major_brand);
 
-    read_size = fread((uint8_t*)&minor_version, sizeof(uint8_t), FYTP_BOX_MINOR_VERSION_BYTE, fp);
+    read_size = demux_io_read(io, (uint8_t*)&minor_version, FYTP_BOX_MINOR_VERSION_BYTE);
     if(read_size < FYTP_BOX_MINOR_VERSION_BYTE){
         printf("read minor_version failed, read_size[%d]\n", read_size);
         return -1;
@@ -235,7 +197,7 @@ static int demux_parse_ftyp_box(FILE* fp, uint64_t body_size){
         printf("compatible_brands NULL\n");
         return -1;
     }
-    read_size = fread((uint8_t*)compatible_brands, sizeof(uint8_t), compatible_brands_len, fp);
+    read_size = demux_io_read(io, (uint8_t*)compatible_brands, compatible_brands_len);
     if(read_size < compatible_brands_len){
         printf("read compatible_brands failed, read_size[%d]\n", read_size);
         return -1;
@@ -247,18 +209,21 @@ static int demux_parse_ftyp_box(FILE* fp, uint64_t body_size){
     return 0;
 }
 
-static int demux_parse_free_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
+static int demux_parse_free_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
+    /* free中是填充数据, 跳过 */
+    demux_io_seek(io, body_size, SEEK_CUR);
+
     return 0;
 }
 
-static int demux_parse_mdat_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
-        printf("file_path [%p]\n", fp);
+static int demux_parse_mdat_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    if(io == NULL){
+        printf("file_path [%p]\n", io);
         return -1;
     }
 
@@ -270,7 +235,7 @@ static int demux_parse_mdat_box(FILE* fp, uint64_t body_size){
     if(body_size > 0){
 #if 0
         mdat_body_data = (uint8_t*)calloc(body_size, 1);
-        read_size = fread((uint8_t*)mdat_body_data, sizeof(uint8_t), body_size, fp);
+        read_size = demux_io_read(io, (uint8_t*)mdat_body_data, body_size);
         if(read_size < body_size){
             printf("read mdat failed, read_size[%d]\n", read_size);
             return -1;
@@ -278,168 +243,217 @@ static int demux_parse_mdat_box(FILE* fp, uint64_t body_size){
 
         free(mdat_body_data);
 #else
-    fseek(fp, body_size, SEEK_CUR);
+    demux_io_seek(io, body_size, SEEK_CUR);
 #endif
     }
 
     return 0;
 }
 
-static int demux_parse_moov_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL || body_size == 0){
-        printf("file_path [%p], body_size[%lu]\n", fp, body_size);
+static int demux_parse_moov_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    if(io == NULL || body_size == 0){
+        printf("file_path [%p], body_size[%lu]\n", io, body_size);
         return -1;
     }
 
     printf("start parse moov box\n");
 
+    /* 子box由之后的demux_handle_box_body逐个解析; 可以整块读入时在这里并行解析trak并跳过body */
+    if(demux_parse_moov_body(demux_ctrl, io, body_size) < 0){
+        return -1;
+    }
+
     return 0;
 }
 
 // 当前媒体文件信息
-static int demux_parse_mvhd_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
+static int demux_parse_mvhd_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    uint8_t buf[FULL_BOX_VERSION_FLAGS_BYTE + sizeof(demux_mvhd_v1_raw_t)];
+    demux_mvhd_t box;
+    int64_t read_len = 0;
+    uint8_t version = 0;
+
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
-    int read_size = 0;
-    uint64_t large_size = 0;
-    uint8_t version = 0;
-    uint8_t flags[3] = {0};
+    read_len = demux_read_fixed_body(io, buf, sizeof(buf), body_size);
+    if(read_len < 0){
+        return -1;
+    }
+    version = buf[0];
+    if(read_len < (int64_t)(FULL_BOX_VERSION_FLAGS_BYTE + (version == 1 ? sizeof(demux_mvhd_v1_raw_t) : sizeof(demux_mvhd_v0_raw_t)))){
+        printf("mvhd version[%u] body_size[%lu] too small, skip\n", version, body_size);
+        demux_io_seek(io, body_size - read_len, SEEK_CUR);
+        return 0;
+    }
 
-    if(body_size > 1){
-        // full box
-        read_size = fread((uint8_t*)&version, sizeof(uint8_t), 1, fp);
-        if(read_size < sizeof(uint8_t)){
-            printf("read version failed, read_size[%d]\n", read_size);
-            return -1;
-        }
+    if(version == 1){
+        demux_mvhd_decode_v1(buf + FULL_BOX_VERSION_FLAGS_BYTE, &box);
+    }else{
+        demux_mvhd_decode_v0(buf + FULL_BOX_VERSION_FLAGS_BYTE, &box);
+    }
 
-        read_size = fread(flags, sizeof(uint8_t), sizeof(flags), fp);
-        if(read_size < sizeof(flags)){
-            printf("read flags failed, read_size[%d]\n", read_size);
-            return -1;
-        }
-        
-        if(version == 0){
-            mvhd_box_t box;
-            memset(&box, 0, sizeof(mvhd_box_t));
+    printf("#body_size: %lu\n", body_size);
 
-            demux_read_big_endian_data(fp, (uint8_t*)&box.creation_time, sizeof(box.creation_time));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.modification_time, sizeof(box.modification_time));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.timescale, sizeof(box.timescale));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.duration, sizeof(box.duration));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.preferred_rate, sizeof(box.preferred_rate));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.preferred_volume, sizeof(box.preferred_volume));
+    // creation_time为"in seconds since midnight, January 1, 1904" 即 从1904/01/01/00:00:00算起 2082844800
+    // utc时间从1970/01/01/00:00:00算起，故 creation_time的utc时间为:creation_time_utc = creation_time - (66年时间差) = creation_time - 2082844800
+    printf("#creation_time: %lu\n", box.creation_time - DEMUX_MVHD_CREATETIME_OFFSET);
+    printf("#modification_time: %lu\n", box.modification_time - DEMUX_MVHD_CREATETIME_OFFSET);
+    printf("#timescale: %u\n", box.timescale);
+    demux_ctrl->movie_timescale = box.timescale;
+    printf("#duration: %lu\n", box.duration);
+    printf("#rate: %u.%u\n", ((box.rate&0xffff0000) >> 16), (box.rate&0x0000ffff));
+    printf("#volume: %u.%u\n", ((box.volume&0xff00) >> 8), (box.volume&0x00ff));
+    printf("#next_track_id: %u\n", box.next_track_id);
 
-            printf("#body_size: %lu\n", body_size);
-            
-            // creation_time为"in seconds since midnight, January 1, 1904" 即 从1904/01/01/00:00:00算起 2082844800
-            // utc时间从1970/01/01/00:00:00算起，故 creation_time的utc时间为:creation_time_utc = creation_time - (66年时间差) = creation_time - 2082844800
-            box.creation_time = box.creation_time - DEMUX_MVHD_CREATETIME_OFFSET;
-            printf("#creation_time: %u\n", box.creation_time);
+    demux_io_seek(io, body_size - read_len, SEEK_CUR);
 
-            box.modification_time = box.modification_time - DEMUX_MVHD_CREATETIME_OFFSET;
-            printf("#modification_time: %u\n", box.modification_time);
+    return 0;
+}
 
-            printf("#timescale: %u\n", box.timescale);
-            printf("#duration: %u\n", box.duration);
-            printf("#rate: %u.%u\n", ((box.preferred_rate&0xffff0000) >> 16), (box.preferred_rate&0x0000ffff));
-            printf("#volume: %u.%u\n", ((box.preferred_volume&0xff00) >> 8), (box.preferred_volume&0x00ff));
+static int demux_parse_trak_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = NULL;
 
-            fseek(fp,( 96 - 22), SEEK_CUR); // 跳过后面的字段
-        }else if(version == 1){
-            
-        }
+    if(io == NULL){
+        printf("file_path NULL\n");
+        return -1;
     }
 
-    return 0;
-}
+    if(demux_ctrl->track_count >= DEMUX_MAX_TRACK_NUM){
+        printf("track count over %d\n", DEMUX_MAX_TRACK_NUM);
+        return -1;
+    }
 
-static int demux_parse_trak_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
-        printf("file_path NULL\n");
+    /* 之后的子box都归属于这个trak */
+    track = (video_ctrl_t*)calloc(sizeof(video_ctrl_t), 1);
+    if(track == NULL){
+        printf("track NULL\n");
         return -1;
     }
+    demux_stats_alloc(&demux_ctrl->stats, sizeof(video_ctrl_t));
+    demux_ctrl->track[demux_ctrl->track_count++] = track;
+    demux_ctrl->cur_track = track;
 
     return 0;
 }
 
-static int demux_parse_tkhd_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
+static int demux_parse_tkhd_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    uint8_t buf[FULL_BOX_VERSION_FLAGS_BYTE + sizeof(demux_tkhd_v1_raw_t)];
+    demux_tkhd_t box;
+    int64_t read_len = 0;
+    uint8_t version = 0;
+
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
-    int read_size = 0;
-    uint64_t large_size = 0;
-    uint8_t version = 0;
-    uint32_t flags = {0};
+    read_len = demux_read_fixed_body(io, buf, sizeof(buf), body_size);
+    if(read_len < 0){
+        return -1;
+    }
+    version = buf[0];
+    if(read_len < (int64_t)(FULL_BOX_VERSION_FLAGS_BYTE + (version == 1 ? sizeof(demux_tkhd_v1_raw_t) : sizeof(demux_tkhd_v0_raw_t)))){
+        printf("tkhd version[%u] body_size[%lu] too small, skip\n", version, body_size);
+        demux_io_seek(io, body_size - read_len, SEEK_CUR);
+        return 0;
+    }
 
-    if(body_size > 1){
-        // full box
-        demux_read_big_endian_data(fp, (uint8_t*)&version, 1);
+    if(version == 1){
+        demux_tkhd_decode_v1(buf + FULL_BOX_VERSION_FLAGS_BYTE, &box);
+    }else{
+        demux_tkhd_decode_v0(buf + FULL_BOX_VERSION_FLAGS_BYTE, &box);
+    }
 
-        demux_read_big_endian_data(fp, (uint8_t*)&flags, 3);
+    printf("#version: %u flags:%x\n", version, demux_get_be32(buf) & 0xffffff);
+    printf("#body_size: %lu\n", body_size);
+    printf("#creation_time: %lu\n", box.creation_time - DEMUX_MVHD_CREATETIME_OFFSET);
+    printf("#modification_time: %lu\n", box.modification_time - DEMUX_MVHD_CREATETIME_OFFSET);
+    printf("#track_id: %u\n", box.track_id);
+    if(demux_ctrl->cur_track){
+        demux_ctrl->cur_track->track_id = box.track_id;
+    }
+    printf("#duration: %lu\n", box.duration);
+    printf("#layer: %u\n", box.layer);
+    printf("#alternate_group: %u\n", box.alternate_group);
+    printf("#volume: %u.%u\n", ((box.volume&0xff00) >> 8), (box.volume&0x00ff));
+    printf("#track_width: %u.%u\n", ((box.track_width&0xffff0000) >> 16), (box.track_width&0x0000ffff));
+    printf("#track_height: %u.%u\n", ((box.track_height&0xffff0000) >> 16), (box.track_height&0x0000ffff));
 
-        printf("#version: %u flags:%x\n", version, flags);
+    demux_io_seek(io, body_size - read_len, SEEK_CUR);
 
-        if(version == 0){
-            tkhd_box_t box;
-            memset(&box, 0, sizeof(tkhd_box_t));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.creation_time, sizeof(box.creation_time));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.modification_time, sizeof(box.modification_time));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.track_id, sizeof(box.track_id));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.reserved0, sizeof(box.reserved0));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.duration, sizeof(box.duration));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.reserved1, sizeof(box.reserved1));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.layer, sizeof(box.layer));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.alternate_group, sizeof(box.alternate_group));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.volume, sizeof(box.volume));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.reserved2, sizeof(box.reserved2));
-            demux_read_big_endian_data(fp, (uint8_t*)box.matrix, sizeof(box.matrix));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.track_width, sizeof(box.track_width));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.track_height, sizeof(box.track_height));
-            
-            printf("#body_size: %lu\n", body_size);
-            
-            // creation_time为"in seconds since midnight, January 1, 1904" 即 从1904/01/01/00:00:00算起 2082844800
-            // utc时间从1970/01/01/00:00:00算起，故 creation_time的utc时间为:creation_time_utc = creation_time - (66年时间差) = creation_time - 2082844800
-            box.creation_time = box.creation_time - DEMUX_MVHD_CREATETIME_OFFSET;
-            printf("#creation_time: %u\n", box.creation_time);
-
-            box.modification_time = box.modification_time - DEMUX_MVHD_CREATETIME_OFFSET;
-            printf("#modification_time: %u\n", box.modification_time);
-
-            printf("#track_id: %u\n", box.track_id);
-            printf("#duration: %u\n", box.duration);
-            printf("#layer: %u\n", box.layer);
-            printf("#alternate_group: %u\n", box.alternate_group);
-            printf("#volume: %u.%u\n", ((box.volume&0xff00) >> 8), (box.volume&0x00ff));
-            printf("#track_width: %u.%u\n", ((box.track_width&0xffff0000) >> 16), (box.track_width&0x0000ffff));
-            printf("#track_height: %u.%u\n", ((box.track_height&0xffff0000) >> 16), (box.track_height&0x0000ffff));
-        }else if(version == 1){
-                
-        }
+    return 0;
+}
+
+static int demux_parse_edts_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    if(io == NULL){
+        printf("file_path NULL\n");
+        return -1;
     }
 
     return 0;
 }
 
-static int demux_parse_edts_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
-        printf("file_path NULL\n");
+// 编辑列表: 空编辑表示开头延迟, 正常编辑的media_time为从track中哪个时间开始显示
+static int demux_parse_elst_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+    uint8_t buf[8 + 8 + 4];
+    elst_entry_t* entry = NULL;
+    uint32_t entry_size = 0;
+    uint32_t entry_count = 0;
+    uint8_t version = 0;
+    uint32_t i = 0;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
+        return -1;
+    }
+    if(body_size < 8 || demux_read_fixed_body(io, buf, 8, body_size) < 0){
+        printf("elst body_size[%lu] error\n", body_size);
+        return -1;
+    }
+    version = buf[0];
+    entry_count = demux_get_be32(buf + 4);
+    entry_size = version == 1 ? 8 + 8 + 4 : 4 + 4 + 4;
+    if((uint64_t)entry_count * entry_size > body_size - 8){
+        printf("elst entry_count[%u] out of body_size[%lu]\n", entry_count, body_size);
         return -1;
     }
 
-    fseek(fp, body_size, SEEK_CUR);
+    free(track->elst);
+    track->elst = (elst_entry_t*)calloc(entry_count ? entry_count : 1, sizeof(elst_entry_t));
+    if(track->elst == NULL){
+        printf("elst NULL\n");
+        return -1;
+    }
+    demux_stats_alloc(&demux_ctrl->stats, (entry_count ? entry_count : 1) * sizeof(elst_entry_t));
+    track->elst_entry_count = entry_count;
+    for(i = 0;i < entry_count;i++){
+        if(demux_read_fixed_body(io, buf, entry_size, entry_size) < 0){
+            return -1;
+        }
+        entry = &track->elst[i];
+        if(version == 1){
+            entry->segment_duration = demux_get_be64(buf);
+            entry->media_time = (int64_t)demux_get_be64(buf + 8);
+            entry->media_rate = (int32_t)demux_get_be32(buf + 16);
+        }else{
+            entry->segment_duration = demux_get_be32(buf);
+            entry->media_time = (int32_t)demux_get_be32(buf + 4);
+            entry->media_rate = (int32_t)demux_get_be32(buf + 8);
+        }
+        printf("#elst %u segment_duration:%lu media_time:%ld media_rate:%d.%u\n", i, entry->segment_duration,
+            entry->media_time, entry->media_rate >> 16, entry->media_rate & 0xffff);
+    }
+    demux_io_seek(io, body_size - 8 - (uint64_t)entry_count * entry_size, SEEK_CUR);
 
     return 0;
 }
 
-static int demux_parse_mdia_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
+static int demux_parse_mdia_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
@@ -447,19 +461,45 @@ static int demux_parse_mdia_box(FILE* fp, uint64_t body_size){
     return 0;
 }
 
-static int demux_parse_mdhd_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
-        printf("file_path NULL\n");
+static int demux_parse_mdhd_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+    uint8_t buf[FULL_BOX_VERSION_FLAGS_BYTE + sizeof(demux_mdhd_v1_raw_t)];
+    demux_mdhd_t box;
+    int64_t read_len = 0;
+    uint8_t version = 0;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
+        return -1;
+    }
+
+    read_len = demux_read_fixed_body(io, buf, sizeof(buf), body_size);
+    if(read_len < 0){
         return -1;
     }
+    version = buf[0];
+    if(read_len < (int64_t)(FULL_BOX_VERSION_FLAGS_BYTE + (version == 1 ? sizeof(demux_mdhd_v1_raw_t) : sizeof(demux_mdhd_v0_raw_t)))){
+        printf("mdhd version[%u] body_size[%lu] too small, skip\n", version, body_size);
+        demux_io_seek(io, body_size - read_len, SEEK_CUR);
+        return 0;
+    }
+
+    if(version == 1){
+        demux_mdhd_decode_v1(buf + FULL_BOX_VERSION_FLAGS_BYTE, &box);
+    }else{
+        demux_mdhd_decode_v0(buf + FULL_BOX_VERSION_FLAGS_BYTE, &box);
+    }
+    track->timescale = box.timescale;
+    track->duration = box.duration;
+    printf("#version: %u timescale:%u duration:%lu\n", version, track->timescale, track->duration);
 
-    fseek(fp, body_size, SEEK_CUR);
+    demux_io_seek(io, body_size - read_len, SEEK_CUR);
 
     return 0;
 }
 
-static int demux_parse_hdlr_box(FILE* fp, uint64_t body_size){
-    if(fp == NULL){
+static int demux_parse_hdlr_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
@@ -471,20 +511,20 @@ static int demux_parse_hdlr_box(FILE* fp, uint64_t body_size){
 
     if(body_size > 1){
         // full box
-        demux_read_big_endian_data(fp, (uint8_t*)&version, 1);
+        demux_read_big_endian_data(io, (uint8_t*)&version, 1);
 
-        demux_read_big_endian_data(fp, (uint8_t*)&flags, 3);
+        demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
 
         printf("#version: %u flags:%x\n", version, flags);
 
         if(version == 0){
             hdlr_box_t box;
             memset(&box, 0, sizeof(hdlr_box_t));
-            demux_read_small_endian_data(fp, (uint8_t*)box.component_type, sizeof(box.component_type));
-            demux_read_small_endian_data(fp, (uint8_t*)box.component_subtype, sizeof(box.component_type));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.component_manufacturer, sizeof(box.component_manufacturer));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.component_flags, sizeof(box.component_flags));
-            demux_read_big_endian_data(fp, (uint8_t*)&box.component_flags_mask, sizeof(box.component_flags_mask));
+            demux_read_small_endian_data(io, (uint8_t*)box.component_type, sizeof(box.component_type));
+            demux_read_small_endian_data(io, (uint8_t*)box.component_subtype, sizeof(box.component_type));
+            demux_read_big_endian_data(io, (uint8_t*)&box.component_manufacturer, sizeof(box.component_manufacturer));
+            demux_read_big_endian_data(io, (uint8_t*)&box.component_flags, sizeof(box.component_flags));
+            demux_read_big_endian_data(io, (uint8_t*)&box.component_flags_mask, sizeof(box.component_flags_mask));
             
             uint32_t component_name_len = body_size - 4 - sizeof(hdlr_box_t) + sizeof(box.component_name);
             box.component_name = (uint8_t*)calloc(component_name_len, sizeof(uint8_t));
@@ -493,7 +533,7 @@ static int demux_parse_hdlr_box(FILE* fp, uint64_t body_size){
                 return -1;
             }
             printf("component_name_len:%d\n", component_name_len);
-            demux_read_small_endian_data(fp, (uint8_t*)box.component_name, component_name_len);
+            demux_read_small_endian_data(io, (uint8_t*)box.component_name, component_name_len);
 
             printf("#body_size: %lu\n", body_size);
             
@@ -502,6 +542,10 @@ static int demux_parse_hdlr_box(FILE* fp, uint64_t body_size){
             printf("#component_subtype: %.*s\n", (int)sizeof(box.component_subtype), box.component_subtype);
             printf("#component_name: %.*s\n", (int)component_name_len, box.component_name);
 
+            if(demux_ctrl->cur_track){
+                memcpy(demux_ctrl->cur_track->handler_type, box.component_subtype, sizeof(box.component_subtype));
+            }
+
             if(box.component_name){
                 free(box.component_name);
             }
@@ -514,8 +558,8 @@ static int demux_parse_hdlr_box(FILE* fp, uint64_t body_size){
     return 0;
 }
 
-static int demux_parse_minf_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
+static int demux_parse_minf_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+     if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
@@ -523,19 +567,19 @@ static int demux_parse_minf_box(FILE* fp, uint64_t body_size){
     return 0;
 }
 
-static int demux_parse_vmhd_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
+static int demux_parse_vmhd_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+     if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
-    fseek(fp, body_size, SEEK_CUR);
+    demux_io_seek(io, body_size, SEEK_CUR);
 
     return 0;
 }
 
-static int demux_parse_dinf_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
+static int demux_parse_dinf_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+     if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
@@ -543,19 +587,19 @@ static int demux_parse_dinf_box(FILE* fp, uint64_t body_size){
     return 0;
 }
 
-static int demux_parse_dref_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
+static int demux_parse_dref_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+     if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
-    fseek(fp, body_size, SEEK_CUR);
+    demux_io_seek(io, body_size, SEEK_CUR);
 
     return 0;
 }
 
-static int demux_parse_stbl_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
+static int demux_parse_stbl_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+     if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
@@ -563,8 +607,8 @@ static int demux_parse_stbl_box(FILE* fp, uint64_t body_size){
     return 0;
 }
 
-static int demux_parse_stsd_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
+static int demux_parse_stsd_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+     if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
@@ -574,62 +618,60 @@ static int demux_parse_stsd_box(FILE* fp, uint64_t body_size){
     uint32_t entries = {0};
 
     if(body_size > 1){
-        demux_read_big_endian_data(fp, (uint8_t*)&version, 1);
-        demux_read_big_endian_data(fp, (uint8_t*)&flags, 3);
-        demux_read_big_endian_data(fp, (uint8_t*)&entries, 4);
+        demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+        demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
+        demux_read_big_endian_data(io, (uint8_t*)&entries, 4);
         printf("#version: %u flags:%x entries:%u\n", version, flags, entries);
     }
 
     return 0;
 }
 
-static int demux_parse_avc1_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
+static int demux_parse_avc1_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    uint8_t buf[sizeof(demux_avc1_v0_raw_t)];
+    demux_avc1_t box;
+
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
+    if(body_size < sizeof(buf)){
+        printf("avc1 body_size[%lu] too small\n", body_size);
+        return -1;
+    }
 
-    if(body_size > 1){
-        avc1_box_t box;
-        memset(&box, 0, sizeof(avc1_box_t));
-
-        demux_read_big_endian_data(fp, (uint8_t*)&box.reserved, sizeof(box.reserved));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.data_reference_index, sizeof(box.data_reference_index));
-
-        demux_read_big_endian_data(fp, (uint8_t*)&box.version, sizeof(box.version));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.revidion_level, sizeof(box.revidion_level));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.vendor, sizeof(box.vendor));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.temporal_quality, sizeof(box.temporal_quality));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.spatial_quality, sizeof(box.spatial_quality));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.width, sizeof(box.width));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.height, sizeof(box.height));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.horizonta_resolution, sizeof(box.horizonta_resolution));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.vertical_resolution, sizeof(box.vertical_resolution));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.data_size, sizeof(box.data_size));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.frame_count, sizeof(box.frame_count));
-        demux_read_big_endian_data(fp, (uint8_t*)box.compressor_name, sizeof(box.compressor_name));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.depth, sizeof(box.depth));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.color_table_id, sizeof(box.color_table_id));
-
-        printf("#avc1_box_t size:%ld, body_size:%lu\n", sizeof(avc1_box_t), body_size);
-        printf("#version:%u\n", box.version);
-        printf("#revidion_level:%u\n", box.revidion_level);
-        printf("#vendor:%u\n", box.vendor);
-        printf("#temporal_quality:%u\n", box.temporal_quality);
-        printf("#spatial_quality:%u\n", box.spatial_quality);
-        printf("#width:%u\n", box.width);
-        printf("#height:%u\n", box.height);
-        printf("#horizonta_resolution:%u\n", box.horizonta_resolution);
-        printf("#vertical_resolution:%u\n", box.vertical_resolution);
+    /* 只读定长部分, 后面的avcC等子box继续按box解析 */
+    if(demux_read_fixed_body(io, buf, sizeof(buf), body_size) < 0){
+        return -1;
+    }
+    demux_avc1_decode_v0(buf, &box);
+
+    printf("#avc1 fixed size:%ld, body_size:%lu\n", sizeof(buf), body_size);
+    printf("#version:%u\n", box.version);
+    printf("#revision_level:%u\n", box.revision_level);
+    printf("#vendor:%u\n", box.vendor);
+    printf("#temporal_quality:%u\n", box.temporal_quality);
+    printf("#spatial_quality:%u\n", box.spatial_quality);
+    printf("#width:%u\n", box.width);
+    printf("#height:%u\n", box.height);
+    printf("#horizontal_resolution:%u\n", box.horizontal_resolution);
+    printf("#vertical_resolution:%u\n", box.vertical_resolution);
+
+    if(demux_ctrl->cur_track){
+        strcpy(demux_ctrl->cur_track->codec, "avc1");
+        demux_ctrl->cur_track->width = box.width;
+        demux_ctrl->cur_track->height = box.height;
     }
 
     return 0;
 }
 
 
-static int demux_parse_avcC_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
-        printf("file_path NULL\n");
+static int demux_parse_avcC_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
         return -1;
     }
 
@@ -638,27 +680,32 @@ static int demux_parse_avcC_box(FILE* fp, uint64_t body_size){
         avcC_box_t box;
         memset(&box, 0, sizeof(avcC_box_t));
 
-        demux_read_big_endian_data(fp, (uint8_t*)&box.configuration_version, sizeof(box.configuration_version));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.avc_profile_indication, sizeof(box.avc_profile_indication));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.profile_compatibility, sizeof(box.profile_compatibility));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.avc_level_indication, sizeof(box.avc_level_indication));
+        demux_read_big_endian_data(io, (uint8_t*)&box.configuration_version, sizeof(box.configuration_version));
+        demux_read_big_endian_data(io, (uint8_t*)&box.avc_profile_indication, sizeof(box.avc_profile_indication));
+        demux_read_big_endian_data(io, (uint8_t*)&box.profile_compatibility, sizeof(box.profile_compatibility));
+        demux_read_big_endian_data(io, (uint8_t*)&box.avc_level_indication, sizeof(box.avc_level_indication));
         
-        demux_read_big_endian_data(fp, (uint8_t*)&box.length_size_minusOne, sizeof(box.length_size_minusOne));
-        box.length_size_minusOne = box.length_size_minusOne & 0x02;
+        demux_read_big_endian_data(io, (uint8_t*)&box.length_size_minusOne, sizeof(box.length_size_minusOne));
+        box.length_size_minusOne = box.length_size_minusOne & 0x03;
+        track->nal_length_size = box.length_size_minusOne + 1;
         
-        demux_read_big_endian_data(fp, (uint8_t*)&box.num_of_sequence_parameter_sets, sizeof(box.num_of_sequence_parameter_sets));
+        demux_read_big_endian_data(io, (uint8_t*)&box.num_of_sequence_parameter_sets, sizeof(box.num_of_sequence_parameter_sets));
         box.num_of_sequence_parameter_sets = box.num_of_sequence_parameter_sets & 0x1f;
 
-        demux_read_big_endian_data(fp, (uint8_t*)&box.sequence_parameter_set_length, sizeof(box.sequence_parameter_set_length));
+        demux_read_big_endian_data(io, (uint8_t*)&box.sequence_parameter_set_length, sizeof(box.sequence_parameter_set_length));
         box.sequence_parameter_set_nal_unit = (uint8_t*)calloc(sizeof(uint8_t), box.sequence_parameter_set_length);
-        if(box.sequence_parameter_set_nal_unit)
-            demux_read_small_endian_data(fp, (uint8_t*)box.sequence_parameter_set_nal_unit, box.sequence_parameter_set_length);
+        if(box.sequence_parameter_set_nal_unit){
+            demux_stats_alloc(&demux_ctrl->stats, box.sequence_parameter_set_length);
+            demux_read_small_endian_data(io, (uint8_t*)box.sequence_parameter_set_nal_unit, box.sequence_parameter_set_length);
+        }
 
-        demux_read_big_endian_data(fp, (uint8_t*)&box.num_of_picture_parameter_sets, sizeof(box.num_of_picture_parameter_sets));
-        demux_read_big_endian_data(fp, (uint8_t*)&box.picture_parameter_set_length, sizeof(box.picture_parameter_set_length));
+        demux_read_big_endian_data(io, (uint8_t*)&box.num_of_picture_parameter_sets, sizeof(box.num_of_picture_parameter_sets));
+        demux_read_big_endian_data(io, (uint8_t*)&box.picture_parameter_set_length, sizeof(box.picture_parameter_set_length));
         box.picture_parameter_set_nal_unit = (uint8_t*)calloc(sizeof(uint8_t), box.picture_parameter_set_length);
-        if(box.picture_parameter_set_nal_unit)
-            demux_read_small_endian_data(fp, (uint8_t*)box.picture_parameter_set_nal_unit, box.picture_parameter_set_length);
+        if(box.picture_parameter_set_nal_unit){
+            demux_stats_alloc(&demux_ctrl->stats, box.picture_parameter_set_length);
+            demux_read_small_endian_data(io, (uint8_t*)box.picture_parameter_set_nal_unit, box.picture_parameter_set_length);
+        }
 
         printf("#num_of_sequence_parameter_sets %u\n", box.num_of_sequence_parameter_sets);
         printf("#sequence_parameter_set_length %u\n", box.sequence_parameter_set_length);
@@ -667,8 +714,8 @@ static int demux_parse_avcC_box(FILE* fp, uint64_t body_size){
             printf("%x", box.sequence_parameter_set_nal_unit[i]);
         }
         printf("\n");
-        video_ctrl.sps = box.sequence_parameter_set_nal_unit;
-        video_ctrl.sps_len = box.sequence_parameter_set_length;
+        track->sps = box.sequence_parameter_set_nal_unit;
+        track->sps_len = box.sequence_parameter_set_length;
         
         printf("#num_of_picture_parameter_sets %u\n", box.num_of_picture_parameter_sets);
         printf("#picture_parameter_set_length %u\n", box.picture_parameter_set_length);
@@ -677,215 +724,779 @@ static int demux_parse_avcC_box(FILE* fp, uint64_t body_size){
             printf("%x", box.picture_parameter_set_nal_unit[i]);
         }
         printf("\n");
-        video_ctrl.pps = box.picture_parameter_set_nal_unit;
-        video_ctrl.pps_len = box.picture_parameter_set_length;
+        track->pps = box.picture_parameter_set_nal_unit;
+        track->pps_len = box.picture_parameter_set_length;
     }
 
     return 0;
 }
 
-static int demux_parse_stts_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
-        printf("file_path NULL\n");
+static int demux_parse_mp4a_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+    uint8_t buf[sizeof(demux_mp4a_v0_raw_t)];
+    demux_mp4a_t box;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
+        return -1;
+    }
+    if(body_size < sizeof(buf)){
+        printf("mp4a body_size[%lu] too small\n", body_size);
+        return -1;
+    }
+
+    if(demux_read_fixed_body(io, buf, sizeof(buf), body_size) < 0){
         return -1;
     }
-    fseek(fp, body_size, SEEK_CUR);
+    demux_mp4a_decode_v0(buf, &box);
+    track->channel_count = box.channel_count;
+    track->sample_rate = box.sample_rate >> 16;
+
+    // quicktime的sound description v1/v2带额外字段
+    if(box.version == 1){
+        demux_io_seek(io, 16, SEEK_CUR);
+    }else if(box.version == 2){
+        demux_io_seek(io, 36, SEEK_CUR);
+    }
+
+    printf("#channel_count:%u sample_size:%u sample_rate:%u\n", track->channel_count, box.sample_size, track->sample_rate);
+    strcpy(track->codec, "mp4a");
 
     return 0;
 }
 
-static int demux_parse_stss_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
-        printf("file_path NULL\n");
+static int demux_read_descriptor_size(uint8_t* buf, uint32_t len, uint32_t* pos, uint32_t* size){
+    int i = 0;
+    uint8_t byte = 0;
+
+    *size = 0;
+    for(i = 0;i < 4 && *pos < len;i++){
+        byte = buf[(*pos)++];
+        *size = (*size << 7) | (byte & 0x7f);
+        if(!(byte & 0x80)){
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// ES_Descriptor -> DecoderConfigDescriptor -> DecoderSpecificInfo(AudioSpecificConfig)
+static int demux_parse_esds_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+
+    if(io == NULL || track == NULL || body_size < 4){
+        printf("file_path[%p] track[%p] body_size[%lu] error\n", io, track, body_size);
         return -1;
     }
-    
-    uint8_t version = 0;
-    uint32_t flags = 0;
-    uint32_t i = 0;
 
-    if(body_size > 1){
-        demux_read_big_endian_data(fp, (uint8_t*)&version, 1);
-        demux_read_big_endian_data(fp, (uint8_t*)&flags, 3);
-        printf("#version: %u flags:%x\n", version, flags);
+    uint8_t* body = (uint8_t*)calloc(sizeof(uint8_t), body_size);
+    uint32_t pos = 4; // version flags
+    uint32_t size = 0;
+    uint8_t tag = 0;
+    uint8_t es_flags = 0;
+
+    if(body == NULL){
+        printf("esds body NULL\n");
+        return -1;
+    }
+    if(demux_read_small_endian_data(io, body, body_size) < 0){
+        free(body);
+        return -1;
+    }
 
-        demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.i_frame_count, sizeof(video_ctrl.i_frame_count));
-        video_ctrl.i_frame_num_buf = (uint32_t*)calloc(sizeof(uint32_t), video_ctrl.i_frame_count);
+    while(pos < body_size){
+        tag = body[pos++];
+        if(demux_read_descriptor_size(body, body_size, &pos, &size) < 0 || size > body_size - pos){
+            break;
+        }
 
-        if(video_ctrl.i_frame_num_buf){
-            printf("# i_frame_num[%u]:", video_ctrl.i_frame_count);
-            for(i = 0;i < video_ctrl.i_frame_count;i++){
-                demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.i_frame_num_buf[i], sizeof(uint32_t));
-                printf("%u ", video_ctrl.i_frame_num_buf[i]);
+        if(tag == 0x03){
+            // ES_ID(2) flags(1)
+            es_flags = body[pos + 2];
+            pos += 3;
+            if(es_flags & 0x80){
+                pos += 2;
+            }
+            if(es_flags & 0x40){
+                pos += 1 + body[pos];
+            }
+            if(es_flags & 0x20){
+                pos += 2;
             }
-            printf("\n");
+        }else if(tag == 0x04){
+            // objectTypeIndication streamType bufferSizeDB maxBitrate avgBitrate
+            printf("#object_type_indication:%x\n", body[pos]);
+            pos += 13;
+        }else if(tag == 0x05){
+            track->audio_config = (uint8_t*)calloc(sizeof(uint8_t), size);
+            if(track->audio_config){
+                demux_stats_alloc(&demux_ctrl->stats, size);
+                memcpy(track->audio_config, body + pos, size);
+                track->audio_config_len = size;
+            }
+            printf("#audio_config_len:%u\n", size);
+            break;
+        }else{
+            pos += size;
         }
     }
 
+    free(body);
 
     return 0;
 }
 
-static int demux_parse_stsc_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
-        printf("file_path NULL\n");
+static int demux_parse_stts_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
         return -1;
     }
 
-    stsc_box_t* stsc_box = (stsc_box_t*)calloc(sizeof(stsc_box_t), video_ctrl.stsc_entry_count);
-    stsc_box_t* p_stsc_box = NULL;
     uint8_t version = 0;
     uint32_t flags = 0;
-    uint32_t i = 0;
-
-    demux_read_big_endian_data(fp, (uint8_t*)&version, 1);
-    demux_read_big_endian_data(fp, (uint8_t*)&flags, 3);
-    printf("#version: %u flags:%x\n", version, flags);
 
-    demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.stsc_entry_count, sizeof(video_ctrl.stsc_entry_count));
-    if(stsc_box == NULL){
-        printf("stsc_box NULL\n");
+    if(body_size < 8){
+        printf("stts body_size[%lu] error\n", body_size);
         return -1;
     }
-
-    for (i = 0; i < video_ctrl.stsc_entry_count; i++) {
-        p_stsc_box = stsc_box+i;
-        demux_read_big_endian_data(fp, (uint8_t*)&p_stsc_box->first_chunk, sizeof(p_stsc_box->first_chunk));
-        demux_read_big_endian_data(fp, (uint8_t*)&p_stsc_box->samples_per_chunk, sizeof(p_stsc_box->samples_per_chunk));
-        demux_read_big_endian_data(fp, (uint8_t*)&p_stsc_box->sample_description_index, sizeof(p_stsc_box->sample_description_index));
+    demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+    demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
+    demux_read_big_endian_data(io, (uint8_t*)&track->stts_entry_count, sizeof(track->stts_entry_count));
+    printf("#version: %u flags:%x entry_count:%u\n", version, flags, track->stts_entry_count);
+    if(track->stts_entry_count > (body_size - 8) / sizeof(stts_box_t)){
+        printf("stts entry_count[%u] error\n", track->stts_entry_count);
+        track->stts_entry_count = 0;
+        return -1;
     }
-    video_ctrl.stsc_box = stsc_box;
 
-    printf("#first_chunk:%u\n", stsc_box->first_chunk);
-    printf("#samples_per_chunk:%u\n", stsc_box->samples_per_chunk);
-    printf("#sample_description_index:%u\n", stsc_box->sample_description_index);
+    track->stts_box = (stts_box_t*)calloc(sizeof(stts_box_t), track->stts_entry_count);
+    if(track->stts_box == NULL){
+        printf("stts_box NULL\n");
+        return -1;
+    }
+    demux_stats_alloc(&demux_ctrl->stats, (uint64_t)track->stts_entry_count * sizeof(stts_box_t));
+    if(demux_read_pair_table(io, (uint32_t*)track->stts_box, track->stts_entry_count) < 0){
+        return -1;
+    }
+    if(track->stts_entry_count > 0){
+        printf("#sample_count:%u sample_delta:%u\n", track->stts_box[0].sample_count, track->stts_box[0].sample_delta);
+    }
 
     return 0;
 }
 
-static int demux_parse_stsz_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
-        printf("file_path NULL\n");
+// 显示时间与解码时间的差值, 有B帧时才会出现
+static int demux_parse_ctts_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
         return -1;
     }
-    
+
     uint8_t version = 0;
     uint32_t flags = 0;
-    uint32_t i = 0;
 
-    demux_read_big_endian_data(fp, (uint8_t*)&version, 1);
-    demux_read_big_endian_data(fp, (uint8_t*)&flags, 3);
-    printf("#version: %u flags:%x\n", version, flags);
-    
-    demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.sample_size, sizeof(video_ctrl.sample_size));
-    demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.sample_count, sizeof(video_ctrl.sample_count));
-
-    if(video_ctrl.sample_size == 0){
-        video_ctrl.sample_size_buf = (uint32_t*)calloc(sizeof(uint32_t), video_ctrl.sample_count);
-        printf("#sample_count:%u\n", video_ctrl.sample_count);
-        for (i = 0; i < video_ctrl.sample_count; i++) {
-            demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.sample_size_buf[i], sizeof(uint32_t));
-            printf("#sample_size_buf[%u]:%u\n", i, video_ctrl.sample_size_buf[i]);
-        }
+    if(body_size < 8){
+        printf("ctts body_size[%lu] error\n", body_size);
+        return -1;
     }
-
-    return 0;
-}
-
-static int demux_output_video_stream(FILE* fp){
-    uint32_t cur_offset = ftell(fp);
-    char* file_path = "out.h264";
-    FILE* out_fp = fopen(file_path, "wb+");
-    uint32_t i = 0;
-
-    if(out_fp == NULL){
-        printf("out_fp NULL\n");
+    demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+    demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
+    demux_read_big_endian_data(io, (uint8_t*)&track->ctts_entry_count, sizeof(track->ctts_entry_count));
+    printf("#version: %u flags:%x entry_count:%u\n", version, flags, track->ctts_entry_count);
+    if(track->ctts_entry_count > (body_size - 8) / sizeof(ctts_box_t)){
+        printf("ctts entry_count[%u] error\n", track->ctts_entry_count);
+        track->ctts_entry_count = 0;
         return -1;
     }
 
-    /* 获取chunk位置 */
-    uint32_t chunk_count = video_ctrl.chunk_count;
-    uint32_t* chunk_offset_buf = video_ctrl.chunk_offset_buf;
-    uint32_t* sample_size_buf = video_ctrl.sample_size_buf;
-    uint32_t sample_count = video_ctrl.sample_count;
-    uint8_t* video_data = NULL;
-    uint8_t start_code[4] = {0x00, 0x00, 0x00, 0x01};
-    for(i = 0;i < video_ctrl.chunk_count;i++){
-        /* 读取sample */
-        fseek(fp, chunk_offset_buf[i], SEEK_SET);
-        video_data = (uint8_t*)calloc(sizeof(uint32_t), sample_size_buf[i]);
-        fread(video_data, sizeof(uint8_t), sample_size_buf[i], fp);
-        /* 判断是否为关键帧 */
-        if(i == 0){
-            /* 写入sps pps */
-            fwrite(start_code, sizeof(uint8_t), sizeof(start_code), out_fp);
-            fwrite(video_ctrl.sps, sizeof(uint8_t), video_ctrl.sps_len, out_fp);
-            fwrite(start_code, sizeof(uint8_t), sizeof(start_code), out_fp);
-            fwrite(video_ctrl.pps, sizeof(uint8_t), video_ctrl.pps_len, out_fp);
-            /* 写入视频数据 */
-            fwrite(start_code, sizeof(uint8_t), sizeof(start_code), out_fp);
-            fwrite(video_data + 4, sizeof(uint8_t), sample_size_buf[i], out_fp); //前四个字节为数据的长度
-        }else{
-            /* 写入视频数据 */
-            fwrite(start_code, sizeof(uint8_t), sizeof(start_code), out_fp);
-            fwrite(video_data + 4, sizeof(uint8_t), sample_size_buf[i], out_fp); //前四个字节为数据的长度
-            
-        }
-        free(video_data);
+    track->ctts_box = (ctts_box_t*)calloc(sizeof(ctts_box_t), track->ctts_entry_count);
+    if(track->ctts_box == NULL){
+        printf("ctts_box NULL\n");
+        return -1;
+    }
+    demux_stats_alloc(&demux_ctrl->stats, (uint64_t)track->ctts_entry_count * sizeof(ctts_box_t));
+    // version 0的offset按无符号存储, 实际文件里同样按补码解释
+    if(demux_read_pair_table(io, (uint32_t*)track->ctts_box, track->ctts_entry_count) < 0){
+        return -1;
     }
 
-    fclose(out_fp);
-    fseek(fp, cur_offset, SEEK_SET);
+    return 0;
 }
 
-static int demux_parse_stco_box(FILE* fp, uint64_t body_size){
-     if(fp == NULL){
-        printf("file_path NULL\n");
+static int demux_parse_stss_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
         return -1;
     }
     
-    int read_size = 0;
-    uint64_t large_size = 0;
     uint8_t version = 0;
-    uint32_t flags = {0};
+    uint32_t flags = 0;
+    uint32_t i = 0;
 
     if(body_size > 1){
-        demux_read_big_endian_data(fp, (uint8_t*)&version, 1);
-        demux_read_big_endian_data(fp, (uint8_t*)&flags, 3);
+        demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+        demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
         printf("#version: %u flags:%x\n", version, flags);
 
-        demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.chunk_count, sizeof(video_ctrl.chunk_count));
-        if(video_ctrl.chunk_count > 0){
-            video_ctrl.chunk_offset_buf = (uint32_t*)calloc(sizeof(uint32_t), video_ctrl.chunk_count);
-            if(video_ctrl.chunk_offset_buf){
-                int i = 0;
-                for(i = 0;i < video_ctrl.chunk_count;i++){
-                    demux_read_big_endian_data(fp, (uint8_t*)&video_ctrl.chunk_offset_buf[i], sizeof(uint32_t));
-                    printf("chunk_offset_buf[%d]:%u\n", i, video_ctrl.chunk_offset_buf[i]);
-                }
-            }
+        demux_read_big_endian_data(io, (uint8_t*)&track->i_frame_count, sizeof(track->i_frame_count));
+        if(track->i_frame_count > (body_size - 8) / sizeof(uint32_t)){
+            printf("stss entry_count[%u] error\n", track->i_frame_count);
+            return -1;
+        }
+        if(demux_read_pack_table(demux_ctrl, io, &track->i_frame_num_pack, track->i_frame_count, sizeof(uint32_t)) < 0){
+            return -1;
         }
-        demux_output_video_stream(fp);
+        track->stss_present = 1;
+        printf("# i_frame_count[%u] packed %lu bytes\n", track->i_frame_count, demux_pack_bytes(&track->i_frame_num_pack));
     }
 
     return 0;
 }
 
-static int demux_regsistor_box(demux_ctrl_t* demux_ctrl){
-    int ret = 0;
-    INIT_LIST_HEAD(&demux_ctrl->parse_func_list);
+static int demux_parse_stsc_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
 
-    ret = demux_parse_func_regsistor(demux_ctrl, "ftyp", demux_parse_ftyp_box);
-    if(ret < 0){
-        printf("regsistor ftyp failed\n");
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
         return -1;
     }
 
-    ret = demux_parse_func_regsistor(demux_ctrl, "free", demux_parse_free_box);
-    if(ret < 0){
-        printf("regsistor free failed\n");
-        return -1;
-    }
+    stsc_box_t* stsc_box = NULL;
+    stsc_box_t* p_stsc_box = NULL;
+    uint8_t version = 0;
+    uint32_t flags = 0;
+    uint32_t i = 0;
+
+    demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+    demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
+    printf("#version: %u flags:%x\n", version, flags);
+
+    demux_read_big_endian_data(io, (uint8_t*)&track->stsc_entry_count, sizeof(track->stsc_entry_count));
+    stsc_box = (stsc_box_t*)calloc(sizeof(stsc_box_t), track->stsc_entry_count);
+    if(stsc_box == NULL){
+        printf("stsc_box NULL\n");
+        return -1;
+    }
+    demux_stats_alloc(&demux_ctrl->stats, (uint64_t)track->stsc_entry_count * sizeof(stsc_box_t));
+
+    for (i = 0; i < track->stsc_entry_count; i++) {
+        p_stsc_box = stsc_box+i;
+        demux_read_big_endian_data(io, (uint8_t*)&p_stsc_box->first_chunk, sizeof(p_stsc_box->first_chunk));
+        demux_read_big_endian_data(io, (uint8_t*)&p_stsc_box->samples_per_chunk, sizeof(p_stsc_box->samples_per_chunk));
+        demux_read_big_endian_data(io, (uint8_t*)&p_stsc_box->sample_description_index, sizeof(p_stsc_box->sample_description_index));
+    }
+    track->stsc_box = stsc_box;
+
+    printf("#first_chunk:%u\n", stsc_box->first_chunk);
+    printf("#samples_per_chunk:%u\n", stsc_box->samples_per_chunk);
+    printf("#sample_description_index:%u\n", stsc_box->sample_description_index);
+
+    return 0;
+}
+
+static int demux_parse_stsz_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
+        return -1;
+    }
+    
+    uint8_t version = 0;
+    uint32_t flags = 0;
+
+    if(body_size < 12){
+        printf("stsz body_size[%lu] error\n", body_size);
+        return -1;
+    }
+    demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+    demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
+    printf("#version: %u flags:%x\n", version, flags);
+    
+    demux_read_big_endian_data(io, (uint8_t*)&track->sample_size, sizeof(track->sample_size));
+    demux_read_big_endian_data(io, (uint8_t*)&track->sample_count, sizeof(track->sample_count));
+
+    printf("#sample_count:%u sample_size:%u\n", track->sample_count, track->sample_size);
+    if(track->sample_size == 0){
+        if(track->sample_count > (body_size - 12) / sizeof(uint32_t)){
+            printf("stsz sample_count[%u] error\n", track->sample_count);
+            return -1;
+        }
+        if(demux_read_pack_table(demux_ctrl, io, &track->sample_size_pack, track->sample_count, sizeof(uint32_t)) < 0){
+            return -1;
+        }
+        printf("#sample_size packed %lu bytes, raw %lu bytes\n",
+            demux_pack_bytes(&track->sample_size_pack), (uint64_t)track->sample_count * sizeof(uint32_t));
+    }
+
+    return 0;
+}
+
+int demux_sample_iter_init(demux_sample_iter_t* iter, video_ctrl_t* track){
+    if(iter == NULL || track == NULL){
+        printf("iter[%p] track[%p] NULL\n", iter, track);
+        return -1;
+    }
+
+    if(track->stsc_box == NULL || track->chunk_count == 0 || track->stsc_entry_count == 0 ||
+       track->chunk_offset_pack.count < track->chunk_count ||
+       (track->sample_size == 0 && track->sample_size_pack.count < track->sample_count)){
+        printf("stsc_box[%p] chunk_count[%u] sample table error\n", track->stsc_box, track->chunk_count);
+        return -1;
+    }
+
+    iter->track = track;
+    iter->chunk_index = 0;
+    iter->stsc_index = 0;
+    iter->sample_in_chunk = 0;
+    iter->sample_index = 0;
+    iter->size_cursor.block = 0;
+    iter->offset_cursor.block = 0;
+    iter->offset = demux_pack_cursor_get(&track->chunk_offset_pack, &iter->offset_cursor, 0);
+
+    return 0;
+}
+
+/* 返回1表示取到sample, 0表示遍历结束 */
+int demux_sample_iter_next(demux_sample_iter_t* iter, uint64_t* offset, uint32_t* size){
+    video_ctrl_t* track = iter->track;
+
+    if(iter->sample_index >= track->sample_count){
+        return 0;
+    }
+
+    /* 当前chunk的sample取完, 切到下一个chunk */
+    while(iter->sample_in_chunk >= track->stsc_box[iter->stsc_index].samples_per_chunk){
+        iter->chunk_index++;
+        if(iter->chunk_index >= track->chunk_count){
+            return 0;
+        }
+        while(iter->stsc_index + 1 < track->stsc_entry_count &&
+              iter->chunk_index + 1 >= track->stsc_box[iter->stsc_index + 1].first_chunk){
+            iter->stsc_index++;
+        }
+        iter->sample_in_chunk = 0;
+        iter->offset = demux_pack_cursor_get(&track->chunk_offset_pack, &iter->offset_cursor, iter->chunk_index);
+    }
+
+    *offset = iter->offset;
+    *size = track->sample_size ? track->sample_size :
+            demux_pack_cursor_get(&track->sample_size_pack, &iter->size_cursor, iter->sample_index);
+
+    iter->offset += *size;
+    iter->sample_in_chunk++;
+    iter->sample_index++;
+
+    return 1;
+}
+
+/* 按偏移读取sample数据 */
+int demux_read_at(demux_ctrl_t* demux_ctrl, uint64_t offset, uint8_t* buf, uint32_t len){
+    if(demux_io_read_at(demux_ctrl->io, offset, buf, len) != len){
+        printf("read failed, offset[%lu] len[%u]\n", offset, len);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 把要读的track的sample区间告诉io后端, 远端输入据此合并请求 */
+int demux_plan_read(demux_ctrl_t* demux_ctrl, uint32_t track_mask){
+    demux_sample_iter_t iter;
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    int i = 0;
+
+    if(demux_ctrl == NULL || demux_ctrl->io == NULL){
+        return -1;
+    }
+
+    demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_RESET, 0, 0);
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        if(!(track_mask & (1u << i)) || demux_ctrl->track[i]->sample_count == 0){
+            continue;
+        }
+        if(demux_sample_iter_init(&iter, demux_ctrl->track[i]) < 0){
+            return -1;
+        }
+        while(demux_sample_iter_next(&iter, &offset, &size) > 0){
+            if(demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_WILLNEED, offset, size) < 0){
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* 有输入fd时由sink直接拷贝, 数据在内存中时直接写出, 否则读到缓冲再写 */
+static int demux_output_copy(demux_ctrl_t* demux_ctrl, demux_sink_t* sink, int in_fd, uint64_t offset, uint64_t len){
+    uint8_t buf[DEMUX_COPY_BUFFER_BYTES / 4];
+    uint32_t read_len = 0;
+
+    if(in_fd >= 0){
+        demux_io_access(demux_ctrl->io, offset, len);
+        return demux_sink_copy_range(sink, in_fd, offset, len);
+    }
+    if(demux_ctrl->io->data != NULL){
+        if(offset + len > demux_ctrl->io->size){
+            printf("copy out of range, offset[%lu] len[%lu]\n", offset, len);
+            return -1;
+        }
+        demux_io_access(demux_ctrl->io, offset, len);
+        return demux_sink_write(sink, demux_ctrl->io->data + offset, len);
+    }
+
+    while(len > 0){
+        read_len = len < sizeof(buf) ? len : sizeof(buf);
+        if(demux_read_at(demux_ctrl, offset, buf, read_len) < 0 ||
+           demux_sink_write(sink, buf, read_len) < 0){
+            return -1;
+        }
+        offset += read_len;
+        len -= read_len;
+    }
+
+    return 0;
+}
+
+static int demux_output_annexb_sample(demux_ctrl_t* demux_ctrl, video_ctrl_t* track, demux_sink_t* sink, int in_fd, uint64_t offset, uint32_t size){
+    uint8_t start_code[4] = {0x00, 0x00, 0x00, 0x01};
+    uint8_t sample_buf[DEMUX_COPY_MIN_ZERO_COPY_BYTES];
+    struct iovec iov[DEMUX_OUTPUT_MAX_IOV];
+    uint32_t nal_length_size = track->nal_length_size;
+    uint32_t nal_len = 0;
+    uint32_t pos = 0;
+    int iov_count = 0;
+    int ret = 0;
+    uint32_t i = 0;
+
+    /* 没有avcC时nal_length_size为0, 按长度前缀拆分会原地循环 */
+    if(nal_length_size == 0 || nal_length_size > 4){
+        printf("track %u nal_length_size[%u] error\n", track->track_id, nal_length_size);
+        return -1;
+    }
+
+    if(size < sizeof(sample_buf)){
+        /* 小sample整块读入, 一次writev写出所有nal */
+        if(demux_read_at(demux_ctrl, offset, sample_buf, size) < 0){
+            return -1;
+        }
+        if(demux_ctrl->nal_index != NULL &&
+           demux_nal_index_add_avcc(demux_ctrl->nal_index, sample_buf, size, nal_length_size) < 0){
+            return -1;
+        }
+
+        while(pos + nal_length_size <= size){
+            nal_len = 0;
+            for(i = 0;i < nal_length_size;i++){
+                nal_len = (nal_len << 8) | sample_buf[pos + i];
+            }
+            pos += nal_length_size;
+            if(nal_len > size - pos){
+                printf("nal_len[%u] out of sample size[%u]\n", nal_len, size);
+                return -1;
+            }
+
+            if(iov_count + 2 > DEMUX_OUTPUT_MAX_IOV){
+                ret = demux_sink_writev(sink, iov, iov_count);
+                if(ret < 0){
+                    return -1;
+                }
+                iov_count = 0;
+            }
+            iov[iov_count].iov_base = start_code;
+            iov[iov_count++].iov_len = sizeof(start_code);
+            iov[iov_count].iov_base = sample_buf + pos;
+            iov[iov_count++].iov_len = nal_len;
+            pos += nal_len;
+        }
+
+        return demux_sink_writev(sink, iov, iov_count);
+    }
+
+    /* 大sample只读nal长度(和nal头), nal数据由sink直接从输入fd拷贝 */
+    while(pos + nal_length_size <= size){
+        if(demux_read_at(demux_ctrl, offset + pos, sample_buf, nal_length_size + (pos + nal_length_size < size)) < 0){
+            return -1;
+        }
+        nal_len = 0;
+        for(i = 0;i < nal_length_size;i++){
+            nal_len = (nal_len << 8) | sample_buf[i];
+        }
+        pos += nal_length_size;
+        if(nal_len > size - pos){
+            printf("nal_len[%u] out of sample size[%u]\n", nal_len, size);
+            return -1;
+        }
+        if(demux_ctrl->nal_index != NULL && nal_len > 0 &&
+           demux_nal_index_add(demux_ctrl->nal_index, sample_buf[nal_length_size] & 0x1f, pos, nal_len) < 0){
+            return -1;
+        }
+
+        ret = demux_sink_write(sink, start_code, sizeof(start_code));
+        if(ret < 0){
+            return -1;
+        }
+        ret = demux_output_copy(demux_ctrl, sink, in_fd, offset + pos, nal_len);
+        if(ret < 0){
+            return -1;
+        }
+        pos += nal_len;
+    }
+
+    if(demux_ctrl->nal_index != NULL){
+        return demux_nal_index_end_sample(demux_ctrl->nal_index);
+    }
+
+    return 0;
+}
+
+/* 原样输出时sample数据不经过用户态, 建nal索引只读每个nal的长度和nal头 */
+static int demux_index_sample_nal(demux_ctrl_t* demux_ctrl, video_ctrl_t* track, uint64_t offset, uint32_t size){
+    uint8_t head[4 + 1];
+    uint32_t nal_length_size = track->nal_length_size;
+    uint32_t nal_len = 0;
+    uint32_t pos = 0;
+    uint32_t i = 0;
+
+    if(nal_length_size == 0 || nal_length_size > 4){
+        printf("nal_length_size[%u] error\n", nal_length_size);
+        return -1;
+    }
+
+    while(pos + nal_length_size < size){
+        if(demux_read_at(demux_ctrl, offset + pos, head, nal_length_size + 1) < 0){
+            return -1;
+        }
+        nal_len = 0;
+        for(i = 0;i < nal_length_size;i++){
+            nal_len = (nal_len << 8) | head[i];
+        }
+        pos += nal_length_size;
+        if(nal_len > size - pos){
+            printf("nal_len[%u] out of sample size[%u]\n", nal_len, size);
+            return -1;
+        }
+        if(nal_len > 0 && demux_nal_index_add(demux_ctrl->nal_index, head[nal_length_size] & 0x1f, pos, nal_len) < 0){
+            return -1;
+        }
+        pos += nal_len;
+    }
+
+    return demux_nal_index_end_sample(demux_ctrl->nal_index);
+}
+
+/* 写入sps pps */
+int demux_output_avc_config(video_ctrl_t* track, demux_sink_t* sink){
+    uint8_t start_code[4] = {0x00, 0x00, 0x00, 0x01};
+    struct iovec iov[4];
+
+    iov[0].iov_base = start_code;
+    iov[0].iov_len = sizeof(start_code);
+    iov[1].iov_base = track->sps;
+    iov[1].iov_len = track->sps_len;
+    iov[2].iov_base = start_code;
+    iov[2].iov_len = sizeof(start_code);
+    iov[3].iov_base = track->pps;
+    iov[3].iov_len = track->pps_len;
+
+    return demux_sink_writev(sink, iov, 4);
+}
+
+/* 按output_mode输出单个sample, 不合并区间 */
+int demux_output_sample(demux_ctrl_t* demux_ctrl, video_ctrl_t* track, demux_sink_t* sink, uint64_t offset, uint32_t size){
+    demux_stats_sample(&demux_ctrl->stats, size);
+    if(demux_ctrl->output_mode == DEMUX_OUTPUT_RAW){
+        return demux_output_copy(demux_ctrl, sink, demux_ctrl->io->fd, offset, size);
+    }
+
+    return demux_output_annexb_sample(demux_ctrl, track, sink, demux_ctrl->io->fd, offset, size);
+}
+
+int demux_output_track(demux_ctrl_t* demux_ctrl, int track_index, demux_sink_t* sink){
+    video_ctrl_t* track = NULL;
+    demux_sample_iter_t iter;
+    uint32_t sample_size = 0;
+    uint64_t offset = 0;
+    uint64_t raw_offset = 0;
+    uint64_t raw_len = 0;
+    int in_fd = -1;
+    int ret = 0;
+
+    track = demux_get_track(demux_ctrl, track_index);
+    if(track == NULL || sink == NULL){
+        printf("track[%p] sink[%p] NULL\n", track, sink);
+        return -1;
+    }
+
+    if(demux_ctrl->output_mode == DEMUX_OUTPUT_ANNEXB && strcmp(track->codec, "avc1") != 0){
+        printf("track %u codec[%s] not support annexb output\n", track->track_id, track->codec);
+        return -1;
+    }
+
+    ret = demux_sample_iter_init(&iter, track);
+    if(ret < 0){
+        return -1;
+    }
+    in_fd = demux_ctrl->io->fd;
+    if(demux_plan_read(demux_ctrl, 1u << track_index) < 0){
+        return -1;
+    }
+
+    if(demux_ctrl->output_mode == DEMUX_OUTPUT_ANNEXB){
+        ret = demux_output_avc_config(track, sink);
+    }
+
+    while(ret >= 0 && demux_sample_iter_next(&iter, &offset, &sample_size) > 0){
+        demux_stats_sample(&demux_ctrl->stats, sample_size);
+        if(demux_ctrl->output_mode == DEMUX_OUTPUT_RAW){
+            /* 原样输出, 合并连续的字节区间 */
+            if(raw_len > 0 && raw_offset + raw_len != offset){
+                ret = demux_output_copy(demux_ctrl, sink, in_fd, raw_offset, raw_len);
+                raw_len = 0;
+            }
+            if(raw_len == 0){
+                raw_offset = offset;
+            }
+            raw_len += sample_size;
+            if(demux_ctrl->nal_index != NULL && strcmp(track->codec, "avc1") == 0){
+                ret = demux_index_sample_nal(demux_ctrl, track, offset, sample_size);
+            }
+        }else{
+            ret = demux_output_annexb_sample(demux_ctrl, track, sink, in_fd, offset, sample_size);
+        }
+    }
+
+    if(ret >= 0 && raw_len > 0){
+        ret = demux_output_copy(demux_ctrl, sink, in_fd, raw_offset, raw_len);
+    }
+    if(ret >= 0){
+        ret = demux_sink_flush(sink);
+    }
+
+    printf("track %u output %u samples, %lu bytes, %lu writes\n",
+        track->track_id, iter.sample_index, sink->write_bytes, sink->write_calls);
+
+    return ret;
+}
+
+// stco和co64只是偏移宽度不同, 统一按64位保存
+static int demux_parse_chunk_offset(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size, uint32_t offset_size){
+    video_ctrl_t* track = demux_ctrl->cur_track;
+
+    if(io == NULL || track == NULL){
+        printf("file_path[%p] track[%p] NULL\n", io, track);
+        return -1;
+    }
+    
+    uint8_t version = 0;
+    uint32_t flags = {0};
+
+    if(body_size > 1){
+        demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+        demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
+        printf("#version: %u flags:%x\n", version, flags);
+
+        demux_read_big_endian_data(io, (uint8_t*)&track->chunk_count, sizeof(track->chunk_count));
+        if(track->chunk_count > (body_size - 8) / offset_size){
+            printf("chunk_count[%u] error\n", track->chunk_count);
+            track->chunk_count = 0;
+            return -1;
+        }
+        if(demux_read_pack_table(demux_ctrl, io, &track->chunk_offset_pack, track->chunk_count, offset_size) < 0){
+            track->chunk_count = 0;
+            return -1;
+        }
+        printf("#chunk_count:%u packed %lu bytes, raw %lu bytes\n", track->chunk_count,
+            demux_pack_bytes(&track->chunk_offset_pack), (uint64_t)track->chunk_count * sizeof(uint64_t));
+    }
+
+    return 0;
+}
+
+static int demux_parse_stco_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    return demux_parse_chunk_offset(demux_ctrl, io, body_size, sizeof(uint32_t));
+}
+
+static int demux_parse_co64_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    return demux_parse_chunk_offset(demux_ctrl, io, body_size, sizeof(uint64_t));
+}
+
+static int demux_parse_mvex_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    if(io == NULL){
+        printf("file_path NULL\n");
+        return -1;
+    }
+
+    printf("start parse mvex box\n");
+
+    return 0;
+}
+
+// fragmented mp4中每个track的sample默认值
+static int demux_parse_trex_box(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    video_ctrl_t* track = NULL;
+    uint8_t version = 0;
+    uint32_t flags = 0;
+    uint32_t track_id = 0;
+    uint32_t description_index = 0;
+    uint32_t duration = 0;
+    uint32_t size = 0;
+    uint32_t sample_flags = 0;
+    int i = 0;
+
+    if(io == NULL || body_size < 24){
+        printf("file_path[%p] body_size[%lu] error\n", io, body_size);
+        return -1;
+    }
+
+    demux_read_big_endian_data(io, (uint8_t*)&version, 1);
+    demux_read_big_endian_data(io, (uint8_t*)&flags, 3);
+    demux_read_big_endian_data(io, (uint8_t*)&track_id, sizeof(track_id));
+    demux_read_big_endian_data(io, (uint8_t*)&description_index, sizeof(description_index));
+    demux_read_big_endian_data(io, (uint8_t*)&duration, sizeof(duration));
+    demux_read_big_endian_data(io, (uint8_t*)&size, sizeof(size));
+    demux_read_big_endian_data(io, (uint8_t*)&sample_flags, sizeof(sample_flags));
+    printf("#track_id:%u default duration:%u size:%u flags:%x\n", track_id, duration, size, sample_flags);
+
+    /* mvex在所有trak之后, 按track_id找到对应的track */
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        track = demux_ctrl->track[i];
+        if(track->track_id == track_id){
+            track->trex_default_duration = duration;
+            track->trex_default_size = size;
+            track->trex_default_flags = sample_flags;
+            break;
+        }
+    }
+    demux_io_seek(io, body_size - 24, SEEK_CUR);
+
+    return 0;
+}
+
+static int demux_regsistor_box(demux_ctrl_t* demux_ctrl){
+    int ret = 0;
+    INIT_LIST_HEAD(&demux_ctrl->parse_func_list);
+
+    ret = demux_parse_func_regsistor(demux_ctrl, "ftyp", demux_parse_ftyp_box);
+    if(ret < 0){
+        printf("regsistor ftyp failed\n");
+        return -1;
+    }
+
+    ret = demux_parse_func_regsistor(demux_ctrl, "free", demux_parse_free_box);
+    if(ret < 0){
+        printf("regsistor free failed\n");
+        return -1;
+    }
 
     ret = demux_parse_func_regsistor(demux_ctrl, "mdat", demux_parse_mdat_box);
     if(ret < 0){
@@ -923,6 +1534,12 @@ static int demux_regsistor_box(demux_ctrl_t* demux_ctrl){
         return -1;
     }
 
+    ret = demux_parse_func_regsistor(demux_ctrl, "elst", demux_parse_elst_box);
+    if(ret < 0){
+        printf("regsistor elst failed\n");
+        return -1;
+    }
+
     ret = demux_parse_func_regsistor(demux_ctrl, "mdia", demux_parse_mdia_box);
     if(ret < 0){
         printf("regsistor mdia failed\n");
@@ -989,6 +1606,24 @@ static int demux_regsistor_box(demux_ctrl_t* demux_ctrl){
         return -1;
     }
     
+    ret = demux_parse_func_regsistor(demux_ctrl, "mp4a", demux_parse_mp4a_box);
+    if(ret < 0){
+        printf("regsistor mp4a failed\n");
+        return -1;
+    }
+
+    ret = demux_parse_func_regsistor(demux_ctrl, "esds", demux_parse_esds_box);
+    if(ret < 0){
+        printf("regsistor esds failed\n");
+        return -1;
+    }
+
+    ret = demux_parse_func_regsistor(demux_ctrl, "ctts", demux_parse_ctts_box);
+    if(ret < 0){
+        printf("regsistor ctts failed\n");
+        return -1;
+    }
+
     ret = demux_parse_func_regsistor(demux_ctrl, "stts", demux_parse_stts_box);
     if(ret < 0){
         printf("regsistor mdia failed\n");
@@ -1019,6 +1654,92 @@ static int demux_regsistor_box(demux_ctrl_t* demux_ctrl){
         return -1;
     }
 
+    ret = demux_parse_func_regsistor(demux_ctrl, "co64", demux_parse_co64_box);
+    if(ret < 0){
+        printf("regsistor co64 failed\n");
+        return -1;
+    }
+
+    ret = demux_parse_func_regsistor(demux_ctrl, "mvex", demux_parse_mvex_box);
+    if(ret < 0){
+        printf("regsistor mvex failed\n");
+        return -1;
+    }
+
+    ret = demux_parse_func_regsistor(demux_ctrl, "trex", demux_parse_trex_box);
+    if(ret < 0){
+        printf("regsistor trex failed\n");
+        return -1;
+    }
+
+
+    return 0;
+}
+
+int demux_set_output_mode(demux_ctrl_t* demux_ctrl, int output_mode){
+    if(demux_ctrl == NULL){
+        printf("demux_ctrl NULL\n");
+        return -1;
+    }
+
+    demux_ctrl->output_mode = output_mode;
+
+    return 0;
+}
+
+/* 当前计数的快照, io计数和索引内存在这里取 */
+int demux_get_stats(demux_ctrl_t* demux_ctrl, demux_stats_t* stats){
+    video_ctrl_t* track = NULL;
+    int i = 0;
+
+    if(demux_ctrl == NULL || stats == NULL){
+        printf("demux_ctrl[%p] or stats[%p] NULL\n", demux_ctrl, stats);
+        return -1;
+    }
+
+    *stats = demux_ctrl->stats;
+    if(demux_ctrl->io != NULL){
+        stats->read_bytes = demux_ctrl->io->read_bytes;
+        stats->read_calls = demux_ctrl->io->read_calls;
+        stats->seek_calls = demux_ctrl->io->seek_calls;
+    }
+
+    stats->index_bytes = 0;
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        track = demux_ctrl->track[i];
+        stats->index_bytes += sizeof(video_ctrl_t);
+        stats->index_bytes += track->stts_entry_count * sizeof(stts_box_t);
+        stats->index_bytes += track->ctts_entry_count * sizeof(ctts_box_t);
+        stats->index_bytes += track->stsc_entry_count * sizeof(stsc_box_t);
+        stats->index_bytes += demux_pack_bytes(&track->i_frame_num_pack);
+        stats->index_bytes += demux_pack_bytes(&track->chunk_offset_pack);
+        stats->index_bytes += demux_pack_bytes(&track->sample_size_pack);
+        stats->index_bytes += track->sps_len + track->pps_len + track->audio_config_len;
+    }
+
+    return 0;
+}
+
+/* nal_index由调用者初始化和释放, 传NULL关闭 */
+int demux_set_nal_index(demux_ctrl_t* demux_ctrl, demux_nal_index_t* nal_index){
+    if(demux_ctrl == NULL){
+        printf("demux_ctrl NULL\n");
+        return -1;
+    }
+
+    demux_ctrl->nal_index = nal_index;
+
+    return 0;
+}
+
+/* moov解析线程数, 0按trak数自动选择, 1串行 */
+int demux_set_parse_threads(demux_ctrl_t* demux_ctrl, int threads){
+    if(demux_ctrl == NULL || threads < 0){
+        printf("demux_ctrl[%p] threads[%d] error\n", demux_ctrl, threads);
+        return -1;
+    }
+
+    demux_ctrl->parse_threads = threads;
 
     return 0;
 }
@@ -1037,8 +1758,8 @@ int demux_init(demux_ctrl_t* demux_ctrl, char* file_path, int file_path_len){
     }
     strncpy(demux_ctrl->file_path, file_path, (FILE_PATH_MAX_LENGTH - 1));
     demux_ctrl->file_path_len = file_path_len;
-    ret = demux_open_file(demux_ctrl->file_path, (FILE**)&demux_ctrl->fp);
-    if(ret < 0){
+    demux_ctrl->io = demux_io_open_file(demux_ctrl->file_path);
+    if(demux_ctrl->io == NULL){
         printf("open file failed\n");
         return -1;
     }
@@ -1052,6 +1773,29 @@ int demux_init(demux_ctrl_t* demux_ctrl, char* file_path, int file_path_len){
     pthread_mutex_init(&demux_ctrl->parse_func_lock, NULL);
 
     printf("init successful\n");
+
+    return 0;
+}
+
+/* 从任意io后端打开输入(内存/mmap/远端fetch等), io由demux_close关闭 */
+int demux_init_io(demux_ctrl_t* demux_ctrl, demux_io_t* io){
+    if(demux_ctrl == NULL || io == NULL){
+        printf("demux_ctrl[%p] or io[%p] NULL\n", demux_ctrl, io);
+        return -1;
+    }
+
+    demux_ctrl->io = io;
+
+    if(demux_regsistor_box(demux_ctrl) < 0){
+        printf("demux regsistor failed\n");
+        return -1;
+    }
+
+    pthread_mutex_init(&demux_ctrl->parse_func_lock, NULL);
+
+    printf("init io successful\n");
+
+    return 0;
 }
 
 static int demux_free_parse_func_info(demux_ctrl_t* demux_ctrl){
@@ -1073,7 +1817,23 @@ static int demux_free_parse_func_info(demux_ctrl_t* demux_ctrl){
     return 0;
 }
 
+static void demux_free_track(video_ctrl_t* track){
+    demux_pack_free(&track->i_frame_num_pack);
+    demux_pack_free(&track->chunk_offset_pack);
+    free(track->stsc_box);
+    demux_pack_free(&track->sample_size_pack);
+    free(track->sps);
+    free(track->pps);
+    free(track->stts_box);
+    free(track->ctts_box);
+    free(track->elst);
+    free(track->audio_config);
+    free(track);
+}
+
 int demux_close(demux_ctrl_t* demux_ctrl){
+    int i = 0;
+
     if(demux_ctrl == NULL){
         printf("demux_ctrl NULL\n");
         return -1;
@@ -1081,9 +1841,14 @@ int demux_close(demux_ctrl_t* demux_ctrl){
 
     demux_free_parse_func_info(demux_ctrl);
 
-    if(demux_ctrl->fp != NULL){
-        fclose((FILE*)demux_ctrl->fp);
-        demux_ctrl->fp = NULL;
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        demux_free_track(demux_ctrl->track[i]);
+        demux_ctrl->track[i] = NULL;
+    }
+
+    if(demux_ctrl->io != NULL){
+        demux_io_close(demux_ctrl->io);
+        demux_ctrl->io = NULL;
     }
     pthread_mutex_destroy(&demux_ctrl->parse_func_lock);
 
@@ -1091,18 +1856,56 @@ int demux_close(demux_ctrl_t* demux_ctrl){
     demux_ctrl = NULL;
 
     printf("demux close success\n");
+
+    return 0;
+}
+
+int demux_get_track_count(demux_ctrl_t* demux_ctrl){
+    if(demux_ctrl == NULL){
+        printf("demux_ctrl NULL\n");
+        return -1;
+    }
+
+    return demux_ctrl->track_count;
+}
+
+video_ctrl_t* demux_get_track(demux_ctrl_t* demux_ctrl, int track_index){
+    if(demux_ctrl == NULL || track_index < 0 || track_index >= demux_ctrl->track_count){
+        printf("demux_ctrl[%p] track_index[%d] error\n", demux_ctrl, track_index);
+        return NULL;
+    }
+
+    return demux_ctrl->track[track_index];
+}
+
+/* 按handler类型(vide/soun)查找第一个track */
+int demux_find_track(demux_ctrl_t* demux_ctrl, const char* handler_type){
+    int i = 0;
+
+    if(demux_ctrl == NULL || handler_type == NULL){
+        printf("demux_ctrl[%p] handler_type[%p] NULL\n", demux_ctrl, handler_type);
+        return -1;
+    }
+
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        if(strncmp(demux_ctrl->track[i]->handler_type, handler_type, 4) == 0){
+            return i;
+        }
+    }
+
+    return -1;
 }
 
-static int demux_read_box_size(FILE* fp, uint64_t* box_size){
+static int demux_read_box_size(demux_io_t* io, uint64_t* box_size){
     int32_t read_size = 0;
     int32_t ret = 0;
 
-    if(fp == NULL){
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
-    ret = demux_read_big_endian_data(fp, (uint8_t*)box_size, BOX_SIZE_BYTE);
+    ret = demux_read_big_endian_data(io, (uint8_t*)box_size, BOX_SIZE_BYTE);
     if(ret < 0){
         printf("read box size failed\n");
         return -1;
@@ -1111,57 +1914,51 @@ static int demux_read_box_size(FILE* fp, uint64_t* box_size){
     return 0;
 }
 
-int demux_read_a_box_head(FILE* fp, char* box_type, uint64_t* body_size){
+int demux_read_a_box_head(demux_io_t* io, char* box_type, uint64_t* body_size){
     int read_size = 0;
     uint64_t box_size = 0;
     int ret = -1;
 
-    if(fp == NULL){
+    if(io == NULL){
         printf("file_path NULL\n");
         return -1;
     }
 
-    ret = demux_read_box_size(fp, &box_size);
+    ret = demux_read_box_size(io, &box_size);
     if(ret < 0){
         printf("read end\n");
         return -1;
     }
 
-    if(box_size == 0){
-        /* large size */
-        printf("the large size\n");
+    read_size = demux_io_read(io, box_type, BOX_TYPE_BYTE);
+    if(read_size < BOX_TYPE_BYTE){
+        printf("read box type failed, read_size[%d]\n", read_size);
+        return -1;
+    }
 
-        read_size = fread(&box_size, 1, BOX_LARGE_SZIE_BYTE, fp);
-        if(read_size < BOX_LARGE_SZIE_BYTE){
-            printf("read box type failed, read_size[%d]\n", read_size);
-            return -1;
-        }
-        *body_size = box_size - BOX_HEAD_BYTE;
+    if(box_size == 1){
+        /* large size, type之后跟8字节的真实大小 */
+        printf("the large size\n");
 
-        read_size = fread(box_type, 1, BOX_TYPE_BYTE, fp);
-        if(read_size < BOX_TYPE_BYTE){
-            printf("read box type failed, read_size[%d]\n", read_size);
+        ret = demux_read_big_endian_data(io, (uint8_t*)&box_size, BOX_LARGE_SZIE_BYTE);
+        if(ret < 0 || box_size < BOX_HEAD_BYTE + BOX_LARGE_SZIE_BYTE){
+            printf("read large size failed, box_size[%lu]\n", box_size);
             return -1;
         }
-
-        // TODO
-    }else if(box_size == 1){
-        /* the last box */
+        *body_size = box_size - BOX_HEAD_BYTE - BOX_LARGE_SZIE_BYTE;
+    }else if(box_size == 0){
+        /* the last box, 一直延伸到文件末尾 */
         printf("the last box\n");
-        return -1;
-        // TODO
+
+        *body_size = demux_io_size(io) - demux_io_tell(io);
+        box_size = *body_size + BOX_HEAD_BYTE;
     }else if(box_size >= BOX_HEAD_BYTE){
         /* normal status */
-        read_size = fread(box_type, 1, BOX_TYPE_BYTE, fp);
-        if(read_size < BOX_TYPE_BYTE){
-            printf("read box type failed, read_size[%d]\n", read_size);
-            return -1;
-        }
-
         *body_size = box_size - BOX_HEAD_BYTE;
     }else{
         /* error status*/
-        // TODO
+        printf("box size[%lu] error\n", box_size);
+        return -1;
     }
 
     printf("\n##### box_type:%s #####\n\n", box_type);
@@ -1190,24 +1987,33 @@ int demux_handle_box_body(demux_ctrl_t* demux_ctrl){
     int ret = -1;
     char box_type[4 + 1] = {0};
     uint64_t body_size = 0;
+    uint64_t box_size = 0;
+    uint64_t start_ns = 0;
     DEMUX_BOX_PARSE demux_parse_box_func = NULL;
 
     // 读一个box head
-    ret = demux_read_a_box_head((FILE*)demux_ctrl->fp, box_type, &body_size);
+    box_size = demux_io_tell(demux_ctrl->io);
+    ret = demux_read_a_box_head(demux_ctrl->io, box_type, &body_size);
     if(ret < 0){
         printf("read a box failed [%d]\n", ret);
         return -1;
     }
+    box_size = demux_io_tell(demux_ctrl->io) - box_size + body_size;
 
     // 获取处理box body的方法
     demux_parse_box_func = demux_get_parse_func(demux_ctrl, box_type);
     if(demux_parse_box_func == NULL){
-        printf("get %s func error\n", box_type);
-        return -1;
+        // 未注册的box直接跳过
+        printf("skip %s box\n", box_type);
+        demux_io_seek(demux_ctrl->io, body_size, SEEK_CUR);
+        demux_stats_box(&demux_ctrl->stats, box_type, box_size, 0);
+        return 0;
     }
 
     // 解析body
-    ret = demux_parse_box_func((FILE*)demux_ctrl->fp, body_size);
+    start_ns = demux_stats_now_ns();
+    ret = demux_parse_box_func(demux_ctrl, demux_ctrl->io, body_size);
+    demux_stats_box(&demux_ctrl->stats, box_type, box_size, demux_stats_now_ns() - start_ns);
     if(ret < 0){
         printf("demux_parse_box_func error %d\n", ret);
         return -1;
@@ -1,6 +1,15 @@
+#ifndef __DEMUX_H
+#define __DEMUX_H
+
+#include <stdio.h>
 #include <stdint.h>
 #include <pthread.h>
 #include "list.h"
+#include "demux_sink.h"
+#include "demux_io.h"
+#include "demux_pack.h"
+#include "demux_nal.h"
+#include "demux_stats.h"
 
 #define BOX_HEAD_BYTE 8
 #define FULL_BOX_HEAD_BYTE 20
@@ -9,8 +18,10 @@
 #define BOX_LARGE_SZIE_BYTE 8
 #define BOX_VERSION_BYTE 1
 #define BOX_FLAGS_BYTE 3
+#define FULL_BOX_VERSION_FLAGS_BYTE (BOX_VERSION_BYTE + BOX_FLAGS_BYTE)
 
 #define FILE_PATH_MAX_LENGTH 256
+#define DEMUX_MAX_TRACK_NUM 32
 
 #define FYTP_BOX_MAJOR_BRAND_BYTE 4
 #define FYTP_BOX_MINOR_VERSION_BYTE 4
@@ -23,6 +34,11 @@ enum DEMUX_MP4_BOX_TYPE{
     DEMUX_MP4_MVHD_BOX
 };
 
+enum DEMUX_OUTPUT_MODE{
+    DEMUX_OUTPUT_ANNEXB,    // avcc转annexb, 插入start code和sps/pps
+    DEMUX_OUTPUT_RAW        // sample原样输出, 全程内核拷贝
+};
+
 typedef struct demux_parse_func_info
 {
     char box_type[8];
@@ -30,17 +46,130 @@ typedef struct demux_parse_func_info
     struct list_head node;
 }demux_parse_func_info_t;
 
+typedef struct stsc_box{
+    uint32_t first_chunk;
+    uint32_t samples_per_chunk; 
+    uint32_t sample_description_index;
+}stsc_box_t;
+
+typedef struct stts_box{
+    uint32_t sample_count;
+    uint32_t sample_delta;
+}stts_box_t;
+
+typedef struct ctts_box{
+    uint32_t sample_count;
+    int32_t sample_offset;
+}ctts_box_t;
+
+/* 编辑列表的一项, segment_duration为movie timescale, media_time为track timescale, -1表示空编辑(延迟) */
+typedef struct elst_entry{
+    uint64_t segment_duration;
+    int64_t media_time;
+    int32_t media_rate;         // 16.16
+}elst_entry_t;
+
+/* 每个trak一份, 保存解析出的sample表 */
+typedef struct  video_ctrl{
+    uint32_t track_id;
+    char handler_type[4 + 1];   // vide/soun
+    char codec[4 + 1];          // avc1/mp4a
+    uint32_t timescale;
+    uint64_t duration;
+
+    uint32_t stts_entry_count;
+    stts_box_t* stts_box;
+    uint32_t ctts_entry_count;
+    ctts_box_t* ctts_box;
+    uint32_t elst_entry_count;
+    elst_entry_t* elst;
+
+    /* 逐sample/逐chunk的表按block压缩保存, 见demux_pack.h */
+    int stss_present;           // 没有stss时每个sample都是关键帧
+    uint32_t i_frame_count;
+    demux_pack_t i_frame_num_pack;
+
+    uint32_t chunk_count;
+    demux_pack_t chunk_offset_pack;
+    
+    uint32_t stsc_entry_count;
+    stsc_box_t* stsc_box;
+    
+    uint32_t sample_count;
+    uint32_t sample_size;
+    demux_pack_t sample_size_pack;
+
+    uint32_t sps_len;
+    int8_t* sps;
+    uint32_t pps_len;
+    int8_t* pps;
+    uint32_t nal_length_size;
+    uint16_t width;
+    uint16_t height;
+
+    uint16_t channel_count;
+    uint32_t sample_rate;
+    uint32_t audio_config_len;
+    uint8_t* audio_config;      // AudioSpecificConfig
+
+    /* fragmented mp4: mvex/trex中的默认值, traf中没有给出时使用 */
+    uint32_t trex_default_duration;
+    uint32_t trex_default_size;
+    uint32_t trex_default_flags;
+}video_ctrl_t;
+
+/* 顺序遍历sample, 按stsc把sample映射到chunk */
+typedef struct demux_sample_iter{
+    video_ctrl_t* track;
+    uint32_t chunk_index;
+    uint32_t stsc_index;
+    uint32_t sample_in_chunk;
+    uint32_t sample_index;
+    uint64_t offset;
+    demux_pack_cursor_t size_cursor;
+    demux_pack_cursor_t offset_cursor;
+}demux_sample_iter_t;
+
 typedef struct demux_ctrl
 {
-    void* fp;
+    demux_io_t* io;
     char file_path[256];
     int file_path_len;
     pthread_mutex_t parse_func_lock;
     struct list_head parse_func_list;
+
+    int output_mode;
+    uint32_t movie_timescale;   // mvhd, elst中segment_duration的单位
+    int parse_threads;          // 并行解析trak的线程数, 0按trak数自动选择, 1串行, 见demux_parallel.h
+    int track_count;
+    video_ctrl_t* track[DEMUX_MAX_TRACK_NUM];
+    video_ctrl_t* cur_track;
+
+    demux_nal_index_t* nal_index;   // 不为NULL时输出avc1 track时顺带建立每个sample的nal索引
+    demux_stats_t stats;
 }demux_ctrl_t;
 
-typedef int (*DEMUX_BOX_PARSE)(FILE* fp, uint64_t body_size);
+typedef int (*DEMUX_BOX_PARSE)(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size);
 
 extern int demux_init(demux_ctrl_t* demux_ctrl, char* file_path, int file_path_len);
+extern int demux_init_io(demux_ctrl_t* demux_ctrl, demux_io_t* io);
+extern int demux_set_output_mode(demux_ctrl_t* demux_ctrl, int output_mode);
+extern int demux_set_parse_threads(demux_ctrl_t* demux_ctrl, int threads);
+extern int demux_set_nal_index(demux_ctrl_t* demux_ctrl, demux_nal_index_t* nal_index);
+extern int demux_get_stats(demux_ctrl_t* demux_ctrl, demux_stats_t* stats);
 extern int demux_close(demux_ctrl_t* demux_ctrl);
-extern int demux_handle_box_body(demux_ctrl_t* demux_ctrl);
\ No newline at end of file
+extern int demux_handle_box_body(demux_ctrl_t* demux_ctrl);
+extern int demux_read_a_box_head(demux_io_t* io, char* box_type, uint64_t* body_size);
+
+extern int demux_get_track_count(demux_ctrl_t* demux_ctrl);
+extern video_ctrl_t* demux_get_track(demux_ctrl_t* demux_ctrl, int track_index);
+extern int demux_find_track(demux_ctrl_t* demux_ctrl, const char* handler_type);
+extern int demux_sample_iter_init(demux_sample_iter_t* iter, video_ctrl_t* track);
+extern int demux_sample_iter_next(demux_sample_iter_t* iter, uint64_t* offset, uint32_t* size);
+extern int demux_read_at(demux_ctrl_t* demux_ctrl, uint64_t offset, uint8_t* buf, uint32_t len);
+extern int demux_plan_read(demux_ctrl_t* demux_ctrl, uint32_t track_mask);
+extern int demux_output_track(demux_ctrl_t* demux_ctrl, int track_index, demux_sink_t* sink);
+extern int demux_output_avc_config(video_ctrl_t* track, demux_sink_t* sink);
+extern int demux_output_sample(demux_ctrl_t* demux_ctrl, video_ctrl_t* track, demux_sink_t* sink, uint64_t offset, uint32_t size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "demux_analytics.h"
+#include "demux_timeline.h"
+
+static void demux_analytics_reduce_c(const uint64_t* values, uint32_t n, uint64_t* sum, uint64_t* min, uint64_t* max){
+    uint32_t i = 0;
+
+    for(i = 0;i < n;i++){
+        *sum += values[i];
+        if(values[i] < *min){
+            *min = values[i];
+        }
+        if(values[i] > *max){
+            *max = values[i];
+        }
+    }
+}
+
+/*
+ * 每次处理4个值, 各lane分别累加和比较, 最后合并lane, 不够4个的尾部逐个处理
+ * sample大小来自stsz的32位字段, SSE2/NEON没有64位比较, 取低32位比较最小/最大值, 和仍按64位累加
+ */
+void demux_analytics_reduce(const uint64_t* values, uint32_t n, uint64_t* sum, uint64_t* min, uint64_t* max){
+    uint32_t i = 0;
+#if defined(__AVX2__)
+    __m256i vsum, vmin, vmax, v;
+    uint64_t lane_sum[4], lane_min[4], lane_max[4];
+    uint64_t unused = 0;
+
+    if(n >= 4){
+        vsum = _mm256_setzero_si256();
+        vmin = _mm256_loadu_si256((const __m256i*)values);
+        vmax = vmin;
+        for(i = 0;i + 4 <= n;i += 4){
+            v = _mm256_loadu_si256((const __m256i*)(values + i));
+            vsum = _mm256_add_epi64(vsum, v);
+            vmin = _mm256_blendv_epi8(vmin, v, _mm256_cmpgt_epi64(vmin, v));
+            vmax = _mm256_blendv_epi8(vmax, v, _mm256_cmpgt_epi64(v, vmax));
+        }
+        _mm256_storeu_si256((__m256i*)lane_sum, vsum);
+        _mm256_storeu_si256((__m256i*)lane_min, vmin);
+        _mm256_storeu_si256((__m256i*)lane_max, vmax);
+        *sum += lane_sum[0] + lane_sum[1] + lane_sum[2] + lane_sum[3];
+        demux_analytics_reduce_c(lane_min, 4, &unused, min, &unused);
+        demux_analytics_reduce_c(lane_max, 4, &unused, &unused, max);
+    }
+#elif defined(__SSE2__)
+    /* 无符号比较: 异或0x80000000后按有符号比较 */
+    const __m128i bias = _mm_set1_epi32((int)0x80000000);
+    __m128i vsum, vmin, vmax, a, b, v, mask;
+    uint64_t lane_sum[2];
+    uint32_t lane[4];
+    uint64_t value = 0;
+    uint64_t unused = 0;
+    uint32_t j = 0;
+
+    if(n >= 4){
+        vsum = _mm_setzero_si128();
+        vmin = _mm_set1_epi32((int)(0xffffffffu ^ 0x80000000u));
+        vmax = _mm_set1_epi32((int)(0u ^ 0x80000000u));
+        for(i = 0;i + 4 <= n;i += 4){
+            a = _mm_loadu_si128((const __m128i*)(values + i));
+            b = _mm_loadu_si128((const __m128i*)(values + i + 2));
+            vsum = _mm_add_epi64(vsum, _mm_add_epi64(a, b));
+            /* 取4个值的低32位放到一个向量 */
+            v = _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0)));
+            v = _mm_xor_si128(v, bias);
+            mask = _mm_cmpgt_epi32(vmin, v);
+            vmin = _mm_or_si128(_mm_and_si128(mask, v), _mm_andnot_si128(mask, vmin));
+            mask = _mm_cmpgt_epi32(v, vmax);
+            vmax = _mm_or_si128(_mm_and_si128(mask, v), _mm_andnot_si128(mask, vmax));
+        }
+        _mm_storeu_si128((__m128i*)lane_sum, vsum);
+        *sum += lane_sum[0] + lane_sum[1];
+        _mm_storeu_si128((__m128i*)lane, _mm_xor_si128(vmin, bias));
+        for(j = 0;j < 4;j++){
+            value = lane[j];
+            demux_analytics_reduce_c(&value, 1, &unused, min, &unused);
+        }
+        _mm_storeu_si128((__m128i*)lane, _mm_xor_si128(vmax, bias));
+        for(j = 0;j < 4;j++){
+            value = lane[j];
+            demux_analytics_reduce_c(&value, 1, &unused, &unused, max);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint64x2_t vsum, a, b;
+    uint32x4_t vmin, vmax, v;
+    uint64_t value = 0;
+    uint64_t unused = 0;
+
+    if(n >= 4){
+        vsum = vdupq_n_u64(0);
+        vmin = vdupq_n_u32(0xffffffffu);
+        vmax = vdupq_n_u32(0);
+        for(i = 0;i + 4 <= n;i += 4){
+            a = vld1q_u64(values + i);
+            b = vld1q_u64(values + i + 2);
+            vsum = vaddq_u64(vsum, vaddq_u64(a, b));
+            v = vcombine_u32(vmovn_u64(a), vmovn_u64(b));
+            vmin = vminq_u32(vmin, v);
+            vmax = vmaxq_u32(vmax, v);
+        }
+        *sum += vaddvq_u64(vsum);
+        value = vminvq_u32(vmin);
+        demux_analytics_reduce_c(&value, 1, &unused, min, &unused);
+        value = vmaxvq_u32(vmax);
+        demux_analytics_reduce_c(&value, 1, &unused, &unused, max);
+    }
+#endif
+
+    demux_analytics_reduce_c(values + i, n - i, sum, min, max);
+}
+
+/* stss中下一个大于current的关键帧(0开始的序号), 没有时返回sample_count */
+static uint32_t demux_analytics_next_key(video_ctrl_t* track, demux_pack_cursor_t* cursor, uint32_t* key_index, uint32_t current){
+    uint32_t sample_index = 0;
+
+    while(*key_index < track->i_frame_count){
+        sample_index = (uint32_t)demux_pack_cursor_get(&track->i_frame_num_pack, cursor, *key_index) - 1;
+        if(sample_index > current && sample_index < track->sample_count){
+            return sample_index;
+        }
+        (*key_index)++;
+    }
+
+    return track->sample_count;
+}
+
+static int demux_analytics_add_gop(demux_analytics_t* analytics, uint32_t first_sample, int64_t dts){
+    demux_analytics_gop_t* gops = NULL;
+
+    if(analytics->gop_count >= analytics->gop_cap){
+        gops = (demux_analytics_gop_t*)realloc(analytics->gops, (analytics->gop_cap ? analytics->gop_cap * 2 : 64) * sizeof(demux_analytics_gop_t));
+        if(gops == NULL){
+            printf("analytics gop realloc failed\n");
+            return -1;
+        }
+        analytics->gops = gops;
+        analytics->gop_cap = analytics->gop_cap ? analytics->gop_cap * 2 : 64;
+    }
+    memset(&analytics->gops[analytics->gop_count], 0, sizeof(demux_analytics_gop_t));
+    analytics->gops[analytics->gop_count].first_sample = first_sample;
+    analytics->gops[analytics->gop_count].dts_start = dts;
+    analytics->gop_count++;
+
+    return 0;
+}
+
+/*
+ * 按sample顺序走一遍: 当前block, 当前秒, 当前GOP三者的边界中最近的一个把sample分段
+ * 每段做一次求和/最小/最大, 加到对应的秒和GOP上
+ */
+int demux_analytics_build(demux_ctrl_t* demux_ctrl, int track_index, demux_analytics_t* analytics){
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+    demux_timeline_t timeline;
+    demux_pack_cursor_t stss_cursor;
+    demux_analytics_gop_t* gop = NULL;
+    uint64_t values[DEMUX_PACK_BLOCK_SIZE];
+    uint64_t sum = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    uint64_t seg_min = 0;
+    uint64_t seg_max = 0;
+    uint32_t block_end = 0;
+    uint32_t second = 0;
+    uint32_t second_end = 0;
+    uint32_t gop_next = 0;
+    uint32_t key_index = 0;
+    uint32_t seg_end = 0;
+    uint32_t i = 0;
+    int64_t span = 0;
+    double bitrate = 0;
+
+    if(analytics == NULL || track == NULL){
+        printf("analytics[%p] track_index[%d] error\n", analytics, track_index);
+        return -1;
+    }
+    if(track->timescale == 0 ||
+       (track->sample_size == 0 && track->sample_size_pack.count < track->sample_count)){
+        printf("track %u sample table error\n", track->track_id);
+        return -1;
+    }
+
+    memset(analytics, 0, sizeof(demux_analytics_t));
+    if(demux_timeline_build(&timeline, demux_ctrl, track_index) < 0){
+        return -1;
+    }
+    analytics->track = track;
+    analytics->timescale = track->timescale;
+    analytics->sample_count = track->sample_count;
+    analytics->duration = timeline.end_dts;
+    analytics->second_count = (uint32_t)(timeline.end_dts / track->timescale) + 1;
+    analytics->second_bytes = (uint64_t*)calloc(analytics->second_count, sizeof(uint64_t));
+    if(analytics->second_bytes == NULL){
+        printf("analytics second calloc failed\n");
+        demux_timeline_free(&timeline);
+        return -1;
+    }
+
+    memset(&stss_cursor, 0, sizeof(demux_pack_cursor_t));
+    /* 没有stss时每个sample都是关键帧(音频/全I帧), 按GOP统计没有意义, 不统计GOP */
+    gop_next = track->stss_present ? 0 : track->sample_count;
+    i = 0;
+    while(i < track->sample_count){
+        if(i >= block_end){
+            block_end = i + DEMUX_PACK_BLOCK_SIZE;
+            if(block_end > track->sample_count){
+                block_end = track->sample_count;
+            }
+            if(track->sample_size == 0){
+                demux_pack_decode_block(&track->sample_size_pack, i / DEMUX_PACK_BLOCK_SIZE, values);
+            }
+        }
+        if(i >= second_end){
+            second = (uint32_t)(demux_timeline_dts(&timeline, i) / track->timescale);
+            second_end = demux_timeline_find(&timeline, (int64_t)(second + 1) * track->timescale - 1) + 1;
+            /* find返回的下标不会小于i, 这里保证每轮至少前进一个sample */
+            if(second_end <= i){
+                second_end = i + 1;
+            }
+        }
+        if(i >= gop_next){
+            /* 第一个sample不是关键帧时, 它之前的sample也算作一个GOP */
+            if(demux_analytics_add_gop(analytics, i, demux_timeline_dts(&timeline, i)) < 0){
+                demux_timeline_free(&timeline);
+                demux_analytics_free(analytics);
+                return -1;
+            }
+            gop_next = demux_analytics_next_key(track, &stss_cursor, &key_index, i);
+        }
+
+        seg_end = block_end;
+        if(second_end < seg_end){
+            seg_end = second_end;
+        }
+        if(gop_next < seg_end){
+            seg_end = gop_next;
+        }
+        if(seg_end <= i){
+            printf("analytics sample[%u] seg_end[%u] error\n", i, seg_end);
+            demux_timeline_free(&timeline);
+            demux_analytics_free(analytics);
+            return -1;
+        }
+
+        sum = 0;
+        if(track->sample_size){
+            sum = (uint64_t)(seg_end - i) * track->sample_size;
+            seg_min = track->sample_size;
+            seg_max = track->sample_size;
+        }else{
+            seg_min = UINT64_MAX;
+            seg_max = 0;
+            demux_analytics_reduce(values + i % DEMUX_PACK_BLOCK_SIZE, seg_end - i, &sum, &seg_min, &seg_max);
+        }
+        if(seg_min < min){
+            min = seg_min;
+        }
+        if(seg_max > max){
+            max = seg_max;
+        }
+        if(second < analytics->second_count){
+            analytics->second_bytes[second] += sum;
+        }
+        if(analytics->gop_count > 0){
+            analytics->gops[analytics->gop_count - 1].bytes += sum;
+        }
+        analytics->bytes += sum;
+        i = seg_end;
+    }
+
+    analytics->min_size = track->sample_count ? (uint32_t)min : 0;
+    analytics->max_size = (uint32_t)max;
+    if(analytics->duration > 0){
+        analytics->avg_bitrate = (double)analytics->bytes * 8 * track->timescale / analytics->duration;
+    }
+    for(i = 0;i < analytics->second_count;i++){
+        if(analytics->second_bytes[i] * 8.0 > analytics->peak_bitrate){
+            analytics->peak_bitrate = analytics->second_bytes[i] * 8.0;
+        }
+    }
+    for(i = 0;i < analytics->gop_count;i++){
+        gop = &analytics->gops[i];
+        if(i + 1 < analytics->gop_count){
+            gop->sample_count = analytics->gops[i + 1].first_sample - gop->first_sample;
+            gop->dts_end = analytics->gops[i + 1].dts_start;
+        }else{
+            gop->sample_count = track->sample_count - gop->first_sample;
+            gop->dts_end = timeline.end_dts;
+        }
+        analytics->gop_hist[gop->sample_count < DEMUX_ANALYTICS_HIST_SIZE ? gop->sample_count : DEMUX_ANALYTICS_HIST_SIZE - 1]++;
+        span = gop->dts_end - gop->dts_start;
+        if(span > 0){
+            bitrate = (double)gop->bytes * 8 * track->timescale / span;
+            if(bitrate > analytics->peak_gop_bitrate){
+                analytics->peak_gop_bitrate = bitrate;
+            }
+        }
+    }
+    demux_timeline_free(&timeline);
+
+    return 0;
+}
+
+void demux_analytics_print(const demux_analytics_t* analytics){
+    const demux_analytics_gop_t* gop = NULL;
+    int64_t span = 0;
+    uint32_t i = 0;
+
+    printf("track %u %s samples[%u] bytes[%lu] %.3fs, frame size min[%u] max[%u], bitrate avg %.1f kbps peak %.1f kbps, gop[%u] peak %.1f kbps\n",
+        analytics->track->track_id, analytics->track->handler_type, analytics->sample_count, analytics->bytes,
+        (double)analytics->duration / analytics->timescale, analytics->min_size, analytics->max_size,
+        analytics->avg_bitrate / 1000, analytics->peak_bitrate / 1000, analytics->gop_count, analytics->peak_gop_bitrate / 1000);
+    for(i = 0;i < analytics->second_count;i++){
+        printf("  second %u: %lu bytes %.1f kbps\n", i, analytics->second_bytes[i], analytics->second_bytes[i] * 8.0 / 1000);
+    }
+    for(i = 0;i < analytics->gop_count;i++){
+        gop = &analytics->gops[i];
+        span = gop->dts_end - gop->dts_start;
+        printf("  gop %u: sample %u count %u %.3fs ~ %.3fs, %lu bytes %.1f kbps\n", i, gop->first_sample, gop->sample_count,
+            (double)gop->dts_start / analytics->timescale, (double)gop->dts_end / analytics->timescale, gop->bytes,
+            span > 0 ? (double)gop->bytes * 8 * analytics->timescale / span / 1000 : 0);
+    }
+    for(i = 0;i < DEMUX_ANALYTICS_HIST_SIZE;i++){
+        if(analytics->gop_hist[i] > 0){
+            printf("  keyframe interval %s%u frames: %u\n", i == DEMUX_ANALYTICS_HIST_SIZE - 1 ? ">=" : "", i, analytics->gop_hist[i]);
+        }
+    }
+}
+
+int demux_analytics_dump_json(const demux_analytics_t* analytics, FILE* fp){
+    const demux_analytics_gop_t* gop = NULL;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    if(analytics == NULL || fp == NULL){
+        return -1;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"track_id\": %u,\n", analytics->track->track_id);
+    fprintf(fp, "  \"timescale\": %u,\n", analytics->timescale);
+    fprintf(fp, "  \"sample_count\": %u,\n", analytics->sample_count);
+    fprintf(fp, "  \"bytes\": %lu,\n", analytics->bytes);
+    fprintf(fp, "  \"duration\": %ld,\n", analytics->duration);
+    fprintf(fp, "  \"min_size\": %u,\n", analytics->min_size);
+    fprintf(fp, "  \"max_size\": %u,\n", analytics->max_size);
+    fprintf(fp, "  \"avg_bitrate\": %.0f,\n", analytics->avg_bitrate);
+    fprintf(fp, "  \"peak_bitrate\": %.0f,\n", analytics->peak_bitrate);
+    fprintf(fp, "  \"peak_gop_bitrate\": %.0f,\n", analytics->peak_gop_bitrate);
+    fprintf(fp, "  \"second_bytes\": [");
+    for(i = 0;i < analytics->second_count;i++){
+        fprintf(fp, "%s%lu", i == 0 ? "" : ", ", analytics->second_bytes[i]);
+    }
+    fprintf(fp, "],\n");
+    fprintf(fp, "  \"gops\": [");
+    for(i = 0;i < analytics->gop_count;i++){
+        gop = &analytics->gops[i];
+        fprintf(fp, "%s\n    {\"first_sample\": %u, \"sample_count\": %u, \"dts_start\": %ld, \"dts_end\": %ld, \"bytes\": %lu}",
+            i == 0 ? "" : ",", gop->first_sample, gop->sample_count, gop->dts_start, gop->dts_end, gop->bytes);
+    }
+    fprintf(fp, "%s],\n", analytics->gop_count > 0 ? "\n  " : "");
+    fprintf(fp, "  \"keyframe_interval\": {");
+    for(i = 0;i < DEMUX_ANALYTICS_HIST_SIZE;i++){
+        if(analytics->gop_hist[i] > 0){
+            fprintf(fp, "%s\"%u\": %u", count == 0 ? "" : ", ", i, analytics->gop_hist[i]);
+            count++;
+        }
+    }
+    fprintf(fp, "}\n}\n");
+
+    return 0;
+}
+
+void demux_analytics_free(demux_analytics_t* analytics){
+    if(analytics == NULL){
+        return;
+    }
+
+    free(analytics->second_bytes);
+    analytics->second_bytes = NULL;
+    free(analytics->gops);
+    analytics->gops = NULL;
+    analytics->gop_count = 0;
+    analytics->gop_cap = 0;
+}
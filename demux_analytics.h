@@ -0,0 +1,56 @@
+#ifndef __DEMUX_ANALYTICS_H
+#define __DEMUX_ANALYTICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "demux.h"
+
+/*
+ * 码率/GOP统计: 只用sample表(stsz/stss/stts), 不读sample数据, 一遍算出
+ * 每秒码率, 每个GOP的码率, 平均和峰值码率, 关键帧间隔直方图, 最小/最大帧大小
+ * sample大小按压缩表的block解出后用SIMD求和/最小/最大, 秒和GOP的边界由时间线和stss给出
+ * 没有stss的track(音频/全I帧)不统计GOP, gop_count为0
+ */
+
+#define DEMUX_ANALYTICS_HIST_SIZE 256   // 关键帧间隔(帧数)直方图, 最后一格为>=HIST_SIZE-1
+
+typedef struct demux_analytics_gop
+{
+    uint32_t first_sample;
+    uint32_t sample_count;
+    uint64_t bytes;
+    int64_t dts_start;
+    int64_t dts_end;
+}demux_analytics_gop_t;
+
+typedef struct demux_analytics
+{
+    video_ctrl_t* track;
+    uint32_t timescale;
+    uint32_t sample_count;
+    uint64_t bytes;
+    int64_t duration;           // track timescale
+    uint32_t min_size;
+    uint32_t max_size;
+    double avg_bitrate;         // bit/s
+    double peak_bitrate;        // 每秒码率的最大值
+    double peak_gop_bitrate;
+
+    uint64_t* second_bytes;     // 第i秒[i, i+1)内sample的字节数, 按dts归属
+    uint32_t second_count;
+
+    demux_analytics_gop_t* gops;
+    uint32_t gop_count;
+    uint32_t gop_cap;
+    uint32_t gop_hist[DEMUX_ANALYTICS_HIST_SIZE];
+}demux_analytics_t;
+
+/* n个值的和/最小/最大, n为0时不修改min/max */
+extern void demux_analytics_reduce(const uint64_t* values, uint32_t n, uint64_t* sum, uint64_t* min, uint64_t* max);
+
+extern int demux_analytics_build(demux_ctrl_t* demux_ctrl, int track_index, demux_analytics_t* analytics);
+extern void demux_analytics_print(const demux_analytics_t* analytics);
+extern int demux_analytics_dump_json(const demux_analytics_t* analytics, FILE* fp);
+extern void demux_analytics_free(demux_analytics_t* analytics);
+
+#endif
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux.h"
+#include "demux_box.h"
+
+/* 在data中从pos处取一个box, 成功返回1, 到末尾返回0 */
+int demux_box_next(const uint8_t* data, uint64_t len, uint64_t* pos, demux_box_info_t* box){
+    uint64_t size = 0;
+    uint32_t header_size = BOX_HEAD_BYTE;
+
+    if(*pos + BOX_HEAD_BYTE > len){
+        return 0;
+    }
+
+    size = demux_get_be32(data + *pos);
+    if(size == 1){
+        if(*pos + BOX_HEAD_BYTE + BOX_LARGE_SZIE_BYTE > len){
+            printf("large size box out of range, pos[%lu]\n", *pos);
+            return -1;
+        }
+        size = demux_get_be64(data + *pos + BOX_HEAD_BYTE);
+        header_size += BOX_LARGE_SZIE_BYTE;
+    }else if(size == 0){
+        size = len - *pos;
+    }
+
+    if(size < header_size || size > len - *pos){
+        printf("box size[%lu] error, pos[%lu] len[%lu]\n", size, *pos, len);
+        return -1;
+    }
+
+    memcpy(box->type, data + *pos + BOX_SIZE_BYTE, BOX_TYPE_BYTE);
+    box->type[BOX_TYPE_BYTE] = 0;
+    box->offset = *pos;
+    box->size = size;
+    box->header_size = header_size;
+    *pos += size;
+
+    return 1;
+}
+
+/* 在同一层级中查找指定类型的box */
+int demux_box_find(const uint8_t* data, uint64_t len, const char* type, demux_box_info_t* box){
+    uint64_t pos = 0;
+
+    while(demux_box_next(data, len, &pos, box) > 0){
+        if(memcmp(box->type, type, BOX_TYPE_BYTE) == 0){
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int demux_buf_init(demux_buf_t* buf, uint64_t cap){
+    memset(buf, 0, sizeof(demux_buf_t));
+
+    if(cap == 0){
+        cap = 4096;
+    }
+    buf->data = (uint8_t*)malloc(cap);
+    if(buf->data == NULL){
+        printf("buf data NULL\n");
+        buf->error = 1;
+        return -1;
+    }
+    buf->cap = cap;
+
+    return 0;
+}
+
+void demux_buf_free(demux_buf_t* buf){
+    free(buf->data);
+    memset(buf, 0, sizeof(demux_buf_t));
+}
+
+static int demux_buf_reserve(demux_buf_t* buf, uint64_t len){
+    uint8_t* data = NULL;
+    uint64_t cap = buf->cap ? buf->cap : 4096;
+
+    if(buf->error){
+        return -1;
+    }
+    if(buf->len + len <= buf->cap){
+        return 0;
+    }
+
+    while(cap < buf->len + len){
+        cap *= 2;
+    }
+    data = (uint8_t*)realloc(buf->data, cap);
+    if(data == NULL){
+        printf("buf realloc failed, cap[%lu]\n", cap);
+        buf->error = 1;
+        return -1;
+    }
+    buf->data = data;
+    buf->cap = cap;
+
+    return 0;
+}
+
+int demux_buf_put(demux_buf_t* buf, const void* data, uint64_t len){
+    if(demux_buf_reserve(buf, len) < 0){
+        return -1;
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+
+    return 0;
+}
+
+void demux_buf_put_u8(demux_buf_t* buf, uint8_t v){
+    demux_buf_put(buf, &v, 1);
+}
+
+void demux_buf_put_u16(demux_buf_t* buf, uint16_t v){
+    uint8_t p[2] = {v >> 8, v & 0xff};
+
+    demux_buf_put(buf, p, sizeof(p));
+}
+
+void demux_buf_put_u24(demux_buf_t* buf, uint32_t v){
+    uint8_t p[3] = {(v >> 16) & 0xff, (v >> 8) & 0xff, v & 0xff};
+
+    demux_buf_put(buf, p, sizeof(p));
+}
+
+void demux_buf_put_u32(demux_buf_t* buf, uint32_t v){
+    uint8_t p[4];
+
+    demux_put_be32(p, v);
+    demux_buf_put(buf, p, sizeof(p));
+}
+
+void demux_buf_put_u64(demux_buf_t* buf, uint64_t v){
+    uint8_t p[8];
+
+    demux_put_be64(p, v);
+    demux_buf_put(buf, p, sizeof(p));
+}
+
+void demux_buf_put_zero(demux_buf_t* buf, uint32_t len){
+    if(demux_buf_reserve(buf, len) < 0){
+        return;
+    }
+
+    memset(buf->data + buf->len, 0, len);
+    buf->len += len;
+}
+
+/* 先写占位的size, 在demux_buf_box_end中回填 */
+uint64_t demux_buf_box_begin(demux_buf_t* buf, const char* type){
+    uint64_t box_start = buf->len;
+
+    demux_buf_put_u32(buf, 0);
+    demux_buf_put(buf, type, BOX_TYPE_BYTE);
+
+    return box_start;
+}
+
+uint64_t demux_buf_full_box_begin(demux_buf_t* buf, const char* type, uint8_t version, uint32_t flags){
+    uint64_t box_start = demux_buf_box_begin(buf, type);
+
+    demux_buf_put_u8(buf, version);
+    demux_buf_put_u24(buf, flags);
+
+    return box_start;
+}
+
+void demux_buf_box_end(demux_buf_t* buf, uint64_t box_start){
+    if(buf->error){
+        return;
+    }
+
+    demux_put_be32(buf->data + box_start, buf->len - box_start);
+}
@@ -0,0 +1,64 @@
+#ifndef __DEMUX_BOX_H
+#define __DEMUX_BOX_H
+
+#include <stdint.h>
+
+/* 内存中的box读写, 供faststart/裁剪/切片等需要重写moov的功能使用 */
+
+typedef struct demux_buf
+{
+    uint8_t* data;
+    uint64_t len;
+    uint64_t cap;
+    int error;
+}demux_buf_t;
+
+typedef struct demux_box_info
+{
+    char type[4 + 1];
+    uint64_t offset;        // box起始位置
+    uint64_t size;          // 含box头
+    uint32_t header_size;
+}demux_box_info_t;
+
+static inline uint16_t demux_get_be16(const uint8_t* p){
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static inline uint32_t demux_get_be32(const uint8_t* p){
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t demux_get_be64(const uint8_t* p){
+    return ((uint64_t)demux_get_be32(p) << 32) | demux_get_be32(p + 4);
+}
+
+static inline void demux_put_be32(uint8_t* p, uint32_t v){
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline void demux_put_be64(uint8_t* p, uint64_t v){
+    demux_put_be32(p, v >> 32);
+    demux_put_be32(p + 4, v & 0xffffffff);
+}
+
+extern int demux_box_next(const uint8_t* data, uint64_t len, uint64_t* pos, demux_box_info_t* box);
+extern int demux_box_find(const uint8_t* data, uint64_t len, const char* type, demux_box_info_t* box);
+
+extern int demux_buf_init(demux_buf_t* buf, uint64_t cap);
+extern void demux_buf_free(demux_buf_t* buf);
+extern int demux_buf_put(demux_buf_t* buf, const void* data, uint64_t len);
+extern void demux_buf_put_u8(demux_buf_t* buf, uint8_t v);
+extern void demux_buf_put_u16(demux_buf_t* buf, uint16_t v);
+extern void demux_buf_put_u24(demux_buf_t* buf, uint32_t v);
+extern void demux_buf_put_u32(demux_buf_t* buf, uint32_t v);
+extern void demux_buf_put_u64(demux_buf_t* buf, uint64_t v);
+extern void demux_buf_put_zero(demux_buf_t* buf, uint32_t len);
+extern uint64_t demux_buf_box_begin(demux_buf_t* buf, const char* type);
+extern uint64_t demux_buf_full_box_begin(demux_buf_t* buf, const char* type, uint8_t version, uint32_t flags);
+extern void demux_buf_box_end(demux_buf_t* buf, uint64_t box_start);
+
+#endif
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "demux_copy.h"
+
+static int demux_copy_select_method(int out_fd){
+    struct stat st;
+
+    if(fstat(out_fd, &st) < 0){
+        return DEMUX_COPY_BUFFER;
+    }
+
+    if(S_ISREG(st.st_mode)){
+        return DEMUX_COPY_FILE_RANGE;
+    }else if(S_ISFIFO(st.st_mode)){
+        return DEMUX_COPY_SPLICE;
+    }else if(S_ISSOCK(st.st_mode)){
+        return DEMUX_COPY_SENDFILE;
+    }
+
+    return DEMUX_COPY_BUFFER;
+}
+
+int demux_copy_init(demux_copy_t* copy, int in_fd, int out_fd){
+    if(copy == NULL || in_fd < 0 || out_fd < 0){
+        printf("copy[%p] in_fd[%d] out_fd[%d] error\n", copy, in_fd, out_fd);
+        return -1;
+    }
+
+    memset(copy, 0, sizeof(demux_copy_t));
+    copy->in_fd = in_fd;
+    copy->out_fd = out_fd;
+    copy->method = demux_copy_select_method(out_fd);
+
+    return 0;
+}
+
+int demux_copy_writev(demux_copy_t* copy, struct iovec* iov, int iov_count){
+    ssize_t write_size = 0;
+
+    while(iov_count > 0){
+        write_size = writev(copy->out_fd, iov, iov_count);
+        if(write_size < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            printf("writev failed, errno[%d]\n", errno);
+            return -1;
+        }
+        copy->copy_bytes += write_size;
+
+        /* 处理部分写入 */
+        while(iov_count > 0 && write_size >= (ssize_t)iov->iov_len){
+            write_size -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if(iov_count > 0){
+            iov->iov_base = (uint8_t*)iov->iov_base + write_size;
+            iov->iov_len -= write_size;
+        }
+    }
+
+    return 0;
+}
+
+int demux_copy_write(demux_copy_t* copy, const void* data, uint32_t len){
+    struct iovec iov;
+
+    iov.iov_base = (void*)data;
+    iov.iov_len = len;
+
+    return demux_copy_writev(copy, &iov, 1);
+}
+
+static int demux_copy_by_buffer(demux_copy_t* copy, uint64_t in_offset, uint64_t len){
+    uint8_t stack_buf[DEMUX_COPY_MIN_ZERO_COPY_BYTES];
+    uint8_t* buf = stack_buf;
+    uint32_t buf_size = sizeof(stack_buf);
+    ssize_t read_size = 0;
+    int ret = 0;
+
+    /* 大块数据用拷贝会话内复用的缓冲, 不在每次调用时申请 */
+    if(len > sizeof(stack_buf)){
+        if(copy->buf == NULL){
+            copy->buf = (uint8_t*)malloc(DEMUX_COPY_BUFFER_BYTES);
+            if(copy->buf == NULL){
+                printf("copy buf NULL\n");
+                return -1;
+            }
+        }
+        buf = copy->buf;
+        buf_size = DEMUX_COPY_BUFFER_BYTES;
+    }
+
+    while(len > 0){
+        read_size = pread(copy->in_fd, buf, len < buf_size ? len : buf_size, in_offset);
+        if(read_size < 0 && errno == EINTR){
+            continue;
+        }
+        if(read_size <= 0){
+            printf("pread failed, offset[%lu] read_size[%ld]\n", in_offset, read_size);
+            ret = -1;
+            break;
+        }
+
+        ret = demux_copy_write(copy, buf, read_size);
+        if(ret < 0){
+            break;
+        }
+        in_offset += read_size;
+        len -= read_size;
+    }
+
+    return ret;
+}
+
+static int demux_copy_by_kernel(demux_copy_t* copy, uint64_t in_offset, uint64_t len){
+    loff_t off_in = in_offset;
+    ssize_t copy_size = 0;
+
+    while(len > 0){
+        if(copy->method == DEMUX_COPY_FILE_RANGE){
+            copy_size = copy_file_range(copy->in_fd, &off_in, copy->out_fd, NULL, len, 0);
+        }else if(copy->method == DEMUX_COPY_SENDFILE){
+            copy_size = sendfile(copy->out_fd, copy->in_fd, (off_t*)&off_in, len);
+        }else{
+            copy_size = splice(copy->in_fd, &off_in, copy->out_fd, NULL, len, SPLICE_F_MOVE);
+        }
+
+        if(copy_size < 0){
+            if(errno == EINTR || errno == EAGAIN){
+                continue;
+            }
+            if(errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP){
+                /* 当前方式不被支持, 降级后继续拷贝剩余部分 */
+                printf("copy method[%d] not supported, errno[%d], fallback\n", copy->method, errno);
+                copy->method = (copy->method == DEMUX_COPY_FILE_RANGE) ? DEMUX_COPY_SENDFILE : DEMUX_COPY_BUFFER;
+                if(copy->method == DEMUX_COPY_BUFFER){
+                    return demux_copy_by_buffer(copy, off_in, len);
+                }
+                continue;
+            }
+            printf("copy range failed, errno[%d]\n", errno);
+            return -1;
+        }
+        if(copy_size == 0){
+            printf("copy range reach eof, offset[%ld] left[%lu]\n", off_in, len);
+            return -1;
+        }
+
+        copy->copy_bytes += copy_size;
+        copy->zero_copy_bytes += copy_size;
+        len -= copy_size;
+    }
+
+    return 0;
+}
+
+int demux_copy_range(demux_copy_t* copy, uint64_t in_offset, uint64_t len){
+    if(copy == NULL){
+        printf("copy NULL\n");
+        return -1;
+    }
+
+    if(len == 0){
+        return 0;
+    }
+
+    if(copy->method == DEMUX_COPY_BUFFER || len < DEMUX_COPY_MIN_ZERO_COPY_BYTES){
+        return demux_copy_by_buffer(copy, in_offset, len);
+    }
+
+    return demux_copy_by_kernel(copy, in_offset, len);
+}
+
+void demux_copy_close(demux_copy_t* copy){
+    if(copy == NULL){
+        return;
+    }
+
+    free(copy->buf);
+    copy->buf = NULL;
+}
@@ -0,0 +1,35 @@
+#ifndef __DEMUX_COPY_H
+#define __DEMUX_COPY_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+/* 拷贝方式, 按输出fd类型选择, 失败时逐级回退 */
+enum DEMUX_COPY_METHOD{
+    DEMUX_COPY_BUFFER,          // pread + write
+    DEMUX_COPY_FILE_RANGE,      // copy_file_range, 普通文件之间
+    DEMUX_COPY_SENDFILE,        // sendfile, 输出为socket
+    DEMUX_COPY_SPLICE           // splice, 输出为pipe
+};
+
+/* 小于该长度的数据走用户态拷贝, 省掉系统调用开销 */
+#define DEMUX_COPY_MIN_ZERO_COPY_BYTES (16 * 1024)
+#define DEMUX_COPY_BUFFER_BYTES (256 * 1024)
+
+typedef struct demux_copy
+{
+    int in_fd;
+    int out_fd;
+    int method;
+    uint64_t copy_bytes;
+    uint64_t zero_copy_bytes;
+    uint8_t* buf;               // 回退到用户态拷贝时的缓冲, 第一次用到时申请, demux_copy_close释放
+}demux_copy_t;
+
+extern int demux_copy_init(demux_copy_t* copy, int in_fd, int out_fd);
+extern int demux_copy_range(demux_copy_t* copy, uint64_t in_offset, uint64_t len);
+extern int demux_copy_write(demux_copy_t* copy, const void* data, uint32_t len);
+extern int demux_copy_writev(demux_copy_t* copy, struct iovec* iov, int iov_count);
+extern void demux_copy_close(demux_copy_t* copy);
+
+#endif
@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "demux.h"
+#include "demux_box.h"
+#include "demux_copy.h"
+#include "demux_packet.h"
+#include "demux_keyframe.h"
+#include "demux_faststart.h"
+#include "demux_cut.h"
+
+/*
+ * 无损裁剪: 只按已解析的sample表挑出[start, end)内的sample, 生成新的moov和mdat
+ * 起点对齐到视频关键帧, mdat中的数据按原文件偏移顺序用copy_file_range拷贝, 开销只和选中的数据量有关
+ */
+
+typedef struct demux_cut_ctx
+{
+    demux_ctrl_t* demux_ctrl;
+    demux_cut_track_t track[DEMUX_MAX_TRACK_NUM];
+    uint32_t movie_timescale;
+    uint64_t movie_duration;
+    uint64_t data_offset;       // 新文件中mdat数据的起始位置
+    int use_co64;
+    int cur_track;              // 正在重写的trak, -1表示不在trak中
+}demux_cut_ctx_t;
+
+static int demux_cut_add_sample(demux_cut_track_t* cut_track, demux_packet_t* pkt){
+    demux_cut_sample_t* samples = NULL;
+    demux_cut_sample_t* sample = NULL;
+
+    if(cut_track->sample_count >= cut_track->sample_cap){
+        cut_track->sample_cap = cut_track->sample_cap ? cut_track->sample_cap * 2 : 256;
+        samples = (demux_cut_sample_t*)realloc(cut_track->samples, cut_track->sample_cap * sizeof(demux_cut_sample_t));
+        if(samples == NULL){
+            printf("cut samples realloc failed\n");
+            return -1;
+        }
+        cut_track->samples = samples;
+    }
+
+    sample = &cut_track->samples[cut_track->sample_count++];
+    sample->offset = pkt->offset;
+    sample->size = pkt->size;
+    sample->duration = pkt->duration;
+    sample->cts_offset = pkt->pts - pkt->dts;
+    sample->keyframe = pkt->keyframe;
+    cut_track->duration += pkt->duration;
+
+    return 0;
+}
+
+/* start_time之前(含)最近的视频关键帧, 没有视频时直接用start_time */
+static double demux_cut_align_start(demux_ctrl_t* demux_ctrl, double start_time){
+    demux_packet_reader_t reader;
+    demux_timeline_t* timeline = NULL;
+    video_ctrl_t* track = NULL;
+    uint32_t sample_index = 0;
+    double cut_start = 0;
+    int track_index = demux_find_track(demux_ctrl, "vide");
+
+    if(track_index < 0){
+        return start_time;
+    }
+    if(demux_packet_reader_init_info(&reader, demux_ctrl, 1u << track_index) < 0){
+        return start_time;
+    }
+    if(!reader.cursor[track_index].enable){
+        demux_packet_reader_close(&reader);
+        return start_time;
+    }
+
+    /* 时间线二分找到start_time所在的sample, 再在stss中二分找它之前的关键帧, 不遍历前面的sample */
+    track = demux_ctrl->track[track_index];
+    timeline = &reader.cursor[track_index].timeline;
+    if(start_time >= 0){
+        sample_index = demux_timeline_find(timeline, (int64_t)(start_time * track->timescale));
+        if((double)demux_timeline_dts(timeline, sample_index) / track->timescale <= start_time){
+            sample_index = demux_keyframe_before(track, sample_index, NULL);
+            cut_start = (double)demux_timeline_dts(timeline, sample_index) / track->timescale;
+        }
+    }
+    demux_packet_reader_close(&reader);
+
+    return cut_start;
+}
+
+/* track中第一个dts(换算成秒)不小于cut_start的sample */
+static uint32_t demux_cut_first_sample(const demux_timeline_t* timeline, double cut_start){
+    uint32_t timescale = timeline->timescale;
+    uint32_t sample_index = 0;
+
+    if(cut_start > 0){
+        sample_index = demux_timeline_find(timeline, (int64_t)(cut_start * timescale));
+    }
+    /* find取的是dts相同的一段中的最后一个, 且换算有舍入, 按秒比较修正到第一个不早于cut_start的sample */
+    while(sample_index > 0 && (double)demux_timeline_dts(timeline, sample_index - 1) / timescale >= cut_start){
+        sample_index--;
+    }
+    while(sample_index < timeline->sample_count && (double)demux_timeline_dts(timeline, sample_index) / timescale < cut_start){
+        sample_index++;
+    }
+
+    return sample_index;
+}
+
+/* 挑出[cut_start, end_time)内的sample, 原文件中连续的sample合并成一个chunk */
+static int demux_cut_select(demux_cut_ctx_t* ctx, double cut_start, double end_time){
+    demux_ctrl_t* demux_ctrl = ctx->demux_ctrl;
+    demux_packet_reader_t reader;
+    demux_packet_t pkt;
+    demux_cut_track_t* cut_track = NULL;
+    demux_cut_sample_t* sample = NULL;
+    demux_cut_chunk_t* chunk = NULL;
+    double dts_time = 0;
+    uint32_t i = 0;
+    int t = 0;
+    int ret = 0;
+
+    if(demux_packet_reader_init_info(&reader, demux_ctrl, DEMUX_PACKET_ALL_TRACK) < 0){
+        return -1;
+    }
+    /* 每个track直接从cut_start处开始读, 开销只和选中的sample数有关 */
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        if(reader.cursor[t].enable &&
+           demux_packet_reader_seek(&reader, t, demux_cut_first_sample(&reader.cursor[t].timeline, cut_start)) < 0){
+            demux_packet_reader_close(&reader);
+            return -1;
+        }
+    }
+
+    /* reader按dts交织输出, 超过end_time后其余track也都超过了 */
+    while(demux_read_packet_info(&reader, &pkt) > 0){
+        dts_time = (double)pkt.dts / demux_ctrl->track[pkt.track_index]->timescale;
+        if(dts_time >= end_time){
+            break;
+        }
+        if(dts_time < cut_start){
+            continue;
+        }
+        if(demux_cut_add_sample(&ctx->track[pkt.track_index], &pkt) < 0){
+            ret = -1;
+            break;
+        }
+    }
+    demux_packet_reader_close(&reader);
+    if(ret < 0){
+        return -1;
+    }
+
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        cut_track = &ctx->track[t];
+        if(cut_track->sample_count == 0){
+            continue;
+        }
+        chunk = NULL;
+        cut_track->chunks = (demux_cut_chunk_t*)calloc(cut_track->sample_count, sizeof(demux_cut_chunk_t));
+        if(cut_track->chunks == NULL){
+            printf("cut chunks NULL\n");
+            return -1;
+        }
+
+        for(i = 0;i < cut_track->sample_count;i++){
+            sample = &cut_track->samples[i];
+            if(chunk != NULL && chunk->src_offset + chunk->size == sample->offset){
+                chunk->size += sample->size;
+                chunk->sample_count++;
+                continue;
+            }
+            chunk = &cut_track->chunks[cut_track->chunk_count++];
+            chunk->track_index = t;
+            chunk->src_offset = sample->offset;
+            chunk->size = sample->size;
+            chunk->sample_count = 1;
+        }
+
+        printf("cut track[%d] %u samples %u chunks\n", t, cut_track->sample_count, cut_track->chunk_count);
+    }
+
+    return 0;
+}
+
+static int demux_cut_chunk_cmp(const void* a, const void* b){
+    const demux_cut_chunk_t* chunk_a = *(const demux_cut_chunk_t**)a;
+    const demux_cut_chunk_t* chunk_b = *(const demux_cut_chunk_t**)b;
+
+    if(chunk_a->src_offset == chunk_b->src_offset){
+        return 0;
+    }
+
+    return chunk_a->src_offset < chunk_b->src_offset ? -1 : 1;
+}
+
+/* 所有chunk按原文件偏移排序, 新mdat中保持原来的交织顺序, 返回数据总长度 */
+static uint64_t demux_cut_layout(demux_cut_ctx_t* ctx, demux_cut_chunk_t** chunks, uint32_t* chunk_count){
+    demux_cut_track_t* cut_track = NULL;
+    uint64_t dst_offset = 0;
+    uint32_t count = 0;
+    uint32_t i = 0;
+    int t = 0;
+
+    for(t = 0;t < ctx->demux_ctrl->track_count;t++){
+        cut_track = &ctx->track[t];
+        for(i = 0;i < cut_track->chunk_count;i++){
+            chunks[count++] = &cut_track->chunks[i];
+        }
+    }
+    qsort(chunks, count, sizeof(demux_cut_chunk_t*), demux_cut_chunk_cmp);
+
+    for(i = 0;i < count;i++){
+        chunks[i]->dst_offset = dst_offset;
+        dst_offset += chunks[i]->size;
+    }
+    *chunk_count = count;
+
+    return dst_offset;
+}
+
+static void demux_cut_write_stbl(demux_cut_ctx_t* ctx, const uint8_t* data, uint64_t len, demux_buf_t* out){
+    demux_cut_track_t* cut_track = (ctx->cur_track >= 0) ? &ctx->track[ctx->cur_track] : NULL;
+    video_ctrl_t* track = (cut_track != NULL) ? cut_track->track : NULL;
+    demux_cut_sample_t* samples = NULL;
+    demux_box_info_t box;
+    uint32_t sample_count = 0;
+    uint32_t entry_count = 0;
+    uint64_t box_start = 0;
+    uint64_t count_pos = 0;
+    uint32_t run = 0;
+    uint32_t i = 0;
+    int negative_cts = 0;
+    int has_cts = 0;
+    int same_size = 1;
+
+    if(cut_track != NULL){
+        samples = cut_track->samples;
+        sample_count = cut_track->sample_count;
+    }
+
+    box_start = demux_buf_box_begin(out, "stbl");
+
+    if(demux_box_find(data, len, "stsd", &box) > 0){
+        demux_buf_put(out, data + box.offset, box.size);
+    }
+
+    /* stts */
+    count_pos = demux_buf_full_box_begin(out, "stts", 0, 0);
+    demux_buf_put_u32(out, 0);
+    entry_count = 0;
+    for(i = 0;i < sample_count;i += run){
+        for(run = 1;i + run < sample_count && samples[i + run].duration == samples[i].duration;run++);
+        demux_buf_put_u32(out, run);
+        demux_buf_put_u32(out, samples[i].duration);
+        entry_count++;
+    }
+    if(!out->error){
+        demux_put_be32(out->data + count_pos + 12, entry_count);
+    }
+    demux_buf_box_end(out, count_pos);
+
+    /* ctts: pts已经带上elst的偏移(原edts不保留), 有非0偏移才写, 出现负偏移时用version 1 */
+    for(i = 0;i < sample_count;i++){
+        if(samples[i].cts_offset != 0){
+            has_cts = 1;
+        }
+        if(samples[i].cts_offset < 0){
+            negative_cts = 1;
+        }
+    }
+    if(track != NULL && has_cts){
+        count_pos = demux_buf_full_box_begin(out, "ctts", negative_cts, 0);
+        demux_buf_put_u32(out, 0);
+        entry_count = 0;
+        for(i = 0;i < sample_count;i += run){
+            for(run = 1;i + run < sample_count && samples[i + run].cts_offset == samples[i].cts_offset;run++);
+            demux_buf_put_u32(out, run);
+            demux_buf_put_u32(out, (uint32_t)samples[i].cts_offset);
+            entry_count++;
+        }
+        if(!out->error){
+            demux_put_be32(out->data + count_pos + 12, entry_count);
+        }
+        demux_buf_box_end(out, count_pos);
+    }
+
+    /* stss: 序号按新的sample重新编号 */
+    if(track != NULL && track->stss_present){
+        count_pos = demux_buf_full_box_begin(out, "stss", 0, 0);
+        demux_buf_put_u32(out, 0);
+        entry_count = 0;
+        for(i = 0;i < sample_count;i++){
+            if(samples[i].keyframe){
+                demux_buf_put_u32(out, i + 1);
+                entry_count++;
+            }
+        }
+        if(!out->error){
+            demux_put_be32(out->data + count_pos + 12, entry_count);
+        }
+        demux_buf_box_end(out, count_pos);
+    }
+
+    /* stsc */
+    count_pos = demux_buf_full_box_begin(out, "stsc", 0, 0);
+    demux_buf_put_u32(out, 0);
+    entry_count = 0;
+    for(i = 0;cut_track != NULL && i < cut_track->chunk_count;i++){
+        if(i > 0 && cut_track->chunks[i].sample_count == cut_track->chunks[i - 1].sample_count){
+            continue;
+        }
+        demux_buf_put_u32(out, i + 1);
+        demux_buf_put_u32(out, cut_track->chunks[i].sample_count);
+        demux_buf_put_u32(out, 1);
+        entry_count++;
+    }
+    if(!out->error){
+        demux_put_be32(out->data + count_pos + 12, entry_count);
+    }
+    demux_buf_box_end(out, count_pos);
+
+    /* stsz: 所有sample一样大时不写表 */
+    for(i = 1;i < sample_count;i++){
+        if(samples[i].size != samples[0].size){
+            same_size = 0;
+            break;
+        }
+    }
+    count_pos = demux_buf_full_box_begin(out, "stsz", 0, 0);
+    demux_buf_put_u32(out, (sample_count > 0 && same_size) ? samples[0].size : 0);
+    demux_buf_put_u32(out, sample_count);
+    for(i = 0;i < sample_count && !same_size;i++){
+        demux_buf_put_u32(out, samples[i].size);
+    }
+    demux_buf_box_end(out, count_pos);
+
+    /* stco/co64 */
+    entry_count = (cut_track != NULL) ? cut_track->chunk_count : 0;
+    count_pos = demux_buf_full_box_begin(out, ctx->use_co64 ? "co64" : "stco", 0, 0);
+    demux_buf_put_u32(out, entry_count);
+    for(i = 0;i < entry_count;i++){
+        if(ctx->use_co64){
+            demux_buf_put_u64(out, ctx->data_offset + cut_track->chunks[i].dst_offset);
+        }else{
+            demux_buf_put_u32(out, ctx->data_offset + cut_track->chunks[i].dst_offset);
+        }
+    }
+    demux_buf_box_end(out, count_pos);
+
+    demux_buf_box_end(out, box_start);
+}
+
+static int demux_cut_find_track(demux_cut_ctx_t* ctx, const uint8_t* data, uint64_t len){
+    demux_box_info_t box;
+    uint32_t track_id = 0;
+    const uint8_t* body = NULL;
+    int i = 0;
+
+    if(demux_box_find(data, len, "tkhd", &box) <= 0){
+        return -1;
+    }
+    body = data + box.offset + box.header_size;
+    track_id = demux_get_be32(body + (body[0] == 1 ? 20 : 12));
+
+    for(i = 0;i < ctx->demux_ctrl->track_count;i++){
+        if(ctx->demux_ctrl->track[i]->track_id == track_id){
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* 修改full box中的duration字段, version 1时为64位 */
+static void demux_cut_patch_duration(uint8_t* body, uint32_t v0_offset, uint32_t v1_offset, uint64_t duration){
+    if(body[0] == 1){
+        demux_put_be64(body + v1_offset, duration);
+    }else{
+        demux_put_be32(body + v0_offset, duration > UINT32_MAX ? UINT32_MAX : duration);
+    }
+}
+
+static int demux_cut_write_box(demux_cut_ctx_t* ctx, const uint8_t* data, uint64_t len, demux_buf_t* out){
+    demux_cut_track_t* cut_track = NULL;
+    demux_box_info_t box;
+    const uint8_t* body = NULL;
+    uint64_t body_size = 0;
+    uint64_t box_start = 0;
+    uint64_t pos = 0;
+    uint64_t duration = 0;
+    int ret = 0;
+
+    while((ret = demux_box_next(data, len, &pos, &box)) > 0){
+        body = data + box.offset + box.header_size;
+        body_size = box.size - box.header_size;
+        cut_track = (ctx->cur_track >= 0) ? &ctx->track[ctx->cur_track] : NULL;
+
+        if(memcmp(box.type, "trak", 4) == 0){
+            ctx->cur_track = demux_cut_find_track(ctx, body, body_size);
+            box_start = demux_buf_box_begin(out, box.type);
+            if(demux_cut_write_box(ctx, body, body_size, out) < 0){
+                return -1;
+            }
+            demux_buf_box_end(out, box_start);
+            ctx->cur_track = -1;
+        }else if(memcmp(box.type, "moov", 4) == 0 || memcmp(box.type, "mdia", 4) == 0 ||
+                 memcmp(box.type, "minf", 4) == 0){
+            box_start = demux_buf_box_begin(out, box.type);
+            if(demux_cut_write_box(ctx, body, body_size, out) < 0){
+                return -1;
+            }
+            demux_buf_box_end(out, box_start);
+        }else if(memcmp(box.type, "stbl", 4) == 0){
+            demux_cut_write_stbl(ctx, body, body_size, out);
+        }else if(memcmp(box.type, "edts", 4) == 0){
+            /* 裁剪后原来的edit list已经不对了, 直接去掉 */
+            continue;
+        }else{
+            box_start = out->len;
+            if(demux_buf_put(out, data + box.offset, box.size) < 0){
+                return -1;
+            }
+
+            /* mvhd/mdhd: v0 duration在16, v1在24; tkhd: v0在20, v1在28 */
+            if(memcmp(box.type, "mvhd", 4) == 0){
+                demux_cut_patch_duration(out->data + box_start + box.header_size, 16, 24, ctx->movie_duration);
+            }else if(memcmp(box.type, "tkhd", 4) == 0 && cut_track != NULL){
+                duration = cut_track->track->timescale ?
+                           cut_track->duration * ctx->movie_timescale / cut_track->track->timescale : 0;
+                demux_cut_patch_duration(out->data + box_start + box.header_size, 20, 28, duration);
+            }else if(memcmp(box.type, "mdhd", 4) == 0 && cut_track != NULL){
+                demux_cut_patch_duration(out->data + box_start + box.header_size, 16, 24, cut_track->duration);
+            }
+        }
+    }
+
+    return out->error ? -1 : ret;
+}
+
+static int demux_cut_write(demux_cut_ctx_t* ctx, int in_fd, int out_fd, demux_top_box_t* ftyp,
+                           demux_buf_t* moov, demux_cut_chunk_t** chunks, uint32_t chunk_count, uint64_t data_size){
+    demux_copy_t copy;
+    uint8_t mdat_head[16] = {0};
+    uint32_t mdat_head_len = 8;
+    uint64_t range_offset = 0;
+    uint64_t range_size = 0;
+    uint32_t i = 0;
+    int ret = -1;
+    int t = 0;
+
+    demux_copy_init(&copy, in_fd, out_fd);
+
+    if(data_size + 8 > UINT32_MAX){
+        demux_put_be32(mdat_head, 1);
+        memcpy(mdat_head + 4, "mdat", 4);
+        demux_put_be64(mdat_head + 8, data_size + 16);
+        mdat_head_len = 16;
+    }else{
+        demux_put_be32(mdat_head, data_size + 8);
+        memcpy(mdat_head + 4, "mdat", 4);
+    }
+
+    if((ftyp != NULL && demux_copy_range(&copy, ftyp->offset, ftyp->size) < 0) ||
+       demux_copy_write(&copy, moov->data, moov->len) < 0 ||
+       demux_copy_write(&copy, mdat_head, mdat_head_len) < 0){
+        printf("cut write head failed\n");
+        goto end;
+    }
+
+    /* 原文件中首尾相接的chunk合并成一次拷贝 */
+    for(i = 0;i < chunk_count;i++){
+        if(range_size > 0 && range_offset + range_size == chunks[i]->src_offset){
+            range_size += chunks[i]->size;
+            continue;
+        }
+        demux_io_access(ctx->demux_ctrl->io, range_offset, range_size);
+        if(range_size > 0 && demux_copy_range(&copy, range_offset, range_size) < 0){
+            printf("cut copy failed, offset[%lu] size[%lu]\n", range_offset, range_size);
+            goto end;
+        }
+        range_offset = chunks[i]->src_offset;
+        range_size = chunks[i]->size;
+    }
+    demux_io_access(ctx->demux_ctrl->io, range_offset, range_size);
+    if(range_size > 0 && demux_copy_range(&copy, range_offset, range_size) < 0){
+        printf("cut copy failed, offset[%lu] size[%lu]\n", range_offset, range_size);
+        goto end;
+    }
+
+    for(t = 0;t < ctx->demux_ctrl->track_count;t++){
+        for(i = 0;i < ctx->track[t].sample_count;i++){
+            demux_stats_sample(&ctx->demux_ctrl->stats, ctx->track[t].samples[i].size);
+        }
+    }
+    printf("cut output %lu bytes, zero copy %lu bytes\n", copy.copy_bytes, copy.zero_copy_bytes);
+    ret = 0;
+
+end:
+    demux_copy_close(&copy);
+
+    return ret;
+}
+
+int demux_cut(demux_ctrl_t* demux_ctrl, double start_time, double end_time, const char* out_path){
+    demux_cut_ctx_t* ctx = NULL;
+    demux_top_box_t* boxes = NULL;
+    demux_top_box_t* ftyp = NULL;
+    demux_top_box_t* moov_box = NULL;
+    demux_cut_chunk_t** chunks = NULL;
+    demux_box_info_t mvhd;
+    demux_box_info_t moov_info;
+    uint64_t moov_pos = 0;
+    uint8_t* moov_body = NULL;
+    demux_buf_t moov_in;
+    demux_buf_t moov;
+    uint32_t chunk_total = 0;
+    uint32_t chunk_count = 0;
+    uint32_t j = 0;
+    uint64_t data_size = 0;
+    uint64_t data_offset = 0;
+    uint64_t duration = 0;
+    double cut_start = 0;
+    int box_count = 0;
+    int in_fd = -1;
+    int out_fd = -1;
+    int ret = -1;
+    int i = 0;
+
+    if(demux_ctrl == NULL || demux_ctrl->io == NULL || out_path == NULL || end_time <= start_time){
+        printf("cut arg error, start[%f] end[%f]\n", start_time, end_time);
+        return -1;
+    }
+
+    /* mdat数据由copy_file_range拷贝, 需要输入fd */
+    if(demux_ctrl->io->fd < 0){
+        printf("cut need input fd\n");
+        return -1;
+    }
+
+    memset(&moov_in, 0, sizeof(moov_in));
+    memset(&moov, 0, sizeof(moov));
+    in_fd = demux_ctrl->io->fd;
+
+    ctx = (demux_cut_ctx_t*)calloc(1, sizeof(demux_cut_ctx_t));
+    if(ctx == NULL){
+        printf("cut ctx NULL\n");
+        goto end;
+    }
+    ctx->demux_ctrl = demux_ctrl;
+    ctx->cur_track = -1;
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        ctx->track[i].track = demux_ctrl->track[i];
+    }
+
+    box_count = demux_walk_top_box(demux_ctrl->io, &boxes);
+    for(i = 0;i < box_count;i++){
+        if(ftyp == NULL && strcmp(boxes[i].type, "ftyp") == 0){
+            ftyp = &boxes[i];
+        }
+        if(moov_box == NULL && strcmp(boxes[i].type, "moov") == 0){
+            moov_box = &boxes[i];
+        }
+    }
+    if(moov_box == NULL){
+        printf("moov not found\n");
+        goto end;
+    }
+
+    if(demux_buf_init(&moov_in, moov_box->size) < 0){
+        goto end;
+    }
+    if(demux_io_read_at(demux_ctrl->io, moov_box->offset, moov_in.data, moov_box->size) != (int64_t)moov_box->size){
+        printf("read moov failed\n");
+        goto end;
+    }
+    moov_in.len = moov_box->size;
+
+    /* moov头可能是16字节(largesize) */
+    moov_pos = 0;
+    if(demux_box_next(moov_in.data, moov_in.len, &moov_pos, &moov_info) <= 0){
+        printf("moov header error\n");
+        goto end;
+    }
+    moov_body = moov_in.data + moov_info.header_size;
+
+    /* mvhd中的timescale: v0在12, v1在20 */
+    if(demux_box_find(moov_body, moov_in.len - moov_info.header_size, "mvhd", &mvhd) <= 0){
+        printf("mvhd not found\n");
+        goto end;
+    }
+    ctx->movie_timescale = demux_get_be32(moov_body + mvhd.offset + mvhd.header_size +
+                                          (moov_body[mvhd.offset + mvhd.header_size] == 1 ? 20 : 12));
+
+    cut_start = demux_cut_align_start(demux_ctrl, start_time);
+    printf("cut [%f, %f) -> [%f, %f)\n", start_time, end_time, cut_start, end_time);
+
+    if(demux_cut_select(ctx, cut_start, end_time) < 0){
+        goto end;
+    }
+
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        chunk_total += ctx->track[i].chunk_count;
+        if(demux_ctrl->track[i]->timescale == 0){
+            continue;
+        }
+        duration = ctx->track[i].duration * ctx->movie_timescale / demux_ctrl->track[i]->timescale;
+        if(duration > ctx->movie_duration){
+            ctx->movie_duration = duration;
+        }
+    }
+    if(chunk_total == 0){
+        printf("no sample in [%f, %f)\n", cut_start, end_time);
+        goto end;
+    }
+
+    chunks = (demux_cut_chunk_t**)calloc(chunk_total, sizeof(demux_cut_chunk_t*));
+    if(chunks == NULL){
+        printf("cut chunks NULL\n");
+        goto end;
+    }
+    data_size = demux_cut_layout(ctx, chunks, &chunk_count);
+
+    /* 读计划只包含选中的chunk, 不是整个sample表 */
+    demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_RESET, 0, 0);
+    for(j = 0;j < chunk_count;j++){
+        if(demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_WILLNEED, chunks[j]->src_offset, chunks[j]->size) < 0){
+            goto end;
+        }
+    }
+
+    /* moov大小和chunk偏移互相依赖, 大小不变时偏移就确定了 */
+    ctx->use_co64 = (data_size + moov_in.len * 2 > UINT32_MAX);
+    do{
+        ctx->data_offset = data_offset;
+        demux_buf_free(&moov);
+        if(demux_buf_init(&moov, moov_in.len) < 0 ||
+           demux_cut_write_box(ctx, moov_in.data, moov_in.len, &moov) < 0){
+            printf("cut build moov failed\n");
+            goto end;
+        }
+        data_offset = (ftyp != NULL ? ftyp->size : 0) + moov.len + (data_size + 8 > UINT32_MAX ? 16 : 8);
+    }while(data_offset != ctx->data_offset);
+
+    out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out_fd < 0){
+        printf("open %s failed\n", out_path);
+        goto end;
+    }
+
+    ret = demux_cut_write(ctx, in_fd, out_fd, ftyp, &moov, chunks, chunk_count, data_size);
+
+end:
+    if(out_fd >= 0){
+        close(out_fd);
+    }
+    if(ctx != NULL){
+        for(i = 0;i < DEMUX_MAX_TRACK_NUM;i++){
+            free(ctx->track[i].samples);
+            free(ctx->track[i].chunks);
+        }
+    }
+    demux_buf_free(&moov_in);
+    demux_buf_free(&moov);
+    free(chunks);
+    free(boxes);
+    free(ctx);
+
+    return ret;
+}
@@ -0,0 +1,40 @@
+#ifndef __DEMUX_CUT_H
+#define __DEMUX_CUT_H
+
+#include <stdint.h>
+#include "demux.h"
+
+typedef struct demux_cut_sample
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t duration;
+    int32_t cts_offset;
+    uint8_t keyframe;
+}demux_cut_sample_t;
+
+/* 新文件中的chunk: 原文件中连续的一段sample */
+typedef struct demux_cut_chunk
+{
+    int track_index;
+    uint64_t src_offset;
+    uint64_t size;
+    uint32_t sample_count;
+    uint64_t dst_offset;
+}demux_cut_chunk_t;
+
+typedef struct demux_cut_track
+{
+    video_ctrl_t* track;
+    demux_cut_sample_t* samples;
+    uint32_t sample_count;
+    uint32_t sample_cap;
+    demux_cut_chunk_t* chunks;
+    uint32_t chunk_count;
+    uint64_t duration;
+}demux_cut_track_t;
+
+/* 从start_time之前最近的关键帧开始, 截取到end_time, 单位秒 */
+extern int demux_cut(demux_ctrl_t* demux_ctrl, double start_time, double end_time, const char* out_path);
+
+#endif
@@ -0,0 +1,581 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "demux.h"
+#include "demux_packet.h"
+#include "demux_probe.h"
+#include "demux_daemon.h"
+
+#define DEMUX_DAEMON_RESPONSE_BYTES (sizeof(demux_daemon_response_t) + DEMUX_DAEMON_MAX_SAMPLES * sizeof(demux_daemon_sample_t))
+
+static void demux_daemon_free_entry(demux_daemon_entry_t* entry){
+    int i = 0;
+
+    for(i = 0;i < DEMUX_DAEMON_MAX_TRACK;i++){
+        free(entry->samples[i]);
+    }
+    if(entry->fd >= 0){
+        close(entry->fd);
+    }
+    free(entry);
+}
+
+/* 解析一次, 只留下每个track的sample表和一个只读fd, demux_ctrl用完就关闭 */
+static int demux_daemon_load(demux_daemon_entry_t* entry, const char* path){
+    demux_ctrl_t* demux_ctrl = NULL;
+    demux_packet_reader_t reader;
+    demux_packet_t pkt;
+    demux_daemon_track_t* info = NULL;
+    demux_daemon_sample_t* sample = NULL;
+    video_ctrl_t* track = NULL;
+    uint32_t count[DEMUX_DAEMON_MAX_TRACK] = {0};
+    int ret = -1;
+    int i = 0;
+
+    demux_ctrl = (demux_ctrl_t*)calloc(1, sizeof(demux_ctrl_t));
+    if(demux_ctrl == NULL || demux_init(demux_ctrl, (char*)path, strlen(path)) < 0){
+        printf("daemon open %s failed\n", path);
+        if(demux_ctrl != NULL && demux_ctrl->io == NULL){
+            free(demux_ctrl);
+            return -1;
+        }
+        goto end;
+    }
+    if(demux_probe(demux_ctrl, DEMUX_PROBE_WINDOW) < 0){
+        while(demux_handle_box_body(demux_ctrl) >= 0){
+        }
+    }
+
+    entry->track_count = demux_ctrl->track_count < DEMUX_DAEMON_MAX_TRACK ? demux_ctrl->track_count : DEMUX_DAEMON_MAX_TRACK;
+    for(i = 0;i < entry->track_count;i++){
+        track = demux_ctrl->track[i];
+        info = &entry->track[i];
+        info->track_id = track->track_id;
+        memcpy(info->handler_type, track->handler_type, sizeof(info->handler_type));
+        memcpy(info->codec, track->codec, sizeof(info->codec));
+        info->timescale = track->timescale;
+        info->duration = track->duration;
+        info->sample_count = track->sample_count;
+        info->width = track->width;
+        info->height = track->height;
+        entry->samples[i] = (demux_daemon_sample_t*)calloc(track->sample_count ? track->sample_count : 1, sizeof(demux_daemon_sample_t));
+        if(entry->samples[i] == NULL){
+            printf("daemon samples NULL\n");
+            goto end;
+        }
+    }
+
+    if(demux_packet_reader_init(&reader, demux_ctrl, (1u << entry->track_count) - 1) < 0){
+        goto end;
+    }
+    while(demux_read_packet_info(&reader, &pkt) > 0){
+        if(count[pkt.track_index] >= entry->track[pkt.track_index].sample_count){
+            continue;
+        }
+        sample = &entry->samples[pkt.track_index][count[pkt.track_index]++];
+        sample->offset = pkt.offset;
+        sample->size = pkt.size;
+        sample->keyframe = pkt.keyframe ? 1 : 0;
+        sample->dts = pkt.dts;
+        sample->pts = pkt.pts;
+        entry->track[pkt.track_index].keyframe_count += sample->keyframe;
+    }
+    demux_packet_reader_close(&reader);
+    for(i = 0;i < entry->track_count;i++){
+        entry->track[i].sample_count = count[i];
+    }
+
+    entry->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(entry->fd < 0){
+        printf("daemon open %s failed\n", path);
+        goto end;
+    }
+    ret = 0;
+
+end:
+    demux_close(demux_ctrl);
+
+    return ret;
+}
+
+/* 按文件身份查缓存, 未命中时解析并放到表头, 超过容量时淘汰表尾 */
+static demux_daemon_entry_t* demux_daemon_lookup(demux_daemon_t* daemon, const char* path, uint32_t* cached){
+    demux_daemon_entry_t* entry = NULL;
+    struct stat st;
+    int64_t mtime_ns = 0;
+
+    if(stat(path, &st) < 0){
+        printf("stat %s failed\n", path);
+        return NULL;
+    }
+    mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+    list_for_each_entry(entry, &daemon->lru, node){
+        if(entry->dev == st.st_dev && entry->ino == st.st_ino && entry->size == st.st_size && entry->mtime_ns == mtime_ns){
+            list_move(&entry->node, &daemon->lru);
+            daemon->hit_count++;
+            *cached = 1;
+            return entry;
+        }
+    }
+
+    entry = (demux_daemon_entry_t*)calloc(1, sizeof(demux_daemon_entry_t));
+    if(entry == NULL){
+        printf("daemon entry NULL\n");
+        return NULL;
+    }
+    entry->fd = -1;
+    if(demux_daemon_load(entry, path) < 0){
+        demux_daemon_free_entry(entry);
+        return NULL;
+    }
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->size = st.st_size;
+    entry->mtime_ns = mtime_ns;
+
+    list_add(&entry->node, &daemon->lru);
+    daemon->entry_count++;
+    daemon->miss_count++;
+    *cached = 0;
+
+    if(daemon->entry_count > DEMUX_DAEMON_CACHE_ENTRIES){
+        entry = list_entry(daemon->lru.prev, demux_daemon_entry_t, node);
+        list_del(&entry->node);
+        demux_daemon_free_entry(entry);
+        daemon->entry_count--;
+        return list_first_entry(&daemon->lru, demux_daemon_entry_t, node);
+    }
+
+    return entry;
+}
+
+/* dts不超过time的最后一个关键帧, 没有时取第一个sample */
+static uint32_t demux_daemon_find_keyframe(demux_daemon_entry_t* entry, uint32_t track_index, double time){
+    demux_daemon_sample_t* samples = entry->samples[track_index];
+    int64_t dts = time * entry->track[track_index].timescale;
+    uint32_t low = 0;
+    uint32_t high = entry->track[track_index].sample_count;
+    uint32_t mid = 0;
+
+    while(low < high){
+        mid = low + (high - low) / 2;
+        if(samples[mid].dts <= dts){
+            low = mid + 1;
+        }else{
+            high = mid;
+        }
+    }
+
+    while(low > 0 && !samples[low - 1].keyframe){
+        low--;
+    }
+
+    return low > 0 ? low - 1 : 0;
+}
+
+static int demux_daemon_send(int sock, const void* data, uint32_t len, int fd){
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg = NULL;
+    char control[CMSG_SPACE(sizeof(int))];
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = (void*)data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if(fd >= 0){
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    if(sendmsg(sock, &msg, MSG_NOSIGNAL) != (ssize_t)len){
+        printf("daemon sendmsg failed, errno[%d]\n", errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 收一条消息, 附带fd时写到*fd, 返回消息长度 */
+static int demux_daemon_recv(int sock, void* data, uint32_t len, int* fd){
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg = NULL;
+    char control[CMSG_SPACE(sizeof(int))];
+    ssize_t ret = 0;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if(ret <= 0){
+        return -1;
+    }
+
+    for(cmsg = CMSG_FIRSTHDR(&msg);cmsg != NULL;cmsg = CMSG_NXTHDR(&msg, cmsg)){
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS){
+            if(fd != NULL){
+                memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+            }else{
+                close(*(int*)CMSG_DATA(cmsg));
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* 只接受和daemon同一用户或root的连接, 其他用户拿不到daemon能读的文件的fd */
+static int demux_daemon_check_peer(demux_daemon_t* daemon, int sock){
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+
+    if(getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) < 0){
+        printf("daemon SO_PEERCRED failed, errno[%d]\n", errno);
+        return -1;
+    }
+    if(cred.uid != daemon->uid && cred.uid != 0){
+        printf("daemon reject pid[%d] uid[%u]\n", cred.pid, cred.uid);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 解析出真实路径, 配置了root时必须在root之下 */
+static int demux_daemon_check_path(demux_daemon_t* daemon, const char* path, char* real_path){
+    size_t root_len = strlen(daemon->root);
+
+    if(realpath(path, real_path) == NULL){
+        printf("daemon realpath %s failed\n", path);
+        return -1;
+    }
+    if(root_len > 0 && (strncmp(real_path, daemon->root, root_len) != 0 ||
+                        (real_path[root_len] != '/' && daemon->root[root_len - 1] != '/'))){
+        printf("daemon path %s outside root %s\n", real_path, daemon->root);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int demux_daemon_handle(demux_daemon_t* daemon, int sock, uint8_t* buf){
+    demux_daemon_request_t request;
+    demux_daemon_response_t* response = (demux_daemon_response_t*)buf;
+    demux_daemon_entry_t* entry = NULL;
+    char real_path[PATH_MAX];
+    uint32_t len = sizeof(demux_daemon_response_t);
+    uint32_t cached = 0;
+    uint32_t total = 0;
+    int fd = -1;
+
+    memset(&request, 0, sizeof(request));
+    if(demux_daemon_recv(sock, &request, sizeof(request), NULL) != sizeof(request)){
+        return -1;
+    }
+    request.path[DEMUX_DAEMON_PATH_LENGTH - 1] = 0;
+
+    memset(response, 0, sizeof(demux_daemon_response_t));
+    response->type = request.type;
+    response->status = -1;
+
+    if(demux_daemon_check_path(daemon, request.path, real_path) < 0){
+        return demux_daemon_send(sock, response, len, -1);
+    }
+    entry = demux_daemon_lookup(daemon, real_path, &cached);
+    response->cached = cached;
+    if(entry == NULL){
+        return demux_daemon_send(sock, response, len, -1);
+    }
+    if(request.type != DEMUX_DAEMON_PROBE && request.track_index >= (uint32_t)entry->track_count){
+        printf("daemon track_index[%u] error\n", request.track_index);
+        return demux_daemon_send(sock, response, len, -1);
+    }
+
+    switch(request.type){
+        case DEMUX_DAEMON_PROBE:
+            response->count = entry->track_count;
+            memcpy(buf + len, entry->track, entry->track_count * sizeof(demux_daemon_track_t));
+            len += entry->track_count * sizeof(demux_daemon_track_t);
+            response->status = 0;
+            break;
+        case DEMUX_DAEMON_SEEK:
+            if(entry->track[request.track_index].sample_count == 0){
+                break;
+            }
+            response->first_sample = demux_daemon_find_keyframe(entry, request.track_index, request.time);
+            response->count = 1;
+            memcpy(buf + len, &entry->samples[request.track_index][response->first_sample], sizeof(demux_daemon_sample_t));
+            len += sizeof(demux_daemon_sample_t);
+            response->status = 0;
+            break;
+        case DEMUX_DAEMON_SAMPLES:
+            total = entry->track[request.track_index].sample_count;
+            response->first_sample = request.first_sample;
+            if(request.first_sample < total){
+                response->count = total - request.first_sample;
+                if(response->count > request.sample_count){
+                    response->count = request.sample_count;
+                }
+                if(response->count > DEMUX_DAEMON_MAX_SAMPLES){
+                    response->count = DEMUX_DAEMON_MAX_SAMPLES;
+                }
+            }
+            memcpy(buf + len, &entry->samples[request.track_index][request.first_sample], response->count * sizeof(demux_daemon_sample_t));
+            len += response->count * sizeof(demux_daemon_sample_t);
+            response->status = 0;
+            fd = entry->fd;
+            break;
+        default:
+            printf("daemon request type[%u] error\n", request.type);
+            break;
+    }
+
+    return demux_daemon_send(sock, buf, len, fd);
+}
+
+int demux_daemon_run(const char* sock_path, const char* root){
+    demux_daemon_t daemon;
+    demux_daemon_entry_t* entry = NULL;
+    demux_daemon_entry_t* tmp = NULL;
+    struct sockaddr_un addr;
+    struct pollfd fds[DEMUX_DAEMON_MAX_CLIENT + 1];
+    char real_root[PATH_MAX];
+    uint8_t* buf = NULL;
+    mode_t old_mask = 0;
+    int nfds = 1;
+    int client = -1;
+    int ret = -1;
+    int i = 0;
+
+    memset(&daemon, 0, sizeof(daemon));
+    INIT_LIST_HEAD(&daemon.lru);
+    daemon.listen_fd = -1;
+    daemon.uid = getuid();
+    if(root != NULL){
+        if(realpath(root, real_root) == NULL || strlen(real_root) >= sizeof(daemon.root)){
+            printf("daemon root %s error\n", root);
+            return -1;
+        }
+        strcpy(daemon.root, real_root);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(sock_path) >= sizeof(addr.sun_path)){
+        printf("sock_path %s too long\n", sock_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, sock_path);
+
+    buf = (uint8_t*)malloc(DEMUX_DAEMON_RESPONSE_BYTES);
+    daemon.listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(buf == NULL || daemon.listen_fd < 0){
+        printf("daemon socket failed\n");
+        goto end;
+    }
+    unlink(sock_path);
+    /* 套接字文件只有本用户可以连接 */
+    old_mask = umask(0177);
+    ret = bind(daemon.listen_fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(old_mask);
+    if(ret < 0 || listen(daemon.listen_fd, DEMUX_DAEMON_MAX_CLIENT) < 0){
+        printf("daemon bind %s failed, errno[%d]\n", sock_path, errno);
+        goto end;
+    }
+    printf("demuxd listen on %s\n", sock_path);
+
+    fds[0].fd = daemon.listen_fd;
+    fds[0].events = POLLIN;
+    while(1){
+        if(poll(fds, nfds, -1) < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            printf("daemon poll failed, errno[%d]\n", errno);
+            break;
+        }
+
+        /* 请求都在本线程中处理, 命中缓存时只是查表 */
+        for(i = nfds - 1;i >= 1;i--){
+            if(fds[i].revents == 0){
+                continue;
+            }
+            if((fds[i].revents & POLLIN) == 0 || demux_daemon_handle(&daemon, fds[i].fd, buf) < 0){
+                close(fds[i].fd);
+                fds[i] = fds[--nfds];
+            }
+        }
+
+        if(fds[0].revents & POLLIN){
+            client = accept4(daemon.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if(client >= 0 && nfds > DEMUX_DAEMON_MAX_CLIENT){
+                printf("daemon too many clients\n");
+                close(client);
+            }else if(client >= 0 && demux_daemon_check_peer(&daemon, client) < 0){
+                close(client);
+            }else if(client >= 0){
+                fds[nfds].fd = client;
+                fds[nfds].events = POLLIN;
+                fds[nfds++].revents = 0;
+            }
+        }
+    }
+
+end:
+    for(i = 1;i < nfds;i++){
+        close(fds[i].fd);
+    }
+    list_for_each_entry_safe(entry, tmp, &daemon.lru, node){
+        list_del(&entry->node);
+        demux_daemon_free_entry(entry);
+    }
+    if(daemon.listen_fd >= 0){
+        close(daemon.listen_fd);
+        unlink(sock_path);
+    }
+    free(buf);
+
+    return -1;
+}
+
+int demux_daemon_connect(const char* sock_path){
+    struct sockaddr_un addr;
+    int sock = -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(sock_path) >= sizeof(addr.sun_path)){
+        printf("sock_path %s too long\n", sock_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, sock_path);
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(sock < 0 || connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+        printf("connect %s failed, errno[%d]\n", sock_path, errno);
+        if(sock >= 0){
+            close(sock);
+        }
+        return -1;
+    }
+
+    return sock;
+}
+
+/* 发一个请求, 回复的内容拷到out中, 返回回复中的条目数 */
+static int demux_daemon_call(int sock, demux_daemon_request_t* request, void* out, uint32_t out_size, uint32_t entry_size,
+                             uint32_t* first_sample, int* fd){
+    demux_daemon_response_t* response = NULL;
+    uint8_t* buf = NULL;
+    int len = 0;
+    int ret = -1;
+
+    buf = (uint8_t*)malloc(DEMUX_DAEMON_RESPONSE_BYTES);
+    if(buf == NULL){
+        printf("daemon buf NULL\n");
+        return -1;
+    }
+    if(demux_daemon_send(sock, request, sizeof(demux_daemon_request_t), -1) < 0){
+        goto end;
+    }
+    len = demux_daemon_recv(sock, buf, DEMUX_DAEMON_RESPONSE_BYTES, fd);
+    if(len < (int)sizeof(demux_daemon_response_t)){
+        printf("daemon recv failed\n");
+        goto end;
+    }
+
+    response = (demux_daemon_response_t*)buf;
+    if(response->status < 0 || len != (int)(sizeof(demux_daemon_response_t) + response->count * entry_size)){
+        printf("daemon request %s failed, status[%d]\n", request->path, response->status);
+        goto end;
+    }
+    if(response->count * entry_size > out_size){
+        response->count = out_size / entry_size;
+    }
+    memcpy(out, buf + sizeof(demux_daemon_response_t), response->count * entry_size);
+    if(first_sample != NULL){
+        *first_sample = response->first_sample;
+    }
+    ret = response->count;
+
+end:
+    free(buf);
+
+    return ret;
+}
+
+static void demux_daemon_request_init(demux_daemon_request_t* request, uint32_t type, const char* path){
+    memset(request, 0, sizeof(demux_daemon_request_t));
+    request->type = type;
+    strncpy(request->path, path, DEMUX_DAEMON_PATH_LENGTH - 1);
+}
+
+int demux_daemon_probe(int sock, const char* path, demux_daemon_track_t* tracks, int max_track){
+    demux_daemon_request_t request;
+
+    demux_daemon_request_init(&request, DEMUX_DAEMON_PROBE, path);
+
+    return demux_daemon_call(sock, &request, tracks, max_track * sizeof(demux_daemon_track_t),
+                             sizeof(demux_daemon_track_t), NULL, NULL);
+}
+
+/* 返回关键帧的sample序号, sample中为它的位置和时间 */
+int demux_daemon_seek(int sock, const char* path, uint32_t track_index, double time, demux_daemon_sample_t* sample){
+    demux_daemon_request_t request;
+    uint32_t first_sample = 0;
+
+    demux_daemon_request_init(&request, DEMUX_DAEMON_SEEK, path);
+    request.track_index = track_index;
+    request.time = time;
+    if(demux_daemon_call(sock, &request, sample, sizeof(demux_daemon_sample_t), sizeof(demux_daemon_sample_t),
+                         &first_sample, NULL) != 1){
+        return -1;
+    }
+
+    return first_sample;
+}
+
+int demux_daemon_samples(int sock, const char* path, uint32_t track_index, uint32_t first_sample, uint32_t sample_count,
+                         demux_daemon_sample_t* samples, int* data_fd){
+    demux_daemon_request_t request;
+    int ret = 0;
+
+    *data_fd = -1;
+    demux_daemon_request_init(&request, DEMUX_DAEMON_SAMPLES, path);
+    request.track_index = track_index;
+    request.first_sample = first_sample;
+    request.sample_count = sample_count;
+
+    ret = demux_daemon_call(sock, &request, samples, sample_count * sizeof(demux_daemon_sample_t),
+                            sizeof(demux_daemon_sample_t), NULL, data_fd);
+    if(ret < 0 && *data_fd >= 0){
+        close(*data_fd);
+        *data_fd = -1;
+    }
+
+    return ret;
+}
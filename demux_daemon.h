@@ -0,0 +1,107 @@
+#ifndef __DEMUX_DAEMON_H
+#define __DEMUX_DAEMON_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "list.h"
+#include "demux.h"
+
+/*
+ * demuxd: 本机常驻的解析服务, 同一台机器上的播放器/worker反复打开同一批文件时不用每次都解析moov
+ * 解析好的sample表按文件身份(dev, ino, size, mtime)放在LRU缓存中
+ * unix域套接字(SOCK_SEQPACKET)上回答probe/seek/sample区间查询, 取sample时把源文件fd通过SCM_RIGHTS传给客户端
+ * 客户端拿到fd + 偏移后自己pread/copy_file_range, sample数据不经过daemon
+ * 套接字权限为0600, 只接受和daemon同一用户(或root)的连接; 指定root目录时只打开root下的文件(按realpath判断)
+ * 所有请求在一个poll循环里串行处理, 未命中缓存时在循环中解析整个moov, 期间其他客户端的请求都要等待
+ */
+
+#define DEMUX_DAEMON_PATH_LENGTH 512
+#define DEMUX_DAEMON_CACHE_ENTRIES 16
+#define DEMUX_DAEMON_MAX_CLIENT 64
+#define DEMUX_DAEMON_MAX_SAMPLES 1024      // 一次sample区间查询最多返回的sample数
+#define DEMUX_DAEMON_MAX_TRACK 8
+
+enum DEMUX_DAEMON_REQUEST{
+    DEMUX_DAEMON_PROBE,     // track信息
+    DEMUX_DAEMON_SEEK,      // time之前(含)最近的关键帧
+    DEMUX_DAEMON_SAMPLES    // [first_sample, first_sample + sample_count)的位置和时间, 附带源文件fd
+};
+
+typedef struct demux_daemon_request
+{
+    uint32_t type;
+    uint32_t track_index;
+    double time;                // SEEK, 秒
+    uint32_t first_sample;      // SAMPLES
+    uint32_t sample_count;
+    char path[DEMUX_DAEMON_PATH_LENGTH];
+}demux_daemon_request_t;
+
+typedef struct demux_daemon_track
+{
+    uint32_t track_id;
+    char handler_type[4 + 1];
+    char codec[4 + 1];
+    uint32_t timescale;
+    uint64_t duration;
+    uint32_t sample_count;
+    uint32_t keyframe_count;
+    uint16_t width;
+    uint16_t height;
+}demux_daemon_track_t;
+
+typedef struct demux_daemon_sample
+{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t keyframe;
+    int64_t dts;
+    int64_t pts;
+}demux_daemon_sample_t;
+
+/* 回复头, 后面跟count个demux_daemon_track_t(PROBE)或demux_daemon_sample_t(SEEK/SAMPLES) */
+typedef struct demux_daemon_response
+{
+    int32_t status;             // 0成功, <0失败
+    uint32_t type;
+    uint32_t count;
+    uint32_t first_sample;      // SEEK时为关键帧的sample序号
+    uint32_t cached;            // 命中缓存为1
+}demux_daemon_response_t;
+
+/* 缓存的一个文件 */
+typedef struct demux_daemon_entry
+{
+    struct list_head node;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    int64_t mtime_ns;
+    int fd;
+    int track_count;
+    demux_daemon_track_t track[DEMUX_DAEMON_MAX_TRACK];
+    demux_daemon_sample_t* samples[DEMUX_DAEMON_MAX_TRACK];    // 按解码顺序
+}demux_daemon_entry_t;
+
+typedef struct demux_daemon
+{
+    int listen_fd;
+    uid_t uid;                  // 只接受这个用户和root的连接
+    char root[DEMUX_DAEMON_PATH_LENGTH];   // 为空时不限制路径
+    struct list_head lru;       // 表头为最近使用
+    int entry_count;
+    uint64_t hit_count;
+    uint64_t miss_count;
+}demux_daemon_t;
+
+/* 在sock_path上服务, root不为NULL时只服务root目录下的文件, 不返回(出错时返回-1) */
+extern int demux_daemon_run(const char* sock_path, const char* root);
+
+extern int demux_daemon_connect(const char* sock_path);
+extern int demux_daemon_probe(int sock, const char* path, demux_daemon_track_t* tracks, int max_track);
+extern int demux_daemon_seek(int sock, const char* path, uint32_t track_index, double time, demux_daemon_sample_t* sample);
+/* 返回取到的sample数, *data_fd为源文件fd, 由调用者close */
+extern int demux_daemon_samples(int sock, const char* path, uint32_t track_index, uint32_t first_sample, uint32_t sample_count,
+                                demux_daemon_sample_t* samples, int* data_fd);
+
+#endif
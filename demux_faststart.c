@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "demux.h"
+#include "demux_box.h"
+#include "demux_copy.h"
+#include "demux_faststart.h"
+
+/*
+ * faststart: 把文件末尾的moov挪到mdat前面
+ * moov读进内存后修正stco/co64中的chunk偏移, mdat等其余数据由copy_file_range直接在内核中拷贝
+ */
+
+typedef struct demux_faststart_ctx
+{
+    uint64_t insert_offset;     // 新moov插入的位置(第一个mdat之前)
+    uint64_t moov_offset;
+    uint64_t moov_size;
+    uint64_t new_moov_size;
+    int overflow;
+    uint32_t stco_entry_count;
+}demux_faststart_ctx_t;
+
+static int demux_faststart_is_container(const char* type){
+    return (memcmp(type, "moov", 4) == 0 || memcmp(type, "trak", 4) == 0 ||
+            memcmp(type, "mdia", 4) == 0 || memcmp(type, "minf", 4) == 0 ||
+            memcmp(type, "stbl", 4) == 0);
+}
+
+/* 旧文件中的偏移在新文件中的位置 */
+static uint64_t demux_faststart_map_offset(demux_faststart_ctx_t* ctx, uint64_t offset){
+    if(offset >= ctx->insert_offset && offset < ctx->moov_offset){
+        return offset + ctx->new_moov_size;
+    }
+    if(offset >= ctx->moov_offset + ctx->moov_size){
+        return offset + ctx->new_moov_size - ctx->moov_size;
+    }
+
+    return offset;
+}
+
+/* 遍历moov中所有stco/co64, patch为0时只检查是否溢出 */
+static int demux_faststart_patch(demux_faststart_ctx_t* ctx, uint8_t* data, uint64_t len, int patch){
+    demux_box_info_t box;
+    uint64_t pos = 0;
+    uint64_t offset = 0;
+    uint8_t* body = NULL;
+    uint64_t body_size = 0;
+    uint32_t entry_count = 0;
+    uint32_t entry_size = 0;
+    uint32_t i = 0;
+    int ret = 0;
+
+    while((ret = demux_box_next(data, len, &pos, &box)) > 0){
+        body = data + box.offset + box.header_size;
+        body_size = box.size - box.header_size;
+
+        if(demux_faststart_is_container(box.type)){
+            if(demux_faststart_patch(ctx, body, box.size - box.header_size, patch) < 0){
+                return -1;
+            }
+        }else if(memcmp(box.type, "stco", 4) == 0 || memcmp(box.type, "co64", 4) == 0){
+            /* 先确认body放得下version/flags和entry_count, 再读entry_count */
+            if(body_size < 8){
+                printf("%s body_size[%lu] error\n", box.type, body_size);
+                return -1;
+            }
+            entry_count = demux_get_be32(body + 4);
+            entry_size = box.type[0] == 's' ? 4 : 8;
+            if(8 + (uint64_t)entry_count * entry_size > body_size){
+                printf("%s entry_count[%u] error\n", box.type, entry_count);
+                return -1;
+            }
+
+            for(i = 0;i < entry_count;i++){
+                if(box.type[0] == 's'){
+                    offset = demux_faststart_map_offset(ctx, demux_get_be32(body + 8 + i * 4));
+                    if(offset > UINT32_MAX){
+                        ctx->overflow = 1;
+                    }else if(patch){
+                        demux_put_be32(body + 8 + i * 4, offset);
+                    }
+                }else if(patch){
+                    offset = demux_faststart_map_offset(ctx, demux_get_be64(body + 8 + i * 8));
+                    demux_put_be64(body + 8 + i * 8, offset);
+                }
+            }
+            if(box.type[0] == 's'){
+                ctx->stco_entry_count += entry_count;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* 把所有stco换成co64重新生成moov */
+static int demux_faststart_promote(const uint8_t* data, uint64_t len, demux_buf_t* out){
+    demux_box_info_t box;
+    const uint8_t* body = NULL;
+    uint64_t box_start = 0;
+    uint64_t pos = 0;
+    uint32_t entry_count = 0;
+    uint32_t i = 0;
+    int ret = 0;
+
+    while((ret = demux_box_next(data, len, &pos, &box)) > 0){
+        body = data + box.offset + box.header_size;
+
+        if(demux_faststart_is_container(box.type)){
+            box_start = demux_buf_box_begin(out, box.type);
+            if(demux_faststart_promote(body, box.size - box.header_size, out) < 0){
+                return -1;
+            }
+            demux_buf_box_end(out, box_start);
+        }else if(memcmp(box.type, "stco", 4) == 0){
+            entry_count = demux_get_be32(body + 4);
+            box_start = demux_buf_full_box_begin(out, "co64", 0, 0);
+            demux_buf_put_u32(out, entry_count);
+            for(i = 0;i < entry_count;i++){
+                demux_buf_put_u64(out, demux_get_be32(body + 8 + i * 4));
+            }
+            demux_buf_box_end(out, box_start);
+        }else{
+            demux_buf_put(out, data + box.offset, box.size);
+        }
+    }
+
+    return out->error ? -1 : ret;
+}
+
+int demux_walk_top_box(demux_io_t* io, demux_top_box_t** boxes){
+    demux_top_box_t* grown = NULL;
+    demux_top_box_t* box = NULL;
+    char box_type[4 + 1] = {0};
+    uint64_t body_size = 0;
+    uint64_t offset = 0;
+    int count = 0;
+    int cap = 0;
+
+    *boxes = NULL;
+    demux_io_seek(io, 0, SEEK_SET);
+    while(1){
+        offset = demux_io_tell(io);
+        if(demux_read_a_box_head(io, box_type, &body_size) < 0){
+            break;
+        }
+
+        /* 分片文件的顶层box很多, 按倍数扩容 */
+        if(count >= cap){
+            cap = cap ? cap * 2 : 64;
+            grown = (demux_top_box_t*)realloc(*boxes, cap * sizeof(demux_top_box_t));
+            if(grown == NULL){
+                printf("top box realloc failed, count[%d]\n", count);
+                free(*boxes);
+                *boxes = NULL;
+                return -1;
+            }
+            *boxes = grown;
+        }
+        box = &(*boxes)[count++];
+        strcpy(box->type, box_type);
+        box->offset = offset;
+        box->header_size = demux_io_tell(io) - offset;
+        box->size = box->header_size + body_size;
+
+        if(demux_io_seek(io, body_size, SEEK_CUR) < 0){
+            break;
+        }
+    }
+
+    return count;
+}
+
+/* 找第一个type类型的顶层box, 不限制顶层box个数, 找到返回0 */
+int demux_find_top_box(demux_io_t* io, const char* type, demux_top_box_t* box){
+    uint64_t body_size = 0;
+    uint64_t offset = 0;
+
+    demux_io_seek(io, 0, SEEK_SET);
+    while(1){
+        offset = demux_io_tell(io);
+        if(demux_read_a_box_head(io, box->type, &body_size) < 0){
+            return -1;
+        }
+        if(strcmp(box->type, type) == 0){
+            box->offset = offset;
+            box->header_size = demux_io_tell(io) - offset;
+            box->size = box->header_size + body_size;
+            return 0;
+        }
+        if(demux_io_seek(io, body_size, SEEK_CUR) < 0){
+            return -1;
+        }
+    }
+}
+
+static int demux_faststart_write(int in_fd, int out_fd, demux_faststart_ctx_t* ctx, demux_buf_t* moov, uint64_t file_size){
+    demux_copy_t copy;
+    uint64_t moov_end = ctx->moov_offset + ctx->moov_size;
+    int ret = 0;
+
+    demux_copy_init(&copy, in_fd, out_fd);
+
+    if(demux_copy_range(&copy, 0, ctx->insert_offset) < 0 ||
+       demux_copy_write(&copy, moov->data, moov->len) < 0 ||
+       demux_copy_range(&copy, ctx->insert_offset, ctx->moov_offset - ctx->insert_offset) < 0 ||
+       demux_copy_range(&copy, moov_end, file_size - moov_end) < 0){
+        printf("faststart write failed\n");
+        ret = -1;
+    }else{
+        printf("faststart output %lu bytes, zero copy %lu bytes\n", copy.copy_bytes, copy.zero_copy_bytes);
+    }
+    demux_copy_close(&copy);
+
+    return ret;
+}
+
+int demux_faststart(const char* in_path, const char* out_path){
+    demux_top_box_t* boxes = NULL;
+    demux_faststart_ctx_t ctx;
+    demux_buf_t moov;
+    demux_buf_t promoted;
+    demux_io_t* io = NULL;
+    uint64_t file_size = 0;
+    int box_count = 0;
+    int moov_index = -1;
+    int mdat_index = -1;
+    int out_fd = -1;
+    int ret = -1;
+    int i = 0;
+
+    if(in_path == NULL || out_path == NULL){
+        printf("in_path[%p] out_path[%p] NULL\n", in_path, out_path);
+        return -1;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&moov, 0, sizeof(moov));
+    memset(&promoted, 0, sizeof(promoted));
+
+    io = demux_io_open_file(in_path);
+    if(io == NULL){
+        printf("open %s failed\n", in_path);
+        goto end;
+    }
+
+    box_count = demux_walk_top_box(io, &boxes);
+    /* 顶层box没有走到文件末尾(文件损坏)时不输出, 否则新文件会被截断 */
+    file_size = demux_io_size(io);
+    if(box_count <= 0 || boxes[box_count - 1].offset + boxes[box_count - 1].size != file_size){
+        printf("top box walk stop at box %d, not reach file end[%lu]\n", box_count, file_size);
+        goto end;
+    }
+    for(i = 0;i < box_count;i++){
+        if(mdat_index < 0 && strcmp(boxes[i].type, "mdat") == 0){
+            mdat_index = i;
+        }
+        if(moov_index < 0 && strcmp(boxes[i].type, "moov") == 0){
+            moov_index = i;
+        }
+    }
+    if(moov_index < 0){
+        printf("moov not found\n");
+        goto end;
+    }
+
+    ctx.moov_offset = boxes[moov_index].offset;
+    ctx.moov_size = boxes[moov_index].size;
+    /* moov已经在mdat前面时原样拷贝 */
+    ctx.insert_offset = (mdat_index >= 0 && mdat_index < moov_index) ? boxes[mdat_index].offset : ctx.moov_offset;
+
+    if(demux_buf_init(&moov, ctx.moov_size) < 0){
+        goto end;
+    }
+    if(demux_io_read_at(io, ctx.moov_offset, moov.data, ctx.moov_size) != (int64_t)ctx.moov_size){
+        printf("read moov failed\n");
+        goto end;
+    }
+    moov.len = ctx.moov_size;
+
+    ctx.new_moov_size = moov.len;
+    if(ctx.insert_offset != ctx.moov_offset){
+        if(demux_faststart_patch(&ctx, moov.data, moov.len, 0) < 0){
+            goto end;
+        }
+
+        /* 偏移超出32位时stco升级为co64, moov变大后重新计算偏移 */
+        if(ctx.overflow){
+            printf("chunk offset overflow, promote %u stco entries to co64\n", ctx.stco_entry_count);
+            if(demux_buf_init(&promoted, moov.len + ctx.stco_entry_count * 4) < 0 ||
+               demux_faststart_promote(moov.data, moov.len, &promoted) < 0){
+                goto end;
+            }
+            demux_buf_free(&moov);
+            moov = promoted;
+            memset(&promoted, 0, sizeof(promoted));
+            ctx.new_moov_size = moov.len;
+        }
+
+        if(demux_faststart_patch(&ctx, moov.data, moov.len, 1) < 0){
+            goto end;
+        }
+    }else{
+        printf("moov already before mdat\n");
+    }
+
+    out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out_fd < 0){
+        printf("open %s failed\n", out_path);
+        goto end;
+    }
+
+    ret = demux_faststart_write(io->fd, out_fd, &ctx, &moov, file_size);
+
+end:
+    if(out_fd >= 0){
+        close(out_fd);
+    }
+    demux_io_close(io);
+    demux_buf_free(&moov);
+    demux_buf_free(&promoted);
+    free(boxes);
+
+    return ret;
+}
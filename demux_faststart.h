@@ -0,0 +1,20 @@
+#ifndef __DEMUX_FASTSTART_H
+#define __DEMUX_FASTSTART_H
+
+#include <stdint.h>
+#include "demux_io.h"
+
+typedef struct demux_top_box
+{
+    char type[4 + 1];
+    uint64_t offset;
+    uint64_t size;
+    uint32_t header_size;       // 8, largesize时为16
+}demux_top_box_t;
+
+/* 从头遍历所有顶层box, *boxes由这里按需扩容分配, 调用者free; 返回box个数, 分配失败返回-1 */
+extern int demux_walk_top_box(demux_io_t* io, demux_top_box_t** boxes);
+extern int demux_find_top_box(demux_io_t* io, const char* type, demux_top_box_t* box);
+extern int demux_faststart(const char* in_path, const char* out_path);
+
+#endif
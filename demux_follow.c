@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "demux.h"
+#include "demux_box.h"
+#include "demux_packet.h"
+#include "demux_follow.h"
+
+/* tfhd flags */
+#define DEMUX_TFHD_BASE_DATA_OFFSET 0x000001
+#define DEMUX_TFHD_DESCRIPTION_INDEX 0x000002
+#define DEMUX_TFHD_DEFAULT_DURATION 0x000008
+#define DEMUX_TFHD_DEFAULT_SIZE 0x000010
+#define DEMUX_TFHD_DEFAULT_FLAGS 0x000020
+#define DEMUX_TFHD_DEFAULT_BASE_IS_MOOF 0x020000
+
+/* trun flags */
+#define DEMUX_TRUN_DATA_OFFSET 0x000001
+#define DEMUX_TRUN_FIRST_SAMPLE_FLAGS 0x000004
+#define DEMUX_TRUN_SAMPLE_DURATION 0x000100
+#define DEMUX_TRUN_SAMPLE_SIZE 0x000200
+#define DEMUX_TRUN_SAMPLE_FLAGS 0x000400
+#define DEMUX_TRUN_SAMPLE_CTS 0x000800
+
+#define DEMUX_SAMPLE_IS_NON_SYNC 0x00010000
+
+/* 一个traf解析时用到的默认值 */
+typedef struct demux_follow_traf
+{
+    int track_index;
+    uint64_t base_offset;
+    uint64_t data_end;          // 上一个trun数据的结束位置
+    uint32_t default_duration;
+    uint32_t default_size;
+    uint32_t default_flags;
+}demux_follow_traf_t;
+
+demux_follow_t* demux_follow_open(const char* file_path, const demux_follow_callback_t* callback){
+    demux_follow_t* follow = NULL;
+
+    if(file_path == NULL){
+        printf("file_path NULL\n");
+        return NULL;
+    }
+
+    follow = (demux_follow_t*)calloc(1, sizeof(demux_follow_t));
+    if(follow == NULL){
+        printf("follow NULL\n");
+        return NULL;
+    }
+    follow->inotify_fd = -1;
+    if(callback != NULL){
+        follow->callback = *callback;
+    }
+
+    follow->demux_ctrl = (demux_ctrl_t*)calloc(1, sizeof(demux_ctrl_t));
+    if(follow->demux_ctrl == NULL || demux_init(follow->demux_ctrl, (char*)file_path, strlen(file_path)) < 0){
+        printf("follow open %s failed\n", file_path);
+        if(follow->demux_ctrl != NULL && follow->demux_ctrl->io == NULL){
+            /* 没有打开输入时解析函数表还没初始化, 不能走demux_close */
+            free(follow->demux_ctrl);
+            follow->demux_ctrl = NULL;
+        }
+        demux_follow_close(follow);
+        return NULL;
+    }
+
+    /* inotify不可用时(如网络文件系统)退化为定时轮询 */
+    follow->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(follow->inotify_fd >= 0){
+        follow->watch_fd = inotify_add_watch(follow->inotify_fd, file_path, IN_MODIFY | IN_CLOSE_WRITE);
+        if(follow->watch_fd < 0){
+            close(follow->inotify_fd);
+            follow->inotify_fd = -1;
+        }
+    }
+    if(follow->inotify_fd < 0){
+        printf("inotify unavailable, poll every %d ms\n", DEMUX_FOLLOW_POLL_MS);
+    }
+
+    return follow;
+}
+
+/* 按需扩大缓冲, 只增不减 */
+static int demux_follow_reserve(uint8_t** buf, uint64_t* cap, uint64_t len){
+    uint8_t* data = NULL;
+
+    if(len <= *cap){
+        return 0;
+    }
+    data = (uint8_t*)realloc(*buf, len);
+    if(data == NULL){
+        printf("follow buffer realloc failed, len[%lu]\n", len);
+        return -1;
+    }
+    *buf = data;
+    *cap = len;
+
+    return 0;
+}
+
+static int demux_follow_packet_cmp(const void* a, const void* b){
+    const demux_packet_t* pkt_a = (const demux_packet_t*)a;
+    const demux_packet_t* pkt_b = (const demux_packet_t*)b;
+
+    if(pkt_a->offset == pkt_b->offset){
+        return 0;
+    }
+
+    return pkt_a->offset < pkt_b->offset ? -1 : 1;
+}
+
+static int demux_follow_add_packet(demux_follow_t* follow, const demux_packet_t* pkt){
+    demux_packet_t* packets = NULL;
+
+    if(follow->packet_count >= follow->packet_cap){
+        follow->packet_cap = follow->packet_cap ? follow->packet_cap * 2 : 1024;
+        packets = (demux_packet_t*)realloc(follow->packets, follow->packet_cap * sizeof(demux_packet_t));
+        if(packets == NULL){
+            printf("follow packets realloc failed\n");
+            return -1;
+        }
+        follow->packets = packets;
+    }
+    follow->packets[follow->packet_count++] = *pkt;
+
+    return 0;
+}
+
+/* 数据已经完整写入(在boundary之前)的sample按文件偏移逐个回调 */
+static int demux_follow_emit(demux_follow_t* follow){
+    demux_packet_t* pkt = NULL;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint32_t count = 0;
+    uint32_t i = 0;
+    int whole = 0;
+    int ret = 0;
+
+    while(count < follow->packet_count && follow->packets[count].offset + follow->packets[count].size <= follow->boundary){
+        count++;
+    }
+    if(count == 0){
+        return 0;
+    }
+
+    /* sample一般连续存放在同一个mdat中, 整段一次读出 */
+    start = follow->packets[0].offset;
+    for(i = 0;i < count;i++){
+        if(follow->packets[i].offset + follow->packets[i].size > end){
+            end = follow->packets[i].offset + follow->packets[i].size;
+        }
+    }
+    whole = (end - start <= DEMUX_FOLLOW_MAX_READ_BYTES);
+
+    for(i = 0;i < count && ret >= 0;i++){
+        pkt = &follow->packets[i];
+        if(whole){
+            if(i == 0){
+                if(demux_follow_reserve(&follow->data, &follow->data_cap, end - start) < 0){
+                    return -1;
+                }
+                if(demux_io_read_at(follow->demux_ctrl->io, start, follow->data, end - start) != (int64_t)(end - start)){
+                    printf("follow read failed, offset[%lu] len[%lu]\n", start, end - start);
+                    return -1;
+                }
+            }
+            pkt->data = follow->data + (pkt->offset - start);
+        }else{
+            if(demux_follow_reserve(&follow->data, &follow->data_cap, pkt->size) < 0){
+                return -1;
+            }
+            if(demux_read_at(follow->demux_ctrl, pkt->offset, follow->data, pkt->size) < 0){
+                return -1;
+            }
+            pkt->data = follow->data;
+        }
+
+        if(follow->callback.on_packet != NULL){
+            ret = follow->callback.on_packet(follow->callback.user, pkt);
+        }
+        pkt->data = NULL;
+        follow->packet_emitted++;
+        demux_stats_sample(&follow->demux_ctrl->stats, pkt->size);
+    }
+
+    follow->packet_count -= count;
+    memmove(follow->packets, follow->packets + count, follow->packet_count * sizeof(demux_packet_t));
+
+    return (ret < 0) ? -1 : (int)count;
+}
+
+static int demux_follow_find_track(demux_ctrl_t* demux_ctrl, uint32_t track_id){
+    int i = 0;
+
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        if(demux_ctrl->track[i]->track_id == track_id){
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int demux_follow_parse_tfhd(demux_follow_t* follow, const uint8_t* body, uint64_t len,
+                                   uint64_t moof_offset, demux_follow_traf_t* traf){
+    video_ctrl_t* track = NULL;
+    uint32_t flags = 0;
+    uint64_t pos = 8;
+
+    if(len < 8){
+        printf("tfhd size[%lu] error\n", len);
+        return -1;
+    }
+    flags = demux_get_be32(body) & 0xffffff;
+    traf->track_index = demux_follow_find_track(follow->demux_ctrl, demux_get_be32(body + 4));
+    if(traf->track_index < 0){
+        printf("tfhd track_id[%u] not found\n", demux_get_be32(body + 4));
+        return -1;
+    }
+    track = follow->demux_ctrl->track[traf->track_index];
+
+    traf->default_duration = track->trex_default_duration;
+    traf->default_size = track->trex_default_size;
+    traf->default_flags = track->trex_default_flags;
+
+    /* 没有base_data_offset时, 第一个traf或default-base-is-moof以moof开头为基准, 否则接着上一个traf的数据 */
+    if(flags & DEMUX_TFHD_BASE_DATA_OFFSET){
+        if(pos + 8 > len){
+            goto err;
+        }
+        traf->base_offset = demux_get_be64(body + pos);
+        pos += 8;
+    }else if((flags & DEMUX_TFHD_DEFAULT_BASE_IS_MOOF) || traf->data_end == 0){
+        traf->base_offset = moof_offset;
+    }else{
+        traf->base_offset = traf->data_end;
+    }
+    if(flags & DEMUX_TFHD_DESCRIPTION_INDEX){
+        pos += 4;
+    }
+    if(flags & DEMUX_TFHD_DEFAULT_DURATION){
+        if(pos + 4 > len){
+            goto err;
+        }
+        traf->default_duration = demux_get_be32(body + pos);
+        pos += 4;
+    }
+    if(flags & DEMUX_TFHD_DEFAULT_SIZE){
+        if(pos + 4 > len){
+            goto err;
+        }
+        traf->default_size = demux_get_be32(body + pos);
+        pos += 4;
+    }
+    if(flags & DEMUX_TFHD_DEFAULT_FLAGS){
+        if(pos + 4 > len){
+            goto err;
+        }
+        traf->default_flags = demux_get_be32(body + pos);
+        pos += 4;
+    }
+    traf->data_end = traf->base_offset;
+
+    return 0;
+
+err:
+    printf("tfhd flags[%x] size[%lu] error\n", flags, len);
+    return -1;
+}
+
+static int demux_follow_parse_trun(demux_follow_t* follow, const uint8_t* body, uint64_t len, demux_follow_traf_t* traf){
+    demux_packet_t pkt;
+    uint32_t flags = 0;
+    uint32_t sample_count = 0;
+    uint32_t first_flags = 0;
+    uint32_t sample_flags = 0;
+    uint32_t entry_size = 0;
+    uint64_t offset = traf->data_end;
+    uint64_t pos = 8;
+    int32_t cts = 0;
+    uint32_t i = 0;
+
+    if(len < 8){
+        printf("trun size[%lu] error\n", len);
+        return -1;
+    }
+    flags = demux_get_be32(body) & 0xffffff;
+    sample_count = demux_get_be32(body + 4);
+
+    if(flags & DEMUX_TRUN_DATA_OFFSET){
+        if(pos + 4 > len){
+            goto err;
+        }
+        offset = traf->base_offset + (int32_t)demux_get_be32(body + pos);
+        pos += 4;
+    }
+    if(flags & DEMUX_TRUN_FIRST_SAMPLE_FLAGS){
+        if(pos + 4 > len){
+            goto err;
+        }
+        first_flags = demux_get_be32(body + pos);
+        pos += 4;
+    }
+
+    entry_size = 4 * (!!(flags & DEMUX_TRUN_SAMPLE_DURATION) + !!(flags & DEMUX_TRUN_SAMPLE_SIZE) +
+                      !!(flags & DEMUX_TRUN_SAMPLE_FLAGS) + !!(flags & DEMUX_TRUN_SAMPLE_CTS));
+    if((uint64_t)sample_count * entry_size > len - pos){
+        goto err;
+    }
+
+    memset(&pkt, 0, sizeof(demux_packet_t));
+    pkt.track_index = traf->track_index;
+    for(i = 0;i < sample_count;i++){
+        pkt.duration = traf->default_duration;
+        pkt.size = traf->default_size;
+        sample_flags = (i == 0 && (flags & DEMUX_TRUN_FIRST_SAMPLE_FLAGS)) ? first_flags : traf->default_flags;
+        cts = 0;
+
+        if(flags & DEMUX_TRUN_SAMPLE_DURATION){
+            pkt.duration = demux_get_be32(body + pos);
+            pos += 4;
+        }
+        if(flags & DEMUX_TRUN_SAMPLE_SIZE){
+            pkt.size = demux_get_be32(body + pos);
+            pos += 4;
+        }
+        if(flags & DEMUX_TRUN_SAMPLE_FLAGS){
+            sample_flags = demux_get_be32(body + pos);
+            pos += 4;
+        }
+        if(flags & DEMUX_TRUN_SAMPLE_CTS){
+            /* version 0为无符号, 实际写出的文件两种都有, 统一按有符号处理 */
+            cts = (int32_t)demux_get_be32(body + pos);
+            pos += 4;
+        }
+
+        pkt.sample_index = follow->next_sample[traf->track_index]++;
+        pkt.offset = offset;
+        pkt.dts = follow->next_dts[traf->track_index];
+        pkt.pts = pkt.dts + cts;
+        pkt.keyframe = !(sample_flags & DEMUX_SAMPLE_IS_NON_SYNC);
+        follow->next_dts[traf->track_index] += pkt.duration;
+        offset += pkt.size;
+
+        if(demux_follow_add_packet(follow, &pkt) < 0){
+            return -1;
+        }
+    }
+    traf->data_end = offset;
+
+    return 0;
+
+err:
+    printf("trun flags[%x] sample_count[%u] size[%lu] error\n", flags, sample_count, len);
+    return -1;
+}
+
+static int demux_follow_parse_traf(demux_follow_t* follow, const uint8_t* data, uint64_t len,
+                                   uint64_t moof_offset, demux_follow_traf_t* traf){
+    demux_box_info_t box;
+    const uint8_t* body = NULL;
+    uint64_t body_len = 0;
+    uint64_t pos = 0;
+    int has_tfhd = 0;
+    int ret = 0;
+
+    while((ret = demux_box_next(data, len, &pos, &box)) > 0){
+        body = data + box.offset + box.header_size;
+        body_len = box.size - box.header_size;
+
+        if(memcmp(box.type, "tfhd", BOX_TYPE_BYTE) == 0){
+            if(demux_follow_parse_tfhd(follow, body, body_len, moof_offset, traf) < 0){
+                return -1;
+            }
+            has_tfhd = 1;
+        }else if(memcmp(box.type, "tfdt", BOX_TYPE_BYTE) == 0 && has_tfhd){
+            /* baseMediaDecodeTime, 中间丢过fragment时以它为准 */
+            if(body_len >= 12 && body[0] == 1){
+                follow->next_dts[traf->track_index] = demux_get_be64(body + 4);
+            }else if(body_len >= 8){
+                follow->next_dts[traf->track_index] = demux_get_be32(body + 4);
+            }
+        }else if(memcmp(box.type, "trun", BOX_TYPE_BYTE) == 0){
+            if(!has_tfhd){
+                printf("trun before tfhd\n");
+                return -1;
+            }
+            if(demux_follow_parse_trun(follow, body, body_len, traf) < 0){
+                return -1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static int demux_follow_parse_moof(demux_follow_t* follow, const uint8_t* data, uint64_t len, uint64_t moof_offset){
+    demux_follow_traf_t traf;
+    demux_box_info_t moof;
+    demux_box_info_t box;
+    uint64_t pos = 0;
+    int ret = 0;
+
+    if(demux_box_next(data, len, &pos, &moof) <= 0){
+        return -1;
+    }
+    data += moof.header_size;
+    len = moof.size - moof.header_size;
+    pos = 0;
+
+    memset(&traf, 0, sizeof(demux_follow_traf_t));
+    while((ret = demux_box_next(data, len, &pos, &box)) > 0){
+        if(memcmp(box.type, "traf", BOX_TYPE_BYTE) != 0){
+            continue;
+        }
+        if(demux_follow_parse_traf(follow, data + box.offset + box.header_size,
+                                   box.size - box.header_size, moof_offset, &traf) < 0){
+            return -1;
+        }
+    }
+    if(ret < 0){
+        return -1;
+    }
+
+    /* 多个traf的数据在mdat中交错, 按偏移排序后回调 */
+    qsort(follow->packets, follow->packet_count, sizeof(demux_packet_t), demux_follow_packet_cmp);
+    follow->fragment_count++;
+
+    return 0;
+}
+
+/* moov用现有的box解析流程, 非fragmented文件的sample也在这里取出 */
+static int demux_follow_parse_moov(demux_follow_t* follow, uint64_t box_end){
+    demux_ctrl_t* demux_ctrl = follow->demux_ctrl;
+    demux_packet_reader_t reader;
+    demux_packet_t pkt;
+    int i = 0;
+
+    demux_io_seek(demux_ctrl->io, follow->boundary, SEEK_SET);
+    while(demux_io_tell(demux_ctrl->io) < box_end){
+        if(demux_handle_box_body(demux_ctrl) < 0){
+            return -1;
+        }
+    }
+    follow->moov_done = 1;
+
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        if(follow->callback.on_track != NULL && follow->callback.on_track(follow->callback.user, demux_ctrl, i) < 0){
+            return -1;
+        }
+    }
+
+    if(demux_packet_reader_init(&reader, demux_ctrl, DEMUX_PACKET_ALL_TRACK) < 0){
+        return -1;
+    }
+    while(demux_read_packet_info(&reader, &pkt) > 0){
+        if(demux_follow_add_packet(follow, &pkt) < 0){
+            demux_packet_reader_close(&reader);
+            return -1;
+        }
+        follow->next_sample[pkt.track_index] = pkt.sample_index + 1;
+        follow->next_dts[pkt.track_index] = pkt.dts + pkt.duration;
+    }
+    demux_packet_reader_close(&reader);
+    qsort(follow->packets, follow->packet_count, sizeof(demux_packet_t), demux_follow_packet_cmp);
+
+    return 0;
+}
+
+static int demux_follow_handle_box(demux_follow_t* follow, const char* box_type, uint64_t box_size){
+    demux_io_t* io = follow->demux_ctrl->io;
+
+    if(memcmp(box_type, "moov", BOX_TYPE_BYTE) == 0 && !follow->moov_done){
+        return demux_follow_parse_moov(follow, follow->boundary + box_size);
+    }
+
+    if(memcmp(box_type, "moof", BOX_TYPE_BYTE) == 0){
+        if(!follow->moov_done){
+            printf("moof before moov, offset[%lu]\n", follow->boundary);
+            return -1;
+        }
+        if(box_size > DEMUX_FOLLOW_MAX_META_BYTES){
+            printf("moof size[%lu] exceed %u\n", box_size, DEMUX_FOLLOW_MAX_META_BYTES);
+            return -1;
+        }
+        if(demux_follow_reserve(&follow->meta, &follow->meta_cap, box_size) < 0){
+            return -1;
+        }
+        if(demux_io_read_at(io, follow->boundary, follow->meta, box_size) != (int64_t)box_size){
+            printf("read moof failed, offset[%lu]\n", follow->boundary);
+            return -1;
+        }
+
+        return demux_follow_parse_moof(follow, follow->meta, box_size, follow->boundary);
+    }
+
+    /* mdat等其余box不需要解析, sample的位置已经由moof/moov给出 */
+    return 0;
+}
+
+/* 解析新写完整的box并回调其中的sample, 返回回调的sample数, 出错返回-1 */
+int demux_follow_poll(demux_follow_t* follow){
+    demux_io_t* io = NULL;
+    uint8_t head[BOX_HEAD_BYTE + BOX_LARGE_SZIE_BYTE];
+    char box_type[4 + 1] = {0};
+    uint64_t box_size = 0;
+    uint32_t head_len = BOX_HEAD_BYTE;
+    int64_t size = 0;
+    int emitted = 0;
+    int ret = 0;
+
+    if(follow == NULL || follow->demux_ctrl == NULL){
+        printf("follow NULL\n");
+        return -1;
+    }
+    io = follow->demux_ctrl->io;
+
+    size = demux_io_refresh(io);
+    if(size < 0){
+        return -1;
+    }
+    if((uint64_t)size < follow->boundary){
+        printf("file shrink to %ld, boundary[%lu]\n", size, follow->boundary);
+        return -1;
+    }
+    follow->file_size = size;
+
+    while(follow->file_size - follow->boundary >= BOX_HEAD_BYTE){
+        if(demux_io_read_at(io, follow->boundary, head, BOX_HEAD_BYTE) != BOX_HEAD_BYTE){
+            return -1;
+        }
+        box_size = demux_get_be32(head);
+        memcpy(box_type, head + BOX_SIZE_BYTE, BOX_TYPE_BYTE);
+
+        if(box_size == 1){
+            head_len += BOX_LARGE_SZIE_BYTE;
+            if(follow->file_size - follow->boundary < head_len){
+                break;
+            }
+            if(demux_io_read_at(io, follow->boundary + BOX_HEAD_BYTE, head + BOX_HEAD_BYTE, BOX_LARGE_SZIE_BYTE) != BOX_LARGE_SZIE_BYTE){
+                return -1;
+            }
+            box_size = demux_get_be64(head + BOX_HEAD_BYTE);
+        }else if(box_size == 0){
+            /* 录制中的size为0的box不知道在哪结束, 等写入方补上大小 */
+            break;
+        }
+        if(box_size < head_len){
+            printf("follow box %s size[%lu] error, offset[%lu]\n", box_type, box_size, follow->boundary);
+            return -1;
+        }
+        head_len = BOX_HEAD_BYTE;
+
+        /* box还没写完, 停在上一个完整box的边界, 下次从这里继续 */
+        if(box_size > follow->file_size - follow->boundary){
+            break;
+        }
+
+        if(demux_follow_handle_box(follow, box_type, box_size) < 0){
+            return -1;
+        }
+        follow->boundary += box_size;
+
+        ret = demux_follow_emit(follow);
+        if(ret < 0){
+            return -1;
+        }
+        emitted += ret;
+    }
+
+    return emitted;
+}
+
+/* 等待文件变化, 返回1表示可能有新数据, 0表示超时 */
+int demux_follow_wait(demux_follow_t* follow, int timeout_ms){
+    char events[4096];
+    struct pollfd pfd;
+    int ret = 0;
+
+    if(follow->inotify_fd < 0){
+        usleep((timeout_ms < DEMUX_FOLLOW_POLL_MS ? timeout_ms : DEMUX_FOLLOW_POLL_MS) * 1000);
+        return 1;
+    }
+
+    pfd.fd = follow->inotify_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ret = poll(&pfd, 1, timeout_ms);
+    if(ret < 0){
+        printf("poll inotify failed\n");
+        return -1;
+    }
+    if(ret == 0){
+        return 0;
+    }
+
+    /* 一次写入会产生多个事件, 全部读掉 */
+    while(read(follow->inotify_fd, events, sizeof(events)) > 0);
+
+    return 1;
+}
+
+static uint64_t demux_follow_now_ms(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* 一直跟随到文件idle_ms内没有增长, idle_ms小于0时不退出 */
+int demux_follow_run(demux_follow_t* follow, int idle_ms){
+    uint64_t last_grow = demux_follow_now_ms();
+    uint64_t last_size = 0;
+    uint64_t now = 0;
+    int ret = 0;
+
+    while(1){
+        if(demux_follow_poll(follow) < 0){
+            return -1;
+        }
+
+        now = demux_follow_now_ms();
+        if(follow->file_size != last_size){
+            last_size = follow->file_size;
+            last_grow = now;
+        }else if(idle_ms >= 0 && now - last_grow >= (uint64_t)idle_ms){
+            break;
+        }
+
+        ret = demux_follow_wait(follow, DEMUX_FOLLOW_POLL_MS);
+        if(ret < 0){
+            return -1;
+        }
+    }
+
+    if(follow->boundary != follow->file_size){
+        printf("follow stop with %lu bytes incomplete box at %lu\n", follow->file_size - follow->boundary, follow->boundary);
+    }
+    printf("follow %lu bytes, %lu fragments, %lu packets\n", follow->boundary, follow->fragment_count, follow->packet_emitted);
+
+    return 0;
+}
+
+demux_ctrl_t* demux_follow_get_ctrl(demux_follow_t* follow){
+    return (follow != NULL) ? follow->demux_ctrl : NULL;
+}
+
+void demux_follow_close(demux_follow_t* follow){
+    if(follow == NULL){
+        return;
+    }
+
+    if(follow->inotify_fd >= 0){
+        close(follow->inotify_fd);
+    }
+    if(follow->demux_ctrl != NULL){
+        demux_close(follow->demux_ctrl);
+    }
+    free(follow->meta);
+    free(follow->packets);
+    free(follow->data);
+    free(follow);
+}
@@ -0,0 +1,60 @@
+#ifndef __DEMUX_FOLLOW_H
+#define __DEMUX_FOLLOW_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_packet.h"
+
+/*
+ * 跟随模式: 文件还在录制(fragmented mp4不断追加moof/mdat)时边写边解析
+ * 只处理已经写完整的顶层box, 记住最后一个完整box的结束位置, 写了一半的box等写完后再从这里继续
+ * 文件变化用inotify等待, inotify不可用时定时轮询
+ */
+
+#define DEMUX_FOLLOW_POLL_MS 200
+#define DEMUX_FOLLOW_MAX_META_BYTES (64 * 1024 * 1024)      // moov/moof读进内存的上限
+#define DEMUX_FOLLOW_MAX_READ_BYTES (64 * 1024 * 1024)      // 一次读出一个fragment全部sample数据的上限
+
+typedef struct demux_follow_callback
+{
+    /* moov解析完后每个track回调一次 */
+    int (*on_track)(void* user, demux_ctrl_t* demux_ctrl, int track_index);
+    /* pkt->data只在回调中有效 */
+    int (*on_packet)(void* user, demux_packet_t* pkt);
+    void* user;
+}demux_follow_callback_t;
+
+typedef struct demux_follow
+{
+    demux_ctrl_t* demux_ctrl;
+    demux_follow_callback_t callback;
+    int inotify_fd;             // -1时定时轮询
+    int watch_fd;
+
+    uint64_t file_size;
+    uint64_t boundary;          // 最后一个完整顶层box的结束位置
+    int moov_done;
+    uint8_t* meta;              // 读进内存的moof
+    uint64_t meta_cap;
+
+    demux_packet_t* packets;    // 已经解析出, 数据还没写完的sample, 按文件偏移排序
+    uint32_t packet_count;
+    uint32_t packet_cap;
+    uint8_t* data;              // 读出的sample数据
+    uint64_t data_cap;
+
+    int64_t next_dts[DEMUX_MAX_TRACK_NUM];
+    uint32_t next_sample[DEMUX_MAX_TRACK_NUM];
+
+    uint64_t fragment_count;
+    uint64_t packet_emitted;
+}demux_follow_t;
+
+extern demux_follow_t* demux_follow_open(const char* file_path, const demux_follow_callback_t* callback);
+extern int demux_follow_poll(demux_follow_t* follow);
+extern int demux_follow_wait(demux_follow_t* follow, int timeout_ms);
+extern int demux_follow_run(demux_follow_t* follow, int idle_ms);
+extern demux_ctrl_t* demux_follow_get_ctrl(demux_follow_t* follow);
+extern void demux_follow_close(demux_follow_t* follow);
+
+#endif
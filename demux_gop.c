@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "demux.h"
+#include "demux_gop.h"
+
+static int demux_gop_add_sample(demux_gop_list_t* list, demux_packet_t* pkt){
+    demux_packet_t* samples = NULL;
+
+    if(list->sample_count >= list->sample_cap){
+        list->sample_cap = list->sample_cap ? list->sample_cap * 2 : 256;
+        samples = (demux_packet_t*)realloc(list->samples, list->sample_cap * sizeof(demux_packet_t));
+        if(samples == NULL){
+            printf("gop samples realloc failed\n");
+            return -1;
+        }
+        list->samples = samples;
+    }
+
+    list->samples[list->sample_count] = *pkt;
+    list->samples[list->sample_count++].data = NULL;
+
+    return 0;
+}
+
+static demux_gop_t* demux_gop_new(demux_gop_list_t* list){
+    demux_gop_t* gops = NULL;
+    demux_gop_t* gop = NULL;
+
+    if(list->gop_count >= list->gop_cap){
+        list->gop_cap = list->gop_cap ? list->gop_cap * 2 : 64;
+        gops = (demux_gop_t*)realloc(list->gops, list->gop_cap * sizeof(demux_gop_t));
+        if(gops == NULL){
+            printf("gops realloc failed\n");
+            return NULL;
+        }
+        list->gops = gops;
+    }
+
+    gop = &list->gops[list->gop_count++];
+    memset(gop, 0, sizeof(demux_gop_t));
+    gop->range_first = list->range_count;
+
+    return gop;
+}
+
+/* 和上一个区间首尾相接时合并, 否则新开一个区间 */
+static int demux_gop_add_range(demux_gop_list_t* list, demux_gop_t* gop, uint64_t offset, uint32_t size){
+    demux_range_t* ranges = NULL;
+    demux_range_t* last = NULL;
+
+    if(gop->range_count > 0){
+        last = &list->ranges[list->range_count - 1];
+        if(last->offset + last->len == offset){
+            last->len += size;
+            return 0;
+        }
+    }
+
+    if(list->range_count >= list->range_cap){
+        list->range_cap = list->range_cap ? list->range_cap * 2 : 64;
+        ranges = (demux_range_t*)realloc(list->ranges, list->range_cap * sizeof(demux_range_t));
+        if(ranges == NULL){
+            printf("gop ranges realloc failed\n");
+            return -1;
+        }
+        list->ranges = ranges;
+    }
+
+    list->ranges[list->range_count].offset = offset;
+    list->ranges[list->range_count++].len = size;
+    gop->range_count++;
+
+    return 0;
+}
+
+/* 没有stss时每个sample都是关键帧, 每个sample一个GOP */
+int demux_gop_build(demux_ctrl_t* demux_ctrl, int track_index, demux_gop_list_t* list){
+    demux_packet_reader_t reader;
+    demux_packet_t pkt;
+    demux_gop_t* gop = NULL;
+    int ret = 0;
+
+    memset(list, 0, sizeof(demux_gop_list_t));
+    list->track = demux_get_track(demux_ctrl, track_index);
+    if(list->track == NULL){
+        printf("track_index[%d] error\n", track_index);
+        return -1;
+    }
+
+    if(demux_packet_reader_init(&reader, demux_ctrl, 1u << track_index) < 0){
+        return -1;
+    }
+    while(ret >= 0 && demux_read_packet_info(&reader, &pkt) > 0){
+        /* 第一个sample不是关键帧时也作为GOP开头, 这个GOP不能单独解码 */
+        if(gop == NULL || pkt.keyframe){
+            gop = demux_gop_new(list);
+            if(gop == NULL){
+                ret = -1;
+                break;
+            }
+            gop->first_sample = pkt.sample_index;
+            gop->dts_start = pkt.dts;
+        }
+        gop->sample_count++;
+        gop->dts_end = pkt.dts + pkt.duration;
+        gop->bytes += pkt.size;
+        ret = demux_gop_add_range(list, gop, pkt.offset, pkt.size);
+        if(ret >= 0){
+            ret = demux_gop_add_sample(list, &pkt);
+        }
+    }
+    demux_packet_reader_close(&reader);
+
+    if(ret < 0){
+        demux_gop_free(list);
+    }
+
+    return ret;
+}
+
+void demux_gop_print(demux_gop_list_t* list){
+    video_ctrl_t* track = list->track;
+    demux_gop_t* gop = NULL;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    printf("track %u %s gops[%u] ranges[%u]\n", track->track_id, track->codec, list->gop_count, list->range_count);
+    for(i = 0;i < list->gop_count;i++){
+        gop = &list->gops[i];
+        printf("gop %u samples[%u, %u) dts[%ld, %ld) time[%.3f, %.3f) bytes[%lu] ranges[%u]",
+            i, gop->first_sample, gop->first_sample + gop->sample_count, gop->dts_start, gop->dts_end,
+            (double)gop->dts_start / track->timescale, (double)gop->dts_end / track->timescale, gop->bytes, gop->range_count);
+        for(j = 0;j < gop->range_count;j++){
+            printf(" %lu+%lu", list->ranges[gop->range_first + j].offset, list->ranges[gop->range_first + j].len);
+        }
+        printf("\n");
+    }
+}
+
+void demux_gop_free(demux_gop_list_t* list){
+    free(list->gops);
+    free(list->ranges);
+    free(list->samples);
+    memset(list, 0, sizeof(demux_gop_list_t));
+}
+
+static void demux_shard_write_hex(FILE* fp, const uint8_t* data, uint32_t len){
+    uint32_t i = 0;
+
+    for(i = 0;i < len;i++){
+        fprintf(fp, "%02x", data[i]);
+    }
+    if(len == 0){
+        fprintf(fp, "-");
+    }
+}
+
+/*
+ * 分片描述为文本, 每行一个字段:
+ * demux-shard 1 / source 源文件 / gop 序号 / track id codec timescale width height
+ * avcc nal_length_size sps pps(十六进制) / range offset len / sample offset size dts cts_offset keyframe
+ */
+static int demux_gop_write_shard(demux_ctrl_t* demux_ctrl, demux_gop_list_t* list, uint32_t gop_index, const char* path){
+    video_ctrl_t* track = list->track;
+    demux_gop_t* gop = &list->gops[gop_index];
+    demux_packet_t* pkt = NULL;
+    demux_range_t* range = NULL;
+    FILE* fp = NULL;
+    uint32_t i = 0;
+    int ret = 0;
+
+    fp = fopen(path, "w");
+    if(fp == NULL){
+        printf("open %s failed\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "%s %d\n", DEMUX_SHARD_MAGIC, DEMUX_SHARD_VERSION);
+    fprintf(fp, "source %s\n", demux_ctrl->file_path);
+    fprintf(fp, "gop %u\n", gop_index);
+    fprintf(fp, "track %u %s %u %u %u\n", track->track_id, track->codec, track->timescale, track->width, track->height);
+    if(strcmp(track->codec, "avc1") == 0){
+        fprintf(fp, "avcc %u ", track->nal_length_size);
+        demux_shard_write_hex(fp, (const uint8_t*)track->sps, track->sps_len);
+        fprintf(fp, " ");
+        demux_shard_write_hex(fp, (const uint8_t*)track->pps, track->pps_len);
+        fprintf(fp, "\n");
+    }
+    for(i = 0;i < gop->range_count;i++){
+        range = &list->ranges[gop->range_first + i];
+        fprintf(fp, "range %lu %lu\n", range->offset, range->len);
+    }
+    for(i = 0;i < gop->sample_count;i++){
+        pkt = &list->samples[gop->first_sample + i];
+        fprintf(fp, "sample %lu %u %ld %ld %d\n", pkt->offset, pkt->size, pkt->dts, pkt->pts - pkt->dts, pkt->keyframe ? 1 : 0);
+    }
+
+    if(ferror(fp)){
+        printf("write %s failed\n", path);
+        ret = -1;
+    }
+    fclose(fp);
+
+    return ret;
+}
+
+int demux_gop_write_shards(demux_ctrl_t* demux_ctrl, demux_gop_list_t* list, const char* out_dir){
+    char path[DEMUX_SHARD_PATH_LENGTH] = {0};
+    char name[64] = {0};
+    uint32_t i = 0;
+
+    /* worker按源文件路径读取数据, 只有从文件打开的输入可以写分片描述 */
+    if(demux_ctrl->file_path[0] == 0){
+        printf("shard need input file path\n");
+        return -1;
+    }
+    if(mkdir(out_dir, 0755) < 0 && errno != EEXIST){
+        printf("mkdir %s failed\n", out_dir);
+        return -1;
+    }
+
+    for(i = 0;i < list->gop_count;i++){
+        snprintf(name, sizeof(name), DEMUX_SHARD_NAME_FORMAT, i);
+        if(snprintf(path, sizeof(path), "%s/%s", out_dir, name) >= (int)sizeof(path)){
+            printf("shard path too long\n");
+            return -1;
+        }
+        if(demux_gop_write_shard(demux_ctrl, list, i, path) < 0){
+            return -1;
+        }
+    }
+    printf("write %u shards to %s\n", list->gop_count, out_dir);
+
+    return 0;
+}
+
+static uint8_t* demux_shard_read_hex(const char* hex, uint32_t* len){
+    uint8_t* data = NULL;
+    uint32_t n = strlen(hex) / 2;
+    unsigned int v = 0;
+    uint32_t i = 0;
+
+    *len = 0;
+    if(strcmp(hex, "-") == 0){
+        return NULL;
+    }
+    data = (uint8_t*)malloc(n ? n : 1);
+    if(data == NULL){
+        printf("shard hex NULL\n");
+        return NULL;
+    }
+    for(i = 0;i < n;i++){
+        if(sscanf(hex + i * 2, "%2x", &v) != 1){
+            free(data);
+            return NULL;
+        }
+        data[i] = v;
+    }
+    *len = n;
+
+    return data;
+}
+
+static int demux_shard_add_sample(demux_shard_t* shard, uint32_t* cap, demux_shard_sample_t* sample){
+    demux_shard_sample_t* samples = NULL;
+
+    if(shard->sample_count >= *cap){
+        *cap = *cap ? *cap * 2 : 64;
+        samples = (demux_shard_sample_t*)realloc(shard->samples, *cap * sizeof(demux_shard_sample_t));
+        if(samples == NULL){
+            printf("shard samples realloc failed\n");
+            return -1;
+        }
+        shard->samples = samples;
+    }
+    shard->samples[shard->sample_count++] = *sample;
+
+    return 0;
+}
+
+static int demux_shard_add_range(demux_shard_t* shard, uint32_t* cap, uint64_t offset, uint64_t len){
+    demux_range_t* ranges = NULL;
+
+    if(shard->range_count >= *cap){
+        *cap = *cap ? *cap * 2 : 16;
+        ranges = (demux_range_t*)realloc(shard->ranges, *cap * sizeof(demux_range_t));
+        if(ranges == NULL){
+            printf("shard ranges realloc failed\n");
+            return -1;
+        }
+        shard->ranges = ranges;
+    }
+    shard->ranges[shard->range_count].offset = offset;
+    shard->ranges[shard->range_count++].len = len;
+
+    return 0;
+}
+
+int demux_shard_load(const char* path, demux_shard_t* shard){
+    char line[DEMUX_SHARD_PATH_LENGTH + 64];
+    char key[16];
+    char sps[1024];
+    char pps[1024];
+    demux_shard_sample_t sample;
+    uint64_t offset = 0;
+    uint64_t len = 0;
+    uint32_t sample_cap = 0;
+    uint32_t range_cap = 0;
+    int version = 0;
+    int keyframe = 0;
+    FILE* fp = NULL;
+    int ret = 0;
+
+    memset(shard, 0, sizeof(demux_shard_t));
+    fp = fopen(path, "r");
+    if(fp == NULL){
+        printf("open %s failed\n", path);
+        return -1;
+    }
+
+    if(fgets(line, sizeof(line), fp) == NULL || sscanf(line, "%15s %d", key, &version) != 2 ||
+       strcmp(key, DEMUX_SHARD_MAGIC) != 0 || version != DEMUX_SHARD_VERSION){
+        printf("%s is not a shard\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    while(ret >= 0 && fgets(line, sizeof(line), fp) != NULL){
+        line[strcspn(line, "\n")] = 0;
+        if(sscanf(line, "%15s", key) != 1){
+            continue;
+        }
+
+        if(strcmp(key, "source") == 0){
+            strncpy(shard->source, line + strlen("source "), sizeof(shard->source) - 1);
+        }else if(strcmp(key, "gop") == 0){
+            sscanf(line, "gop %u", &shard->gop_index);
+        }else if(strcmp(key, "track") == 0){
+            if(sscanf(line, "track %u %4s %u %u %u", &shard->track_id, shard->codec, &shard->timescale,
+                      &shard->width, &shard->height) != 5){
+                ret = -1;
+            }
+        }else if(strcmp(key, "avcc") == 0){
+            if(sscanf(line, "avcc %u %1023s %1023s", &shard->nal_length_size, sps, pps) != 3){
+                ret = -1;
+                continue;
+            }
+            shard->sps = demux_shard_read_hex(sps, &shard->sps_len);
+            shard->pps = demux_shard_read_hex(pps, &shard->pps_len);
+        }else if(strcmp(key, "range") == 0){
+            if(sscanf(line, "range %lu %lu", &offset, &len) != 2){
+                ret = -1;
+                continue;
+            }
+            ret = demux_shard_add_range(shard, &range_cap, offset, len);
+        }else if(strcmp(key, "sample") == 0){
+            if(sscanf(line, "sample %lu %u %ld %d %d", &sample.offset, &sample.size, &sample.dts,
+                      &sample.cts_offset, &keyframe) != 5){
+                ret = -1;
+                continue;
+            }
+            sample.keyframe = keyframe;
+            ret = demux_shard_add_sample(shard, &sample_cap, &sample);
+        }
+    }
+    fclose(fp);
+
+    if(ret < 0 || shard->source[0] == 0 || shard->timescale == 0){
+        printf("shard %s format error\n", path);
+        demux_shard_free(shard);
+        return -1;
+    }
+    printf("shard %s gop %u track %u %s samples[%u] ranges[%u]\n", path, shard->gop_index, shard->track_id,
+        shard->codec, shard->sample_count, shard->range_count);
+
+    return 0;
+}
+
+/* sample数据按描述中的字节区间整段读回, avc1时拆nal写成annexb, 开头写入sps/pps */
+int demux_shard_output(demux_shard_t* shard, demux_sink_t* sink){
+    uint8_t start_code[4] = {0x00, 0x00, 0x00, 0x01};
+    demux_shard_sample_t* sample = NULL;
+    demux_range_t* range = NULL;
+    struct iovec iov[4];
+    demux_io_t* io = NULL;
+    uint8_t* buf = NULL;
+    uint8_t* data = NULL;
+    uint64_t buf_cap = 0;
+    uint32_t range_index = 0;
+    uint32_t nal_len = 0;
+    uint32_t pos = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    int annexb = 0;
+    int ret = 0;
+
+    io = demux_io_open_file(shard->source);
+    if(io == NULL){
+        return -1;
+    }
+
+    annexb = strcmp(shard->codec, "avc1") == 0 && shard->nal_length_size > 0 && shard->nal_length_size <= 4;
+    if(annexb){
+        iov[0].iov_base = start_code;
+        iov[0].iov_len = sizeof(start_code);
+        iov[1].iov_base = shard->sps;
+        iov[1].iov_len = shard->sps_len;
+        iov[2].iov_base = start_code;
+        iov[2].iov_len = sizeof(start_code);
+        iov[3].iov_base = shard->pps;
+        iov[3].iov_len = shard->pps_len;
+        ret = demux_sink_writev(sink, iov, 4);
+    }
+
+    for(i = 0;ret >= 0 && i < shard->sample_count;i++){
+        sample = &shard->samples[i];
+
+        /* sample按解码顺序落在区间中, 读到一个新区间时整段读入 */
+        if(range == NULL || sample->offset < range->offset || sample->offset + sample->size > range->offset + range->len){
+            range = NULL;
+            for(;range_index < shard->range_count;range_index++){
+                if(sample->offset >= shard->ranges[range_index].offset &&
+                   sample->offset + sample->size <= shard->ranges[range_index].offset + shard->ranges[range_index].len){
+                    range = &shard->ranges[range_index];
+                    break;
+                }
+            }
+            if(range == NULL){
+                printf("sample %u offset[%lu] not in shard ranges\n", i, sample->offset);
+                ret = -1;
+                break;
+            }
+            if(range->len > buf_cap){
+                data = (uint8_t*)realloc(buf, range->len);
+                if(data == NULL){
+                    printf("shard buf realloc failed, len[%lu]\n", range->len);
+                    ret = -1;
+                    break;
+                }
+                buf = data;
+                buf_cap = range->len;
+            }
+            if(demux_io_read_at(io, range->offset, buf, range->len) != (int64_t)range->len){
+                printf("read range offset[%lu] len[%lu] failed\n", range->offset, range->len);
+                ret = -1;
+                break;
+            }
+        }
+        data = buf + (sample->offset - range->offset);
+
+        if(!annexb){
+            ret = demux_sink_write(sink, data, sample->size);
+            continue;
+        }
+        pos = 0;
+        while(ret >= 0 && pos + shard->nal_length_size <= sample->size){
+            nal_len = 0;
+            for(j = 0;j < shard->nal_length_size;j++){
+                nal_len = (nal_len << 8) | data[pos + j];
+            }
+            pos += shard->nal_length_size;
+            if(nal_len > sample->size - pos){
+                printf("nal_len[%u] out of sample size[%u]\n", nal_len, sample->size);
+                ret = -1;
+                break;
+            }
+            iov[0].iov_base = start_code;
+            iov[0].iov_len = sizeof(start_code);
+            iov[1].iov_base = data + pos;
+            iov[1].iov_len = nal_len;
+            ret = demux_sink_writev(sink, iov, 2);
+            pos += nal_len;
+        }
+    }
+    if(ret >= 0){
+        ret = demux_sink_flush(sink);
+    }
+
+    free(buf);
+    demux_io_close(io);
+
+    return ret;
+}
+
+void demux_shard_free(demux_shard_t* shard){
+    free(shard->sps);
+    free(shard->pps);
+    free(shard->ranges);
+    free(shard->samples);
+    memset(shard, 0, sizeof(demux_shard_t));
+}
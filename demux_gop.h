@@ -0,0 +1,86 @@
+#ifndef __DEMUX_GOP_H
+#define __DEMUX_GOP_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_range.h"
+#include "demux_packet.h"
+
+/*
+ * GOP索引: 按stss把一个track切成以关键帧开头的GOP, 给出sample范围, dts范围和覆盖这些sample的最少字节区间
+ * 分布式转码按GOP分片时, 每个分片可以写成一个自描述的分片描述文件(codec配置 + sample表 + 字节区间)
+ * worker只读描述文件和源文件中的字节区间, 不需要解析moov
+ */
+
+#define DEMUX_SHARD_MAGIC "demux-shard"
+#define DEMUX_SHARD_VERSION 1
+#define DEMUX_SHARD_NAME_FORMAT "shard_%05u.txt"
+#define DEMUX_SHARD_PATH_LENGTH 512
+
+typedef struct demux_gop
+{
+    uint32_t first_sample;
+    uint32_t sample_count;
+    int64_t dts_start;          // track timescale
+    int64_t dts_end;            // 最后一个sample的dts + duration
+    uint32_t range_first;       // 在demux_gop_list_t.ranges中的下标
+    uint32_t range_count;
+    uint64_t bytes;
+}demux_gop_t;
+
+typedef struct demux_gop_list
+{
+    video_ctrl_t* track;
+    demux_gop_t* gops;
+    uint32_t gop_count;
+    uint32_t gop_cap;
+    demux_range_t* ranges;
+    uint32_t range_count;
+    uint32_t range_cap;
+    demux_packet_t* samples;    // 按解码顺序的sample表, 写分片描述时使用
+    uint32_t sample_count;
+    uint32_t sample_cap;
+}demux_gop_list_t;
+
+typedef struct demux_shard_sample
+{
+    uint64_t offset;
+    uint32_t size;
+    int64_t dts;
+    int32_t cts_offset;
+    uint8_t keyframe;
+}demux_shard_sample_t;
+
+/* 分片描述文件读回后的内容 */
+typedef struct demux_shard
+{
+    char source[DEMUX_SHARD_PATH_LENGTH];
+    uint32_t gop_index;
+    uint32_t track_id;
+    char codec[4 + 1];
+    uint32_t timescale;
+    uint32_t width;
+    uint32_t height;
+    uint32_t nal_length_size;
+    uint8_t* sps;
+    uint32_t sps_len;
+    uint8_t* pps;
+    uint32_t pps_len;
+    demux_range_t* ranges;
+    uint32_t range_count;
+    demux_shard_sample_t* samples;
+    uint32_t sample_count;
+}demux_shard_t;
+
+extern int demux_gop_build(demux_ctrl_t* demux_ctrl, int track_index, demux_gop_list_t* list);
+extern void demux_gop_print(demux_gop_list_t* list);
+extern void demux_gop_free(demux_gop_list_t* list);
+/* 每个GOP写一个分片描述文件到out_dir, 文件名为DEMUX_SHARD_NAME_FORMAT */
+extern int demux_gop_write_shards(demux_ctrl_t* demux_ctrl, demux_gop_list_t* list, const char* out_dir);
+
+extern int demux_shard_load(const char* path, demux_shard_t* shard);
+/* 按描述文件从源文件读出分片的sample, avc1写成annexb */
+extern int demux_shard_output(demux_shard_t* shard, demux_sink_t* sink);
+extern void demux_shard_free(demux_shard_t* shard);
+
+#endif
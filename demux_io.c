@@ -0,0 +1,474 @@
+#define _FILE_OFFSET_BITS 64
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "demux_io.h"
+#include "demux_readahead.h"
+
+typedef struct demux_io_file
+{
+    FILE* fp;
+    int fd;
+    void* map;
+    uint64_t map_len;
+}demux_io_file_t;
+
+/* stdio: 调用者传入的FILE*, 关闭时一起fclose */
+static int64_t demux_io_stdio_read_at(demux_io_t* io, uint64_t offset, uint8_t* buf, uint64_t len){
+    demux_io_file_t* file = (demux_io_file_t*)io->priv;
+
+    if(fseeko(file->fp, offset, SEEK_SET) < 0){
+        printf("fseeko failed, offset[%lu]\n", offset);
+        return -1;
+    }
+
+    return fread(buf, 1, len, file->fp);
+}
+
+static int64_t demux_io_stdio_size(demux_io_t* io){
+    demux_io_file_t* file = (demux_io_file_t*)io->priv;
+
+    if(fseeko(file->fp, 0, SEEK_END) < 0){
+        printf("fseeko end failed\n");
+        return -1;
+    }
+
+    return ftello(file->fp);
+}
+
+static void demux_io_stdio_close(demux_io_t* io){
+    demux_io_file_t* file = (demux_io_file_t*)io->priv;
+
+    fclose(file->fp);
+    free(file);
+}
+
+static const demux_io_ops_t demux_io_stdio_ops = {
+    .read_at = demux_io_stdio_read_at,
+    .size = demux_io_stdio_size,
+    .hint = NULL,
+    .close = demux_io_stdio_close,
+};
+
+/* pread fd */
+static int64_t demux_io_fd_read_at(demux_io_t* io, uint64_t offset, uint8_t* buf, uint64_t len){
+    demux_io_file_t* file = (demux_io_file_t*)io->priv;
+    uint64_t read_len = 0;
+    ssize_t ret = 0;
+
+    while(read_len < len){
+        ret = pread(file->fd, buf + read_len, len - read_len, offset + read_len);
+        if(ret < 0){
+            printf("pread failed, offset[%lu] len[%lu]\n", offset + read_len, len - read_len);
+            return -1;
+        }
+        if(ret == 0){
+            break;
+        }
+        read_len += ret;
+    }
+
+    return read_len;
+}
+
+static int64_t demux_io_fd_size(demux_io_t* io){
+    demux_io_file_t* file = (demux_io_file_t*)io->priv;
+    struct stat st;
+
+    if(fstat(file->fd, &st) < 0){
+        printf("fstat failed\n");
+        return -1;
+    }
+
+    return st.st_size;
+}
+
+static void demux_io_fd_close(demux_io_t* io){
+    demux_io_file_t* file = (demux_io_file_t*)io->priv;
+
+    close(file->fd);
+    free(file);
+}
+
+static const demux_io_ops_t demux_io_fd_ops = {
+    .read_at = demux_io_fd_read_at,
+    .size = demux_io_fd_size,
+    .hint = NULL,
+    .close = demux_io_fd_close,
+};
+
+/* mmap和memory: 数据都在io->data中 */
+static int64_t demux_io_memory_read_at(demux_io_t* io, uint64_t offset, uint8_t* buf, uint64_t len){
+    if(offset >= io->size){
+        return 0;
+    }
+    if(len > io->size - offset){
+        len = io->size - offset;
+    }
+    memcpy(buf, io->data + offset, len);
+
+    return len;
+}
+
+static int64_t demux_io_memory_size(demux_io_t* io){
+    return *(uint64_t*)io->priv;
+}
+
+static void demux_io_memory_close(demux_io_t* io){
+    free(io->priv);
+}
+
+static const demux_io_ops_t demux_io_memory_ops = {
+    .read_at = demux_io_memory_read_at,
+    .size = demux_io_memory_size,
+    .hint = NULL,
+    .close = demux_io_memory_close,
+};
+
+static int64_t demux_io_mmap_size(demux_io_t* io){
+    return ((demux_io_file_t*)io->priv)->map_len;
+}
+
+static void demux_io_mmap_close(demux_io_t* io){
+    demux_io_file_t* file = (demux_io_file_t*)io->priv;
+
+    if(file->map != NULL){
+        munmap(file->map, file->map_len);
+    }
+    close(file->fd);
+    free(file);
+}
+
+static const demux_io_ops_t demux_io_mmap_ops = {
+    .read_at = demux_io_memory_read_at,
+    .size = demux_io_mmap_size,
+    .hint = NULL,
+    .close = demux_io_mmap_close,
+};
+
+demux_io_t* demux_io_open(const demux_io_ops_t* ops, void* priv, int fd, const uint8_t* data){
+    demux_io_t* io = NULL;
+    int64_t size = 0;
+
+    io = (demux_io_t*)calloc(1, sizeof(demux_io_t));
+    if(io == NULL){
+        printf("io NULL\n");
+        return NULL;
+    }
+
+    io->ops = ops;
+    io->priv = priv;
+    io->fd = fd;
+    io->data = data;
+
+    /* 内存中的输入直接读, 不需要顺序读缓冲 */
+    if(data == NULL){
+        io->buf = (uint8_t*)malloc(DEMUX_IO_READ_BUFFER_BYTES);
+        if(io->buf == NULL){
+            printf("io buf NULL\n");
+            free(io);
+            return NULL;
+        }
+    }
+
+    size = ops->size(io);
+    if(size < 0){
+        free(io->buf);
+        free(io);
+        return NULL;
+    }
+    io->size = size;
+
+    /* 本地文件才有页缓存可以提示, 创建失败时只是不做提示 */
+    if(fd >= 0){
+        io->readahead = demux_readahead_open(fd);
+    }
+
+    return io;
+}
+
+demux_io_t* demux_io_open_stdio(FILE* fp){
+    demux_io_file_t* file = NULL;
+    demux_io_t* io = NULL;
+
+    if(fp == NULL){
+        printf("fp NULL\n");
+        return NULL;
+    }
+
+    file = (demux_io_file_t*)calloc(1, sizeof(demux_io_file_t));
+    if(file == NULL){
+        printf("io file NULL\n");
+        return NULL;
+    }
+    file->fp = fp;
+
+    io = demux_io_open(&demux_io_stdio_ops, file, fileno(fp), NULL);
+    if(io == NULL){
+        free(file);
+    }
+
+    return io;
+}
+
+demux_io_t* demux_io_open_fd(int fd){
+    demux_io_file_t* file = NULL;
+    demux_io_t* io = NULL;
+
+    if(fd < 0){
+        printf("fd[%d] error\n", fd);
+        return NULL;
+    }
+
+    file = (demux_io_file_t*)calloc(1, sizeof(demux_io_file_t));
+    if(file == NULL){
+        printf("io file NULL\n");
+        return NULL;
+    }
+    file->fd = fd;
+
+    io = demux_io_open(&demux_io_fd_ops, file, fd, NULL);
+    if(io == NULL){
+        free(file);
+    }
+
+    return io;
+}
+
+demux_io_t* demux_io_open_file(const char* file_path){
+    demux_io_t* io = NULL;
+    int fd = open(file_path, O_RDONLY);
+
+    if(fd < 0){
+        printf("open %s failed\n", file_path);
+        return NULL;
+    }
+
+    io = demux_io_open_fd(fd);
+    if(io == NULL){
+        close(fd);
+    }
+
+    return io;
+}
+
+demux_io_t* demux_io_open_mmap(const char* file_path){
+    demux_io_file_t* file = NULL;
+    demux_io_t* io = NULL;
+    struct stat st;
+
+    file = (demux_io_file_t*)calloc(1, sizeof(demux_io_file_t));
+    if(file == NULL){
+        printf("io file NULL\n");
+        return NULL;
+    }
+
+    file->fd = open(file_path, O_RDONLY);
+    if(file->fd < 0 || fstat(file->fd, &st) < 0){
+        printf("open %s failed\n", file_path);
+        goto err;
+    }
+
+    file->map_len = st.st_size;
+    if(file->map_len > 0){
+        file->map = mmap(NULL, file->map_len, PROT_READ, MAP_SHARED, file->fd, 0);
+        if(file->map == MAP_FAILED){
+            printf("mmap %s failed\n", file_path);
+            file->map = NULL;
+            goto err;
+        }
+    }
+
+    io = demux_io_open(&demux_io_mmap_ops, file, file->fd, (const uint8_t*)file->map);
+    if(io == NULL){
+        goto err;
+    }
+
+    return io;
+
+err:
+    if(file->map != NULL){
+        munmap(file->map, file->map_len);
+    }
+    if(file->fd >= 0){
+        close(file->fd);
+    }
+    free(file);
+    return NULL;
+}
+
+/* 调用者持有的内存, close时不释放data */
+demux_io_t* demux_io_open_memory(const uint8_t* data, uint64_t len){
+    demux_io_t* io = NULL;
+    uint64_t* size = NULL;
+
+    if(data == NULL && len > 0){
+        printf("data NULL\n");
+        return NULL;
+    }
+
+    size = (uint64_t*)malloc(sizeof(uint64_t));
+    if(size == NULL){
+        printf("io size NULL\n");
+        return NULL;
+    }
+    *size = len;
+
+    io = demux_io_open(&demux_io_memory_ops, size, -1, data);
+    if(io == NULL){
+        free(size);
+    }
+
+    return io;
+}
+
+int64_t demux_io_read_at(demux_io_t* io, uint64_t offset, uint8_t* buf, uint64_t len){
+    int64_t ret = 0;
+
+    demux_io_access(io, offset, len);
+    ret = io->ops->read_at(io, offset, buf, len);
+
+    io->read_calls++;
+    if(ret > 0){
+        io->read_bytes += ret;
+    }
+
+    return ret;
+}
+
+/* 从position顺序读, 小读取由缓冲合并, 返回读到的长度 */
+int64_t demux_io_read(demux_io_t* io, void* buf, uint64_t len){
+    uint8_t* dest = (uint8_t*)buf;
+    uint64_t read_len = 0;
+    uint64_t copy_len = 0;
+    int64_t ret = 0;
+
+    if(io->position >= io->size){
+        return 0;
+    }
+    if(len > io->size - io->position){
+        len = io->size - io->position;
+    }
+
+    if(io->data != NULL){
+        memcpy(dest, io->data + io->position, len);
+        io->position += len;
+        return len;
+    }
+
+    while(read_len < len){
+        if(io->position >= io->buf_offset && io->position < io->buf_offset + io->buf_len){
+            copy_len = io->buf_offset + io->buf_len - io->position;
+            if(copy_len > len - read_len){
+                copy_len = len - read_len;
+            }
+            memcpy(dest + read_len, io->buf + (io->position - io->buf_offset), copy_len);
+            read_len += copy_len;
+            io->position += copy_len;
+            continue;
+        }
+
+        /* 大块读取直接读到目标内存 */
+        if(len - read_len >= DEMUX_IO_READ_BUFFER_BYTES){
+            ret = demux_io_read_at(io, io->position, dest + read_len, len - read_len);
+            if(ret <= 0){
+                break;
+            }
+            read_len += ret;
+            io->position += ret;
+            continue;
+        }
+
+        ret = demux_io_read_at(io, io->position, io->buf, DEMUX_IO_READ_BUFFER_BYTES);
+        if(ret <= 0){
+            break;
+        }
+        io->buf_offset = io->position;
+        io->buf_len = ret;
+    }
+
+    return read_len;
+}
+
+int demux_io_seek(demux_io_t* io, int64_t offset, int whence){
+    int64_t position = offset;
+
+    if(whence == SEEK_CUR){
+        position += io->position;
+    }else if(whence == SEEK_END){
+        position += io->size;
+    }
+    if(position < 0){
+        printf("io seek position[%ld] error\n", position);
+        return -1;
+    }
+
+    io->position = position;
+    io->seek_calls++;
+
+    return 0;
+}
+
+uint64_t demux_io_tell(demux_io_t* io){
+    return io->position;
+}
+
+uint64_t demux_io_size(demux_io_t* io){
+    return io->size;
+}
+
+/* 重新获取输入大小, 用于还在写入的文件 */
+int64_t demux_io_refresh(demux_io_t* io){
+    int64_t size = io->ops->size(io);
+
+    if(size < 0){
+        return -1;
+    }
+    io->size = size;
+
+    return size;
+}
+
+int demux_io_hint(demux_io_t* io, int hint, uint64_t offset, uint64_t len){
+    if(io->readahead != NULL && demux_readahead_hint(io->readahead, hint, offset, len) < 0){
+        return -1;
+    }
+    if(io->ops->hint == NULL){
+        return 0;
+    }
+
+    return io->ops->hint(io, hint, offset, len);
+}
+
+/* 不经过read_at的读取(零拷贝/直接访问mmap)在读之前调用, 推进页缓存提示 */
+void demux_io_access(demux_io_t* io, uint64_t offset, uint64_t len){
+    if(io->readahead != NULL){
+        demux_readahead_access(io->readahead, offset, len);
+    }
+}
+
+/* window为预读窗口字节数, 为0时关闭提示; drop_consumed为1时读过的区间DONTNEED */
+int demux_io_set_readahead(demux_io_t* io, uint64_t window, int drop_consumed){
+    if(io == NULL || io->readahead == NULL){
+        return -1;
+    }
+
+    demux_readahead_set_window(io->readahead, window, drop_consumed);
+
+    return 0;
+}
+
+void demux_io_close(demux_io_t* io){
+    if(io == NULL){
+        return;
+    }
+
+    demux_readahead_close(io->readahead);
+    io->ops->close(io);
+    free(io->buf);
+    free(io);
+}
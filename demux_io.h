@@ -0,0 +1,73 @@
+#ifndef __DEMUX_IO_H
+#define __DEMUX_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * 输入抽象: 所有读取都是按偏移读(read_at), box解析的顺序读由demux_io_read在其上加一层缓冲
+ * 后端: stdio, pread fd, mmap, 调用者持有的内存, 以及demux_range中的远端fetch
+ */
+
+#define DEMUX_IO_READ_BUFFER_BYTES (64 * 1024)
+
+enum DEMUX_IO_HINT{
+    DEMUX_IO_HINT_RESET,        // 丢弃之前的WILLNEED
+    DEMUX_IO_HINT_WILLNEED,     // [offset, offset + len)马上会读
+    DEMUX_IO_HINT_SEQUENTIAL,   // 之后基本顺序读
+    DEMUX_IO_HINT_DONTNEED,     // [offset, offset + len)不会再读
+    DEMUX_IO_HINT_CONSUMED      // offset之前的数据所有读取者都不再需要, 多个track交织读取时由reader给出
+};
+
+typedef struct demux_io demux_io_t;
+struct demux_readahead;
+
+typedef struct demux_io_ops
+{
+    /* 读[offset, offset + len), 返回读到的长度, 到末尾时可能小于len */
+    int64_t (*read_at)(demux_io_t* io, uint64_t offset, uint8_t* buf, uint64_t len);
+    int64_t (*size)(demux_io_t* io);
+    /* 可为NULL */
+    int (*hint)(demux_io_t* io, int hint, uint64_t offset, uint64_t len);
+    void (*close)(demux_io_t* io);
+}demux_io_ops_t;
+
+struct demux_io
+{
+    const demux_io_ops_t* ops;
+    void* priv;
+    int fd;                     // 可以零拷贝时为输入fd, 否则为-1
+    const uint8_t* data;        // 整个输入都在内存中时(mmap/memory)指向数据, 否则为NULL
+    uint64_t size;
+    uint64_t position;          // demux_io_read的读位置
+
+    uint8_t* buf;               // 顺序读缓冲
+    uint64_t buf_offset;
+    uint64_t buf_len;
+
+    uint64_t read_calls;
+    uint64_t read_bytes;
+    uint64_t seek_calls;
+
+    struct demux_readahead* readahead;  // 有fd时按读计划做页缓存提示, 见demux_readahead.h
+};
+
+extern demux_io_t* demux_io_open(const demux_io_ops_t* ops, void* priv, int fd, const uint8_t* data);
+extern demux_io_t* demux_io_open_stdio(FILE* fp);
+extern demux_io_t* demux_io_open_fd(int fd);
+extern demux_io_t* demux_io_open_file(const char* file_path);
+extern demux_io_t* demux_io_open_mmap(const char* file_path);
+extern demux_io_t* demux_io_open_memory(const uint8_t* data, uint64_t len);
+
+extern int64_t demux_io_read_at(demux_io_t* io, uint64_t offset, uint8_t* buf, uint64_t len);
+extern int64_t demux_io_read(demux_io_t* io, void* buf, uint64_t len);
+extern int demux_io_seek(demux_io_t* io, int64_t offset, int whence);
+extern uint64_t demux_io_tell(demux_io_t* io);
+extern uint64_t demux_io_size(demux_io_t* io);
+extern int64_t demux_io_refresh(demux_io_t* io);
+extern int demux_io_hint(demux_io_t* io, int hint, uint64_t offset, uint64_t len);
+extern void demux_io_access(demux_io_t* io, uint64_t offset, uint64_t len);
+extern int demux_io_set_readahead(demux_io_t* io, uint64_t window, int drop_consumed);
+extern void demux_io_close(demux_io_t* io);
+
+#endif
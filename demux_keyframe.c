@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux_keyframe.h"
+
+int demux_sample_locator_init(demux_sample_locator_t* locator, demux_ctrl_t* demux_ctrl, int track_index){
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+
+    if(locator == NULL || track == NULL){
+        printf("locator[%p] track[%p] NULL\n", locator, track);
+        return -1;
+    }
+
+    if(track->stsc_box == NULL || track->chunk_count == 0 || track->stsc_entry_count == 0 ||
+       track->chunk_offset_pack.count < track->chunk_count ||
+       (track->sample_size == 0 && track->sample_size_pack.count < track->sample_count)){
+        printf("stsc_box[%p] chunk_count[%u] sample table error\n", track->stsc_box, track->chunk_count);
+        return -1;
+    }
+
+    memset(locator, 0, sizeof(demux_sample_locator_t));
+    locator->track = track;
+    if(demux_timeline_build(&locator->timeline, demux_ctrl, track_index) < 0){
+        return -1;
+    }
+
+    return 0;
+}
+
+void demux_sample_locator_free(demux_sample_locator_t* locator){
+    if(locator == NULL){
+        return;
+    }
+
+    demux_timeline_free(&locator->timeline);
+}
+
+/* stsc的一项覆盖一段连续chunk, 段内每个chunk的sample数相同, 整段跳过或直接除出chunk序号 */
+static int demux_locate_chunk(demux_sample_locator_t* locator, uint32_t sample_index){
+    video_ctrl_t* track = locator->track;
+    uint32_t samples_per_chunk = 0;
+    uint32_t run_end = 0;
+    uint32_t skip = 0;
+
+    while(1){
+        samples_per_chunk = track->stsc_box[locator->stsc_index].samples_per_chunk;
+        run_end = track->chunk_count;
+        if(locator->stsc_index + 1 < track->stsc_entry_count &&
+           track->stsc_box[locator->stsc_index + 1].first_chunk - 1 < run_end){
+            run_end = track->stsc_box[locator->stsc_index + 1].first_chunk - 1;
+        }
+
+        if(samples_per_chunk > 0 && locator->chunk_index < run_end){
+            skip = (sample_index - locator->chunk_first_sample) / samples_per_chunk;
+            if(skip < run_end - locator->chunk_index){
+                locator->chunk_index += skip;
+                locator->chunk_first_sample += skip * samples_per_chunk;
+                return 0;
+            }
+            locator->chunk_first_sample += (run_end - locator->chunk_index) * samples_per_chunk;
+            locator->chunk_index = run_end;
+        }
+
+        if(locator->stsc_index + 1 >= track->stsc_entry_count){
+            printf("sample %u out of chunk table\n", sample_index);
+            return -1;
+        }
+        locator->stsc_index++;
+    }
+}
+
+int demux_sample_locate(demux_sample_locator_t* locator, uint32_t sample_index, demux_packet_t* pkt){
+    video_ctrl_t* track = locator->track;
+    uint64_t offset = 0;
+    uint32_t i = 0;
+
+    if(sample_index >= track->sample_count){
+        printf("sample_index[%u] >= sample_count[%u]\n", sample_index, track->sample_count);
+        return -1;
+    }
+    /* 序号回退时chunk从头重新定位, 时间线可以随机访问不用重建 */
+    if(sample_index < locator->chunk_first_sample){
+        locator->stsc_index = 0;
+        locator->chunk_index = 0;
+        locator->chunk_first_sample = 0;
+    }
+
+    if(demux_locate_chunk(locator, sample_index) < 0){
+        return -1;
+    }
+
+    /* chunk起始偏移加上chunk内前面sample的大小 */
+    offset = demux_pack_cursor_get(&track->chunk_offset_pack, &locator->offset_cursor, locator->chunk_index);
+    if(track->sample_size){
+        offset += (uint64_t)(sample_index - locator->chunk_first_sample) * track->sample_size;
+        pkt->size = track->sample_size;
+    }else{
+        for(i = locator->chunk_first_sample;i < sample_index;i++){
+            offset += demux_pack_cursor_get(&track->sample_size_pack, &locator->size_cursor, i);
+        }
+        pkt->size = demux_pack_cursor_get(&track->sample_size_pack, &locator->size_cursor, sample_index);
+    }
+    pkt->offset = offset;
+    pkt->sample_index = sample_index;
+    pkt->dts = demux_timeline_dts(&locator->timeline, sample_index);
+    pkt->pts = demux_timeline_pts(&locator->timeline, sample_index);
+    pkt->duration = demux_timeline_duration(&locator->timeline, sample_index);
+
+    return 0;
+}
+
+uint32_t demux_keyframe_before(video_ctrl_t* track, uint32_t sample_index, uint32_t* stss_index){
+    uint32_t low = 0;
+    uint32_t high = track->i_frame_count;
+    uint32_t mid = 0;
+
+    if(!track->stss_present){
+        if(stss_index != NULL){
+            *stss_index = 0;
+        }
+        return sample_index;
+    }
+
+    /* stss有序, 二分找最后一个序号 <= sample_index + 1 的关键帧; demux_pack_get不改共享状态 */
+    while(low < high){
+        mid = low + (high - low) / 2;
+        if(demux_pack_get(&track->i_frame_num_pack, mid) <= sample_index + 1){
+            low = mid + 1;
+        }else{
+            high = mid;
+        }
+    }
+    if(stss_index != NULL){
+        *stss_index = low > 0 ? low - 1 : 0;
+    }
+
+    return low > 0 ? demux_pack_get(&track->i_frame_num_pack, low - 1) - 1 : 0;
+}
+
+int demux_keyframe_select(demux_ctrl_t* demux_ctrl, int track_index, const demux_keyframe_opt_t* opt, demux_packet_t** pkts){
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+    demux_sample_locator_t locator;
+    demux_pack_cursor_t stss_cursor;
+    demux_packet_t* list = NULL;
+    uint32_t keyframe_count = 0;
+    uint32_t every_n = 1;
+    uint32_t sample_number = 0;
+    int64_t interval = 0;
+    int64_t last_dts = 0;
+    int count = 0;
+    uint32_t i = 0;
+
+    if(track == NULL || pkts == NULL || demux_sample_locator_init(&locator, demux_ctrl, track_index) < 0){
+        printf("track_index[%d] error\n", track_index);
+        return -1;
+    }
+
+    if(opt != NULL && opt->every_n > 1){
+        every_n = opt->every_n;
+    }
+    if(opt != NULL && opt->interval > 0){
+        interval = (int64_t)(opt->interval * track->timescale);
+    }
+
+    /* 没有stss时每个sample都是关键帧 */
+    keyframe_count = track->stss_present ? track->i_frame_count : track->sample_count;
+    list = (demux_packet_t*)calloc(keyframe_count / every_n + 1, sizeof(demux_packet_t));
+    if(list == NULL){
+        printf("calloc keyframe list failed\n");
+        demux_sample_locator_free(&locator);
+        return -1;
+    }
+
+    stss_cursor.block = 0;
+    for(i = 0;i < keyframe_count;i += every_n){
+        /* stss中的序号从1开始 */
+        sample_number = track->stss_present ? demux_pack_cursor_get(&track->i_frame_num_pack, &stss_cursor, i) : i + 1;
+        if(sample_number == 0 || sample_number > track->sample_count){
+            continue;
+        }
+        if(demux_sample_locate(&locator, sample_number - 1, &list[count]) < 0){
+            demux_sample_locator_free(&locator);
+            free(list);
+            return -1;
+        }
+        if(interval > 0 && count > 0 && list[count].dts < last_dts + interval){
+            continue;
+        }
+        list[count].track_index = track_index;
+        list[count].keyframe = 1;
+        list[count].data = NULL;
+        last_dts = list[count].dts;
+        count++;
+    }
+
+    demux_sample_locator_free(&locator);
+    *pkts = list;
+
+    return count;
+}
+
+int demux_output_keyframes(demux_ctrl_t* demux_ctrl, int track_index, const demux_keyframe_opt_t* opt, demux_sink_t* sink){
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+    demux_packet_t* pkts = NULL;
+    int count = 0;
+    int ret = 0;
+    int i = 0;
+
+    if(track == NULL || sink == NULL){
+        printf("track[%p] sink[%p] NULL\n", track, sink);
+        return -1;
+    }
+    if(demux_ctrl->output_mode == DEMUX_OUTPUT_ANNEXB && strcmp(track->codec, "avc1") != 0){
+        printf("track %u codec[%s] not support annexb output\n", track->track_id, track->codec);
+        return -1;
+    }
+
+    count = demux_keyframe_select(demux_ctrl, track_index, opt, &pkts);
+    if(count < 0){
+        return -1;
+    }
+
+    /* 读计划中只有选中的关键帧 */
+    demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_RESET, 0, 0);
+    for(i = 0;i < count;i++){
+        demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_WILLNEED, pkts[i].offset, pkts[i].size);
+    }
+
+    for(i = 0;ret >= 0 && i < count;i++){
+        printf("keyframe sample[%u] dts[%ld] time[%.3f] offset[%lu] size[%u]\n", pkts[i].sample_index, pkts[i].dts,
+            (double)pkts[i].dts / track->timescale, pkts[i].offset, pkts[i].size);
+        if(demux_ctrl->output_mode == DEMUX_OUTPUT_ANNEXB){
+            ret = demux_output_avc_config(track, sink);
+        }
+        if(ret >= 0){
+            ret = demux_output_sample(demux_ctrl, track, sink, pkts[i].offset, pkts[i].size);
+        }
+    }
+    if(ret >= 0){
+        ret = demux_sink_flush(sink);
+    }
+
+    printf("track %u output %d keyframes of %u samples, %lu bytes, %lu writes\n",
+        track->track_id, count, track->sample_count, sink->write_bytes, sink->write_calls);
+    free(pkts);
+
+    return ret;
+}
@@ -0,0 +1,45 @@
+#ifndef __DEMUX_KEYFRAME_H
+#define __DEMUX_KEYFRAME_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_packet.h"
+
+/*
+ * 只取关键帧: 缩略图/快进快退只需要IDR帧
+ * 按stss中的sample序号直接在sample表中定位字节区间, 不遍历其他sample, 也只读关键帧的数据
+ * 可以每N个关键帧取一个, 或按时间间隔取
+ */
+
+typedef struct demux_keyframe_opt
+{
+    uint32_t every_n;           // 每every_n个关键帧取一个, 0和1为全部
+    double interval;            // 秒, 和上一个取出的关键帧至少相隔interval, 0不限
+}demux_keyframe_opt_t;
+
+/* 按sample序号随机定位, 序号需要递增(不递增时从头重新定位) */
+typedef struct demux_sample_locator
+{
+    video_ctrl_t* track;
+    uint32_t stsc_index;
+    uint32_t chunk_index;
+    uint32_t chunk_first_sample;    // chunk_index的第一个sample
+    demux_pack_cursor_t size_cursor;
+    demux_pack_cursor_t offset_cursor;
+    demux_timeline_t timeline;      // dts/pts/duration都从时间线取
+}demux_sample_locator_t;
+
+extern int demux_sample_locator_init(demux_sample_locator_t* locator, demux_ctrl_t* demux_ctrl, int track_index);
+extern void demux_sample_locator_free(demux_sample_locator_t* locator);
+/* 填pkt的offset/size/dts/pts/duration, sample_index从0开始 */
+extern int demux_sample_locate(demux_sample_locator_t* locator, uint32_t sample_index, demux_packet_t* pkt);
+
+/* sample_index之前(含)最近的关键帧的sample序号, stss_index不为NULL时填它在stss中的位置; 没有stss时就是sample_index */
+extern uint32_t demux_keyframe_before(video_ctrl_t* track, uint32_t sample_index, uint32_t* stss_index);
+
+/* 选出的关键帧放在*pkts中, 由调用者free, 返回个数 */
+extern int demux_keyframe_select(demux_ctrl_t* demux_ctrl, int track_index, const demux_keyframe_opt_t* opt, demux_packet_t** pkts);
+/* 按output_mode输出选出的关键帧, annexb时每个关键帧前都带sps/pps, 可以单独解码 */
+extern int demux_output_keyframes(demux_ctrl_t* demux_ctrl, int track_index, const demux_keyframe_opt_t* opt, demux_sink_t* sink);
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "demux_nal.h"
+
+int demux_nal_index_init(demux_nal_index_t* index){
+    memset(index, 0, sizeof(demux_nal_index_t));
+
+    index->sample_cap = 1024;
+    index->sample_first = (uint32_t*)calloc(index->sample_cap + 1, sizeof(uint32_t));
+    index->sample_types = (uint32_t*)calloc(index->sample_cap + 1, sizeof(uint32_t));
+    if(index->sample_first == NULL || index->sample_types == NULL){
+        printf("nal index NULL\n");
+        demux_nal_index_free(index);
+        return -1;
+    }
+
+    return 0;
+}
+
+void demux_nal_index_free(demux_nal_index_t* index){
+    free(index->nals);
+    free(index->types);
+    free(index->sample_first);
+    free(index->sample_types);
+    memset(index, 0, sizeof(demux_nal_index_t));
+}
+
+int demux_nal_index_add(demux_nal_index_t* index, uint8_t type, uint32_t offset, uint32_t size){
+    demux_nal_t* nals = NULL;
+    uint8_t* types = NULL;
+    uint32_t cap = 0;
+
+    if(index->nal_count == index->nal_cap){
+        cap = index->nal_cap ? index->nal_cap * 2 : 4096;
+        nals = (demux_nal_t*)realloc(index->nals, cap * sizeof(demux_nal_t));
+        if(nals == NULL){
+            printf("nal realloc failed, cap[%u]\n", cap);
+            return -1;
+        }
+        index->nals = nals;
+        types = (uint8_t*)realloc(index->types, cap);
+        if(types == NULL){
+            printf("nal type realloc failed, cap[%u]\n", cap);
+            return -1;
+        }
+        index->types = types;
+        index->nal_cap = cap;
+    }
+
+    index->nals[index->nal_count].offset = offset;
+    index->nals[index->nal_count].size = size;
+    index->types[index->nal_count++] = type;
+    index->sample_types[index->sample_count] |= 1u << (type & 0x1f);
+
+    return 0;
+}
+
+int demux_nal_index_end_sample(demux_nal_index_t* index){
+    uint32_t* first = NULL;
+    uint32_t* types = NULL;
+    uint32_t cap = 0;
+
+    if(index->sample_count == index->sample_cap){
+        cap = index->sample_cap * 2;
+        first = (uint32_t*)realloc(index->sample_first, (cap + 1) * sizeof(uint32_t));
+        if(first == NULL){
+            printf("nal sample realloc failed, cap[%u]\n", cap);
+            return -1;
+        }
+        index->sample_first = first;
+        types = (uint32_t*)realloc(index->sample_types, (cap + 1) * sizeof(uint32_t));
+        if(types == NULL){
+            printf("nal sample realloc failed, cap[%u]\n", cap);
+            return -1;
+        }
+        index->sample_types = types;
+        index->sample_cap = cap;
+    }
+
+    index->sample_count++;
+    index->sample_first[index->sample_count] = index->nal_count;
+    index->sample_types[index->sample_count] = 0;
+
+    return 0;
+}
+
+/* avcc: 每个nal前是nal_length_size字节的大端长度 */
+int demux_nal_index_add_avcc(demux_nal_index_t* index, const uint8_t* data, uint32_t size, uint32_t nal_length_size){
+    uint32_t nal_len = 0;
+    uint32_t pos = 0;
+    uint32_t i = 0;
+
+    while(pos + nal_length_size <= size){
+        nal_len = 0;
+        for(i = 0;i < nal_length_size;i++){
+            nal_len = (nal_len << 8) | data[pos + i];
+        }
+        pos += nal_length_size;
+        if(nal_len > size - pos){
+            printf("nal_len[%u] out of sample size[%u]\n", nal_len, size);
+            return -1;
+        }
+        if(nal_len > 0 && demux_nal_index_add(index, data[pos] & 0x1f, pos, nal_len) < 0){
+            return -1;
+        }
+        pos += nal_len;
+    }
+
+    return demux_nal_index_end_sample(index);
+}
+
+/* annexb: nal在两个start code之间, 4字节start code多出的0和trailing_zero_8bits不算在nal中 */
+int demux_nal_index_add_annexb(demux_nal_index_t* index, const uint8_t* data, uint32_t size){
+    const uint8_t* end = data + size;
+    const uint8_t* nal = NULL;
+    const uint8_t* next = NULL;
+    const uint8_t* nal_end = NULL;
+
+    nal = demux_nal_find_start_code(data, end);
+    while(nal < end){
+        nal += 3;
+        next = demux_nal_find_start_code(nal, end);
+        nal_end = next;
+        while(nal_end > nal && nal_end[-1] == 0){
+            nal_end--;
+        }
+        if(nal_end > nal && demux_nal_index_add(index, nal[0] & 0x1f, nal - data, nal_end - nal) < 0){
+            return -1;
+        }
+        nal = next;
+    }
+
+    return demux_nal_index_end_sample(index);
+}
+
+const demux_nal_t* demux_nal_index_get(demux_nal_index_t* index, uint32_t sample_index, uint32_t* count){
+    if(sample_index >= index->sample_count){
+        *count = 0;
+        return NULL;
+    }
+
+    *count = index->sample_first[sample_index + 1] - index->sample_first[sample_index];
+
+    return index->nals + index->sample_first[sample_index];
+}
+
+int64_t demux_nal_index_find(demux_nal_index_t* index, uint32_t start, uint8_t type){
+    uint32_t mask = 1u << (type & 0x1f);
+    uint32_t i = 0;
+
+    for(i = start;i < index->sample_count;i++){
+        if(index->sample_types[i] & mask){
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static const uint8_t* demux_nal_find_start_code_c(const uint8_t* p, const uint8_t* end){
+    for(;p + 3 <= end;p++){
+        if(p[2] > 1){
+            p += 2;     // p[2]不是0/1时, p, p+1, p+2开头的都不可能是start code
+        }else if(p[0] == 0 && p[1] == 0 && p[2] == 1){
+            return p;
+        }
+    }
+
+    return end;
+}
+
+/*
+ * 一次比较一个向量宽度的起始位置: 分别加载p, p+1, p+2, 三个比较结果相与后非0的位就是start code
+ * 末尾不够一个向量时逐字节查找
+ */
+const uint8_t* demux_nal_find_start_code(const uint8_t* p, const uint8_t* end){
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    __m256i v0, v1, v2;
+    uint32_t mask = 0;
+
+    while(p + 32 + 2 <= end){
+        v0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), zero);
+        v1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 1)), zero);
+        v2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 2)), one);
+        mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(v0, v1), v2));
+        if(mask != 0){
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i v0, v1, v2;
+    uint32_t mask = 0;
+
+    while(p + 16 + 2 <= end){
+        v0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero);
+        v1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), zero);
+        v2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2)), one);
+        mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(v0, v1), v2));
+        if(mask != 0){
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    uint8x16_t hit;
+
+    while(p + 16 + 2 <= end){
+        hit = vandq_u8(vandq_u8(vceqq_u8(vld1q_u8(p), zero), vceqq_u8(vld1q_u8(p + 1), zero)),
+                       vceqq_u8(vld1q_u8(p + 2), one));
+        if(vmaxvq_u8(hit) != 0){
+            return demux_nal_find_start_code_c(p, p + 16 + 2);
+        }
+        p += 16;
+    }
+#endif
+
+    return demux_nal_find_start_code_c(p, end);
+}
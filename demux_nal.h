@@ -0,0 +1,53 @@
+#ifndef __DEMUX_NAL_H
+#define __DEMUX_NAL_H
+
+#include <stdint.h>
+
+/*
+ * 每个sample的nal索引: 输出时顺带把avcc sample拆成nal, 记录类型/偏移/大小
+ * 下游找SEI/IDR/AUD时直接查索引, 不用再扫一遍数据
+ * annexb数据用start code查找, 按编译目标使用AVX2/SSE2/NEON, 都没有时逐字节查找
+ */
+
+#define DEMUX_NAL_TYPE_IDR 5
+#define DEMUX_NAL_TYPE_SEI 6
+#define DEMUX_NAL_TYPE_SPS 7
+#define DEMUX_NAL_TYPE_PPS 8
+#define DEMUX_NAL_TYPE_AUD 9
+
+/* offset为nal头(类型字节)在sample中的偏移, size不含长度前缀/start code */
+typedef struct demux_nal
+{
+    uint32_t offset;
+    uint32_t size;
+}demux_nal_t;
+
+typedef struct demux_nal_index
+{
+    demux_nal_t* nals;
+    uint8_t* types;             // 和nals一一对应, 单独存放保持nals为8字节
+    uint32_t nal_count;
+    uint32_t nal_cap;
+
+    uint32_t* sample_first;     // 第i个sample的nal为[sample_first[i], sample_first[i + 1])
+    uint32_t* sample_types;     // 第i个sample中出现的nal类型位图, bit n为类型n
+    uint32_t sample_count;
+    uint32_t sample_cap;
+}demux_nal_index_t;
+
+extern int demux_nal_index_init(demux_nal_index_t* index);
+extern void demux_nal_index_free(demux_nal_index_t* index);
+/* 给当前sample添加一个nal, 当前sample由demux_nal_index_end_sample结束 */
+extern int demux_nal_index_add(demux_nal_index_t* index, uint8_t type, uint32_t offset, uint32_t size);
+extern int demux_nal_index_end_sample(demux_nal_index_t* index);
+extern int demux_nal_index_add_avcc(demux_nal_index_t* index, const uint8_t* data, uint32_t size, uint32_t nal_length_size);
+extern int demux_nal_index_add_annexb(demux_nal_index_t* index, const uint8_t* data, uint32_t size);
+
+extern const demux_nal_t* demux_nal_index_get(demux_nal_index_t* index, uint32_t sample_index, uint32_t* count);
+/* 从start开始第一个含有type类型nal的sample, 没有时返回-1 */
+extern int64_t demux_nal_index_find(demux_nal_index_t* index, uint32_t start, uint8_t type);
+
+/* 返回[p, end)中第一个00 00 01的位置, 没有时返回end */
+extern const uint8_t* demux_nal_find_start_code(const uint8_t* p, const uint8_t* end);
+
+#endif
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux_pack.h"
+
+static uint8_t demux_pack_bit_width(uint64_t value){
+    uint8_t bits = 0;
+
+    while(value != 0){
+        bits++;
+        value >>= 1;
+    }
+
+    return bits;
+}
+
+static uint64_t demux_pack_read_bits(const uint64_t* words, uint64_t bit_pos, uint8_t bits){
+    uint64_t word = bit_pos / 64;
+    uint32_t shift = bit_pos % 64;
+    uint64_t value = words[word] >> shift;
+
+    if(shift + bits > 64){
+        value |= words[word + 1] << (64 - shift);
+    }
+
+    return (bits == 64) ? value : (value & ((1ull << bits) - 1));
+}
+
+int demux_pack_init(demux_pack_t* pack){
+    memset(pack, 0, sizeof(demux_pack_t));
+
+    pack->pending = (uint64_t*)malloc(DEMUX_PACK_BLOCK_SIZE * sizeof(uint64_t));
+    if(pack->pending == NULL){
+        printf("pack pending NULL\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 把pending中的值编码成一个block */
+static int demux_pack_flush(demux_pack_t* pack){
+    demux_pack_block_t* blocks = NULL;
+    demux_pack_block_t* block = NULL;
+    uint64_t* words = NULL;
+    uint64_t* values = pack->pending;
+    uint64_t min_value = values[0];
+    uint64_t max_value = values[0];
+    uint64_t max_delta = 0;
+    uint64_t entry = 0;
+    uint64_t bit_pos = 0;
+    uint32_t word_need = 0;
+    uint32_t n = pack->pending_count;
+    uint32_t i = 0;
+    int delta = 1;
+
+    if(n == 0){
+        return 0;
+    }
+
+    for(i = 1;i < n;i++){
+        if(values[i] < min_value){
+            min_value = values[i];
+        }
+        if(values[i] > max_value){
+            max_value = values[i];
+        }
+        if(values[i] < values[i - 1]){
+            delta = 0;
+        }else if(values[i] - values[i - 1] > max_delta){
+            max_delta = values[i] - values[i - 1];
+        }
+    }
+
+    if(pack->block_count >= pack->block_cap){
+        pack->block_cap = pack->block_cap ? pack->block_cap * 2 : 64;
+        blocks = (demux_pack_block_t*)realloc(pack->blocks, pack->block_cap * sizeof(demux_pack_block_t));
+        if(blocks == NULL){
+            printf("pack blocks realloc failed\n");
+            return -1;
+        }
+        pack->blocks = blocks;
+    }
+
+    block = &pack->blocks[pack->block_count++];
+    block->delta = (delta && demux_pack_bit_width(max_delta) < demux_pack_bit_width(max_value - min_value));
+    block->base = block->delta ? values[0] : min_value;
+    block->bits = demux_pack_bit_width(block->delta ? max_delta : max_value - min_value);
+    block->word_offset = pack->word_count;
+
+    word_need = ((uint64_t)block->bits * n + 63) / 64;
+    if(pack->word_count + word_need > pack->word_cap){
+        while(pack->word_count + word_need > pack->word_cap){
+            pack->word_cap = pack->word_cap ? pack->word_cap * 2 : 256;
+        }
+        words = (uint64_t*)realloc(pack->words, pack->word_cap * sizeof(uint64_t));
+        if(words == NULL){
+            printf("pack words realloc failed\n");
+            return -1;
+        }
+        pack->words = words;
+    }
+    /* 整块取值相同时bits为0, 不占word */
+    if(word_need > 0){
+        memset(pack->words + pack->word_count, 0, word_need * sizeof(uint64_t));
+    }
+
+    for(i = 0;i < n && block->bits > 0;i++){
+        if(block->delta){
+            entry = (i == 0) ? 0 : values[i] - values[i - 1];
+        }else{
+            entry = values[i] - min_value;
+        }
+        bit_pos = (uint64_t)i * block->bits;
+        pack->words[pack->word_count + bit_pos / 64] |= entry << (bit_pos % 64);
+        if(bit_pos % 64 + block->bits > 64){
+            pack->words[pack->word_count + bit_pos / 64 + 1] |= entry >> (64 - bit_pos % 64);
+        }
+    }
+
+    pack->word_count += word_need;
+    pack->pending_count = 0;
+
+    return 0;
+}
+
+int demux_pack_append(demux_pack_t* pack, uint64_t value){
+    pack->pending[pack->pending_count++] = value;
+    pack->count++;
+
+    if(pack->pending_count == DEMUX_PACK_BLOCK_SIZE){
+        return demux_pack_flush(pack);
+    }
+
+    return 0;
+}
+
+/* 编码结束, 释放编码用的缓冲并收缩内存 */
+int demux_pack_finish(demux_pack_t* pack){
+    uint64_t* words = NULL;
+    demux_pack_block_t* blocks = NULL;
+
+    if(demux_pack_flush(pack) < 0){
+        return -1;
+    }
+    free(pack->pending);
+    pack->pending = NULL;
+
+    if(pack->word_count > 0 && pack->word_count < pack->word_cap){
+        words = (uint64_t*)realloc(pack->words, pack->word_count * sizeof(uint64_t));
+        if(words != NULL){
+            pack->words = words;
+            pack->word_cap = pack->word_count;
+        }
+    }
+    if(pack->block_count > 0 && pack->block_count < pack->block_cap){
+        blocks = (demux_pack_block_t*)realloc(pack->blocks, pack->block_count * sizeof(demux_pack_block_t));
+        if(blocks != NULL){
+            pack->blocks = blocks;
+            pack->block_cap = pack->block_count;
+        }
+    }
+
+    return 0;
+}
+
+uint64_t demux_pack_get(const demux_pack_t* pack, uint32_t index){
+    const demux_pack_block_t* block = &pack->blocks[index / DEMUX_PACK_BLOCK_SIZE];
+    const uint64_t* words = pack->words + block->word_offset;
+    uint32_t pos = index % DEMUX_PACK_BLOCK_SIZE;
+    uint64_t value = block->base;
+    uint32_t i = 0;
+
+    if(block->bits == 0){
+        return value;
+    }
+    if(!block->delta){
+        return value + demux_pack_read_bits(words, (uint64_t)pos * block->bits, block->bits);
+    }
+
+    /* delta block需要从block开头累加 */
+    for(i = 1;i <= pos;i++){
+        value += demux_pack_read_bits(words, (uint64_t)i * block->bits, block->bits);
+    }
+
+    return value;
+}
+
+/* 解出一个block, 返回值的个数 */
+uint32_t demux_pack_decode_block(const demux_pack_t* pack, uint32_t block_index, uint64_t* values){
+    const demux_pack_block_t* block = &pack->blocks[block_index];
+    const uint64_t* words = pack->words + block->word_offset;
+    uint32_t n = DEMUX_PACK_BLOCK_SIZE;
+    uint64_t bit_pos = 0;
+    uint32_t i = 0;
+
+    if(block_index == pack->block_count - 1 && pack->count % DEMUX_PACK_BLOCK_SIZE != 0){
+        n = pack->count % DEMUX_PACK_BLOCK_SIZE;
+    }
+
+    if(block->bits == 0){
+        for(i = 0;i < n;i++){
+            values[i] = block->base;
+        }
+        return n;
+    }
+
+    for(i = 0;i < n;i++){
+        values[i] = demux_pack_read_bits(words, bit_pos, block->bits);
+        bit_pos += block->bits;
+    }
+    if(block->delta){
+        values[0] = block->base;
+        for(i = 1;i < n;i++){
+            values[i] += values[i - 1];
+        }
+    }else{
+        for(i = 0;i < n;i++){
+            values[i] += block->base;
+        }
+    }
+
+    return n;
+}
+
+uint64_t demux_pack_bytes(const demux_pack_t* pack){
+    return (uint64_t)pack->block_count * sizeof(demux_pack_block_t) + (uint64_t)pack->word_count * sizeof(uint64_t);
+}
+
+void demux_pack_free(demux_pack_t* pack){
+    free(pack->blocks);
+    free(pack->words);
+    free(pack->pending);
+    memset(pack, 0, sizeof(demux_pack_t));
+}
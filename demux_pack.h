@@ -0,0 +1,61 @@
+#ifndef __DEMUX_PACK_H
+#define __DEMUX_PACK_H
+
+#include <stdint.h>
+
+/*
+ * 压缩的sample表: 每DEMUX_PACK_BLOCK_SIZE个值一个block, block内按位打包
+ * 每个block取 值-最小值(frame of reference) 或 相邻差值(delta) 中位宽较小的一种
+ * 值都相同时位宽为0, 只占一个block头; block头记录数据位置, 随机访问先O(1)定位block
+ */
+
+#define DEMUX_PACK_BLOCK_SIZE 64
+
+typedef struct demux_pack_block
+{
+    uint64_t base;              // frame of reference时为最小值, delta时为第一个值
+    uint32_t word_offset;       // block数据在words中的位置
+    uint8_t bits;
+    uint8_t delta;
+}demux_pack_block_t;
+
+typedef struct demux_pack
+{
+    uint32_t count;
+    uint32_t block_count;
+    uint32_t block_cap;
+    demux_pack_block_t* blocks;
+    uint64_t* words;
+    uint32_t word_count;
+    uint32_t word_cap;
+    uint64_t* pending;          // 编码时还没凑满一个block的值
+    uint32_t pending_count;
+}demux_pack_t;
+
+/* 顺序读取时缓存解出来的一个block */
+typedef struct demux_pack_cursor
+{
+    uint32_t block;             // 缓存的block序号+1, 0表示没有缓存
+    uint64_t values[DEMUX_PACK_BLOCK_SIZE];
+}demux_pack_cursor_t;
+
+extern int demux_pack_init(demux_pack_t* pack);
+extern int demux_pack_append(demux_pack_t* pack, uint64_t value);
+extern int demux_pack_finish(demux_pack_t* pack);
+extern uint64_t demux_pack_get(const demux_pack_t* pack, uint32_t index);
+extern uint32_t demux_pack_decode_block(const demux_pack_t* pack, uint32_t block, uint64_t* values);
+extern uint64_t demux_pack_bytes(const demux_pack_t* pack);
+extern void demux_pack_free(demux_pack_t* pack);
+
+static inline uint64_t demux_pack_cursor_get(const demux_pack_t* pack, demux_pack_cursor_t* cursor, uint32_t index){
+    uint32_t block = index / DEMUX_PACK_BLOCK_SIZE;
+
+    if(cursor->block != block + 1){
+        demux_pack_decode_block(pack, block, cursor->values);
+        cursor->block = block + 1;
+    }
+
+    return cursor->values[index % DEMUX_PACK_BLOCK_SIZE];
+}
+
+#endif
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "demux_packet.h"
+#include "demux_keyframe.h"
+
+/* 取出track的下一个sample信息, 不读数据 */
+static int demux_track_cursor_advance(demux_track_cursor_t* cursor, video_ctrl_t* track){
+    demux_packet_t* pkt = &cursor->next;
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    uint32_t sample_number = 0;
+
+    if(demux_sample_iter_next(&cursor->sample_iter, &offset, &size) <= 0){
+        cursor->eof = 1;
+        return 0;
+    }
+
+    pkt->sample_index = cursor->sample_iter.sample_index - 1;
+    pkt->offset = offset;
+    pkt->size = size;
+    pkt->dts = demux_timeline_dts(&cursor->timeline, pkt->sample_index);
+    pkt->pts = demux_timeline_pts(&cursor->timeline, pkt->sample_index);
+    pkt->duration = demux_timeline_duration(&cursor->timeline, pkt->sample_index);
+
+    /* stss: 没有stss时每个sample都是关键帧, stss中的序号从1开始 */
+    sample_number = pkt->sample_index + 1;
+    if(!track->stss_present){
+        pkt->keyframe = 1;
+    }else{
+        while(cursor->stss_index < track->i_frame_count &&
+              demux_pack_cursor_get(&track->i_frame_num_pack, &cursor->stss_cursor, cursor->stss_index) < sample_number){
+            cursor->stss_index++;
+        }
+        pkt->keyframe = (cursor->stss_index < track->i_frame_count &&
+                         demux_pack_cursor_get(&track->i_frame_num_pack, &cursor->stss_cursor, cursor->stss_index) == sample_number);
+    }
+
+    return 1;
+}
+
+/* 只取sample信息时用, 不把sample区间提交给io后端 */
+int demux_packet_reader_init_info(demux_packet_reader_t* reader, demux_ctrl_t* demux_ctrl, uint32_t track_mask){
+    demux_track_cursor_t* cursor = NULL;
+    video_ctrl_t* track = NULL;
+    int i = 0;
+
+    if(reader == NULL || demux_ctrl == NULL || demux_ctrl->io == NULL){
+        printf("reader[%p] demux_ctrl[%p] NULL\n", reader, demux_ctrl);
+        return -1;
+    }
+
+    memset(reader, 0, sizeof(demux_packet_reader_t));
+    reader->demux_ctrl = demux_ctrl;
+
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        cursor = &reader->cursor[i];
+        track = demux_ctrl->track[i];
+        if(!(track_mask & (1u << i)) || track->sample_count == 0 || track->timescale == 0){
+            continue;
+        }
+        if(demux_sample_iter_init(&cursor->sample_iter, track) < 0 ||
+           demux_timeline_build(&cursor->timeline, demux_ctrl, i) < 0){
+            continue;
+        }
+        cursor->enable = 1;
+        cursor->next.track_index = i;
+        demux_track_cursor_advance(cursor, track);
+    }
+
+    return 0;
+}
+
+int demux_packet_reader_seek(demux_packet_reader_t* reader, int track_index, uint32_t sample_index){
+    demux_ctrl_t* demux_ctrl = reader->demux_ctrl;
+    demux_track_cursor_t* cursor = NULL;
+    demux_sample_locator_t locator;
+    demux_sample_iter_t* iter = NULL;
+    demux_packet_t pkt;
+    video_ctrl_t* track = NULL;
+
+    if(track_index < 0 || track_index >= demux_ctrl->track_count || !reader->cursor[track_index].enable){
+        printf("reader track_index[%d] error\n", track_index);
+        return -1;
+    }
+    cursor = &reader->cursor[track_index];
+    track = demux_ctrl->track[track_index];
+    if(sample_index >= track->sample_count){
+        cursor->eof = 1;
+        return 0;
+    }
+
+    /* 由locator按stsc整段跳到sample所在的chunk, 再把sample迭代器放到这个位置 */
+    if(demux_sample_locator_init(&locator, demux_ctrl, track_index) < 0){
+        return -1;
+    }
+    if(demux_sample_locate(&locator, sample_index, &pkt) < 0){
+        demux_sample_locator_free(&locator);
+        return -1;
+    }
+    iter = &cursor->sample_iter;
+    iter->chunk_index = locator.chunk_index;
+    iter->stsc_index = locator.stsc_index;
+    iter->sample_in_chunk = sample_index - locator.chunk_first_sample;
+    iter->sample_index = sample_index;
+    iter->offset = pkt.offset;
+    demux_sample_locator_free(&locator);
+
+    demux_keyframe_before(track, sample_index, &cursor->stss_index);
+    cursor->eof = 0;
+    demux_track_cursor_advance(cursor, track);
+
+    return 0;
+}
+
+int demux_packet_reader_init(demux_packet_reader_t* reader, demux_ctrl_t* demux_ctrl, uint32_t track_mask){
+    if(demux_packet_reader_init_info(reader, demux_ctrl, track_mask) < 0){
+        return -1;
+    }
+
+    return demux_plan_read(demux_ctrl, track_mask);
+}
+
+/* 只取sample信息不读数据, 返回1表示取到, 0表示所有track读完 */
+int demux_read_packet_info(demux_packet_reader_t* reader, demux_packet_t* pkt){
+    demux_ctrl_t* demux_ctrl = reader->demux_ctrl;
+    demux_track_cursor_t* cursor = NULL;
+    demux_track_cursor_t* best = NULL;
+    uint64_t consumed = 0;
+    int i = 0;
+
+    /* 选出dts(换算成秒)最小的track */
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        cursor = &reader->cursor[i];
+        if(!cursor->enable || cursor->eof){
+            continue;
+        }
+        if(best == NULL ||
+           (double)cursor->next.dts / demux_ctrl->track[i]->timescale <
+           (double)best->next.dts / demux_ctrl->track[best->next.track_index]->timescale){
+            best = cursor;
+        }
+    }
+
+    if(best == NULL){
+        return 0;
+    }
+
+    *pkt = best->next;
+    pkt->data = NULL;
+    pkt->buf = NULL;
+    demux_track_cursor_advance(best, demux_ctrl->track[pkt->track_index]);
+
+    /* 各track的数据在文件中交织, 告诉io哪些数据所有track都读过了, 预读不会丢掉其它track还要读的区间 */
+    consumed = UINT64_MAX;
+    for(i = 0;i < demux_ctrl->track_count;i++){
+        cursor = &reader->cursor[i];
+        if(cursor->enable && !cursor->eof && cursor->next.offset < consumed){
+            consumed = cursor->next.offset;
+        }
+    }
+    if(consumed > pkt->offset){
+        consumed = pkt->offset;
+    }
+    if(consumed > reader->consumed_offset){
+        reader->consumed_offset = consumed;
+        demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_CONSUMED, consumed, 0);
+    }
+
+    return 1;
+}
+
+/* 返回1表示读到packet, 0表示所有track读完 */
+int demux_read_packet(demux_packet_reader_t* reader, demux_packet_t* pkt){
+    int ret = 0;
+
+    ret = demux_read_packet_info(reader, pkt);
+    if(ret <= 0){
+        return ret;
+    }
+
+    if(reader->pool != NULL){
+        pkt->buf = demux_pool_alloc(reader->pool, pkt->size);
+        if(pkt->buf == NULL){
+            return -1;
+        }
+        if(demux_read_at(reader->demux_ctrl, pkt->offset, pkt->buf->data, pkt->size) < 0){
+            printf("read packet failed, offset[%lu] size[%u]\n", pkt->offset, pkt->size);
+            demux_pool_free(reader->pool, pkt->buf);
+            pkt->buf = NULL;
+            return -1;
+        }
+        pkt->data = pkt->buf->data;
+        demux_stats_sample(&reader->demux_ctrl->stats, pkt->size);
+        return 1;
+    }
+
+    if(pkt->size > reader->buf_size){
+        free(reader->buf);
+        reader->buf_size = pkt->size;
+        reader->buf = (uint8_t*)malloc(reader->buf_size);
+        if(reader->buf == NULL){
+            printf("packet buf NULL\n");
+            reader->buf_size = 0;
+            return -1;
+        }
+    }
+
+    if(demux_read_at(reader->demux_ctrl, pkt->offset, reader->buf, pkt->size) < 0){
+        printf("read packet failed, offset[%lu] size[%u]\n", pkt->offset, pkt->size);
+        return -1;
+    }
+    pkt->data = reader->buf;
+    demux_stats_sample(&reader->demux_ctrl->stats, pkt->size);
+
+    return 1;
+}
+
+int demux_packet_reader_set_pool(demux_packet_reader_t* reader, demux_pool_t* pool){
+    if(reader == NULL){
+        return -1;
+    }
+
+    reader->pool = pool;
+
+    return 0;
+}
+
+void demux_packet_reader_close(demux_packet_reader_t* reader){
+    int i = 0;
+
+    if(reader == NULL){
+        return;
+    }
+
+    for(i = 0;i < DEMUX_MAX_TRACK_NUM;i++){
+        demux_timeline_free(&reader->cursor[i].timeline);
+    }
+    free(reader->buf);
+    reader->buf = NULL;
+    reader->buf_size = 0;
+}
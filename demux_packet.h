@@ -0,0 +1,57 @@
+#ifndef __DEMUX_PACKET_H
+#define __DEMUX_PACKET_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_pool.h"
+#include "demux_timeline.h"
+
+#define DEMUX_PACKET_ALL_TRACK 0xffffffff
+
+typedef struct demux_packet
+{
+    int track_index;
+    uint32_t sample_index;
+    uint64_t offset;
+    uint32_t size;
+    int64_t dts;        // track timescale
+    int64_t pts;        // 已经加上ctts和elst的偏移, 见demux_timeline_pts
+    uint32_t duration;
+    int keyframe;
+    uint8_t* data;      // 下一次demux_read_packet前有效, 从缓冲池取时在释放buf前有效
+    demux_pool_buf_t* buf;  // reader设置了缓冲池时不为NULL, 由使用者demux_pool_free
+}demux_packet_t;
+
+/* 单个track的读取位置 */
+typedef struct demux_track_cursor
+{
+    int enable;
+    int eof;
+    demux_sample_iter_t sample_iter;
+    demux_timeline_t timeline;  // dts/pts/duration都从时间线取
+    uint32_t stss_index;
+    demux_pack_cursor_t stss_cursor;
+    demux_packet_t next;
+}demux_track_cursor_t;
+
+/* 按dts交织多个track的sample */
+typedef struct demux_packet_reader
+{
+    demux_ctrl_t* demux_ctrl;
+    demux_track_cursor_t cursor[DEMUX_MAX_TRACK_NUM];
+    uint8_t* buf;
+    uint32_t buf_size;
+    demux_pool_t* pool;     // 不为NULL时每个packet的数据放在池中单独的缓冲里, 可以跨多次读取保留
+    uint64_t consumed_offset;   // 所有track下一个sample的最小偏移, 之前的数据已经读完
+}demux_packet_reader_t;
+
+extern int demux_packet_reader_init(demux_packet_reader_t* reader, demux_ctrl_t* demux_ctrl, uint32_t track_mask);
+extern int demux_packet_reader_init_info(demux_packet_reader_t* reader, demux_ctrl_t* demux_ctrl, uint32_t track_mask);
+/* 把track的读取位置移到sample_index, 之后从这个sample开始按dts交织 */
+extern int demux_packet_reader_seek(demux_packet_reader_t* reader, int track_index, uint32_t sample_index);
+extern int demux_read_packet_info(demux_packet_reader_t* reader, demux_packet_t* pkt);
+extern int demux_read_packet(demux_packet_reader_t* reader, demux_packet_t* pkt);
+extern int demux_packet_reader_set_pool(demux_packet_reader_t* reader, demux_pool_t* pool);
+extern void demux_packet_reader_close(demux_packet_reader_t* reader);
+
+#endif
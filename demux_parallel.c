@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "demux_parallel.h"
+#include "demux_box.h"
+
+typedef struct demux_parallel_trak
+{
+    const uint8_t* data;
+    uint64_t len;
+    demux_ctrl_t* demux_ctrl;   // 工作线程自己的解析上下文, 只有一个track
+    int ret;
+}demux_parallel_trak_t;
+
+typedef struct demux_parallel_ctx
+{
+    demux_parallel_trak_t trak[DEMUX_MAX_TRACK_NUM];
+    int trak_count;
+    int next;                   // 下一个要解析的trak, 工作线程原子取
+}demux_parallel_ctx_t;
+
+/* 在内存io上把一段box解析完 */
+static int demux_parallel_parse_boxes(demux_ctrl_t* demux_ctrl, const uint8_t* data, uint64_t len){
+    demux_io_t* io = demux_ctrl->io;
+    demux_io_t* mem_io = NULL;
+    int ret = 0;
+
+    mem_io = demux_io_open_memory(data, len);
+    if(mem_io == NULL){
+        return -1;
+    }
+
+    demux_ctrl->io = mem_io;
+    while(ret >= 0 && demux_io_tell(mem_io) < len){
+        ret = demux_handle_box_body(demux_ctrl);
+    }
+    demux_ctrl->io = io;
+    demux_io_close(mem_io);
+
+    return ret;
+}
+
+static int demux_parallel_parse_trak(demux_parallel_trak_t* trak){
+    demux_ctrl_t* demux_ctrl = NULL;
+
+    demux_ctrl = (demux_ctrl_t*)calloc(1, sizeof(demux_ctrl_t));
+    if(demux_ctrl == NULL){
+        printf("parallel demux_ctrl calloc failed\n");
+        return -1;
+    }
+    trak->demux_ctrl = demux_ctrl;
+    if(demux_init_io(demux_ctrl, demux_io_open_memory(trak->data, trak->len)) < 0){
+        return -1;
+    }
+    while(demux_io_tell(demux_ctrl->io) < trak->len){
+        if(demux_handle_box_body(demux_ctrl) < 0){
+            break;
+        }
+    }
+    if(demux_ctrl->track_count != 1){
+        printf("parallel trak parse got %d tracks\n", demux_ctrl->track_count);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void* demux_parallel_thread(void* arg){
+    demux_parallel_ctx_t* ctx = (demux_parallel_ctx_t*)arg;
+    int index = 0;
+
+    while((index = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED)) < ctx->trak_count){
+        ctx->trak[index].ret = demux_parallel_parse_trak(&ctx->trak[index]);
+    }
+
+    return NULL;
+}
+
+static void demux_parallel_free(demux_parallel_ctx_t* ctx){
+    int i = 0;
+
+    for(i = 0;i < ctx->trak_count;i++){
+        if(ctx->trak[i].demux_ctrl == NULL){
+            continue;
+        }
+        if(ctx->trak[i].demux_ctrl->io != NULL){
+            demux_close(ctx->trak[i].demux_ctrl);
+        }else{
+            free(ctx->trak[i].demux_ctrl);
+        }
+        ctx->trak[i].demux_ctrl = NULL;
+    }
+}
+
+/* moov的body在内存中, 返回-1时demux_ctrl没有被修改 */
+static int demux_parallel_parse_body(demux_ctrl_t* demux_ctrl, const uint8_t* body, uint64_t body_len, int threads){
+    demux_parallel_ctx_t* ctx = NULL;
+    demux_box_info_t box;
+    demux_ctrl_t* worker = NULL;
+    pthread_t tid[DEMUX_PARALLEL_MAX_THREAD];
+    uint64_t pos = 0;
+    long cpu_count = 0;
+    int thread_count = 0;
+    int ret = 0;
+    int i = 0;
+    uint32_t j = 0;
+
+    if(threads == 1){
+        return -1;
+    }
+
+    ctx = (demux_parallel_ctx_t*)calloc(1, sizeof(demux_parallel_ctx_t));
+    if(ctx == NULL){
+        printf("parallel ctx calloc failed\n");
+        return -1;
+    }
+
+    /* 先找出所有trak */
+    pos = 0;
+    while((ret = demux_box_next(body, body_len, &pos, &box)) > 0){
+        if(strcmp(box.type, "trak") != 0){
+            continue;
+        }
+        if(ctx->trak_count + demux_ctrl->track_count >= DEMUX_MAX_TRACK_NUM){
+            ret = -1;
+            break;
+        }
+        ctx->trak[ctx->trak_count].data = body + box.offset;
+        ctx->trak[ctx->trak_count].len = box.size;
+        ctx->trak_count++;
+    }
+    if(ret < 0 || ctx->trak_count == 0 || (threads == 0 && ctx->trak_count < DEMUX_PARALLEL_MIN_TRAK)){
+        free(ctx);
+        return -1;
+    }
+
+    if(threads <= 0){
+        cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpu_count > 0 ? cpu_count : 1;
+    }
+    if(threads > ctx->trak_count){
+        threads = ctx->trak_count;
+    }
+    if(threads > DEMUX_PARALLEL_MAX_THREAD){
+        threads = DEMUX_PARALLEL_MAX_THREAD;
+    }
+
+    /* 当前线程也作为一个工作线程 */
+    for(thread_count = 0;thread_count < threads - 1;thread_count++){
+        if(pthread_create(&tid[thread_count], NULL, demux_parallel_thread, ctx) != 0){
+            break;
+        }
+    }
+    demux_parallel_thread(ctx);
+    for(i = 0;i < thread_count;i++){
+        pthread_join(tid[i], NULL);
+    }
+
+    ret = 0;
+    for(i = 0;i < ctx->trak_count;i++){
+        if(ctx->trak[i].ret < 0){
+            printf("parallel trak %d parse failed\n", i);
+            ret = -1;
+        }
+    }
+    if(ret < 0){
+        demux_parallel_free(ctx);
+        free(ctx);
+        return -1;
+    }
+
+    /* 按trak顺序合并, track的所有权转给demux_ctrl */
+    for(i = 0;i < ctx->trak_count;i++){
+        worker = ctx->trak[i].demux_ctrl;
+        demux_ctrl->track[demux_ctrl->track_count++] = worker->track[0];
+        demux_ctrl->cur_track = worker->track[0];
+        worker->track[0] = NULL;
+        worker->track_count = 0;
+        for(j = 0;j < worker->stats.box_type_count;j++){
+            demux_stats_merge_box(&demux_ctrl->stats, &worker->stats.box[j]);
+        }
+        demux_stats_alloc(&demux_ctrl->stats, worker->stats.alloc_bytes);
+    }
+    demux_parallel_free(ctx);
+    printf("parallel parse %d traks with %d threads\n", ctx->trak_count, thread_count + 1);
+
+    /* 其余子box串行解析 */
+    pos = 0;
+    while(ret >= 0 && demux_box_next(body, body_len, &pos, &box) > 0){
+        if(strcmp(box.type, "trak") != 0){
+            ret = demux_parallel_parse_boxes(demux_ctrl, body + box.offset, box.size);
+        }
+    }
+    free(ctx);
+
+    return 0;
+}
+
+int demux_parse_moov_parallel(demux_ctrl_t* demux_ctrl, const uint8_t* moov, uint64_t len, int threads){
+    demux_box_info_t box;
+    uint64_t pos = 0;
+
+    if(demux_ctrl == NULL || moov == NULL || threads == 1){
+        return -1;
+    }
+    if(demux_box_next(moov, len, &pos, &box) <= 0 || strcmp(box.type, "moov") != 0){
+        printf("parallel input is not moov\n");
+        return -1;
+    }
+
+    return demux_parallel_parse_body(demux_ctrl, moov + box.header_size, box.size - box.header_size, threads);
+}
+
+int demux_parse_moov_body(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size){
+    const uint8_t* body = NULL;
+    uint8_t* buf = NULL;
+    uint64_t offset = demux_io_tell(io);
+    int ret = 0;
+
+    if(demux_ctrl->parse_threads == 1 || body_size > DEMUX_PARALLEL_MAX_MOOV_BYTES){
+        return 1;
+    }
+
+    /* mmap/内存输入直接用原数据, 其他输入整块读一次 */
+    if(io->data != NULL && offset + body_size <= io->size){
+        body = io->data + offset;
+    }else{
+        buf = (uint8_t*)malloc(body_size);
+        if(buf == NULL){
+            return 1;
+        }
+        if(demux_io_read_at(io, offset, buf, body_size) != (int64_t)body_size){
+            free(buf);
+            return 1;
+        }
+        body = buf;
+    }
+
+    if(demux_parallel_parse_body(demux_ctrl, body, body_size, demux_ctrl->parse_threads) < 0){
+        ret = demux_parallel_parse_boxes(demux_ctrl, body, body_size);
+    }
+    free(buf);
+    if(ret < 0){
+        return -1;
+    }
+    demux_io_seek(io, body_size, SEEK_CUR);
+
+    return 0;
+}
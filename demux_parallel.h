@@ -0,0 +1,26 @@
+#ifndef __DEMUX_PARALLEL_H
+#define __DEMUX_PARALLEL_H
+
+#include <stdint.h>
+#include "demux.h"
+
+/*
+ * 并行解析trak: moov整块在内存中时, 各个trak的子树互不依赖
+ * 每个trak交给一个工作线程, 用自己的demux_ctrl和指向这段内存的io解析, 全部完成后按trak顺序并入demux_ctrl
+ * mvhd/mvex等其他子box在合并之后串行解析(trex要按track_id找track)
+ * 两个入口: demux_probe拿到内存中的moov后调用demux_parse_moov_parallel,
+ * demux_init等走demux_handle_box_body的流程在遇到moov时调用demux_parse_moov_body, 先把body整块读入内存
+ */
+
+#define DEMUX_PARALLEL_MIN_TRAK 4       // 自动模式下trak少于该值时串行解析
+#define DEMUX_PARALLEL_MAX_THREAD 16
+#define DEMUX_PARALLEL_MAX_MOOV_BYTES (256 * 1024 * 1024)   // 更大的moov不整块读入, 按原流程逐个解析子box
+
+/* moov为完整的moov box(含box头); threads为0时按trak数和cpu数自动选择, 1为串行
+ * 返回0表示已经解析完moov, 返回-1时demux_ctrl没有被修改, 调用者按原流程串行解析 */
+extern int demux_parse_moov_parallel(demux_ctrl_t* demux_ctrl, const uint8_t* moov, uint64_t len, int threads);
+/* io位于moov body开头; 按demux_ctrl->parse_threads并行解析, 不满足并行条件时在内存中串行解析
+ * 返回0表示moov已解析完且io移到body之后, 返回1表示没有处理(串行设置/moov过大/读不全), io不动, -1为解析失败 */
+extern int demux_parse_moov_body(demux_ctrl_t* demux_ctrl, demux_io_t* io, uint64_t body_size);
+
+#endif
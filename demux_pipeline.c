@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
+#include "demux_pipeline.h"
+
+int demux_ring_init(demux_ring_t* ring, uint32_t capacity){
+    uint32_t size = 1;
+
+    while(size < capacity){
+        size <<= 1;
+    }
+
+    memset(ring, 0, sizeof(demux_ring_t));
+    ring->slots = (void**)calloc(size, sizeof(void*));
+    if(ring->slots == NULL){
+        printf("ring slots calloc failed\n");
+        return -1;
+    }
+    ring->mask = size - 1;
+
+    return 0;
+}
+
+void demux_ring_free(demux_ring_t* ring){
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+/* 只由生产者调用 */
+int demux_ring_push(demux_ring_t* ring, void* item){
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    if(tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > ring->mask){
+        return -1;
+    }
+    ring->slots[tail & ring->mask] = item;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/* 只由消费者调用 */
+void* demux_ring_pop(demux_ring_t* ring){
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    void* item = NULL;
+
+    if(head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)){
+        return NULL;
+    }
+    item = ring->slots[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return item;
+}
+
+static void demux_pipeline_wait(demux_pipeline_t* pipeline, uint32_t* spins){
+    if(pipeline->opt.wait == DEMUX_PIPELINE_WAIT_SLEEP){
+        usleep(DEMUX_PIPELINE_SLEEP_US);
+    }else if(++(*spins) >= DEMUX_PIPELINE_SPIN_COUNT){
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+/* 描述符总数(depth + 1)不超过环容量, 环不会满, 这里的等待只是保险 */
+static void demux_pipeline_push(demux_pipeline_t* pipeline, demux_ring_t* ring, demux_pipeline_item_t* item){
+    uint32_t spins = 0;
+
+    while(demux_ring_push(ring, item) < 0){
+        demux_pipeline_wait(pipeline, &spins);
+    }
+}
+
+/* check_stop时出错停止后不再等待, 返回NULL */
+static demux_pipeline_item_t* demux_pipeline_pop(demux_pipeline_t* pipeline, demux_ring_t* ring, uint64_t* wait_count, int check_stop){
+    demux_pipeline_item_t* item = NULL;
+    uint32_t spins = 0;
+
+    item = (demux_pipeline_item_t*)demux_ring_pop(ring);
+    if(item != NULL){
+        return item;
+    }
+    (*wait_count)++;
+    while((item = (demux_pipeline_item_t*)demux_ring_pop(ring)) == NULL){
+        if(check_stop && __atomic_load_n(&pipeline->stop, __ATOMIC_ACQUIRE)){
+            return NULL;
+        }
+        demux_pipeline_wait(pipeline, &spins);
+    }
+
+    return item;
+}
+
+static void* demux_pipeline_read_thread(void* arg){
+    demux_pipeline_t* pipeline = (demux_pipeline_t*)arg;
+    demux_pipeline_item_t* item = NULL;
+    demux_packet_reader_t reader;
+    int ret = 0;
+
+    ret = demux_packet_reader_init(&reader, pipeline->demux_ctrl, 1u << pipeline->track_index);
+    if(ret >= 0){
+        demux_packet_reader_set_pool(&reader, &pipeline->pool);
+    }
+
+    while(1){
+        /* 拿不到空闲描述符说明下游还没处理完, 在这里形成背压 */
+        item = NULL;
+        if(ret >= 0 && !__atomic_load_n(&pipeline->stop, __ATOMIC_ACQUIRE)){
+            item = demux_pipeline_pop(pipeline, &pipeline->free_ring, &pipeline->stats.reader_wait, 1);
+        }
+        if(item != NULL){
+            item->read_ns = demux_stats_now_ns();
+            item->out = NULL;
+            item->out_len = 0;
+            item->eof = 0;
+            item->error = 0;
+            ret = demux_read_packet(&reader, &item->pkt);
+            if(ret > 0){
+                demux_pipeline_push(pipeline, &pipeline->read_ring, item);
+                continue;
+            }
+        }else{
+            /* 停止时用预留的描述符结束, 不等下游归还 */
+            item = &pipeline->eof_item;
+        }
+        item->pkt.buf = NULL;
+        item->out = NULL;
+        item->eof = 1;
+        item->error = ret < 0;
+        demux_pipeline_push(pipeline, &pipeline->read_ring, item);
+        break;
+    }
+    demux_packet_reader_close(&reader);
+
+    return NULL;
+}
+
+/* avcc -> annexb, 第一个sample前加sps/pps, 和demux_output_track的输出一致 */
+static int demux_pipeline_convert(demux_pipeline_t* pipeline, video_ctrl_t* track, demux_pipeline_item_t* item, int first){
+    static const uint8_t start_code[4] = {0x00, 0x00, 0x00, 0x01};
+    uint32_t nal_length_size = track->nal_length_size;
+    uint8_t* data = item->pkt.data;
+    uint32_t size = item->pkt.size;
+    uint32_t out_len = 0;
+    uint32_t nal_len = 0;
+    uint32_t pos = 0;
+    uint8_t* p = NULL;
+    uint32_t i = 0;
+
+    /* 先算出转换后的长度 */
+    if(first){
+        out_len += sizeof(start_code) * 2 + track->sps_len + track->pps_len;
+    }
+    while(pos + nal_length_size <= size){
+        nal_len = 0;
+        for(i = 0;i < nal_length_size;i++){
+            nal_len = (nal_len << 8) | data[pos + i];
+        }
+        pos += nal_length_size;
+        if(nal_len > size - pos){
+            printf("nal_len[%u] out of sample size[%u]\n", nal_len, size);
+            return -1;
+        }
+        out_len += sizeof(start_code) + nal_len;
+        pos += nal_len;
+    }
+
+    item->out = demux_pool_alloc(&pipeline->pool, out_len ? out_len : 1);
+    if(item->out == NULL){
+        return -1;
+    }
+    p = item->out->data;
+    if(first){
+        memcpy(p, start_code, sizeof(start_code));
+        p += sizeof(start_code);
+        memcpy(p, track->sps, track->sps_len);
+        p += track->sps_len;
+        memcpy(p, start_code, sizeof(start_code));
+        p += sizeof(start_code);
+        memcpy(p, track->pps, track->pps_len);
+        p += track->pps_len;
+    }
+    pos = 0;
+    while(pos + nal_length_size <= size){
+        nal_len = 0;
+        for(i = 0;i < nal_length_size;i++){
+            nal_len = (nal_len << 8) | data[pos + i];
+        }
+        pos += nal_length_size;
+        memcpy(p, start_code, sizeof(start_code));
+        memcpy(p + sizeof(start_code), data + pos, nal_len);
+        p += sizeof(start_code) + nal_len;
+        pos += nal_len;
+    }
+    item->out_len = out_len;
+
+    return 0;
+}
+
+static void* demux_pipeline_convert_thread(void* arg){
+    demux_pipeline_t* pipeline = (demux_pipeline_t*)arg;
+    video_ctrl_t* track = demux_get_track(pipeline->demux_ctrl, pipeline->track_index);
+    demux_pipeline_item_t* item = NULL;
+    int first = 1;
+    int eof = 0;
+
+    while(!eof){
+        item = demux_pipeline_pop(pipeline, &pipeline->read_ring, &pipeline->stats.converter_wait, 0);
+        eof = item->eof;
+        if(!item->eof && !item->error && !__atomic_load_n(&pipeline->stop, __ATOMIC_ACQUIRE)){
+            if(demux_pipeline_convert(pipeline, track, item, first) < 0){
+                item->error = 1;
+                __atomic_store_n(&pipeline->stop, 1, __ATOMIC_RELEASE);
+            }
+            first = 0;
+        }
+        /* 输入缓冲转换完就还给池, 出错后只传递描述符 */
+        demux_pool_free(&pipeline->pool, item->pkt.buf);
+        item->pkt.buf = NULL;
+        demux_pipeline_push(pipeline, &pipeline->convert_ring, item);
+    }
+
+    return NULL;
+}
+
+static void* demux_pipeline_write_thread(void* arg){
+    demux_pipeline_t* pipeline = (demux_pipeline_t*)arg;
+    demux_pipeline_stats_t* stats = &pipeline->stats;
+    demux_pipeline_item_t* item = NULL;
+    double latency_us = 0;
+
+    while(1){
+        item = demux_pipeline_pop(pipeline, &pipeline->convert_ring, &stats->writer_wait, 0);
+        if(item->error){
+            pipeline->ret = -1;
+            __atomic_store_n(&pipeline->stop, 1, __ATOMIC_RELEASE);
+        }
+        if(item->eof){
+            break;
+        }
+        if(pipeline->ret >= 0 && item->out != NULL){
+            if(demux_sink_write(pipeline->sink, item->out->data, item->out_len) < 0){
+                pipeline->ret = -1;
+                __atomic_store_n(&pipeline->stop, 1, __ATOMIC_RELEASE);
+            }else{
+                latency_us = (demux_stats_now_ns() - item->read_ns) / 1e3;
+                stats->sample_count++;
+                stats->bytes += item->out_len;
+                pipeline->latency_sum_us += latency_us;
+                pipeline->latency_sq_sum_us += latency_us * latency_us;
+                if(latency_us > stats->latency_max_us){
+                    stats->latency_max_us = latency_us;
+                }
+            }
+        }
+        demux_pool_free(&pipeline->pool, item->out);
+        item->out = NULL;
+        demux_pipeline_push(pipeline, &pipeline->free_ring, item);
+    }
+    if(pipeline->ret >= 0 && demux_sink_flush(pipeline->sink) < 0){
+        pipeline->ret = -1;
+    }
+
+    return NULL;
+}
+
+int demux_pipeline_output(demux_ctrl_t* demux_ctrl, int track_index, const demux_pipeline_opt_t* opt, demux_sink_t* sink,
+                          demux_pipeline_stats_t* stats){
+    void* (*stage[3])(void*) = {demux_pipeline_read_thread, demux_pipeline_convert_thread, demux_pipeline_write_thread};
+    demux_pipeline_t* pipeline = NULL;
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+    double variance = 0;
+    int thread_count = 0;
+    int ret = -1;
+    int i = 0;
+
+    if(track == NULL || sink == NULL){
+        printf("track[%p] sink[%p] NULL\n", track, sink);
+        return -1;
+    }
+    if(strcmp(track->codec, "avc1") != 0 || track->nal_length_size == 0 || track->nal_length_size > 4){
+        printf("track %u codec[%s] not support annexb output\n", track->track_id, track->codec);
+        return -1;
+    }
+
+    pipeline = (demux_pipeline_t*)calloc(1, sizeof(demux_pipeline_t));
+    if(pipeline == NULL){
+        printf("pipeline calloc failed\n");
+        return -1;
+    }
+    pipeline->demux_ctrl = demux_ctrl;
+    pipeline->track_index = track_index;
+    pipeline->sink = sink;
+    pipeline->opt.depth = DEMUX_PIPELINE_DEFAULT_DEPTH;
+    if(opt != NULL){
+        pipeline->opt = *opt;
+        if(pipeline->opt.depth == 0 || pipeline->opt.depth > DEMUX_PIPELINE_MAX_DEPTH){
+            pipeline->opt.depth = DEMUX_PIPELINE_DEFAULT_DEPTH;
+        }
+    }
+
+    pipeline->items = (demux_pipeline_item_t*)calloc(pipeline->opt.depth, sizeof(demux_pipeline_item_t));
+    if(pipeline->items == NULL || demux_pool_init(&pipeline->pool) < 0 ||
+       demux_ring_init(&pipeline->free_ring, pipeline->opt.depth + 1) < 0 ||
+       demux_ring_init(&pipeline->read_ring, pipeline->opt.depth + 1) < 0 ||
+       demux_ring_init(&pipeline->convert_ring, pipeline->opt.depth + 1) < 0){
+        goto end;
+    }
+    for(i = 0;i < (int)pipeline->opt.depth;i++){
+        demux_ring_push(&pipeline->free_ring, &pipeline->items[i]);
+    }
+    for(thread_count = 0;thread_count < 3;thread_count++){
+        if(pthread_create(&pipeline->thread[thread_count], NULL, stage[thread_count], pipeline) != 0){
+            printf("pipeline pthread_create failed\n");
+            break;
+        }
+    }
+    /* 有一级没起来时停止读取, 剩下的级在当前线程依次运行, 把已经在环中的描述符排空 */
+    if(thread_count < 3){
+        pipeline->ret = -1;
+        __atomic_store_n(&pipeline->stop, 1, __ATOMIC_RELEASE);
+        for(i = thread_count;i < 3;i++){
+            stage[i](pipeline);
+        }
+    }
+    for(i = 0;i < thread_count;i++){
+        pthread_join(pipeline->thread[i], NULL);
+    }
+    ret = pipeline->ret;
+
+    if(pipeline->stats.sample_count > 0){
+        pipeline->stats.latency_avg_us = pipeline->latency_sum_us / pipeline->stats.sample_count;
+        variance = pipeline->latency_sq_sum_us / pipeline->stats.sample_count -
+                   pipeline->stats.latency_avg_us * pipeline->stats.latency_avg_us;
+        pipeline->stats.latency_jitter_us = variance > 0 ? sqrt(variance) : 0;
+    }
+    if(stats != NULL){
+        *stats = pipeline->stats;
+    }
+    printf("track %u pipeline depth[%u] output %u samples, %lu bytes, pool malloc[%lu]\n", track->track_id,
+        pipeline->opt.depth, pipeline->stats.sample_count, pipeline->stats.bytes, pipeline->pool.malloc_count);
+
+end:
+    demux_ring_free(&pipeline->free_ring);
+    demux_ring_free(&pipeline->read_ring);
+    demux_ring_free(&pipeline->convert_ring);
+    demux_pool_destroy(&pipeline->pool);
+    free(pipeline->items);
+    free(pipeline);
+
+    return ret;
+}
@@ -0,0 +1,97 @@
+#ifndef __DEMUX_PIPELINE_H
+#define __DEMUX_PIPELINE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "demux.h"
+#include "demux_packet.h"
+#include "demux_pool.h"
+
+/*
+ * 单路流水线输出: 读sample, avcc转annexb, 写sink 分别在三个线程, 输出严格按解码顺序
+ * 线程之间用有界的单生产者单消费者环传递描述符, 描述符个数(depth)即流水线深度
+ * 写线程用完的描述符经回收环还给读线程, 下游慢时读线程拿不到描述符而等待(背压)
+ * sink慢或磁盘卡顿时, 前面的读和转换继续进行, 直到填满depth
+ */
+
+#define DEMUX_PIPELINE_DEFAULT_DEPTH 16
+#define DEMUX_PIPELINE_MAX_DEPTH 1024
+
+enum DEMUX_PIPELINE_WAIT{
+    DEMUX_PIPELINE_WAIT_SPIN,   // 环空/满时忙等后让出cpu, 延迟最低
+    DEMUX_PIPELINE_WAIT_SLEEP   // 环空/满时睡眠DEMUX_PIPELINE_SLEEP_US, 省cpu
+};
+
+#define DEMUX_PIPELINE_SPIN_COUNT 1024
+#define DEMUX_PIPELINE_SLEEP_US 50
+
+/* 单生产者单消费者环, 容量为2的幂 */
+typedef struct demux_ring
+{
+    uint64_t head __attribute__((aligned(64)));     // 消费者位置
+    uint64_t tail __attribute__((aligned(64)));     // 生产者位置
+    uint32_t mask;
+    void** slots;
+}demux_ring_t;
+
+typedef struct demux_pipeline_opt
+{
+    uint32_t depth;             // 同时在流水线中的sample数, 0为默认
+    int wait;                   // DEMUX_PIPELINE_WAIT
+}demux_pipeline_opt_t;
+
+/* 在环之间传递的描述符 */
+typedef struct demux_pipeline_item
+{
+    demux_packet_t pkt;
+    demux_pool_buf_t* out;      // 转换后的数据
+    uint32_t out_len;
+    int eof;
+    int error;
+    uint64_t read_ns;           // 开始读的时间, 统计每帧延迟
+}demux_pipeline_item_t;
+
+typedef struct demux_pipeline_stats
+{
+    uint32_t sample_count;
+    uint64_t bytes;
+    double latency_avg_us;      // 开始读到写完的时间
+    double latency_max_us;
+    double latency_jitter_us;   // 标准差
+    uint64_t reader_wait;       // 读线程等空闲描述符的次数(背压)
+    uint64_t converter_wait;
+    uint64_t writer_wait;
+}demux_pipeline_stats_t;
+
+typedef struct demux_pipeline
+{
+    demux_ctrl_t* demux_ctrl;
+    int track_index;
+    demux_sink_t* sink;
+    demux_pipeline_opt_t opt;
+    demux_pool_t pool;
+    demux_pipeline_item_t* items;
+    demux_pipeline_item_t eof_item;     // 读线程停止时使用, 不在空闲环中
+    demux_ring_t free_ring;     // 写 -> 读, 空闲描述符
+    demux_ring_t read_ring;     // 读 -> 转换
+    demux_ring_t convert_ring;  // 转换 -> 写
+    pthread_t thread[3];
+    int stop;                   // 转换或写出错时置1, 读线程不再读新的sample
+    int ret;
+
+    double latency_sum_us;
+    double latency_sq_sum_us;
+    demux_pipeline_stats_t stats;
+}demux_pipeline_t;
+
+extern int demux_ring_init(demux_ring_t* ring, uint32_t capacity);
+extern void demux_ring_free(demux_ring_t* ring);
+/* 满/空时返回-1, 不等待 */
+extern int demux_ring_push(demux_ring_t* ring, void* item);
+extern void* demux_ring_pop(demux_ring_t* ring);
+
+/* 按流水线输出一个avc1 track为annexb, 返回时所有线程已结束 */
+extern int demux_pipeline_output(demux_ctrl_t* demux_ctrl, int track_index, const demux_pipeline_opt_t* opt, demux_sink_t* sink,
+                                 demux_pipeline_stats_t* stats);
+
+#endif
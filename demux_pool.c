@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux_pool.h"
+
+int demux_pool_init(demux_pool_t* pool){
+    demux_pool_class_t* cls = NULL;
+    uint32_t i = 0;
+
+    if(pool == NULL){
+        printf("pool NULL\n");
+        return -1;
+    }
+
+    memset(pool, 0, sizeof(demux_pool_t));
+    for(i = 0;i < DEMUX_POOL_CLASS_COUNT;i++){
+        cls = &pool->classes[i];
+        cls->buf_size = 1u << (DEMUX_POOL_MIN_SHIFT + i);
+        cls->slab_buffers = cls->buf_size < DEMUX_POOL_SLAB_BYTES ? DEMUX_POOL_SLAB_BYTES / cls->buf_size : 1;
+    }
+    pthread_mutex_init(&pool->grow_lock, NULL);
+
+    return 0;
+}
+
+static inline demux_pool_buf_t* demux_pool_get_buf(demux_pool_class_t* cls, uint32_t id){
+    return &cls->slabs[id / cls->slab_buffers]->bufs[id % cls->slab_buffers];
+}
+
+static void demux_pool_push(demux_pool_class_t* cls, demux_pool_buf_t* buf){
+    uint64_t head = __atomic_load_n(&cls->head, __ATOMIC_RELAXED);
+    uint64_t new_head = 0;
+
+    do{
+        __atomic_store_n(&buf->next, (uint32_t)head, __ATOMIC_RELAXED);
+        new_head = (((head >> 32) + 1) << 32) | (buf->id + 1);
+    }while(!__atomic_compare_exchange_n(&cls->head, &head, new_head, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static demux_pool_buf_t* demux_pool_pop(demux_pool_class_t* cls){
+    uint64_t head = __atomic_load_n(&cls->head, __ATOMIC_ACQUIRE);
+    uint64_t new_head = 0;
+    demux_pool_buf_t* buf = NULL;
+
+    do{
+        if((uint32_t)head == 0){
+            return NULL;
+        }
+        /* buf在链表中时next可能已被其他线程改掉, 这时版本号也变了, CAS会失败重来 */
+        buf = demux_pool_get_buf(cls, (uint32_t)head - 1);
+        new_head = (((head >> 32) + 1) << 32) | __atomic_load_n(&buf->next, __ATOMIC_RELAXED);
+    }while(!__atomic_compare_exchange_n(&cls->head, &head, new_head, 1, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return buf;
+}
+
+/* 空闲链表为空时申请一个slab, 第一个缓冲直接返回, 其余挂到空闲链表 */
+static demux_pool_buf_t* demux_pool_grow(demux_pool_t* pool, demux_pool_class_t* cls, uint32_t class_index){
+    demux_pool_slab_t* slab = NULL;
+    demux_pool_buf_t* buf = NULL;
+    uint32_t slab_index = 0;
+    uint32_t i = 0;
+
+    pthread_mutex_lock(&pool->grow_lock);
+    /* 等锁期间其他线程可能已经申请过slab */
+    buf = demux_pool_pop(cls);
+    if(buf != NULL){
+        pthread_mutex_unlock(&pool->grow_lock);
+        return buf;
+    }
+
+    slab_index = cls->slab_count;
+    if(slab_index >= DEMUX_POOL_MAX_SLAB){
+        pthread_mutex_unlock(&pool->grow_lock);
+        printf("pool class[%u] slab full\n", cls->buf_size);
+        return NULL;
+    }
+    slab = (demux_pool_slab_t*)malloc(sizeof(demux_pool_slab_t) + cls->slab_buffers * sizeof(demux_pool_buf_t));
+    if(slab != NULL){
+        /* 不清零, 缓冲内容由读取覆盖 */
+        slab->data = (uint8_t*)malloc((uint64_t)cls->slab_buffers * cls->buf_size);
+    }
+    if(slab == NULL || slab->data == NULL){
+        pthread_mutex_unlock(&pool->grow_lock);
+        printf("pool slab malloc failed, class[%u]\n", cls->buf_size);
+        free(slab);
+        return NULL;
+    }
+    for(i = 0;i < cls->slab_buffers;i++){
+        slab->bufs[i].data = slab->data + (uint64_t)i * cls->buf_size;
+        slab->bufs[i].capacity = cls->buf_size;
+        slab->bufs[i].size = 0;
+        slab->bufs[i].id = slab_index * cls->slab_buffers + i;
+        slab->bufs[i].next = 0;
+        slab->bufs[i].class_index = class_index;
+    }
+    /* slab先发布再把缓冲挂到链表, pop时按id一定能找到slab */
+    cls->slabs[slab_index] = slab;
+    __atomic_store_n(&cls->slab_count, slab_index + 1, __ATOMIC_RELEASE);
+    for(i = 1;i < cls->slab_buffers;i++){
+        demux_pool_push(cls, &slab->bufs[i]);
+    }
+    __atomic_fetch_add(&pool->malloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pool->malloc_bytes, (uint64_t)cls->slab_buffers * cls->buf_size, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool->grow_lock);
+
+    return &slab->bufs[0];
+}
+
+demux_pool_buf_t* demux_pool_alloc(demux_pool_t* pool, uint32_t size){
+    demux_pool_class_t* cls = NULL;
+    demux_pool_buf_t* buf = NULL;
+    uint32_t class_index = 0;
+
+    while(class_index < DEMUX_POOL_CLASS_COUNT && pool->classes[class_index].buf_size < size){
+        class_index++;
+    }
+    if(class_index >= DEMUX_POOL_CLASS_COUNT){
+        printf("pool alloc size[%u] too large\n", size);
+        return NULL;
+    }
+
+    cls = &pool->classes[class_index];
+    buf = demux_pool_pop(cls);
+    if(buf == NULL){
+        buf = demux_pool_grow(pool, cls, class_index);
+        if(buf == NULL){
+            return NULL;
+        }
+    }
+    buf->size = size;
+    __atomic_fetch_add(&pool->alloc_count, 1, __ATOMIC_RELAXED);
+
+    return buf;
+}
+
+void demux_pool_free(demux_pool_t* pool, demux_pool_buf_t* buf){
+    if(pool == NULL || buf == NULL){
+        return;
+    }
+
+    demux_pool_push(&pool->classes[buf->class_index], buf);
+    __atomic_fetch_add(&pool->free_count, 1, __ATOMIC_RELAXED);
+}
+
+void demux_pool_destroy(demux_pool_t* pool){
+    demux_pool_class_t* cls = NULL;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    if(pool == NULL){
+        return;
+    }
+
+    for(i = 0;i < DEMUX_POOL_CLASS_COUNT;i++){
+        cls = &pool->classes[i];
+        for(j = 0;j < cls->slab_count;j++){
+            free(cls->slabs[j]->data);
+            free(cls->slabs[j]);
+        }
+        cls->slab_count = 0;
+        cls->head = 0;
+    }
+    pthread_mutex_destroy(&pool->grow_lock);
+}
@@ -0,0 +1,64 @@
+#ifndef __DEMUX_POOL_H
+#define __DEMUX_POOL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * sample数据缓冲池: 按大小分级(4KB << n), 每级的缓冲按slab成批申请, 不清零
+ * 释放的缓冲挂回该级的无锁空闲链表(链表头带版本号防ABA), 任意线程都可以申请和释放
+ * 预热之后每个sample的读取不再malloc, malloc_count只在新申请slab时增加
+ */
+
+#define DEMUX_POOL_MIN_SHIFT 12                 // 最小一级4KB
+#define DEMUX_POOL_CLASS_COUNT 16               // 最大一级128MB
+#define DEMUX_POOL_SLAB_BYTES (1024 * 1024)     // 小缓冲一个slab凑满1MB, 大缓冲一个slab一个
+#define DEMUX_POOL_MAX_SLAB 256
+
+typedef struct demux_pool_buf
+{
+    uint8_t* data;
+    uint32_t capacity;
+    uint32_t size;              // 使用者写入的长度
+    uint32_t id;                // 在所属级中的序号
+    uint32_t next;              // 空闲链表中下一个的id + 1, 0为结尾
+    uint32_t class_index;
+}demux_pool_buf_t;
+
+typedef struct demux_pool_slab
+{
+    uint8_t* data;
+    demux_pool_buf_t bufs[];
+}demux_pool_slab_t;
+
+typedef struct demux_pool_class
+{
+    uint64_t head;              // 高32位版本号, 低32位为空闲链表头的id + 1
+    uint32_t buf_size;
+    uint32_t slab_buffers;      // 每个slab中的缓冲数
+    uint32_t slab_count;
+    demux_pool_slab_t* slabs[DEMUX_POOL_MAX_SLAB];
+}demux_pool_class_t;
+
+typedef struct demux_pool
+{
+    demux_pool_class_t classes[DEMUX_POOL_CLASS_COUNT];
+    pthread_mutex_t grow_lock;  // 只在空闲链表为空, 申请新slab时使用
+    uint64_t alloc_count;
+    uint64_t free_count;
+    uint64_t malloc_count;      // slab申请次数
+    uint64_t malloc_bytes;
+}demux_pool_t;
+
+extern int demux_pool_init(demux_pool_t* pool);
+/* 取一个容量不小于size的缓冲, 失败返回NULL */
+extern demux_pool_buf_t* demux_pool_alloc(demux_pool_t* pool, uint32_t size);
+extern void demux_pool_free(demux_pool_t* pool, demux_pool_buf_t* buf);
+/* 释放所有slab, 调用时不能还有缓冲在使用 */
+extern void demux_pool_destroy(demux_pool_t* pool);
+
+static inline uint64_t demux_pool_malloc_count(demux_pool_t* pool){
+    return __atomic_load_n(&pool->malloc_count, __ATOMIC_RELAXED);
+}
+
+#endif
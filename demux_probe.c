@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux.h"
+#include "demux_box.h"
+#include "demux_probe.h"
+#include "demux_parallel.h"
+
+typedef struct demux_probe_window
+{
+    uint64_t offset;
+    uint64_t len;
+    uint8_t* data;
+}demux_probe_window_t;
+
+typedef struct demux_probe_ctx
+{
+    demux_probe_window_t window[3];     // 头部, 尾部, 第三次读
+    int window_count;
+    uint64_t ftyp_offset;
+    uint64_t ftyp_size;
+    uint64_t moov_offset;
+    uint64_t moov_size;
+    int moov_found;
+}demux_probe_ctx_t;
+
+static int demux_probe_read(demux_ctrl_t* demux_ctrl, demux_probe_ctx_t* ctx, uint64_t offset, uint64_t len){
+    demux_probe_window_t* window = &ctx->window[ctx->window_count];
+
+    window->data = (uint8_t*)malloc(len ? len : 1);
+    if(window->data == NULL){
+        printf("probe window NULL, len[%lu]\n", len);
+        return -1;
+    }
+    if(demux_io_read_at(demux_ctrl->io, offset, window->data, len) != (int64_t)len){
+        printf("probe read failed, offset[%lu] len[%lu]\n", offset, len);
+        free(window->data);
+        window->data = NULL;
+        return -1;
+    }
+    window->offset = offset;
+    window->len = len;
+    ctx->window_count++;
+
+    return 0;
+}
+
+/* [offset, offset + len)完整在某个窗口中时返回对应的数据 */
+static uint8_t* demux_probe_find(demux_probe_ctx_t* ctx, uint64_t offset, uint64_t len){
+    demux_probe_window_t* window = NULL;
+    int i = 0;
+
+    for(i = 0;i < ctx->window_count;i++){
+        window = &ctx->window[i];
+        if(offset >= window->offset && offset + len <= window->offset + window->len){
+            return window->data + (offset - window->offset);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * 从pos开始按box大小往后跳, 只需要box头在窗口中
+ * 返回1找到moov, 0到文件末尾, -1格式错误; 头不在任何窗口中时停下, *pos为下一个box的位置
+ */
+static int demux_probe_walk(demux_probe_ctx_t* ctx, uint64_t file_size, uint64_t* pos){
+    uint8_t* head = NULL;
+    uint64_t size = 0;
+    uint32_t header_size = BOX_HEAD_BYTE;
+
+    while(*pos + BOX_HEAD_BYTE <= file_size){
+        head = demux_probe_find(ctx, *pos, BOX_HEAD_BYTE);
+        if(head == NULL){
+            return 0;
+        }
+
+        header_size = BOX_HEAD_BYTE;
+        size = demux_get_be32(head);
+        if(size == 1){
+            head = demux_probe_find(ctx, *pos, BOX_HEAD_BYTE + BOX_LARGE_SZIE_BYTE);
+            if(head == NULL){
+                return 0;
+            }
+            size = demux_get_be64(head + BOX_HEAD_BYTE);
+            header_size += BOX_LARGE_SZIE_BYTE;
+        }else if(size == 0){
+            size = file_size - *pos;
+        }
+        if(size < header_size || size > file_size - *pos){
+            printf("probe box size[%lu] error, offset[%lu]\n", size, *pos);
+            return -1;
+        }
+
+        printf("probe %.4s offset[%lu] size[%lu]\n", (char*)head + BOX_SIZE_BYTE, *pos, size);
+        if(memcmp(head + BOX_SIZE_BYTE, "ftyp", BOX_TYPE_BYTE) == 0){
+            ctx->ftyp_offset = *pos;
+            ctx->ftyp_size = size;
+        }else if(memcmp(head + BOX_SIZE_BYTE, "moov", BOX_TYPE_BYTE) == 0){
+            ctx->moov_offset = *pos;
+            ctx->moov_size = size;
+            ctx->moov_found = 1;
+            return 1;
+        }
+        *pos += size;
+    }
+
+    return 0;
+}
+
+/* 用现有的box解析流程解析内存中的一个顶层box, io临时换成这段内存 */
+static int demux_probe_parse(demux_ctrl_t* demux_ctrl, const uint8_t* data, uint64_t len){
+    demux_io_t* io = demux_ctrl->io;
+    demux_io_t* mem_io = NULL;
+    int ret = 0;
+
+    mem_io = demux_io_open_memory(data, len);
+    if(mem_io == NULL){
+        return -1;
+    }
+
+    demux_ctrl->io = mem_io;
+    while(ret >= 0 && demux_io_tell(mem_io) < len){
+        ret = demux_handle_box_body(demux_ctrl);
+    }
+    demux_ctrl->io = io;
+    demux_io_close(mem_io);
+
+    return ret;
+}
+
+int demux_probe(demux_ctrl_t* demux_ctrl, uint32_t window){
+    demux_probe_ctx_t ctx;
+    uint64_t file_size = 0;
+    uint64_t head_len = 0;
+    uint64_t tail_offset = 0;
+    uint64_t read_calls = 0;
+    uint64_t pos = 0;
+    uint8_t* data = NULL;
+    int ret = -1;
+    int i = 0;
+
+    if(demux_ctrl == NULL || demux_ctrl->io == NULL || window < BOX_HEAD_BYTE + BOX_LARGE_SZIE_BYTE){
+        printf("demux_ctrl[%p] or window[%u] error\n", demux_ctrl, window);
+        return -1;
+    }
+
+    memset(&ctx, 0, sizeof(demux_probe_ctx_t));
+    read_calls = demux_ctrl->io->read_calls;
+    file_size = demux_io_size(demux_ctrl->io);
+    head_len = file_size < window ? file_size : window;
+    tail_offset = file_size - head_len;
+
+    /* 头尾两个窗口先放进读计划, 远端后端各用一次请求取回(离得近时合并成一次) */
+    demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_RESET, 0, 0);
+    demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_WILLNEED, 0, head_len);
+    if(tail_offset > head_len){
+        demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_WILLNEED, tail_offset, head_len);
+    }
+
+    if(demux_probe_read(demux_ctrl, &ctx, 0, head_len) < 0){
+        goto end;
+    }
+    if(tail_offset > head_len && demux_probe_read(demux_ctrl, &ctx, tail_offset, head_len) < 0){
+        goto end;
+    }else if(tail_offset > 0 && tail_offset <= head_len){
+        /* 头尾窗口重叠, 尾部剩下的部分接在头部窗口后面 */
+        if(demux_probe_read(demux_ctrl, &ctx, head_len, file_size - head_len) < 0){
+            goto end;
+        }
+    }
+
+    ret = demux_probe_walk(&ctx, file_size, &pos);
+    if(ret < 0){
+        goto end;
+    }
+
+    /* 第三次读: moov跨出了窗口, 或者mdat之后下一个box头不在尾部窗口中(moov大于窗口) */
+    if(ret == 0 && pos + BOX_HEAD_BYTE <= file_size){
+        if(file_size - pos > DEMUX_PROBE_MAX_MOOV){
+            printf("probe gap[%lu] too large\n", file_size - pos);
+            ret = -1;
+            goto end;
+        }
+        if(demux_probe_read(demux_ctrl, &ctx, pos, file_size - pos) < 0){
+            ret = -1;
+            goto end;
+        }
+        ret = demux_probe_walk(&ctx, file_size, &pos);
+    }else if(ret == 1 && demux_probe_find(&ctx, ctx.moov_offset, ctx.moov_size) == NULL){
+        if(ctx.moov_size > DEMUX_PROBE_MAX_MOOV){
+            printf("probe moov size[%lu] too large\n", ctx.moov_size);
+            ret = -1;
+            goto end;
+        }
+        ret = demux_probe_read(demux_ctrl, &ctx, ctx.moov_offset, ctx.moov_size) < 0 ? -1 : 1;
+    }
+    if(ret <= 0 || !ctx.moov_found){
+        printf("probe moov not found\n");
+        ret = -1;
+        goto end;
+    }
+
+    printf("probe moov offset[%lu] size[%lu], %lu reads\n", ctx.moov_offset, ctx.moov_size,
+           demux_ctrl->io->read_calls - read_calls);
+
+    /* 找到moov之后的解析错误和逐个box遍历一样只是结束解析, 不再退回 */
+    data = demux_probe_find(&ctx, ctx.ftyp_offset, ctx.ftyp_size);
+    if(ctx.ftyp_size > 0 && data != NULL){
+        demux_probe_parse(demux_ctrl, data, ctx.ftyp_size);
+    }
+    data = demux_probe_find(&ctx, ctx.moov_offset, ctx.moov_size);
+    if(data != NULL && demux_parse_moov_parallel(demux_ctrl, data, ctx.moov_size, demux_ctrl->parse_threads) < 0){
+        demux_probe_parse(demux_ctrl, data, ctx.moov_size);
+    }
+    demux_io_seek(demux_ctrl->io, file_size, SEEK_SET);
+    ret = 0;
+
+end:
+    demux_io_hint(demux_ctrl->io, DEMUX_IO_HINT_RESET, 0, 0);
+    for(i = 0;i < ctx.window_count;i++){
+        free(ctx.window[i].data);
+    }
+
+    return ret;
+}
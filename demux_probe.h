@@ -0,0 +1,19 @@
+#ifndef __DEMUX_PROBE_H
+#define __DEMUX_PROBE_H
+
+#include <stdint.h>
+#include "demux.h"
+
+/*
+ * 快速探测: 不逐个读box头, 一次读文件头部window字节, 一次读尾部window字节
+ * 按两个窗口中顶层box的大小跳到ftyp/mdat/moov, moov不完整时再读一次, 任何渐进式mp4最多3次IO
+ * 远端/冷存储上每次读都是一次请求, 逐个box遍历在mdat很大时也要多次往返
+ */
+
+#define DEMUX_PROBE_WINDOW (256 * 1024)
+#define DEMUX_PROBE_MAX_MOOV (64 * 1024 * 1024)    // 第三次读的上限, 超过时退回逐个box遍历
+
+/* 找到并解析了moov返回0, io停在文件末尾; 找不到moov返回-1, 没有解析任何box, 调用者退回逐个box遍历 */
+extern int demux_probe(demux_ctrl_t* demux_ctrl, uint32_t window);
+
+#endif
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux.h"
+#include "demux_box.h"
+#include "demux_packet.h"
+#include "demux_push.h"
+
+demux_push_t* demux_push_open(const demux_push_callback_t* callback){
+    demux_push_t* push = NULL;
+
+    push = (demux_push_t*)calloc(1, sizeof(demux_push_t));
+    if(push == NULL){
+        printf("push NULL\n");
+        return NULL;
+    }
+
+    if(callback != NULL){
+        push->callback = *callback;
+    }
+    push->state = DEMUX_PUSH_BOX_HEAD;
+
+    return push;
+}
+
+static int demux_push_packet_cmp(const void* a, const void* b){
+    const demux_packet_t* pkt_a = (const demux_packet_t*)a;
+    const demux_packet_t* pkt_b = (const demux_packet_t*)b;
+
+    if(pkt_a->offset == pkt_b->offset){
+        return 0;
+    }
+
+    return pkt_a->offset < pkt_b->offset ? -1 : 1;
+}
+
+/* 收到的mdat数据中凑齐的sample逐个回调, 完整落在buf中的sample直接指向buf不拷贝 */
+static int demux_push_emit(demux_push_t* push, const uint8_t* data, uint64_t len, uint64_t offset){
+    demux_packet_t* pkt = NULL;
+    uint64_t end = offset + len;
+    uint64_t copy_start = 0;
+    uint64_t copy_end = 0;
+    int ret = 0;
+
+    while(push->next_packet < push->packet_count){
+        pkt = &push->packets[push->next_packet];
+        if(pkt->offset >= end){
+            break;
+        }
+
+        if(push->partial.len == 0 && pkt->offset >= offset && pkt->offset + pkt->size <= end){
+            pkt->data = (uint8_t*)data + (pkt->offset - offset);
+        }else{
+            copy_start = pkt->offset + push->partial.len;
+            if(copy_start < offset){
+                /* sample的前半部分不在收到的数据中 */
+                printf("sample %u of track %d missing data, offset[%lu]\n",
+                    pkt->sample_index, pkt->track_index, pkt->offset);
+                push->partial.len = 0;
+                push->next_packet++;
+                continue;
+            }
+            copy_end = (pkt->offset + pkt->size < end) ? pkt->offset + pkt->size : end;
+            if(demux_buf_put(&push->partial, data + (copy_start - offset), copy_end - copy_start) < 0){
+                return -1;
+            }
+            if(push->partial.len < pkt->size){
+                break;
+            }
+            pkt->data = push->partial.data;
+        }
+
+        if(push->callback.on_packet != NULL){
+            ret = push->callback.on_packet(push->callback.user, pkt);
+        }
+        pkt->data = NULL;
+        push->partial.len = 0;
+        push->next_packet++;
+        push->packet_emitted++;
+        demux_stats_sample(&push->demux_ctrl->stats, pkt->size);
+        if(ret < 0){
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* moov收齐后用现有的box解析流程解析, 再把所有sample按文件偏移排好 */
+static int demux_push_parse_moov(demux_push_t* push){
+    demux_packet_reader_t reader;
+    demux_packet_t* packets = NULL;
+    demux_packet_t pkt;
+    demux_io_t* io = NULL;
+    uint32_t cap = 0;
+    int i = 0;
+
+    push->demux_ctrl = (demux_ctrl_t*)calloc(1, sizeof(demux_ctrl_t));
+    io = demux_io_open_memory(push->meta.data, push->meta.len);
+    if(push->demux_ctrl == NULL || io == NULL){
+        printf("push demux_ctrl[%p] io[%p] NULL\n", push->demux_ctrl, io);
+        demux_io_close(io);
+        return -1;
+    }
+    if(demux_init_io(push->demux_ctrl, io) < 0){
+        return -1;
+    }
+    while(demux_handle_box_body(push->demux_ctrl) >= 0);
+
+    if(demux_packet_reader_init(&reader, push->demux_ctrl, DEMUX_PACKET_ALL_TRACK) < 0){
+        return -1;
+    }
+    while(demux_read_packet_info(&reader, &pkt) > 0){
+        if(push->packet_count >= cap){
+            cap = cap ? cap * 2 : 1024;
+            packets = (demux_packet_t*)realloc(push->packets, cap * sizeof(demux_packet_t));
+            if(packets == NULL){
+                printf("push packets realloc failed\n");
+                demux_packet_reader_close(&reader);
+                return -1;
+            }
+            push->packets = packets;
+        }
+        push->packets[push->packet_count++] = pkt;
+    }
+    demux_packet_reader_close(&reader);
+
+    qsort(push->packets, push->packet_count, sizeof(demux_packet_t), demux_push_packet_cmp);
+    push->moov_done = 1;
+    printf("push moov done, %d tracks %u samples\n", push->demux_ctrl->track_count, push->packet_count);
+
+    for(i = 0;i < push->demux_ctrl->track_count;i++){
+        if(push->callback.on_track != NULL && push->callback.on_track(push->callback.user, push->demux_ctrl, i) < 0){
+            return -1;
+        }
+    }
+
+    /* moov之前收到的mdat数据 */
+    if(push->pending.len > 0){
+        if(demux_push_emit(push, push->pending.data, push->pending.len, push->pending_offset) < 0){
+            return -1;
+        }
+        demux_buf_free(&push->pending);
+    }
+
+    return 0;
+}
+
+static int demux_push_mdat_data(demux_push_t* push, const uint8_t* data, uint64_t len){
+    uint64_t pending_end = push->pending_offset + push->pending.len;
+
+    if(push->moov_done){
+        return demux_push_emit(push, data, len, push->stream_offset);
+    }
+
+    /* moov还没到, 先把mdat暂存, 多个mdat之间的box头补0 */
+    if(push->pending.len == 0){
+        push->pending_offset = push->stream_offset;
+        pending_end = push->stream_offset;
+    }
+    if(push->stream_offset - push->pending_offset + len > DEMUX_PUSH_MAX_PENDING_BYTES){
+        printf("mdat before moov exceed %u bytes\n", DEMUX_PUSH_MAX_PENDING_BYTES);
+        return -1;
+    }
+    if(push->pending.data == NULL && demux_buf_init(&push->pending, len) < 0){
+        return -1;
+    }
+    if(push->stream_offset > pending_end){
+        demux_buf_put_zero(&push->pending, push->stream_offset - pending_end);
+    }
+
+    return demux_buf_put(&push->pending, data, len);
+}
+
+static int demux_push_box_head(demux_push_t* push){
+    uint64_t box_size = demux_get_be32(push->head);
+
+    memcpy(push->box_type, push->head + BOX_SIZE_BYTE, BOX_TYPE_BYTE);
+    push->box_type[BOX_TYPE_BYTE] = 0;
+    push->box_offset = push->stream_offset - push->head_len;
+
+    if(box_size == 1){
+        box_size = demux_get_be64(push->head + BOX_HEAD_BYTE);
+    }
+    if(box_size != 0 && box_size < push->head_len){
+        printf("push box %s size[%lu] error\n", push->box_type, box_size);
+        return -1;
+    }
+    push->box_end = box_size ? push->box_offset + box_size : 0;
+
+    if(memcmp(push->box_type, "mdat", BOX_TYPE_BYTE) == 0){
+        push->state = DEMUX_PUSH_MDAT;
+    }else if(memcmp(push->box_type, "moov", BOX_TYPE_BYTE) == 0 && !push->moov_done){
+        if(box_size <= push->head_len || box_size > DEMUX_PUSH_MAX_META_BYTES){
+            printf("push moov size[%lu] error\n", box_size);
+            return -1;
+        }
+        if(demux_buf_init(&push->meta, box_size) < 0 || demux_buf_put(&push->meta, push->head, push->head_len) < 0){
+            return -1;
+        }
+        push->state = DEMUX_PUSH_BOX_BUFFER;
+    }else{
+        push->state = DEMUX_PUSH_BOX_SKIP;
+    }
+    push->head_len = 0;
+
+    /* 空box没有body, 直接收下一个box头 */
+    if(push->box_end == push->stream_offset && push->state != DEMUX_PUSH_BOX_BUFFER){
+        push->state = DEMUX_PUSH_BOX_HEAD;
+    }
+
+    return 0;
+}
+
+/* 返回0表示数据全部处理, -1表示出错, 出错后不能再喂数据 */
+int demux_feed(demux_push_t* push, const uint8_t* buf, uint32_t len){
+    uint64_t used = 0;
+    uint32_t need = 0;
+    int ret = 0;
+
+    if(push == NULL || (buf == NULL && len > 0)){
+        printf("push[%p] buf[%p] NULL\n", push, buf);
+        return -1;
+    }
+
+    while(len > 0 && ret >= 0){
+        switch(push->state){
+            case DEMUX_PUSH_BOX_HEAD:
+                /* size为1时头部还有8字节largesize */
+                need = BOX_HEAD_BYTE;
+                if(push->head_len >= BOX_SIZE_BYTE && demux_get_be32(push->head) == 1){
+                    need += BOX_LARGE_SZIE_BYTE;
+                }
+                used = need - push->head_len;
+                if(used > len){
+                    used = len;
+                }
+                memcpy(push->head + push->head_len, buf, used);
+                push->head_len += used;
+                push->stream_offset += used;
+                if(push->head_len == need && !(need == BOX_HEAD_BYTE && demux_get_be32(push->head) == 1)){
+                    ret = demux_push_box_head(push);
+                }
+                break;
+            case DEMUX_PUSH_BOX_BUFFER:
+                used = push->box_end - push->stream_offset;
+                if(used > len){
+                    used = len;
+                }
+                ret = demux_buf_put(&push->meta, buf, used);
+                push->stream_offset += used;
+                if(ret >= 0 && push->stream_offset == push->box_end){
+                    ret = demux_push_parse_moov(push);
+                    push->state = DEMUX_PUSH_BOX_HEAD;
+                }
+                break;
+            case DEMUX_PUSH_BOX_SKIP:
+            case DEMUX_PUSH_MDAT:
+                used = len;
+                if(push->box_end != 0 && push->box_end - push->stream_offset < used){
+                    used = push->box_end - push->stream_offset;
+                }
+                if(push->state == DEMUX_PUSH_MDAT){
+                    ret = demux_push_mdat_data(push, buf, used);
+                }
+                push->stream_offset += used;
+                if(push->box_end != 0 && push->stream_offset == push->box_end){
+                    push->state = DEMUX_PUSH_BOX_HEAD;
+                }
+                break;
+            default:
+                ret = -1;
+                break;
+        }
+        buf += used;
+        len -= used;
+    }
+
+    if(ret < 0){
+        push->state = DEMUX_PUSH_ERROR;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 输入结束, 检查box和sample是否都收齐 */
+int demux_feed_end(demux_push_t* push){
+    if(push == NULL || push->state == DEMUX_PUSH_ERROR){
+        return -1;
+    }
+
+    if(push->head_len > 0 || push->state == DEMUX_PUSH_BOX_BUFFER ||
+       (push->box_end != 0 && push->state != DEMUX_PUSH_BOX_HEAD)){
+        printf("push input truncated in %s box, offset[%lu]\n", push->box_type, push->stream_offset);
+        return -1;
+    }
+    if(!push->moov_done){
+        printf("push moov not found\n");
+        return -1;
+    }
+    if(push->next_packet < push->packet_count){
+        printf("push %u samples not received\n", push->packet_count - push->next_packet);
+        return -1;
+    }
+
+    printf("push %lu bytes, %lu packets\n", push->stream_offset, push->packet_emitted);
+
+    return 0;
+}
+
+demux_ctrl_t* demux_push_get_ctrl(demux_push_t* push){
+    return (push != NULL) ? push->demux_ctrl : NULL;
+}
+
+void demux_push_close(demux_push_t* push){
+    if(push == NULL){
+        return;
+    }
+
+    /* demux_ctrl的io指向meta, 先关demux_ctrl */
+    if(push->demux_ctrl != NULL){
+        demux_close(push->demux_ctrl);
+    }
+    demux_buf_free(&push->meta);
+    demux_buf_free(&push->pending);
+    demux_buf_free(&push->partial);
+    free(push->packets);
+    free(push);
+}
@@ -0,0 +1,66 @@
+#ifndef __DEMUX_PUSH_H
+#define __DEMUX_PUSH_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_box.h"
+#include "demux_packet.h"
+
+/*
+ * 推模式解析: 调用者收到多少数据就喂多少, 不阻塞也不需要seek, 适合epoll等事件循环
+ * moov收齐后解析sample表并回调track信息, mdat中的sample收齐一个回调一个(按文件中的顺序)
+ */
+
+#define DEMUX_PUSH_MAX_META_BYTES (64 * 1024 * 1024)     // moov等需要整块解析的box上限
+#define DEMUX_PUSH_MAX_PENDING_BYTES (256 * 1024 * 1024) // moov在mdat之后时需要暂存的mdat上限
+
+enum DEMUX_PUSH_STATE{
+    DEMUX_PUSH_BOX_HEAD,        // 收box头, 8或16字节
+    DEMUX_PUSH_BOX_BUFFER,      // 收完整的box(moov)再解析
+    DEMUX_PUSH_BOX_SKIP,        // 跳过不关心的box
+    DEMUX_PUSH_MDAT,            // mdat数据, 边收边输出sample
+    DEMUX_PUSH_ERROR
+};
+
+typedef struct demux_push_callback
+{
+    /* moov解析完后每个track回调一次 */
+    int (*on_track)(void* user, demux_ctrl_t* demux_ctrl, int track_index);
+    /* pkt->data只在回调中有效 */
+    int (*on_packet)(void* user, demux_packet_t* pkt);
+    void* user;
+}demux_push_callback_t;
+
+typedef struct demux_push
+{
+    demux_ctrl_t* demux_ctrl;
+    demux_push_callback_t callback;
+    int state;
+
+    uint64_t stream_offset;     // 下一个输入字节在文件中的位置
+    uint8_t head[BOX_HEAD_BYTE + BOX_LARGE_SZIE_BYTE];
+    uint32_t head_len;
+    char box_type[4 + 1];
+    uint64_t box_offset;
+    uint64_t box_end;           // 为0表示box延伸到输入结束(size为0)
+
+    demux_buf_t meta;           // 正在收的moov, 解析后作为demux_ctrl的输入保留
+    demux_buf_t pending;        // moov之前收到的mdat数据
+    uint64_t pending_offset;
+
+    int moov_done;
+    demux_packet_t* packets;    // 所有sample按文件偏移排序
+    uint32_t packet_count;
+    uint32_t next_packet;
+    demux_buf_t partial;        // 跨多次feed的sample
+
+    uint64_t packet_emitted;
+}demux_push_t;
+
+extern demux_push_t* demux_push_open(const demux_push_callback_t* callback);
+extern int demux_feed(demux_push_t* push, const uint8_t* buf, uint32_t len);
+extern int demux_feed_end(demux_push_t* push);
+extern demux_ctrl_t* demux_push_get_ctrl(demux_push_t* push);
+extern void demux_push_close(demux_push_t* push);
+
+#endif
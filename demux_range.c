@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "demux.h"
+#include "demux_range.h"
+
+typedef struct demux_fetch_file
+{
+    int fd;
+}demux_fetch_file_t;
+
+static int64_t demux_fetch_file_fetch(demux_fetch_t* fetch, uint64_t offset, uint8_t* buf, uint64_t len){
+    demux_fetch_file_t* file = (demux_fetch_file_t*)fetch->priv;
+    uint64_t read_len = 0;
+    ssize_t ret = 0;
+
+    while(read_len < len){
+        ret = pread(file->fd, buf + read_len, len - read_len, offset + read_len);
+        if(ret < 0){
+            printf("fetch pread failed, offset[%lu] len[%lu]\n", offset + read_len, len - read_len);
+            return -1;
+        }
+        if(ret == 0){
+            break;
+        }
+        read_len += ret;
+    }
+
+    return read_len;
+}
+
+static int64_t demux_fetch_file_size(demux_fetch_t* fetch){
+    demux_fetch_file_t* file = (demux_fetch_file_t*)fetch->priv;
+    struct stat st;
+
+    if(fstat(file->fd, &st) < 0){
+        printf("fstat failed\n");
+        return -1;
+    }
+
+    return st.st_size;
+}
+
+static void demux_fetch_file_close(demux_fetch_t* fetch){
+    demux_fetch_file_t* file = (demux_fetch_file_t*)fetch->priv;
+
+    close(file->fd);
+    free(file);
+}
+
+static const demux_fetch_ops_t demux_fetch_file_ops = {
+    .fetch = demux_fetch_file_fetch,
+    .size = demux_fetch_file_size,
+    .close = demux_fetch_file_close,
+};
+
+demux_fetch_t* demux_fetch_open_file(const char* file_path){
+    demux_fetch_t* fetch = NULL;
+    demux_fetch_file_t* file = NULL;
+
+    fetch = (demux_fetch_t*)calloc(1, sizeof(demux_fetch_t));
+    file = (demux_fetch_file_t*)calloc(1, sizeof(demux_fetch_file_t));
+    if(fetch == NULL || file == NULL){
+        printf("fetch[%p] file[%p] NULL\n", fetch, file);
+        goto err;
+    }
+
+    file->fd = open(file_path, O_RDONLY);
+    if(file->fd < 0){
+        printf("open %s failed\n", file_path);
+        goto err;
+    }
+
+    fetch->ops = &demux_fetch_file_ops;
+    fetch->priv = file;
+
+    return fetch;
+
+err:
+    free(file);
+    free(fetch);
+    return NULL;
+}
+
+int64_t demux_fetch_range(demux_fetch_t* fetch, uint64_t offset, uint8_t* buf, uint64_t len){
+    int64_t ret = fetch->ops->fetch(fetch, offset, buf, len);
+
+    fetch->request_count++;
+    if(ret > 0){
+        fetch->request_bytes += ret;
+    }
+
+    return ret;
+}
+
+void demux_fetch_close(demux_fetch_t* fetch){
+    if(fetch == NULL){
+        return;
+    }
+
+    printf("fetch %lu requests, %lu bytes\n", fetch->request_count, fetch->request_bytes);
+    fetch->ops->close(fetch);
+    free(fetch);
+}
+
+void demux_read_plan_init(demux_read_plan_t* plan, uint64_t gap_threshold, uint64_t max_request){
+    memset(plan, 0, sizeof(demux_read_plan_t));
+    plan->gap_threshold = gap_threshold;
+    plan->max_request = max_request ? max_request : DEMUX_RANGE_MAX_REQUEST;
+}
+
+void demux_read_plan_reset(demux_read_plan_t* plan){
+    plan->count = 0;
+}
+
+int demux_read_plan_add(demux_read_plan_t* plan, uint64_t offset, uint64_t len){
+    demux_range_t* ranges = NULL;
+
+    if(len == 0){
+        return 0;
+    }
+
+    /* 按顺序添加的相邻区间直接合并, sample表基本都是这种情况 */
+    if(plan->count > 0 && plan->ranges[plan->count - 1].offset + plan->ranges[plan->count - 1].len == offset){
+        plan->ranges[plan->count - 1].len += len;
+        return 0;
+    }
+
+    if(plan->count >= plan->cap){
+        plan->cap = plan->cap ? plan->cap * 2 : 1024;
+        ranges = (demux_range_t*)realloc(plan->ranges, plan->cap * sizeof(demux_range_t));
+        if(ranges == NULL){
+            printf("plan ranges realloc failed\n");
+            return -1;
+        }
+        plan->ranges = ranges;
+    }
+
+    plan->ranges[plan->count].offset = offset;
+    plan->ranges[plan->count].len = len;
+    plan->count++;
+
+    return 0;
+}
+
+static int demux_range_cmp(const void* a, const void* b){
+    const demux_range_t* range_a = (const demux_range_t*)a;
+    const demux_range_t* range_b = (const demux_range_t*)b;
+
+    if(range_a->offset == range_b->offset){
+        return 0;
+    }
+
+    return range_a->offset < range_b->offset ? -1 : 1;
+}
+
+/* 排序后合并重叠和间隔小于gap_threshold的区间, 超过max_request的拆开 */
+int demux_read_plan_build(demux_read_plan_t* plan){
+    demux_range_t* ranges = NULL;
+    demux_range_t* last = NULL;
+    uint64_t end = 0;
+    uint64_t len = 0;
+    uint32_t count = 0;
+    uint32_t cap = 0;
+    uint32_t i = 0;
+
+    if(plan->count == 0){
+        return 0;
+    }
+
+    qsort(plan->ranges, plan->count, sizeof(demux_range_t), demux_range_cmp);
+
+    for(i = 0;i < plan->count;i++){
+        end = plan->ranges[i].offset + plan->ranges[i].len;
+        if(count > 0 && plan->ranges[i].offset <= last->offset + last->len + plan->gap_threshold){
+            if(end > last->offset + last->len){
+                last->len = end - last->offset;
+            }
+            continue;
+        }
+        plan->ranges[count] = plan->ranges[i];
+        last = &plan->ranges[count++];
+    }
+
+    for(i = 0;i < count;i++){
+        cap += (plan->ranges[i].len + plan->max_request - 1) / plan->max_request;
+    }
+    ranges = (demux_range_t*)malloc(cap * sizeof(demux_range_t));
+    if(ranges == NULL){
+        printf("plan ranges NULL\n");
+        return -1;
+    }
+
+    plan->count = 0;
+    for(i = 0;i < count;i++){
+        for(end = 0;end < plan->ranges[i].len;end += len){
+            len = plan->ranges[i].len - end;
+            if(len > plan->max_request){
+                len = plan->max_request;
+            }
+            ranges[plan->count].offset = plan->ranges[i].offset + end;
+            ranges[plan->count].len = len;
+            plan->count++;
+        }
+    }
+
+    free(plan->ranges);
+    plan->ranges = ranges;
+    plan->cap = cap;
+
+    return 0;
+}
+
+const demux_range_t* demux_read_plan_find(demux_read_plan_t* plan, uint64_t offset){
+    uint32_t low = 0;
+    uint32_t high = plan->count;
+    uint32_t mid = 0;
+
+    while(low < high){
+        mid = low + (high - low) / 2;
+        if(offset < plan->ranges[mid].offset){
+            high = mid;
+        }else if(offset >= plan->ranges[mid].offset + plan->ranges[mid].len){
+            low = mid + 1;
+        }else{
+            return &plan->ranges[mid];
+        }
+    }
+
+    return NULL;
+}
+
+void demux_read_plan_free(demux_read_plan_t* plan){
+    free(plan->ranges);
+    plan->ranges = NULL;
+    plan->count = 0;
+    plan->cap = 0;
+}
+
+/* 未命中时取回包含offset的区间: 优先用读计划中合并好的区间, 否则按块对齐预读 */
+static demux_cache_block_t* demux_read_cache_load(demux_read_cache_t* cache, uint64_t offset){
+    demux_cache_block_t* block = &cache->block[0];
+    const demux_range_t* range = NULL;
+    uint64_t start = 0;
+    uint64_t len = 0;
+    uint8_t* data = NULL;
+    int64_t ret = 0;
+    int i = 0;
+
+    for(i = 1;i < DEMUX_RANGE_MAX_BLOCK;i++){
+        if(cache->block[i].last_use < block->last_use){
+            block = &cache->block[i];
+        }
+    }
+
+    range = demux_read_plan_find(&cache->plan, offset);
+    if(range != NULL){
+        start = range->offset;
+        len = range->len;
+    }else{
+        start = offset - offset % cache->block_bytes;
+        len = cache->block_bytes;
+    }
+    if(start + len > cache->file_size){
+        len = cache->file_size - start;
+    }
+
+    if(len > block->cap){
+        data = (uint8_t*)realloc(block->data, len);
+        if(data == NULL){
+            printf("cache block realloc failed, len[%lu]\n", len);
+            return NULL;
+        }
+        block->data = data;
+        block->cap = len;
+    }
+
+    ret = demux_fetch_range(cache->fetch, start, block->data, len);
+    if(ret <= 0){
+        block->len = 0;
+        block->last_use = 0;
+        return NULL;
+    }
+
+    block->offset = start;
+    block->len = ret;
+    cache->miss_count++;
+
+    return block;
+}
+
+static int64_t demux_read_cache_read_at(demux_io_t* io, uint64_t offset, uint8_t* buf, uint64_t len){
+    demux_read_cache_t* cache = (demux_read_cache_t*)io->priv;
+    demux_cache_block_t* block = NULL;
+    uint64_t read_len = 0;
+    uint64_t copy_len = 0;
+    int i = 0;
+
+    if(offset >= cache->file_size){
+        return 0;
+    }
+    if(len > cache->file_size - offset){
+        len = cache->file_size - offset;
+    }
+
+    /* WILLNEED之后第一次读时才合并区间 */
+    if(cache->plan_dirty){
+        if(demux_read_plan_build(&cache->plan) < 0){
+            return -1;
+        }
+        cache->plan_dirty = 0;
+        printf("read plan %u requests\n", cache->plan.count);
+    }
+
+    while(read_len < len){
+        block = NULL;
+        for(i = 0;i < DEMUX_RANGE_MAX_BLOCK;i++){
+            if(cache->block[i].len > 0 && offset >= cache->block[i].offset &&
+               offset < cache->block[i].offset + cache->block[i].len){
+                block = &cache->block[i];
+                cache->hit_count++;
+                break;
+            }
+        }
+        if(block == NULL){
+            block = demux_read_cache_load(cache, offset);
+            if(block == NULL){
+                return read_len > 0 ? (int64_t)read_len : -1;
+            }
+        }
+        block->last_use = ++cache->tick;
+
+        copy_len = block->offset + block->len - offset;
+        if(copy_len > len - read_len){
+            copy_len = len - read_len;
+        }
+        memcpy(buf + read_len, block->data + (offset - block->offset), copy_len);
+        read_len += copy_len;
+        offset += copy_len;
+    }
+
+    return read_len;
+}
+
+static int64_t demux_read_cache_size(demux_io_t* io){
+    demux_read_cache_t* cache = (demux_read_cache_t*)io->priv;
+
+    return cache->file_size;
+}
+
+/* 读计划通过hint传入: RESET清空, WILLNEED添加区间 */
+static int demux_read_cache_hint(demux_io_t* io, int hint, uint64_t offset, uint64_t len){
+    demux_read_cache_t* cache = (demux_read_cache_t*)io->priv;
+
+    if(hint == DEMUX_IO_HINT_RESET){
+        demux_read_plan_reset(&cache->plan);
+        cache->plan_dirty = 0;
+    }else if(hint == DEMUX_IO_HINT_WILLNEED){
+        if(demux_read_plan_add(&cache->plan, offset, len) < 0){
+            return -1;
+        }
+        cache->plan_dirty = 1;
+    }
+
+    return 0;
+}
+
+static void demux_read_cache_close(demux_io_t* io){
+    demux_read_cache_t* cache = (demux_read_cache_t*)io->priv;
+    int i = 0;
+
+    printf("read cache hit[%lu] miss[%lu]\n", cache->hit_count, cache->miss_count);
+    for(i = 0;i < DEMUX_RANGE_MAX_BLOCK;i++){
+        free(cache->block[i].data);
+    }
+    demux_read_plan_free(&cache->plan);
+    demux_fetch_close(cache->fetch);
+    free(cache);
+}
+
+static const demux_io_ops_t demux_read_cache_ops = {
+    .read_at = demux_read_cache_read_at,
+    .size = demux_read_cache_size,
+    .hint = demux_read_cache_hint,
+    .close = demux_read_cache_close,
+};
+
+/* fetch后端加读缓存作为demux的输入, io关闭时fetch一起关闭 */
+demux_io_t* demux_io_open_fetch(demux_fetch_t* fetch, uint64_t gap_threshold, uint64_t max_request){
+    demux_read_cache_t* cache = NULL;
+    demux_io_t* io = NULL;
+    int64_t file_size = 0;
+
+    if(fetch == NULL){
+        printf("fetch NULL\n");
+        return NULL;
+    }
+
+    file_size = fetch->ops->size(fetch);
+    if(file_size < 0){
+        return NULL;
+    }
+
+    cache = (demux_read_cache_t*)calloc(1, sizeof(demux_read_cache_t));
+    if(cache == NULL){
+        printf("read cache NULL\n");
+        return NULL;
+    }
+
+    cache->fetch = fetch;
+    cache->file_size = file_size;
+    cache->block_bytes = DEMUX_RANGE_BLOCK_BYTES;
+    demux_read_plan_init(&cache->plan, gap_threshold, max_request);
+
+    io = demux_io_open(&demux_read_cache_ops, cache, -1, NULL);
+    if(io == NULL){
+        demux_read_plan_free(&cache->plan);
+        free(cache);
+    }
+
+    return io;
+}
@@ -0,0 +1,88 @@
+#ifndef __DEMUX_RANGE_H
+#define __DEMUX_RANGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "demux_io.h"
+
+/*
+ * 远端输入(对象存储/http range请求)的读取:
+ * fetch后端按区间取数据, 读计划把sample表中相邻的区间合并成大请求, 取回的数据放进读缓存
+ */
+
+#define DEMUX_RANGE_GAP_THRESHOLD (256 * 1024)       // 间隔小于该值的区间合并, 中间的数据一起读回
+#define DEMUX_RANGE_MAX_REQUEST (8 * 1024 * 1024)    // 单次请求的最大长度
+#define DEMUX_RANGE_BLOCK_BYTES (256 * 1024)         // 不在读计划中的读取按块预读
+#define DEMUX_RANGE_MAX_BLOCK 8
+
+typedef struct demux_fetch demux_fetch_t;
+
+typedef struct demux_fetch_ops
+{
+    /* 读[offset, offset + len), 返回读到的长度 */
+    int64_t (*fetch)(demux_fetch_t* fetch, uint64_t offset, uint8_t* buf, uint64_t len);
+    int64_t (*size)(demux_fetch_t* fetch);
+    void (*close)(demux_fetch_t* fetch);
+}demux_fetch_ops_t;
+
+struct demux_fetch
+{
+    const demux_fetch_ops_t* ops;
+    void* priv;
+    uint64_t request_count;
+    uint64_t request_bytes;
+};
+
+typedef struct demux_range
+{
+    uint64_t offset;
+    uint64_t len;
+}demux_range_t;
+
+typedef struct demux_read_plan
+{
+    demux_range_t* ranges;
+    uint32_t count;
+    uint32_t cap;
+    uint64_t gap_threshold;
+    uint64_t max_request;
+}demux_read_plan_t;
+
+typedef struct demux_cache_block
+{
+    uint64_t offset;
+    uint64_t len;
+    uint64_t cap;
+    uint8_t* data;
+    uint64_t last_use;
+}demux_cache_block_t;
+
+/* 读缓存, 作为demux_io后端使用, 不是线程安全的 */
+typedef struct demux_read_cache
+{
+    demux_fetch_t* fetch;
+    demux_read_plan_t plan;     // 未命中时按计划中的区间取数据
+    demux_cache_block_t block[DEMUX_RANGE_MAX_BLOCK];
+    uint64_t block_bytes;
+    uint64_t file_size;
+    int plan_dirty;
+    uint64_t tick;
+    uint64_t hit_count;
+    uint64_t miss_count;
+}demux_read_cache_t;
+
+/* 本地文件模拟的fetch后端, 每次fetch计为一次请求 */
+extern demux_fetch_t* demux_fetch_open_file(const char* file_path);
+extern int64_t demux_fetch_range(demux_fetch_t* fetch, uint64_t offset, uint8_t* buf, uint64_t len);
+extern void demux_fetch_close(demux_fetch_t* fetch);
+
+extern void demux_read_plan_init(demux_read_plan_t* plan, uint64_t gap_threshold, uint64_t max_request);
+extern void demux_read_plan_reset(demux_read_plan_t* plan);
+extern int demux_read_plan_add(demux_read_plan_t* plan, uint64_t offset, uint64_t len);
+extern int demux_read_plan_build(demux_read_plan_t* plan);
+extern const demux_range_t* demux_read_plan_find(demux_read_plan_t* plan, uint64_t offset);
+extern void demux_read_plan_free(demux_read_plan_t* plan);
+
+extern demux_io_t* demux_io_open_fetch(demux_fetch_t* fetch, uint64_t gap_threshold, uint64_t max_request);
+
+#endif
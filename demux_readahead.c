@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include "demux_io.h"
+#include "demux_readahead.h"
+
+demux_readahead_t* demux_readahead_open(int fd){
+    demux_readahead_t* readahead = NULL;
+
+    readahead = (demux_readahead_t*)calloc(1, sizeof(demux_readahead_t));
+    if(readahead == NULL){
+        printf("readahead NULL\n");
+        return NULL;
+    }
+
+    readahead->fd = fd;
+    readahead->window = DEMUX_READAHEAD_WINDOW;
+    readahead->drop_consumed = 1;
+    readahead->consumed_offset = UINT64_MAX;
+    demux_read_plan_init(&readahead->plan, DEMUX_READAHEAD_GAP, DEMUX_READAHEAD_MAX_RANGE);
+
+    return readahead;
+}
+
+void demux_readahead_set_window(demux_readahead_t* readahead, uint64_t window, int drop_consumed){
+    readahead->window = window;
+    readahead->drop_consumed = drop_consumed;
+}
+
+static void demux_readahead_advise(demux_readahead_t* readahead, const demux_range_t* range, int advice){
+    if(posix_fadvise(readahead->fd, range->offset, range->len, advice) != 0){
+        return;
+    }
+
+    if(advice == POSIX_FADV_WILLNEED){
+        readahead->willneed_calls++;
+        readahead->willneed_bytes += range->len;
+    }else{
+        readahead->dontneed_calls++;
+        readahead->dontneed_bytes += range->len;
+    }
+}
+
+/* 读计划通过hint传入, 和远端读缓存共用同一套RESET/WILLNEED */
+int demux_readahead_hint(demux_readahead_t* readahead, int hint, uint64_t offset, uint64_t len){
+    demux_range_t range = {offset, len};
+
+    switch(hint){
+        case DEMUX_IO_HINT_RESET:
+            demux_read_plan_reset(&readahead->plan);
+            readahead->plan_dirty = 0;
+            readahead->advise_index = 0;
+            readahead->drop_index = 0;
+            readahead->consumed_offset = UINT64_MAX;
+            break;
+        case DEMUX_IO_HINT_WILLNEED:
+            if(demux_read_plan_add(&readahead->plan, offset, len) < 0){
+                return -1;
+            }
+            readahead->plan_dirty = 1;
+            break;
+        case DEMUX_IO_HINT_SEQUENTIAL:
+            posix_fadvise(readahead->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            break;
+        case DEMUX_IO_HINT_DONTNEED:
+            demux_readahead_advise(readahead, &range, POSIX_FADV_DONTNEED);
+            break;
+        case DEMUX_IO_HINT_CONSUMED:
+            readahead->consumed_offset = offset;
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/* 第一个结束位置在offset之后的区间 */
+static uint32_t demux_readahead_lower_bound(demux_readahead_t* readahead, uint64_t offset){
+    const demux_range_t* ranges = readahead->plan.ranges;
+    uint32_t low = 0;
+    uint32_t high = readahead->plan.count;
+    uint32_t mid = 0;
+
+    while(low < high){
+        mid = low + (high - low) / 2;
+        if(ranges[mid].offset + ranges[mid].len <= offset){
+            low = mid + 1;
+        }else{
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/* 即将读[offset, offset + len): 推进预读窗口, 丢掉已经读过的区间 */
+void demux_readahead_access(demux_readahead_t* readahead, uint64_t offset, uint64_t len){
+    demux_range_t* ranges = NULL;
+    uint32_t index = 0;
+    uint32_t drop_limit = 0;
+
+    if(readahead == NULL || readahead->window == 0){
+        return;
+    }
+    if(readahead->plan_dirty){
+        if(demux_read_plan_build(&readahead->plan) < 0){
+            demux_read_plan_reset(&readahead->plan);
+        }
+        readahead->plan_dirty = 0;
+        readahead->advise_index = 0;
+        readahead->drop_index = 0;
+    }
+    if(readahead->plan.count == 0){
+        return;
+    }
+
+    ranges = readahead->plan.ranges;
+    index = demux_readahead_lower_bound(readahead, offset);
+
+    /*
+     * 多个track交织读取时位置会小幅往回跳, 落在已经预读的区间内时不重新预读
+     * 读到已经DONTNEED的区间才算往回seek, 从新位置重新预读; 往前跳过的区间不再需要预读
+     */
+    if(index < readahead->drop_index){
+        readahead->drop_index = index;
+        readahead->advise_index = index;
+    }else if(index > readahead->advise_index){
+        readahead->advise_index = index;
+    }
+
+    /* 只丢弃当前位置和所有读取者都已经读过的区间 */
+    drop_limit = index;
+    if(readahead->consumed_offset != UINT64_MAX && demux_readahead_lower_bound(readahead, readahead->consumed_offset) < drop_limit){
+        drop_limit = demux_readahead_lower_bound(readahead, readahead->consumed_offset);
+    }
+    while(readahead->drop_consumed && readahead->drop_index < drop_limit){
+        demux_readahead_advise(readahead, &ranges[readahead->drop_index++], POSIX_FADV_DONTNEED);
+    }
+
+    while(readahead->advise_index < readahead->plan.count &&
+          ranges[readahead->advise_index].offset < offset + len + readahead->window){
+        demux_readahead_advise(readahead, &ranges[readahead->advise_index++], POSIX_FADV_WILLNEED);
+    }
+}
+
+void demux_readahead_close(demux_readahead_t* readahead){
+    if(readahead == NULL){
+        return;
+    }
+
+    if(readahead->willneed_calls > 0 || readahead->dontneed_calls > 0){
+        printf("readahead willneed %lu calls %lu bytes, dontneed %lu calls %lu bytes\n",
+            readahead->willneed_calls, readahead->willneed_bytes, readahead->dontneed_calls, readahead->dontneed_bytes);
+    }
+    demux_read_plan_free(&readahead->plan);
+    free(readahead);
+}
@@ -0,0 +1,41 @@
+#ifndef __DEMUX_READAHEAD_H
+#define __DEMUX_READAHEAD_H
+
+#include <stdint.h>
+#include "demux_range.h"
+
+/*
+ * 本地文件的页缓存提示: sample表建好后就知道之后要读哪些区间
+ * 读到哪里就对读计划中之后window字节内的区间posix_fadvise(WILLNEED), 已经读过的区间DONTNEED
+ * 大文件批处理时不把同机其它服务的热数据挤出页缓存, seek之后的第一次读也不用等冷IO
+ */
+
+#define DEMUX_READAHEAD_WINDOW (4 * 1024 * 1024)     // 默认预读窗口
+#define DEMUX_READAHEAD_GAP (128 * 1024)            // 间隔小于该值的区间合并成一次提示
+#define DEMUX_READAHEAD_MAX_RANGE (1024 * 1024)     // 大区间拆开, 窗口按这个粒度推进
+
+typedef struct demux_readahead
+{
+    int fd;
+    demux_read_plan_t plan;
+    int plan_dirty;
+    uint64_t window;            // 为0时不做提示
+    int drop_consumed;          // 读过的区间是否DONTNEED
+
+    uint32_t advise_index;      // 下一个还没有WILLNEED的区间
+    uint32_t drop_index;        // 下一个还没有DONTNEED的区间
+    uint64_t consumed_offset;   // 之前的数据可以DONTNEED, 没有CONSUMED提示时为UINT64_MAX(按读取位置丢弃)
+
+    uint64_t willneed_calls;
+    uint64_t willneed_bytes;
+    uint64_t dontneed_calls;
+    uint64_t dontneed_bytes;
+}demux_readahead_t;
+
+extern demux_readahead_t* demux_readahead_open(int fd);
+extern void demux_readahead_set_window(demux_readahead_t* readahead, uint64_t window, int drop_consumed);
+extern int demux_readahead_hint(demux_readahead_t* readahead, int hint, uint64_t offset, uint64_t len);
+extern void demux_readahead_access(demux_readahead_t* readahead, uint64_t offset, uint64_t len);
+extern void demux_readahead_close(demux_readahead_t* readahead);
+
+#endif
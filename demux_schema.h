@@ -0,0 +1,130 @@
+#ifndef __DEMUX_SCHEMA_H
+#define __DEMUX_SCHEMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "demux_box.h"
+
+/*
+ * 定长box的字段表: 每个box的磁盘布局只写一次(X-macro), 由DEMUX_SCHEMA_DEFINE生成
+ *   box_v0_raw_t/box_v1_raw_t  全是uint8_t数组的结构体, 和磁盘布局一一对应(没有对齐填充), offsetof就是字段偏移
+ *   box_t                      解出来的字段, 时间等按最宽的类型保存
+ *   box_decode_v0/box_decode_v1 定长部分整块读入后按常量偏移取大端数
+ * 字段表中 F(字段, 类型, v0字节数, v1字节数) 为要解出的字段, R(字段, v0字节数, v1字节数) 为跳过的字段
+ * 没有version的box两列写成一样, 只用v0
+ */
+
+static inline uint64_t demux_schema_be(const uint8_t* p, uint32_t size){
+    /* size在每个调用处都是常量, 内联后只剩一次load和bswap */
+    switch(size){
+        case 1:
+            return p[0];
+        case 2:
+            return demux_get_be16(p);
+        case 4:
+            return demux_get_be32(p);
+        case 8:
+            return demux_get_be64(p);
+        default:
+            return 0;
+    }
+}
+
+#define DEMUX_SCHEMA_RAW_V0(name, type, v0, v1) uint8_t name[v0];
+#define DEMUX_SCHEMA_RAW_V1(name, type, v0, v1) uint8_t name[v1];
+#define DEMUX_SCHEMA_RESERVED_V0(name, v0, v1) uint8_t name[v0];
+#define DEMUX_SCHEMA_RESERVED_V1(name, v0, v1) uint8_t name[v1];
+#define DEMUX_SCHEMA_VALUE(name, type, v0, v1) type name;
+#define DEMUX_SCHEMA_SKIP(name, v0, v1)
+#define DEMUX_SCHEMA_LOAD_V0(name, type, v0, v1) out->name = (type)demux_schema_be(data + offsetof(demux_schema_raw_t, name), v0);
+#define DEMUX_SCHEMA_LOAD_V1(name, type, v0, v1) out->name = (type)demux_schema_be(data + offsetof(demux_schema_raw_t, name), v1);
+
+#define DEMUX_SCHEMA_DEFINE(box, LAYOUT) \
+    typedef struct box##_v0_raw { LAYOUT(DEMUX_SCHEMA_RAW_V0, DEMUX_SCHEMA_RESERVED_V0) } box##_v0_raw_t; \
+    typedef struct box##_v1_raw { LAYOUT(DEMUX_SCHEMA_RAW_V1, DEMUX_SCHEMA_RESERVED_V1) } box##_v1_raw_t; \
+    typedef struct box { LAYOUT(DEMUX_SCHEMA_VALUE, DEMUX_SCHEMA_SKIP) } box##_t; \
+    static inline void box##_decode_v0(const uint8_t* data, box##_t* out){ \
+        typedef box##_v0_raw_t demux_schema_raw_t; \
+        LAYOUT(DEMUX_SCHEMA_LOAD_V0, DEMUX_SCHEMA_SKIP) \
+    } \
+    static inline void box##_decode_v1(const uint8_t* data, box##_t* out){ \
+        typedef box##_v1_raw_t demux_schema_raw_t; \
+        LAYOUT(DEMUX_SCHEMA_LOAD_V1, DEMUX_SCHEMA_SKIP) \
+    }
+
+/* 以下为full box时不含version和flags */
+
+#define DEMUX_MVHD_LAYOUT(F, R) \
+    F(creation_time, uint64_t, 4, 8) \
+    F(modification_time, uint64_t, 4, 8) \
+    F(timescale, uint32_t, 4, 4) \
+    F(duration, uint64_t, 4, 8) \
+    F(rate, uint32_t, 4, 4) \
+    F(volume, uint16_t, 2, 2) \
+    R(reserved, 10, 10) \
+    R(matrix, 36, 36) \
+    R(pre_defined, 24, 24) \
+    F(next_track_id, uint32_t, 4, 4)
+
+#define DEMUX_TKHD_LAYOUT(F, R) \
+    F(creation_time, uint64_t, 4, 8) \
+    F(modification_time, uint64_t, 4, 8) \
+    F(track_id, uint32_t, 4, 4) \
+    R(reserved0, 4, 4) \
+    F(duration, uint64_t, 4, 8) \
+    R(reserved1, 8, 8) \
+    F(layer, uint16_t, 2, 2) \
+    F(alternate_group, uint16_t, 2, 2) \
+    F(volume, uint16_t, 2, 2) \
+    R(reserved2, 2, 2) \
+    R(matrix, 36, 36) \
+    F(track_width, uint32_t, 4, 4) \
+    F(track_height, uint32_t, 4, 4)
+
+#define DEMUX_MDHD_LAYOUT(F, R) \
+    F(creation_time, uint64_t, 4, 8) \
+    F(modification_time, uint64_t, 4, 8) \
+    F(timescale, uint32_t, 4, 4) \
+    F(duration, uint64_t, 4, 8) \
+    F(language, uint16_t, 2, 2) \
+    F(quality, uint16_t, 2, 2)
+
+/* VisualSampleEntry, 后面跟avcC等子box */
+#define DEMUX_AVC1_LAYOUT(F, R) \
+    R(reserved, 6, 6) \
+    F(data_reference_index, uint16_t, 2, 2) \
+    F(version, uint16_t, 2, 2) \
+    F(revision_level, uint16_t, 2, 2) \
+    F(vendor, uint32_t, 4, 4) \
+    F(temporal_quality, uint32_t, 4, 4) \
+    F(spatial_quality, uint32_t, 4, 4) \
+    F(width, uint16_t, 2, 2) \
+    F(height, uint16_t, 2, 2) \
+    F(horizontal_resolution, uint32_t, 4, 4) \
+    F(vertical_resolution, uint32_t, 4, 4) \
+    F(data_size, uint32_t, 4, 4) \
+    F(frame_count, uint16_t, 2, 2) \
+    R(compressor_name, 32, 32) \
+    F(depth, uint16_t, 2, 2) \
+    F(color_table_id, uint16_t, 2, 2)
+
+/* SoundSampleEntry, quicktime的version 1/2在后面另有字段, 由解析函数跳过 */
+#define DEMUX_MP4A_LAYOUT(F, R) \
+    R(reserved, 6, 6) \
+    F(data_reference_index, uint16_t, 2, 2) \
+    F(version, uint16_t, 2, 2) \
+    F(revision_level, uint16_t, 2, 2) \
+    F(vendor, uint32_t, 4, 4) \
+    F(channel_count, uint16_t, 2, 2) \
+    F(sample_size, uint16_t, 2, 2) \
+    F(compression_id, uint16_t, 2, 2) \
+    F(packet_size, uint16_t, 2, 2) \
+    F(sample_rate, uint32_t, 4, 4)
+
+DEMUX_SCHEMA_DEFINE(demux_mvhd, DEMUX_MVHD_LAYOUT)
+DEMUX_SCHEMA_DEFINE(demux_tkhd, DEMUX_TKHD_LAYOUT)
+DEMUX_SCHEMA_DEFINE(demux_mdhd, DEMUX_MDHD_LAYOUT)
+DEMUX_SCHEMA_DEFINE(demux_avc1, DEMUX_AVC1_LAYOUT)
+DEMUX_SCHEMA_DEFINE(demux_mp4a, DEMUX_MP4A_LAYOUT)
+
+#endif
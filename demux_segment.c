@@ -0,0 +1,730 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "demux.h"
+#include "demux_box.h"
+#include "demux_copy.h"
+#include "demux_packet.h"
+#include "demux_faststart.h"
+#include "demux_segment.h"
+
+/* trun中的sample_flags */
+#define DEMUX_SEGMENT_SYNC_FLAGS 0x02000000        // sample_depends_on = 2
+#define DEMUX_SEGMENT_NON_SYNC_FLAGS 0x01010000    // sample_depends_on = 1, sample_is_non_sync_sample
+
+/* trun flags: data_offset, duration, size, flags, 有非0的cts时加composition offset */
+#define DEMUX_SEGMENT_TRUN_FLAGS 0x000701
+#define DEMUX_SEGMENT_TRUN_CTS 0x000800
+
+typedef struct demux_segment_ctx
+{
+    demux_ctrl_t* demux_ctrl;
+    demux_segment_track_t track[DEMUX_MAX_TRACK_NUM];
+    int ref_track;              // 按这个track的关键帧切
+    uint32_t movie_timescale;
+    uint64_t movie_duration;    // movie timescale
+    double* bounds;             // 每个分片的起始时间
+    demux_segment_info_t* segments;
+    uint32_t segment_count;
+    const char* out_dir;
+}demux_segment_ctx_t;
+
+static int demux_segment_add_sample(demux_segment_track_t* seg_track, demux_packet_t* pkt){
+    demux_cut_sample_t* samples = NULL;
+    demux_cut_sample_t* sample = NULL;
+
+    if(seg_track->sample_count >= seg_track->sample_cap){
+        seg_track->sample_cap = seg_track->sample_cap ? seg_track->sample_cap * 2 : 256;
+        samples = (demux_cut_sample_t*)realloc(seg_track->samples, seg_track->sample_cap * sizeof(demux_cut_sample_t));
+        if(samples == NULL){
+            printf("segment samples realloc failed\n");
+            return -1;
+        }
+        seg_track->samples = samples;
+    }
+
+    if(seg_track->sample_count == 0){
+        seg_track->next_dts = pkt->dts;
+    }
+    sample = &seg_track->samples[seg_track->sample_count++];
+    sample->offset = pkt->offset;
+    sample->size = pkt->size;
+    sample->duration = pkt->duration;
+    sample->cts_offset = pkt->pts - pkt->dts;
+    sample->keyframe = pkt->keyframe;
+
+    return 0;
+}
+
+static int demux_segment_collect(demux_segment_ctx_t* ctx){
+    demux_packet_reader_t reader;
+    demux_packet_t pkt;
+    int ret = 0;
+
+    if(demux_packet_reader_init(&reader, ctx->demux_ctrl, DEMUX_PACKET_ALL_TRACK) < 0){
+        return -1;
+    }
+    while(demux_read_packet_info(&reader, &pkt) > 0){
+        if(demux_segment_add_sample(&ctx->track[pkt.track_index], &pkt) < 0){
+            ret = -1;
+            break;
+        }
+    }
+    demux_packet_reader_close(&reader);
+
+    return ret;
+}
+
+/* 参考track上距上一个切点不少于target_duration的关键帧作为新切点 */
+static int demux_segment_plan(demux_segment_ctx_t* ctx, double target_duration){
+    demux_segment_track_t* ref = &ctx->track[ctx->ref_track];
+    video_ctrl_t* track = ref->track;
+    int64_t dts = ref->next_dts;
+    double time = 0;
+    uint32_t cap = 0;
+    uint32_t i = 0;
+
+    cap = ref->sample_count + 1;
+    ctx->bounds = (double*)calloc(cap, sizeof(double));
+    ctx->segments = (demux_segment_info_t*)calloc(cap, sizeof(demux_segment_info_t));
+    if(ctx->bounds == NULL || ctx->segments == NULL){
+        printf("segment bounds NULL\n");
+        return -1;
+    }
+
+    for(i = 0;i < ref->sample_count;i++){
+        time = (double)dts / track->timescale;
+        if(i == 0 || (ref->samples[i].keyframe && time - ctx->bounds[ctx->segment_count - 1] >= target_duration)){
+            ctx->bounds[ctx->segment_count++] = time;
+        }
+        dts += ref->samples[i].duration;
+    }
+    /* 最后一个分片的结束时间 */
+    ctx->bounds[ctx->segment_count] = (double)dts / track->timescale;
+
+    for(i = 0;i < ctx->segment_count;i++){
+        ctx->segments[i].start = ctx->bounds[i];
+        ctx->segments[i].duration = ctx->bounds[i + 1] - ctx->bounds[i];
+    }
+
+    return 0;
+}
+
+static void demux_segment_write_stbl(const uint8_t* data, uint64_t len, demux_buf_t* out){
+    demux_box_info_t box;
+    uint64_t box_start = 0;
+    uint64_t pos = 0;
+
+    /* sample都在分片中, stbl中只留stsd和空表 */
+    box_start = demux_buf_box_begin(out, "stbl");
+    if(demux_box_find(data, len, "stsd", &box) > 0){
+        demux_buf_put(out, data + box.offset, box.size);
+    }
+    pos = demux_buf_full_box_begin(out, "stts", 0, 0);
+    demux_buf_put_u32(out, 0);
+    demux_buf_box_end(out, pos);
+    pos = demux_buf_full_box_begin(out, "stsc", 0, 0);
+    demux_buf_put_u32(out, 0);
+    demux_buf_box_end(out, pos);
+    pos = demux_buf_full_box_begin(out, "stsz", 0, 0);
+    demux_buf_put_u32(out, 0);
+    demux_buf_put_u32(out, 0);
+    demux_buf_box_end(out, pos);
+    pos = demux_buf_full_box_begin(out, "stco", 0, 0);
+    demux_buf_put_u32(out, 0);
+    demux_buf_box_end(out, pos);
+    demux_buf_box_end(out, box_start);
+}
+
+/* trak中tkhd的track_id: v0在12, v1在20, 找不到返回0 */
+static uint32_t demux_segment_trak_id(const uint8_t* data, uint64_t len){
+    demux_box_info_t tkhd;
+    const uint8_t* body = NULL;
+    uint64_t body_size = 0;
+
+    if(demux_box_find(data, len, "tkhd", &tkhd) <= 0){
+        return 0;
+    }
+    body = data + tkhd.offset + tkhd.header_size;
+    body_size = tkhd.size - tkhd.header_size;
+    if(body_size < 16 || (body[0] == 1 && body_size < 24)){
+        return 0;
+    }
+
+    return demux_get_be32(body + (body[0] == 1 ? 20 : 12));
+}
+
+/* 只保留track_id对应的trak */
+static int demux_segment_write_box(demux_segment_ctx_t* ctx, const uint8_t* data, uint64_t len, uint32_t track_id, demux_buf_t* out){
+    demux_box_info_t box;
+    const uint8_t* body = NULL;
+    uint64_t body_size = 0;
+    uint64_t box_start = 0;
+    uint64_t mvex_start = 0;
+    uint64_t child_start = 0;
+    uint64_t pos = 0;
+    int ret = 0;
+
+    while((ret = demux_box_next(data, len, &pos, &box)) > 0){
+        body = data + box.offset + box.header_size;
+        body_size = box.size - box.header_size;
+
+        if(memcmp(box.type, "trak", 4) == 0 && demux_segment_trak_id(body, body_size) != track_id){
+            continue;
+        }
+        if(memcmp(box.type, "moov", 4) == 0 || memcmp(box.type, "trak", 4) == 0 ||
+           memcmp(box.type, "mdia", 4) == 0 || memcmp(box.type, "minf", 4) == 0){
+            box_start = demux_buf_box_begin(out, box.type);
+            if(demux_segment_write_box(ctx, body, body_size, track_id, out) < 0){
+                return -1;
+            }
+
+            /* moov的最后加上mvex, 声明这是fragmented文件 */
+            if(memcmp(box.type, "moov", 4) == 0){
+                mvex_start = demux_buf_box_begin(out, "mvex");
+                child_start = demux_buf_full_box_begin(out, "mehd", 1, 0);
+                demux_buf_put_u64(out, ctx->movie_duration);
+                demux_buf_box_end(out, child_start);
+                child_start = demux_buf_full_box_begin(out, "trex", 0, 0);
+                demux_buf_put_u32(out, track_id);
+                demux_buf_put_u32(out, 1);
+                demux_buf_put_u32(out, 0);
+                demux_buf_put_u32(out, 0);
+                demux_buf_put_u32(out, 0);
+                demux_buf_box_end(out, child_start);
+                demux_buf_box_end(out, mvex_start);
+            }
+            demux_buf_box_end(out, box_start);
+        }else if(memcmp(box.type, "stbl", 4) == 0){
+            demux_segment_write_stbl(body, body_size, out);
+        }else{
+            demux_buf_put(out, data + box.offset, box.size);
+        }
+    }
+
+    return out->error ? -1 : ret;
+}
+
+static int demux_segment_write_file(const char* path, const uint8_t* data, uint64_t len){
+    FILE* fp = fopen(path, "wb");
+    int ret = 0;
+
+    if(fp == NULL){
+        printf("open %s failed\n", path);
+        return -1;
+    }
+    if(fwrite(data, 1, len, fp) != len){
+        printf("write %s failed\n", path);
+        ret = -1;
+    }
+    fclose(fp);
+
+    return ret;
+}
+
+/* init分片: ftyp + 只含一个trak且去掉sample表的moov + mvex */
+static int demux_segment_write_init(demux_segment_ctx_t* ctx, int t, const uint8_t* moov, uint64_t moov_len){
+    uint32_t track_id = ctx->track[t].track->track_id;
+    char path[DEMUX_SEGMENT_PATH_LENGTH];
+    demux_buf_t out;
+    uint64_t box_start = 0;
+    int ret = -1;
+
+    if(demux_buf_init(&out, moov_len + 64) < 0){
+        return -1;
+    }
+
+    box_start = demux_buf_box_begin(&out, "ftyp");
+    demux_buf_put(&out, "iso6", 4);
+    demux_buf_put_u32(&out, 0);
+    demux_buf_put(&out, "iso6cmfcdashmp41", 16);
+    demux_buf_box_end(&out, box_start);
+
+    if(demux_segment_write_box(ctx, moov, moov_len, track_id, &out) >= 0){
+        snprintf(path, sizeof(path), "%s/" DEMUX_SEGMENT_INIT_FORMAT, ctx->out_dir, track_id);
+        ret = demux_segment_write_file(path, out.data, out.len);
+    }
+    demux_buf_free(&out);
+
+    return ret;
+}
+
+/* 一个track的一个分片: moof + mdat, 原文件中连续的sample合并成一次拷贝 */
+static int demux_segment_write_one(demux_segment_ctx_t* ctx, uint32_t index, int t, int in_fd){
+    demux_ctrl_t* demux_ctrl = ctx->demux_ctrl;
+    demux_segment_track_t* seg_track = &ctx->track[t];
+    demux_cut_sample_t* sample = NULL;
+    char path[DEMUX_SEGMENT_PATH_LENGTH];
+    uint8_t mdat_head[16] = {0};
+    uint32_t mdat_head_len = 8;
+    demux_copy_t copy;
+    demux_buf_t moof;
+    uint64_t moof_start = 0;
+    uint64_t traf_start = 0;
+    uint64_t box_start = 0;
+    uint64_t offset_pos = 0;
+    uint64_t data_size = 0;
+    uint64_t range_offset = 0;
+    uint64_t range_size = 0;
+    uint32_t trun_flags = DEMUX_SEGMENT_TRUN_FLAGS;
+    uint32_t end = seg_track->next_sample;
+    uint32_t i = 0;
+    double end_time = ctx->bounds[index + 1];
+    int64_t dts = seg_track->next_dts;
+    int out_fd = -1;
+    int ret = -1;
+
+    if(demux_buf_init(&moof, 4096) < 0){
+        return -1;
+    }
+    memset(&copy, 0, sizeof(demux_copy_t));
+
+    /* 最后一个分片带上所有剩下的sample */
+    while(end < seg_track->sample_count &&
+          (index + 1 == ctx->segment_count || (double)dts / seg_track->track->timescale < end_time)){
+        dts += seg_track->samples[end].duration;
+        end++;
+    }
+    for(i = seg_track->next_sample;i < end;i++){
+        if(seg_track->samples[i].cts_offset != 0){
+            trun_flags |= DEMUX_SEGMENT_TRUN_CTS;
+            break;
+        }
+    }
+
+    moof_start = demux_buf_box_begin(&moof, "moof");
+    box_start = demux_buf_full_box_begin(&moof, "mfhd", 0, 0);
+    demux_buf_put_u32(&moof, index + 1);
+    demux_buf_box_end(&moof, box_start);
+
+    /* 这个时间段内没有sample时也写traf, tfdt保持连续 */
+    traf_start = demux_buf_box_begin(&moof, "traf");
+    box_start = demux_buf_full_box_begin(&moof, "tfhd", 0, 0x020000);    // default-base-is-moof
+    demux_buf_put_u32(&moof, seg_track->track->track_id);
+    demux_buf_box_end(&moof, box_start);
+
+    box_start = demux_buf_full_box_begin(&moof, "tfdt", 1, 0);
+    demux_buf_put_u64(&moof, seg_track->next_dts);
+    demux_buf_box_end(&moof, box_start);
+
+    box_start = demux_buf_full_box_begin(&moof, "trun", 1, trun_flags);
+    demux_buf_put_u32(&moof, end - seg_track->next_sample);
+    offset_pos = moof.len;
+    demux_buf_put_u32(&moof, 0);
+    for(i = seg_track->next_sample;i < end;i++){
+        sample = &seg_track->samples[i];
+        demux_buf_put_u32(&moof, sample->duration);
+        demux_buf_put_u32(&moof, sample->size);
+        demux_buf_put_u32(&moof, sample->keyframe ? DEMUX_SEGMENT_SYNC_FLAGS : DEMUX_SEGMENT_NON_SYNC_FLAGS);
+        if(trun_flags & DEMUX_SEGMENT_TRUN_CTS){
+            demux_buf_put_u32(&moof, (uint32_t)sample->cts_offset);
+        }
+        data_size += sample->size;
+    }
+    demux_buf_box_end(&moof, box_start);
+    demux_buf_box_end(&moof, traf_start);
+    demux_buf_box_end(&moof, moof_start);
+    if(moof.error){
+        goto end;
+    }
+
+    if(data_size + 8 > UINT32_MAX){
+        demux_put_be32(mdat_head, 1);
+        memcpy(mdat_head + 4, "mdat", 4);
+        demux_put_be64(mdat_head + 8, data_size + 16);
+        mdat_head_len = 16;
+    }else{
+        demux_put_be32(mdat_head, data_size + 8);
+        memcpy(mdat_head + 4, "mdat", 4);
+    }
+
+    /* data_offset相对moof开头 */
+    demux_put_be32(moof.data + offset_pos, moof.len + mdat_head_len);
+
+    snprintf(path, sizeof(path), "%s/" DEMUX_SEGMENT_NAME_FORMAT, ctx->out_dir, seg_track->track->track_id, index + 1);
+    out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out_fd < 0){
+        printf("open %s failed\n", path);
+        goto end;
+    }
+    demux_copy_init(&copy, in_fd, out_fd);
+    if(demux_copy_write(&copy, moof.data, moof.len) < 0 || demux_copy_write(&copy, mdat_head, mdat_head_len) < 0){
+        printf("segment write head failed\n");
+        goto end;
+    }
+
+    for(i = seg_track->next_sample;i <= end;i++){
+        sample = (i < end) ? &seg_track->samples[i] : NULL;
+        if(sample != NULL && range_size > 0 && range_offset + range_size == sample->offset){
+            range_size += sample->size;
+            continue;
+        }
+        if(range_size > 0){
+            demux_io_access(demux_ctrl->io, range_offset, range_size);
+            if(demux_copy_range(&copy, range_offset, range_size) < 0){
+                printf("segment copy failed, offset[%lu] size[%lu]\n", range_offset, range_size);
+                goto end;
+            }
+        }
+        if(sample != NULL){
+            range_offset = sample->offset;
+            range_size = sample->size;
+        }
+    }
+
+    for(i = seg_track->next_sample;i < end;i++){
+        demux_stats_sample(&demux_ctrl->stats, seg_track->samples[i].size);
+    }
+    seg_track->next_dts = dts;
+    seg_track->next_sample = end;
+    seg_track->bytes += moof.len + mdat_head_len + data_size;
+    ctx->segments[index].size += moof.len + mdat_head_len + data_size;
+    ret = 0;
+
+end:
+    if(out_fd >= 0){
+        close(out_fd);
+    }
+    demux_copy_close(&copy);
+    demux_buf_free(&moof);
+
+    return ret;
+}
+
+/* 没有sample或timescale为0的track不输出 */
+static int demux_segment_track_enabled(demux_segment_ctx_t* ctx, int t){
+    return ctx->track[t].sample_count > 0 && ctx->track[t].track->timescale > 0;
+}
+
+static uint64_t demux_segment_bandwidth(demux_segment_ctx_t* ctx, int t){
+    double total = ctx->bounds[ctx->segment_count] - ctx->bounds[0];
+
+    return total > 0 ? (uint64_t)(ctx->track[t].bytes * 8 / total) : 0;
+}
+
+/* RFC 6381 codecs: avc1.PPCCLL, mp4a.40.aot */
+static void demux_segment_codecs(video_ctrl_t* track, char* codecs, uint32_t len){
+    codecs[0] = 0;
+    if(strcmp(track->codec, "avc1") == 0 && track->sps != NULL && track->sps_len >= 4){
+        snprintf(codecs, len, "avc1.%02X%02X%02X", (uint8_t)track->sps[1], (uint8_t)track->sps[2], (uint8_t)track->sps[3]);
+    }else if(strcmp(track->codec, "mp4a") == 0){
+        snprintf(codecs, len, "mp4a.40.%u",
+                 (track->audio_config != NULL && track->audio_config_len > 0) ? track->audio_config[0] >> 3 : 2);
+    }else{
+        snprintf(codecs, len, "%s", track->codec);
+    }
+}
+
+/* 一个track的media playlist */
+static int demux_segment_write_playlist(demux_segment_ctx_t* ctx, int t){
+    uint32_t track_id = ctx->track[t].track->track_id;
+    char path[DEMUX_SEGMENT_PATH_LENGTH];
+    double target = 0;
+    uint32_t i = 0;
+    FILE* fp = NULL;
+
+    snprintf(path, sizeof(path), "%s/" DEMUX_SEGMENT_PLAYLIST_FORMAT, ctx->out_dir, track_id);
+    fp = fopen(path, "w");
+    if(fp == NULL){
+        printf("open %s failed\n", path);
+        return -1;
+    }
+
+    for(i = 0;i < ctx->segment_count;i++){
+        if(ctx->segments[i].duration > target){
+            target = ctx->segments[i].duration;
+        }
+    }
+
+    fprintf(fp, "#EXTM3U\n#EXT-X-VERSION:7\n#EXT-X-TARGETDURATION:%u\n", (uint32_t)(target + 0.999));
+    fprintf(fp, "#EXT-X-MEDIA-SEQUENCE:1\n#EXT-X-PLAYLIST-TYPE:VOD\n#EXT-X-INDEPENDENT-SEGMENTS\n");
+    fprintf(fp, "#EXT-X-MAP:URI=\"" DEMUX_SEGMENT_INIT_FORMAT "\"\n", track_id);
+    for(i = 0;i < ctx->segment_count;i++){
+        fprintf(fp, "#EXTINF:%.3f,\n" DEMUX_SEGMENT_NAME_FORMAT "\n", ctx->segments[i].duration, track_id, i + 1);
+    }
+    fprintf(fp, "#EXT-X-ENDLIST\n");
+    fclose(fp);
+
+    return 0;
+}
+
+/* 主playlist: 有视频时音频放在EXT-X-MEDIA的audio组里, 由视频的EXT-X-STREAM-INF引用 */
+static int demux_segment_write_hls(demux_segment_ctx_t* ctx){
+    demux_ctrl_t* demux_ctrl = ctx->demux_ctrl;
+    video_ctrl_t* track = NULL;
+    char path[DEMUX_SEGMENT_PATH_LENGTH];
+    char codecs[64];
+    char audio_codecs[64];
+    uint64_t audio_bandwidth = 0;
+    int audio = -1;
+    int video = -1;
+    int t = 0;
+    FILE* fp = NULL;
+
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        if(!demux_segment_track_enabled(ctx, t)){
+            continue;
+        }
+        if(demux_segment_write_playlist(ctx, t) < 0){
+            return -1;
+        }
+        if(video < 0 && strcmp(demux_ctrl->track[t]->handler_type, "vide") == 0){
+            video = t;
+        }else if(audio < 0 && strcmp(demux_ctrl->track[t]->handler_type, "soun") == 0){
+            audio = t;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", ctx->out_dir, DEMUX_SEGMENT_HLS_NAME);
+    fp = fopen(path, "w");
+    if(fp == NULL){
+        printf("open %s failed\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "#EXTM3U\n#EXT-X-VERSION:7\n#EXT-X-INDEPENDENT-SEGMENTS\n");
+    if(video >= 0 && audio >= 0){
+        demux_segment_codecs(demux_ctrl->track[audio], audio_codecs, sizeof(audio_codecs));
+        audio_bandwidth = demux_segment_bandwidth(ctx, audio);
+        for(t = 0;t < demux_ctrl->track_count;t++){
+            if(demux_segment_track_enabled(ctx, t) && strcmp(demux_ctrl->track[t]->handler_type, "soun") == 0){
+                fprintf(fp, "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"audio\",NAME=\"audio_%u\",DEFAULT=%s,AUTOSELECT=YES,"
+                            "URI=\"" DEMUX_SEGMENT_PLAYLIST_FORMAT "\"\n",
+                        demux_ctrl->track[t]->track_id, t == audio ? "YES" : "NO", demux_ctrl->track[t]->track_id);
+            }
+        }
+    }
+
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        track = demux_ctrl->track[t];
+        if(!demux_segment_track_enabled(ctx, t)){
+            continue;
+        }
+        /* 有视频时只列出视频, 否则每个track各自一路 */
+        if(video >= 0 && strcmp(track->handler_type, "vide") != 0){
+            continue;
+        }
+        demux_segment_codecs(track, codecs, sizeof(codecs));
+        if(video >= 0 && audio >= 0){
+            fprintf(fp, "#EXT-X-STREAM-INF:BANDWIDTH=%lu,CODECS=\"%s,%s\",AUDIO=\"audio\"",
+                    demux_segment_bandwidth(ctx, t) + audio_bandwidth, codecs, audio_codecs);
+        }else{
+            fprintf(fp, "#EXT-X-STREAM-INF:BANDWIDTH=%lu,CODECS=\"%s\"", demux_segment_bandwidth(ctx, t), codecs);
+        }
+        if(strcmp(track->handler_type, "vide") == 0 && track->width > 0){
+            fprintf(fp, ",RESOLUTION=%ux%u", track->width, track->height);
+        }
+        fprintf(fp, "\n" DEMUX_SEGMENT_PLAYLIST_FORMAT "\n", track->track_id);
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+/* 每个track一个AdaptationSet, 分片时间都按参考track的切点, 所以SegmentTimeline相同 */
+static int demux_segment_write_dash(demux_segment_ctx_t* ctx){
+    demux_ctrl_t* demux_ctrl = ctx->demux_ctrl;
+    video_ctrl_t* track = NULL;
+    char path[DEMUX_SEGMENT_PATH_LENGTH];
+    char codecs[64];
+    const char* content_type = NULL;
+    double total = ctx->bounds[ctx->segment_count] - ctx->bounds[0];
+    uint64_t start_ms = 0;
+    uint64_t end_ms = 0;
+    uint32_t i = 0;
+    int t = 0;
+    FILE* fp = NULL;
+
+    snprintf(path, sizeof(path), "%s/%s", ctx->out_dir, DEMUX_SEGMENT_DASH_NAME);
+    fp = fopen(path, "w");
+    if(fp == NULL){
+        printf("open %s failed\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(fp, "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" profiles=\"urn:mpeg:dash:profile:isoff-live:2011\" "
+                "type=\"static\" mediaPresentationDuration=\"PT%.3fS\" minBufferTime=\"PT2S\">\n", total);
+    fprintf(fp, "  <Period start=\"PT0S\">\n");
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        track = demux_ctrl->track[t];
+        if(!demux_segment_track_enabled(ctx, t)){
+            continue;
+        }
+        if(strcmp(track->handler_type, "vide") == 0){
+            content_type = "video";
+        }else if(strcmp(track->handler_type, "soun") == 0){
+            content_type = "audio";
+        }else{
+            continue;
+        }
+        demux_segment_codecs(track, codecs, sizeof(codecs));
+
+        fprintf(fp, "    <AdaptationSet id=\"%d\" contentType=\"%s\" mimeType=\"%s/mp4\" segmentAlignment=\"true\" startWithSAP=\"1\">\n",
+                t, content_type, content_type);
+        fprintf(fp, "      <Representation id=\"%u\" codecs=\"%s\" bandwidth=\"%lu\"",
+                track->track_id, codecs, demux_segment_bandwidth(ctx, t));
+        if(strcmp(content_type, "video") == 0 && track->width > 0){
+            fprintf(fp, " width=\"%u\" height=\"%u\"", track->width, track->height);
+        }else if(strcmp(content_type, "audio") == 0 && track->sample_rate > 0){
+            fprintf(fp, " audioSamplingRate=\"%u\"", track->sample_rate);
+        }
+        fprintf(fp, ">\n");
+        fprintf(fp, "        <SegmentTemplate timescale=\"1000\" initialization=\"%s\" media=\"%s\" startNumber=\"1\">\n",
+                DEMUX_SEGMENT_DASH_INIT, DEMUX_SEGMENT_DASH_TEMPLATE);
+        fprintf(fp, "          <SegmentTimeline>\n");
+        for(i = 0;i < ctx->segment_count;i++){
+            /* 按毫秒取整后相减, 累积不会漂移 */
+            start_ms = (uint64_t)(ctx->bounds[i] * 1000 + 0.5);
+            end_ms = (uint64_t)(ctx->bounds[i + 1] * 1000 + 0.5);
+            fprintf(fp, "            <S t=\"%lu\" d=\"%lu\"/>\n", start_ms, end_ms - start_ms);
+        }
+        fprintf(fp, "          </SegmentTimeline>\n        </SegmentTemplate>\n      </Representation>\n");
+        fprintf(fp, "    </AdaptationSet>\n");
+    }
+    fprintf(fp, "  </Period>\n</MPD>\n");
+    fclose(fp);
+
+    return 0;
+}
+
+int demux_segment(demux_ctrl_t* demux_ctrl, double target_duration, const char* out_dir){
+    demux_segment_ctx_t* ctx = NULL;
+    demux_top_box_t moov_box;
+    demux_box_info_t mvhd;
+    demux_buf_t moov;
+    const uint8_t* body = NULL;
+    uint64_t body_size = 0;
+    uint64_t duration = 0;
+    uint64_t bytes = 0;
+    uint32_t i = 0;
+    int ret = -1;
+    int t = 0;
+
+    if(demux_ctrl == NULL || demux_ctrl->io == NULL || out_dir == NULL || target_duration <= 0){
+        printf("segment arg error, target_duration[%f]\n", target_duration);
+        return -1;
+    }
+
+    /* sample数据由copy_file_range拷贝, 需要输入fd */
+    if(demux_ctrl->io->fd < 0){
+        printf("segment need input fd\n");
+        return -1;
+    }
+    if(mkdir(out_dir, 0755) < 0 && errno != EEXIST){
+        printf("mkdir %s failed\n", out_dir);
+        return -1;
+    }
+
+    memset(&moov, 0, sizeof(moov));
+    ctx = (demux_segment_ctx_t*)calloc(1, sizeof(demux_segment_ctx_t));
+    if(ctx == NULL){
+        printf("segment ctx NULL\n");
+        goto end;
+    }
+    ctx->demux_ctrl = demux_ctrl;
+    ctx->out_dir = out_dir;
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        ctx->track[t].track = demux_ctrl->track[t];
+    }
+
+    /* 只需要moov, 顶层box再多也一直找下去 */
+    if(demux_find_top_box(demux_ctrl->io, "moov", &moov_box) < 0){
+        printf("moov not found\n");
+        goto end;
+    }
+    if(demux_buf_init(&moov, moov_box.size) < 0){
+        goto end;
+    }
+    if(demux_io_read_at(demux_ctrl->io, moov_box.offset, moov.data, moov_box.size) != (int64_t)moov_box.size){
+        printf("read moov failed\n");
+        goto end;
+    }
+    moov.len = moov_box.size;
+
+    /* mvhd中的timescale: v0在12, v1在20 */
+    if(demux_box_find(moov.data + moov_box.header_size, moov.len - moov_box.header_size, "mvhd", &mvhd) <= 0){
+        printf("mvhd not found\n");
+        goto end;
+    }
+    body = moov.data + moov_box.header_size + mvhd.offset + mvhd.header_size;
+    body_size = mvhd.size - mvhd.header_size;
+    if(body_size < 16 || (body[0] == 1 && body_size < 24)){
+        printf("mvhd size[%lu] error\n", mvhd.size);
+        goto end;
+    }
+    ctx->movie_timescale = demux_get_be32(body + (body[0] == 1 ? 20 : 12));
+
+    if(demux_segment_collect(ctx) < 0){
+        goto end;
+    }
+
+    /* 有视频时按视频关键帧切, 否则按第一个有sample的track */
+    ctx->ref_track = demux_find_track(demux_ctrl, "vide");
+    if(ctx->ref_track < 0 || ctx->track[ctx->ref_track].sample_count == 0){
+        for(ctx->ref_track = 0;ctx->ref_track < demux_ctrl->track_count;ctx->ref_track++){
+            if(ctx->track[ctx->ref_track].sample_count > 0){
+                break;
+            }
+        }
+    }
+    if(ctx->ref_track >= demux_ctrl->track_count || ctx->track[ctx->ref_track].track->timescale == 0){
+        printf("segment no sample\n");
+        goto end;
+    }
+
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        if(demux_ctrl->track[t]->timescale == 0){
+            continue;
+        }
+        duration = 0;
+        for(i = 0;i < ctx->track[t].sample_count;i++){
+            duration += ctx->track[t].samples[i].duration;
+        }
+        duration = duration * ctx->movie_timescale / demux_ctrl->track[t]->timescale;
+        if(duration > ctx->movie_duration){
+            ctx->movie_duration = duration;
+        }
+    }
+
+    if(demux_segment_plan(ctx, target_duration) < 0){
+        goto end;
+    }
+    for(t = 0;t < demux_ctrl->track_count;t++){
+        if(!demux_segment_track_enabled(ctx, t)){
+            continue;
+        }
+        if(demux_segment_write_init(ctx, t, moov.data, moov.len) < 0){
+            goto end;
+        }
+        for(i = 0;i < ctx->segment_count;i++){
+            if(demux_segment_write_one(ctx, i, t, demux_ctrl->io->fd) < 0){
+                goto end;
+            }
+        }
+        bytes += ctx->track[t].bytes;
+    }
+    if(demux_segment_write_hls(ctx) < 0 || demux_segment_write_dash(ctx) < 0){
+        goto end;
+    }
+
+    printf("segment %u segments, %lu bytes to %s\n", ctx->segment_count, bytes, out_dir);
+    ret = 0;
+
+end:
+    if(ctx != NULL){
+        for(t = 0;t < DEMUX_MAX_TRACK_NUM;t++){
+            free(ctx->track[t].samples);
+        }
+        free(ctx->bounds);
+        free(ctx->segments);
+    }
+    demux_buf_free(&moov);
+    free(ctx);
+
+    return ret;
+}
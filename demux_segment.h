@@ -0,0 +1,47 @@
+#ifndef __DEMUX_SEGMENT_H
+#define __DEMUX_SEGMENT_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_cut.h"
+
+/*
+ * 切片: 按已解析的sample表和stss关键帧把普通mp4切成CMAF/fMP4分片
+ * 每个track单独输出: init分片(ftyp+只含该trak的moov+mvex)和只含该track的moof+mdat分片,
+ * 所有track在参考track的同一组关键帧时间点切开, 分片序号一一对应
+ * sample数据不做任何修改, 由copy_file_range直接拷贝
+ * 同时生成HLS(主m3u8+每个track一个m3u8)和DASH(mpd, 每个track一个AdaptationSet)索引
+ */
+
+#define DEMUX_SEGMENT_INIT_FORMAT "init_%u.mp4"                 // track_id
+#define DEMUX_SEGMENT_NAME_FORMAT "seg_%u_%05u.m4s"             // track_id, 序号
+#define DEMUX_SEGMENT_PLAYLIST_FORMAT "track_%u.m3u8"           // track_id
+#define DEMUX_SEGMENT_DASH_INIT "init_$RepresentationID$.mp4"
+#define DEMUX_SEGMENT_DASH_TEMPLATE "seg_$RepresentationID$_$Number%05d$.m4s"
+#define DEMUX_SEGMENT_HLS_NAME "index.m3u8"
+#define DEMUX_SEGMENT_DASH_NAME "manifest.mpd"
+#define DEMUX_SEGMENT_PATH_LENGTH 512
+
+typedef struct demux_segment_track
+{
+    video_ctrl_t* track;
+    demux_cut_sample_t* samples;
+    uint32_t sample_count;
+    uint32_t sample_cap;
+    uint32_t next_sample;       // 下一个分片的第一个sample
+    int64_t next_dts;           // next_sample的dts, 写入tfdt
+    uint64_t bytes;             // 所有分片的大小, 算bandwidth
+}demux_segment_track_t;
+
+/* 一个分片, 时间以参考track(有视频时为视频)的关键帧为界 */
+typedef struct demux_segment_info
+{
+    double start;
+    double duration;
+    uint64_t size;
+}demux_segment_info_t;
+
+/* target_duration为目标分片时长(秒), 分片在达到目标时长后的第一个关键帧处切开 */
+extern int demux_segment(demux_ctrl_t* demux_ctrl, double target_duration, const char* out_dir);
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "demux_shared.h"
+#include "demux_probe.h"
+
+demux_shared_t* demux_shared_open(const char* file_path){
+    demux_shared_t* shared = NULL;
+    demux_ctrl_t* demux_ctrl = NULL;
+
+    if(file_path == NULL){
+        printf("file_path NULL\n");
+        return NULL;
+    }
+
+    shared = (demux_shared_t*)calloc(1, sizeof(demux_shared_t));
+    demux_ctrl = (demux_ctrl_t*)calloc(1, sizeof(demux_ctrl_t));
+    if(shared == NULL || demux_ctrl == NULL){
+        printf("shared[%p] demux_ctrl[%p] NULL\n", shared, demux_ctrl);
+        free(shared);
+        free(demux_ctrl);
+        return NULL;
+    }
+    if(demux_init(demux_ctrl, (char*)file_path, strlen(file_path)) < 0){
+        printf("shared open %s failed\n", file_path);
+        if(demux_ctrl->io != NULL){
+            demux_close(demux_ctrl);
+        }else{
+            free(demux_ctrl);
+        }
+        free(shared);
+        return NULL;
+    }
+
+    /* 解析在发布给其他线程之前完成, 之后不再修改demux_ctrl */
+    if(demux_probe(demux_ctrl, DEMUX_PROBE_WINDOW) < 0){
+        while(demux_handle_box_body(demux_ctrl) >= 0){
+        }
+    }
+
+    shared->demux_ctrl = demux_ctrl;
+    shared->fd = demux_ctrl->io->fd;
+    shared->data = demux_ctrl->io->data;
+    shared->size = demux_ctrl->io->size;
+    shared->refcount = 1;
+
+    return shared;
+}
+
+demux_shared_t* demux_shared_ref(demux_shared_t* shared){
+    if(shared != NULL){
+        __atomic_fetch_add(&shared->refcount, 1, __ATOMIC_RELAXED);
+    }
+
+    return shared;
+}
+
+void demux_shared_unref(demux_shared_t* shared){
+    if(shared == NULL){
+        return;
+    }
+
+    /* 最后一个引用释放时, 其他线程对sample表的读取都已经结束 */
+    if(__atomic_sub_fetch(&shared->refcount, 1, __ATOMIC_ACQ_REL) == 0){
+        demux_close(shared->demux_ctrl);
+        free(shared);
+    }
+}
+
+demux_cursor_t* demux_cursor_open(demux_shared_t* shared, int track_index){
+    demux_cursor_t* cursor = NULL;
+    video_ctrl_t* track = NULL;
+
+    if(shared == NULL){
+        printf("shared NULL\n");
+        return NULL;
+    }
+    track = demux_get_track(shared->demux_ctrl, track_index);
+    if(track == NULL){
+        printf("track_index[%d] error\n", track_index);
+        return NULL;
+    }
+
+    cursor = (demux_cursor_t*)calloc(1, sizeof(demux_cursor_t));
+    if(cursor == NULL){
+        printf("calloc cursor failed\n");
+        return NULL;
+    }
+    if(demux_sample_locator_init(&cursor->locator, shared->demux_ctrl, track_index) < 0){
+        free(cursor);
+        return NULL;
+    }
+    cursor->shared = demux_shared_ref(shared);
+    cursor->track_index = track_index;
+    cursor->track = track;
+
+    return cursor;
+}
+
+int demux_cursor_seek(demux_cursor_t* cursor, double time){
+    video_ctrl_t* track = cursor->track;
+    int64_t target = (int64_t)(time * track->timescale);
+    uint32_t sample_index = 0;
+
+    if(track->sample_count == 0){
+        return -1;
+    }
+
+    /* 时间线二分找到time所在的sample, 再在stss中二分找它之前的关键帧 */
+    sample_index = demux_timeline_find(&cursor->locator.timeline, target);
+    sample_index = demux_keyframe_before(track, sample_index, &cursor->stss_index);
+    cursor->stss_cursor.block = 0;
+    cursor->sample_index = sample_index;
+
+    return sample_index;
+}
+
+int demux_cursor_read(demux_cursor_t* cursor, demux_packet_t* pkt){
+    demux_shared_t* shared = cursor->shared;
+    video_ctrl_t* track = cursor->track;
+    uint32_t sample_number = 0;
+    uint8_t* buf = NULL;
+
+    if(cursor->sample_index >= track->sample_count){
+        return 0;
+    }
+    if(demux_sample_locate(&cursor->locator, cursor->sample_index, pkt) < 0){
+        return -1;
+    }
+    pkt->track_index = cursor->track_index;
+
+    /* stss: 没有stss时每个sample都是关键帧, stss中的序号从1开始 */
+    sample_number = cursor->sample_index + 1;
+    pkt->keyframe = 1;
+    if(track->stss_present){
+        while(cursor->stss_index < track->i_frame_count &&
+              demux_pack_cursor_get(&track->i_frame_num_pack, &cursor->stss_cursor, cursor->stss_index) < sample_number){
+            cursor->stss_index++;
+        }
+        pkt->keyframe = (cursor->stss_index < track->i_frame_count &&
+                         demux_pack_cursor_get(&track->i_frame_num_pack, &cursor->stss_cursor, cursor->stss_index) == sample_number);
+    }
+
+    if(shared->data != NULL){
+        if(pkt->offset + pkt->size > shared->size){
+            printf("sample out of range, offset[%lu] size[%u]\n", pkt->offset, pkt->size);
+            return -1;
+        }
+        pkt->data = (uint8_t*)shared->data + pkt->offset;
+    }else{
+        if(pkt->size > cursor->buf_size){
+            buf = (uint8_t*)realloc(cursor->buf, pkt->size);
+            if(buf == NULL){
+                printf("realloc cursor buf[%u] failed\n", pkt->size);
+                return -1;
+            }
+            cursor->buf = buf;
+            cursor->buf_size = pkt->size;
+        }
+        if(pread(shared->fd, cursor->buf, pkt->size, pkt->offset) != pkt->size){
+            printf("pread failed, offset[%lu] size[%u]\n", pkt->offset, pkt->size);
+            return -1;
+        }
+        pkt->data = cursor->buf;
+    }
+    cursor->sample_index++;
+
+    return 1;
+}
+
+void demux_cursor_close(demux_cursor_t* cursor){
+    if(cursor == NULL){
+        return;
+    }
+
+    demux_sample_locator_free(&cursor->locator);
+    demux_shared_unref(cursor->shared);
+    free(cursor->buf);
+    free(cursor);
+}
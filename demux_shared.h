@@ -0,0 +1,52 @@
+#ifndef __DEMUX_SHARED_H
+#define __DEMUX_SHARED_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_packet.h"
+#include "demux_keyframe.h"
+
+/*
+ * 多线程共享一份解析结果: 解析完成后demux_ctrl中的sample表只读, 由引用计数的demux_shared_t持有
+ * 每个线程创建自己的demux_cursor_t(读位置 + 读缓冲), 用pread按偏移读(内存输入直接取指针), 不动共享的io位置
+ * 同一个热门文件被多个连接同时seek时只保留一份sample表
+ */
+
+typedef struct demux_shared
+{
+    demux_ctrl_t* demux_ctrl;   // 解析完成后只读
+    int fd;                     // 只用pread, <0时从data读
+    const uint8_t* data;
+    uint64_t size;
+    int refcount;
+}demux_shared_t;
+
+/* 单个线程的读取位置, 不加锁, 不能跨线程同时使用 */
+typedef struct demux_cursor
+{
+    demux_shared_t* shared;
+    int track_index;
+    video_ctrl_t* track;
+    uint32_t sample_index;      // 下一个要读的sample
+    demux_sample_locator_t locator;
+    demux_pack_cursor_t stss_cursor;
+    uint32_t stss_index;
+    uint8_t* buf;
+    uint32_t buf_size;
+}demux_cursor_t;
+
+/* 打开并解析文件, 引用计数为1 */
+extern demux_shared_t* demux_shared_open(const char* file_path);
+extern demux_shared_t* demux_shared_ref(demux_shared_t* shared);
+/* 引用计数减到0时释放sample表和io */
+extern void demux_shared_unref(demux_shared_t* shared);
+
+/* cursor持有shared的一个引用 */
+extern demux_cursor_t* demux_cursor_open(demux_shared_t* shared, int track_index);
+/* 定位到time(秒)之前(含)最近的关键帧, 返回sample序号 */
+extern int demux_cursor_seek(demux_cursor_t* cursor, double time);
+/* 读下一个sample, pkt->data在下一次读之前有效, 返回1取到, 0结束, -1出错 */
+extern int demux_cursor_read(demux_cursor_t* cursor, demux_packet_t* pkt);
+extern void demux_cursor_close(demux_cursor_t* cursor);
+
+#endif
@@ -0,0 +1,513 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include "demux_sink.h"
+#include "demux_copy.h"
+
+#define DEMUX_SINK_MAX_IOV 64
+
+typedef struct demux_sink_fd
+{
+    int fd;
+    int own_fd;
+    uint8_t* buf;
+    uint32_t buf_size;
+    uint32_t buf_len;
+    demux_copy_t copy;
+}demux_sink_fd_t;
+
+typedef struct demux_sink_ring
+{
+    uint8_t* buf;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t len;
+    int finished;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+}demux_sink_ring_t;
+
+typedef struct demux_sink_callback
+{
+    DEMUX_SINK_CALLBACK callback;
+    void* user;
+}demux_sink_callback_t;
+
+static demux_sink_t* demux_sink_alloc(const demux_sink_ops_t* ops, void* priv){
+    demux_sink_t* sink = (demux_sink_t*)calloc(1, sizeof(demux_sink_t));
+    if(sink == NULL){
+        printf("sink NULL\n");
+        return NULL;
+    }
+
+    sink->ops = ops;
+    sink->priv = priv;
+
+    return sink;
+}
+
+/*
+ * fd sink
+ * 小块数据先攒在对齐的write-behind缓存里, 缓存放不下时把缓存和新数据合成一次writev
+ */
+static int demux_sink_fd_flush(demux_sink_t* sink){
+    demux_sink_fd_t* fd_sink = (demux_sink_fd_t*)sink->priv;
+    int ret = 0;
+
+    if(fd_sink->buf_len == 0){
+        return 0;
+    }
+
+    ret = demux_copy_write(&fd_sink->copy, fd_sink->buf, fd_sink->buf_len);
+    fd_sink->buf_len = 0;
+    sink->write_calls++;
+
+    return ret;
+}
+
+static int demux_sink_fd_writev(demux_sink_t* sink, const struct iovec* iov, int iov_count){
+    demux_sink_fd_t* fd_sink = (demux_sink_fd_t*)sink->priv;
+    struct iovec batch[DEMUX_SINK_MAX_IOV + 1];
+    uint64_t total = 0;
+    int batch_count = 0;
+    int i = 0;
+
+    for(i = 0;i < iov_count;i++){
+        total += iov[i].iov_len;
+    }
+
+    if(fd_sink->buf_len + total <= fd_sink->buf_size){
+        for(i = 0;i < iov_count;i++){
+            memcpy(fd_sink->buf + fd_sink->buf_len, iov[i].iov_base, iov[i].iov_len);
+            fd_sink->buf_len += iov[i].iov_len;
+        }
+        return 0;
+    }
+
+    while(iov_count > 0){
+        batch_count = 0;
+        if(fd_sink->buf_len > 0){
+            batch[batch_count].iov_base = fd_sink->buf;
+            batch[batch_count++].iov_len = fd_sink->buf_len;
+        }
+        for(i = 0;i < iov_count && batch_count < DEMUX_SINK_MAX_IOV + 1;i++){
+            batch[batch_count++] = iov[i];
+        }
+        iov += i;
+        iov_count -= i;
+
+        if(demux_copy_writev(&fd_sink->copy, batch, batch_count) < 0){
+            return -1;
+        }
+        fd_sink->buf_len = 0;
+        sink->write_calls++;
+    }
+
+    return 0;
+}
+
+/*
+ * 小区间直接读到write-behind缓存末尾, 和前后的小块写合并, 不打断缓存
+ * 大区间由内核拷贝写到文件当前位置, 只有缓存里还有数据(要写在它前面)时才先flush
+ */
+static int demux_sink_fd_copy_range(demux_sink_t* sink, int in_fd, uint64_t in_offset, uint64_t len){
+    demux_sink_fd_t* fd_sink = (demux_sink_fd_t*)sink->priv;
+    ssize_t read_size = 0;
+
+    if(len < DEMUX_COPY_MIN_ZERO_COPY_BYTES && fd_sink->buf_len + len <= fd_sink->buf_size){
+        while(len > 0){
+            read_size = pread(in_fd, fd_sink->buf + fd_sink->buf_len, len, in_offset);
+            if(read_size < 0 && errno == EINTR){
+                continue;
+            }
+            if(read_size <= 0){
+                printf("pread failed, offset[%lu] read_size[%ld]\n", in_offset, read_size);
+                return -1;
+            }
+            fd_sink->buf_len += read_size;
+            in_offset += read_size;
+            len -= read_size;
+        }
+        return 0;
+    }
+
+    if(fd_sink->buf_len > 0 && demux_sink_fd_flush(sink) < 0){
+        return -1;
+    }
+
+    if(fd_sink->copy.in_fd != in_fd){
+        demux_copy_close(&fd_sink->copy);
+        demux_copy_init(&fd_sink->copy, in_fd, fd_sink->fd);
+    }
+    sink->write_calls++;
+
+    return demux_copy_range(&fd_sink->copy, in_offset, len);
+}
+
+static void demux_sink_fd_close(demux_sink_t* sink){
+    demux_sink_fd_t* fd_sink = (demux_sink_fd_t*)sink->priv;
+
+    demux_sink_fd_flush(sink);
+    if(fd_sink->own_fd){
+        close(fd_sink->fd);
+    }
+    demux_copy_close(&fd_sink->copy);
+    free(fd_sink->buf);
+    free(fd_sink);
+}
+
+static const demux_sink_ops_t demux_sink_fd_ops = {
+    .writev = demux_sink_fd_writev,
+    .copy_range = demux_sink_fd_copy_range,
+    .flush = demux_sink_fd_flush,
+    .close = demux_sink_fd_close,
+};
+
+demux_sink_t* demux_sink_open_fd(int fd, uint32_t buffer_size){
+    demux_sink_fd_t* fd_sink = NULL;
+    demux_sink_t* sink = NULL;
+
+    if(fd < 0 || buffer_size == 0){
+        printf("fd[%d] buffer_size[%u] error\n", fd, buffer_size);
+        return NULL;
+    }
+
+    fd_sink = (demux_sink_fd_t*)calloc(1, sizeof(demux_sink_fd_t));
+    if(fd_sink == NULL){
+        printf("fd_sink NULL\n");
+        return NULL;
+    }
+
+    if(posix_memalign((void**)&fd_sink->buf, DEMUX_SINK_BUFFER_ALIGN, buffer_size) != 0){
+        printf("sink buf NULL\n");
+        free(fd_sink);
+        return NULL;
+    }
+    fd_sink->fd = fd;
+    fd_sink->buf_size = buffer_size;
+    /* in_fd在第一次copy_range时确定 */
+    demux_copy_init(&fd_sink->copy, fd, fd);
+    fd_sink->copy.in_fd = -1;
+
+    sink = demux_sink_alloc(&demux_sink_fd_ops, fd_sink);
+    if(sink == NULL){
+        free(fd_sink->buf);
+        free(fd_sink);
+        return NULL;
+    }
+
+    return sink;
+}
+
+demux_sink_t* demux_sink_open_file(const char* file_path){
+    demux_sink_t* sink = NULL;
+    int fd = -1;
+
+    if(file_path == NULL){
+        printf("file_path NULL\n");
+        return NULL;
+    }
+
+    fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        printf("open %s failed, errno[%d]\n", file_path, errno);
+        return NULL;
+    }
+
+    sink = demux_sink_open_fd(fd, DEMUX_SINK_FILE_BUFFER_BYTES);
+    if(sink == NULL){
+        close(fd);
+        return NULL;
+    }
+    ((demux_sink_fd_t*)sink->priv)->own_fd = 1;
+
+    return sink;
+}
+
+demux_sink_t* demux_sink_open_pipe(int fd){
+    /* pipe容量有限, 缓存与pipe大小一致, 大块数据由splice直接搬运 */
+    return demux_sink_open_fd(fd, DEMUX_SINK_PIPE_BUFFER_BYTES);
+}
+
+/*
+ * ring sink
+ * 写满时阻塞等待读者消费, 读者通过demux_sink_ring_read取数据
+ */
+static int demux_sink_ring_writev(demux_sink_t* sink, const struct iovec* iov, int iov_count){
+    demux_sink_ring_t* ring = (demux_sink_ring_t*)sink->priv;
+    const uint8_t* data = NULL;
+    uint32_t left = 0;
+    uint32_t tail = 0;
+    uint32_t copy_len = 0;
+    int i = 0;
+
+    pthread_mutex_lock(&ring->lock);
+    for(i = 0;i < iov_count;i++){
+        data = (const uint8_t*)iov[i].iov_base;
+        left = iov[i].iov_len;
+        while(left > 0){
+            while(ring->len == ring->capacity){
+                pthread_cond_wait(&ring->cond, &ring->lock);
+            }
+            tail = (ring->head + ring->len) % ring->capacity;
+            copy_len = ring->capacity - ring->len;
+            if(copy_len > ring->capacity - tail){
+                copy_len = ring->capacity - tail;
+            }
+            if(copy_len > left){
+                copy_len = left;
+            }
+            memcpy(ring->buf + tail, data, copy_len);
+            ring->len += copy_len;
+            data += copy_len;
+            left -= copy_len;
+            pthread_cond_broadcast(&ring->cond);
+        }
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    sink->write_calls++;
+
+    return 0;
+}
+
+static void demux_sink_ring_close(demux_sink_t* sink){
+    demux_sink_ring_t* ring = (demux_sink_ring_t*)sink->priv;
+
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->cond);
+    free(ring->buf);
+    free(ring);
+}
+
+static const demux_sink_ops_t demux_sink_ring_ops = {
+    .writev = demux_sink_ring_writev,
+    .copy_range = NULL,
+    .flush = NULL,
+    .close = demux_sink_ring_close,
+};
+
+demux_sink_t* demux_sink_open_ring(uint32_t capacity){
+    demux_sink_ring_t* ring = NULL;
+    demux_sink_t* sink = NULL;
+
+    if(capacity == 0){
+        printf("ring capacity 0\n");
+        return NULL;
+    }
+
+    ring = (demux_sink_ring_t*)calloc(1, sizeof(demux_sink_ring_t));
+    if(ring == NULL){
+        printf("ring NULL\n");
+        return NULL;
+    }
+    ring->buf = (uint8_t*)malloc(capacity);
+    if(ring->buf == NULL){
+        printf("ring buf NULL\n");
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = capacity;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->cond, NULL);
+
+    sink = demux_sink_alloc(&demux_sink_ring_ops, ring);
+    if(sink == NULL){
+        pthread_mutex_destroy(&ring->lock);
+        pthread_cond_destroy(&ring->cond);
+        free(ring->buf);
+        free(ring);
+        return NULL;
+    }
+
+    return sink;
+}
+
+/* 标记写入结束, 读者取完剩余数据后返回0 */
+void demux_sink_ring_finish(demux_sink_t* sink){
+    demux_sink_ring_t* ring = NULL;
+
+    if(sink == NULL || sink->ops != &demux_sink_ring_ops){
+        printf("sink[%p] is not ring sink\n", sink);
+        return;
+    }
+    ring = (demux_sink_ring_t*)sink->priv;
+
+    pthread_mutex_lock(&ring->lock);
+    ring->finished = 1;
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+int demux_sink_ring_read(demux_sink_t* sink, uint8_t* buf, uint32_t len){
+    demux_sink_ring_t* ring = NULL;
+    uint32_t read_len = 0;
+    uint32_t copy_len = 0;
+
+    if(sink == NULL || sink->ops != &demux_sink_ring_ops || buf == NULL){
+        printf("sink[%p] is not ring sink\n", sink);
+        return -1;
+    }
+    ring = (demux_sink_ring_t*)sink->priv;
+
+    pthread_mutex_lock(&ring->lock);
+    while(ring->len == 0 && !ring->finished){
+        pthread_cond_wait(&ring->cond, &ring->lock);
+    }
+    while(read_len < len && ring->len > 0){
+        copy_len = ring->capacity - ring->head;
+        if(copy_len > ring->len){
+            copy_len = ring->len;
+        }
+        if(copy_len > len - read_len){
+            copy_len = len - read_len;
+        }
+        memcpy(buf + read_len, ring->buf + ring->head, copy_len);
+        ring->head = (ring->head + copy_len) % ring->capacity;
+        ring->len -= copy_len;
+        read_len += copy_len;
+    }
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+
+    return read_len;
+}
+
+/*
+ * callback sink
+ */
+static int demux_sink_callback_writev(demux_sink_t* sink, const struct iovec* iov, int iov_count){
+    demux_sink_callback_t* cb_sink = (demux_sink_callback_t*)sink->priv;
+
+    sink->write_calls++;
+
+    return cb_sink->callback(iov, iov_count, cb_sink->user);
+}
+
+static void demux_sink_callback_close(demux_sink_t* sink){
+    free(sink->priv);
+}
+
+static const demux_sink_ops_t demux_sink_callback_ops = {
+    .writev = demux_sink_callback_writev,
+    .copy_range = NULL,
+    .flush = NULL,
+    .close = demux_sink_callback_close,
+};
+
+demux_sink_t* demux_sink_open_callback(DEMUX_SINK_CALLBACK callback, void* user){
+    demux_sink_callback_t* cb_sink = NULL;
+    demux_sink_t* sink = NULL;
+
+    if(callback == NULL){
+        printf("callback NULL\n");
+        return NULL;
+    }
+
+    cb_sink = (demux_sink_callback_t*)calloc(1, sizeof(demux_sink_callback_t));
+    if(cb_sink == NULL){
+        printf("cb_sink NULL\n");
+        return NULL;
+    }
+    cb_sink->callback = callback;
+    cb_sink->user = user;
+
+    sink = demux_sink_alloc(&demux_sink_callback_ops, cb_sink);
+    if(sink == NULL){
+        free(cb_sink);
+        return NULL;
+    }
+
+    return sink;
+}
+
+/*
+ * 通用接口
+ */
+int demux_sink_writev(demux_sink_t* sink, const struct iovec* iov, int iov_count){
+    int i = 0;
+
+    if(sink == NULL || iov == NULL){
+        printf("sink[%p] iov[%p] NULL\n", sink, iov);
+        return -1;
+    }
+
+    for(i = 0;i < iov_count;i++){
+        sink->write_bytes += iov[i].iov_len;
+    }
+
+    return sink->ops->writev(sink, iov, iov_count);
+}
+
+int demux_sink_write(demux_sink_t* sink, const void* data, uint32_t len){
+    struct iovec iov;
+
+    iov.iov_base = (void*)data;
+    iov.iov_len = len;
+
+    return demux_sink_writev(sink, &iov, 1);
+}
+
+int demux_sink_copy_range(demux_sink_t* sink, int in_fd, uint64_t in_offset, uint64_t len){
+    uint8_t buf[DEMUX_COPY_MIN_ZERO_COPY_BYTES];
+    ssize_t read_size = 0;
+
+    if(sink == NULL || in_fd < 0){
+        printf("sink[%p] in_fd[%d] error\n", sink, in_fd);
+        return -1;
+    }
+
+    sink->write_bytes += len;
+    if(sink->ops->copy_range != NULL){
+        return sink->ops->copy_range(sink, in_fd, in_offset, len);
+    }
+
+    /* sink不支持内核拷贝, 分块读入后写出 */
+    while(len > 0){
+        read_size = pread(in_fd, buf, len < sizeof(buf) ? len : sizeof(buf), in_offset);
+        if(read_size < 0 && errno == EINTR){
+            continue;
+        }
+        if(read_size <= 0){
+            printf("pread failed, offset[%lu] read_size[%ld]\n", in_offset, read_size);
+            return -1;
+        }
+        struct iovec iov = {buf, read_size};
+        if(sink->ops->writev(sink, &iov, 1) < 0){
+            return -1;
+        }
+        in_offset += read_size;
+        len -= read_size;
+    }
+
+    return 0;
+}
+
+int demux_sink_flush(demux_sink_t* sink){
+    if(sink == NULL){
+        printf("sink NULL\n");
+        return -1;
+    }
+
+    /* ring和callback sink不缓存数据, 没有flush */
+    if(sink->ops->flush == NULL){
+        return 0;
+    }
+
+    return sink->ops->flush(sink);
+}
+
+void demux_sink_close(demux_sink_t* sink){
+    if(sink == NULL){
+        return;
+    }
+
+    sink->ops->close(sink);
+    free(sink);
+}
@@ -0,0 +1,49 @@
+#ifndef __DEMUX_SINK_H
+#define __DEMUX_SINK_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define DEMUX_SINK_FILE_BUFFER_BYTES (4 * 1024 * 1024)
+#define DEMUX_SINK_PIPE_BUFFER_BYTES (64 * 1024)
+#define DEMUX_SINK_BUFFER_ALIGN 4096
+
+typedef struct demux_sink demux_sink_t;
+
+/* 回调sink, 每批数据以iovec数组的形式交给调用者 */
+typedef int (*DEMUX_SINK_CALLBACK)(const struct iovec* iov, int iov_count, void* user);
+
+typedef struct demux_sink_ops
+{
+    int (*writev)(demux_sink_t* sink, const struct iovec* iov, int iov_count);
+    /* 可为NULL, 为NULL时由demux_sink_copy_range读入内存后走writev */
+    int (*copy_range)(demux_sink_t* sink, int in_fd, uint64_t in_offset, uint64_t len);
+    /* 可为NULL, 不缓存数据的sink不需要flush */
+    int (*flush)(demux_sink_t* sink);
+    void (*close)(demux_sink_t* sink);
+}demux_sink_ops_t;
+
+struct demux_sink
+{
+    const demux_sink_ops_t* ops;
+    void* priv;
+    uint64_t write_bytes;
+    uint64_t write_calls;
+};
+
+extern demux_sink_t* demux_sink_open_file(const char* file_path);
+extern demux_sink_t* demux_sink_open_fd(int fd, uint32_t buffer_size);
+extern demux_sink_t* demux_sink_open_pipe(int fd);
+extern demux_sink_t* demux_sink_open_ring(uint32_t capacity);
+extern demux_sink_t* demux_sink_open_callback(DEMUX_SINK_CALLBACK callback, void* user);
+
+extern void demux_sink_ring_finish(demux_sink_t* sink);
+extern int demux_sink_ring_read(demux_sink_t* sink, uint8_t* buf, uint32_t len);
+
+extern int demux_sink_writev(demux_sink_t* sink, const struct iovec* iov, int iov_count);
+extern int demux_sink_write(demux_sink_t* sink, const void* data, uint32_t len);
+extern int demux_sink_copy_range(demux_sink_t* sink, int in_fd, uint64_t in_offset, uint64_t len);
+extern int demux_sink_flush(demux_sink_t* sink);
+extern void demux_sink_close(demux_sink_t* sink);
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+#include "demux_stats.h"
+
+static demux_box_stats_t* demux_stats_find_box(demux_stats_t* stats, const char* box_type){
+    demux_box_stats_t* box = NULL;
+    uint32_t i = 0;
+
+    /* box类型不多, 顺序比较4字节即可 */
+    for(i = 0;i < stats->box_type_count;i++){
+        if(memcmp(stats->box[i].type, box_type, 4) == 0){
+            box = &stats->box[i];
+            break;
+        }
+    }
+    if(box == NULL){
+        if(stats->box_type_count < DEMUX_STATS_MAX_BOX_TYPE){
+            box = &stats->box[stats->box_type_count++];
+            memcpy(box->type, box_type, 4);
+        }else{
+            box = &stats->box[DEMUX_STATS_MAX_BOX_TYPE - 1];
+            memcpy(box->type, "????", 4);
+        }
+        box->type[4] = 0;
+    }
+
+    return box;
+}
+
+void demux_stats_box(demux_stats_t* stats, const char* box_type, uint64_t box_size, uint64_t parse_ns){
+    demux_box_stats_t* box = demux_stats_find_box(stats, box_type);
+
+    stats->box_count++;
+    stats->parse_ns += parse_ns;
+    box->count++;
+    box->bytes += box_size;
+    box->parse_ns += parse_ns;
+}
+
+void demux_stats_merge_box(demux_stats_t* stats, const demux_box_stats_t* src){
+    demux_box_stats_t* box = demux_stats_find_box(stats, src->type);
+
+    stats->box_count += src->count;
+    stats->parse_ns += src->parse_ns;
+    box->count += src->count;
+    box->bytes += src->bytes;
+    box->parse_ns += src->parse_ns;
+}
+
+/* box类型来自文件, 不可打印的字节转义后再写入json */
+static void demux_stats_json_type(const char* type, FILE* fp){
+    int i = 0;
+
+    fputc('"', fp);
+    for(i = 0;i < 4 && type[i] != 0;i++){
+        if(type[i] == '"' || type[i] == '\\'){
+            fprintf(fp, "\\%c", type[i]);
+        }else if((unsigned char)type[i] < 0x20 || (unsigned char)type[i] >= 0x7f){
+            fprintf(fp, "\\u%04x", (unsigned char)type[i]);
+        }else{
+            fputc(type[i], fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+int demux_stats_dump_json(const demux_stats_t* stats, FILE* fp){
+    const demux_box_stats_t* box = NULL;
+    uint32_t i = 0;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"read_bytes\": %lu,\n", stats->read_bytes);
+    fprintf(fp, "  \"read_calls\": %lu,\n", stats->read_calls);
+    fprintf(fp, "  \"seek_calls\": %lu,\n", stats->seek_calls);
+    fprintf(fp, "  \"box_count\": %lu,\n", stats->box_count);
+    fprintf(fp, "  \"parse_ns\": %lu,\n", stats->parse_ns);
+    fprintf(fp, "  \"sample_count\": %lu,\n", stats->sample_count);
+    fprintf(fp, "  \"sample_bytes\": %lu,\n", stats->sample_bytes);
+    fprintf(fp, "  \"index_bytes\": %lu,\n", stats->index_bytes);
+    fprintf(fp, "  \"alloc_bytes\": %lu,\n", stats->alloc_bytes);
+    fprintf(fp, "  \"boxes\": {");
+    for(i = 0;i < stats->box_type_count;i++){
+        box = &stats->box[i];
+        fprintf(fp, "%s\n    ", i == 0 ? "" : ",");
+        demux_stats_json_type(box->type, fp);
+        fprintf(fp, ": {\"count\": %lu, \"bytes\": %lu, \"parse_ns\": %lu}", box->count, box->bytes, box->parse_ns);
+    }
+    fprintf(fp, "%s}\n}\n", stats->box_type_count > 0 ? "\n  " : "");
+
+    return ferror(fp) ? -1 : 0;
+}
@@ -0,0 +1,64 @@
+#ifndef __DEMUX_STATS_H
+#define __DEMUX_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * 性能计数: 每个demux_ctrl一份, 只由使用这个demux_ctrl的线程更新, 不用原子操作, 可以常开
+ * 读字节数/读调用/seek次数取自io, 索引内存在取统计时按sample表计算, 热路径上只有box计时和sample计数
+ * sample只在真正输出数据的路径上计数, 只取sample信息的遍历(cut规划/GOP/analytics等)不计
+ */
+
+#define DEMUX_STATS_MAX_BOX_TYPE 64
+
+typedef struct demux_box_stats
+{
+    char type[4 + 1];
+    uint64_t count;
+    uint64_t bytes;             // 含box头
+    uint64_t parse_ns;          // 解析函数耗时
+}demux_box_stats_t;
+
+typedef struct demux_stats
+{
+    uint64_t read_bytes;
+    uint64_t read_calls;        // 后端读调用(本地文件为pread次数)
+    uint64_t seek_calls;
+
+    uint64_t box_count;
+    uint64_t parse_ns;
+    uint32_t box_type_count;
+    demux_box_stats_t box[DEMUX_STATS_MAX_BOX_TYPE];    // 超出的类型计入最后一项"????"
+
+    uint64_t sample_count;      // 输出/读出的sample
+    uint64_t sample_bytes;
+
+    uint64_t index_bytes;       // sample表等解析结果占用的内存
+    uint64_t alloc_bytes;       // 解析时分配表的累计字节数, 由各分配处累加, 重复解析会累计
+}demux_stats_t;
+
+static inline uint64_t demux_stats_now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void demux_stats_sample(demux_stats_t* stats, uint32_t size){
+    stats->sample_count++;
+    stats->sample_bytes += size;
+}
+
+static inline void demux_stats_alloc(demux_stats_t* stats, uint64_t bytes){
+    stats->alloc_bytes += bytes;
+}
+
+extern void demux_stats_box(demux_stats_t* stats, const char* box_type, uint64_t box_size, uint64_t parse_ns);
+/* 把另一个demux_ctrl中某类box的计数加进来, 并行解析合并结果时使用 */
+extern void demux_stats_merge_box(demux_stats_t* stats, const demux_box_stats_t* box);
+extern int demux_stats_dump_json(const demux_stats_t* stats, FILE* fp);
+
+#endif
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux_timeline.h"
+
+/* elst: 开头的空编辑是延迟, 第一个正常编辑的media_time对应显示时间的起点, 只处理这种常见的形式 */
+static int64_t demux_timeline_elst_shift(demux_ctrl_t* demux_ctrl, video_ctrl_t* track){
+    int64_t delay = 0;
+    uint32_t i = 0;
+
+    for(i = 0;i < track->elst_entry_count;i++){
+        if(track->elst[i].media_time == -1){
+            if(demux_ctrl->movie_timescale > 0){
+                delay += (int64_t)(track->elst[i].segment_duration * track->timescale / demux_ctrl->movie_timescale);
+            }
+            continue;
+        }
+        return delay - track->elst[i].media_time;
+    }
+
+    return delay;
+}
+
+int64_t demux_timeline_edit_shift(demux_ctrl_t* demux_ctrl, int track_index){
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+
+    if(track == NULL){
+        return 0;
+    }
+
+    return demux_timeline_elst_shift(demux_ctrl, track);
+}
+
+int demux_timeline_build(demux_timeline_t* timeline, demux_ctrl_t* demux_ctrl, int track_index){
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+    demux_timeline_run_t* run = NULL;
+    uint32_t first_sample = 0;
+    int64_t dts = 0;
+    uint32_t i = 0;
+
+    if(timeline == NULL || track == NULL){
+        printf("timeline[%p] track_index[%d] error\n", timeline, track_index);
+        return -1;
+    }
+
+    memset(timeline, 0, sizeof(demux_timeline_t));
+    timeline->track = track;
+    timeline->timescale = track->timescale;
+    timeline->sample_count = track->sample_count;
+    timeline->pts_shift = demux_timeline_elst_shift(demux_ctrl, track);
+
+    /* stts只有一项且覆盖所有sample时按序号直接算 */
+    if(track->stts_entry_count == 0 ||
+       (track->stts_entry_count == 1 && track->stts_box[0].sample_count >= track->sample_count)){
+        timeline->cfr = 1;
+        timeline->cfr_delta = track->stts_entry_count ? track->stts_box[0].sample_delta : 0;
+        timeline->end_dts = (int64_t)track->sample_count * timeline->cfr_delta;
+    }else{
+        timeline->runs = (demux_timeline_run_t*)calloc(track->stts_entry_count, sizeof(demux_timeline_run_t));
+        if(timeline->runs == NULL){
+            printf("timeline runs calloc failed\n");
+            return -1;
+        }
+        for(i = 0;i < track->stts_entry_count && first_sample < track->sample_count;i++){
+            if(track->stts_box[i].sample_count == 0){
+                continue;
+            }
+            run = &timeline->runs[timeline->run_count++];
+            run->first_sample = first_sample;
+            run->sample_count = track->stts_box[i].sample_count;
+            if(run->sample_count > track->sample_count - first_sample){
+                run->sample_count = track->sample_count - first_sample;
+            }
+            run->sample_delta = track->stts_box[i].sample_delta;
+            run->first_dts = dts;
+            dts += (int64_t)run->sample_count * run->sample_delta;
+            first_sample += run->sample_count;
+        }
+        timeline->end_dts = dts;
+    }
+
+    /* ctts只有一项时为固定偏移 */
+    for(i = 0;i < track->ctts_entry_count;i++){
+        timeline->ctts_sample_total += track->ctts_box[i].sample_count;
+    }
+    if(track->ctts_entry_count == 1){
+        timeline->ctts_offset = track->ctts_box[0].sample_offset;
+    }else if(track->ctts_entry_count > 1){
+        timeline->ctts_first_sample = (uint32_t*)calloc(track->ctts_entry_count, sizeof(uint32_t));
+        if(timeline->ctts_first_sample == NULL){
+            printf("timeline ctts calloc failed\n");
+            demux_timeline_free(timeline);
+            return -1;
+        }
+        first_sample = 0;
+        for(i = 0;i < track->ctts_entry_count;i++){
+            timeline->ctts_first_sample[i] = first_sample;
+            first_sample += track->ctts_box[i].sample_count;
+        }
+        timeline->ctts_count = track->ctts_entry_count;
+    }
+
+    return 0;
+}
+
+/* 最后一个first_sample <= sample_index的run */
+static const demux_timeline_run_t* demux_timeline_find_run(const demux_timeline_t* timeline, uint32_t sample_index){
+    uint32_t low = 0;
+    uint32_t high = timeline->run_count;
+    uint32_t mid = 0;
+
+    while(low < high){
+        mid = low + (high - low) / 2;
+        if(timeline->runs[mid].first_sample <= sample_index){
+            low = mid + 1;
+        }else{
+            high = mid;
+        }
+    }
+
+    return low > 0 ? &timeline->runs[low - 1] : NULL;
+}
+
+int64_t demux_timeline_dts(const demux_timeline_t* timeline, uint32_t sample_index){
+    const demux_timeline_run_t* run = NULL;
+
+    if(timeline->cfr){
+        return (int64_t)sample_index * timeline->cfr_delta;
+    }
+
+    run = demux_timeline_find_run(timeline, sample_index);
+    if(run == NULL){
+        return 0;
+    }
+    /* stts没有覆盖到的sample停在结尾 */
+    if(sample_index - run->first_sample >= run->sample_count){
+        return timeline->end_dts;
+    }
+
+    return run->first_dts + (int64_t)(sample_index - run->first_sample) * run->sample_delta;
+}
+
+uint32_t demux_timeline_duration(const demux_timeline_t* timeline, uint32_t sample_index){
+    const demux_timeline_run_t* run = NULL;
+
+    if(timeline->cfr){
+        return timeline->cfr_delta;
+    }
+
+    run = demux_timeline_find_run(timeline, sample_index);
+    if(run == NULL || sample_index - run->first_sample >= run->sample_count){
+        return 0;
+    }
+
+    return run->sample_delta;
+}
+
+int64_t demux_timeline_pts(const demux_timeline_t* timeline, uint32_t sample_index){
+    video_ctrl_t* track = timeline->track;
+    int64_t pts = demux_timeline_dts(timeline, sample_index) + timeline->pts_shift;
+    uint32_t low = 0;
+    uint32_t high = timeline->ctts_count;
+    uint32_t mid = 0;
+
+    if(sample_index >= timeline->ctts_sample_total){
+        return pts;
+    }
+    if(timeline->ctts_first_sample == NULL){
+        return pts + timeline->ctts_offset;
+    }
+
+    /* 数量为0的项和下一项的first_sample相同, 取最后一个即跳过了空项 */
+    while(low < high){
+        mid = low + (high - low) / 2;
+        if(timeline->ctts_first_sample[mid] <= sample_index){
+            low = mid + 1;
+        }else{
+            high = mid;
+        }
+    }
+
+    return pts + track->ctts_box[low - 1].sample_offset;
+}
+
+uint32_t demux_timeline_find(const demux_timeline_t* timeline, int64_t dts){
+    const demux_timeline_run_t* run = NULL;
+    uint64_t sample_index = 0;
+    uint32_t low = 0;
+    uint32_t high = timeline->run_count;
+    uint32_t mid = 0;
+
+    if(timeline->sample_count == 0 || dts < 0){
+        return 0;
+    }
+
+    /* sample_delta为0时整段sample的dts相同, 取这一段的最后一个 */
+    if(timeline->cfr){
+        sample_index = timeline->cfr_delta ? (uint64_t)dts / timeline->cfr_delta : timeline->sample_count - 1;
+    }else{
+        while(low < high){
+            mid = low + (high - low) / 2;
+            if(timeline->runs[mid].first_dts <= dts){
+                low = mid + 1;
+            }else{
+                high = mid;
+            }
+        }
+        /* first_dts不大于dts的最后一个run, 之后的run都晚于dts */
+        run = low > 0 ? &timeline->runs[low - 1] : NULL;
+        if(run != NULL){
+            if(run->sample_delta == 0 || (uint64_t)(dts - run->first_dts) / run->sample_delta >= run->sample_count){
+                sample_index = run->first_sample + run->sample_count - 1;
+            }else{
+                sample_index = run->first_sample + (uint32_t)((uint64_t)(dts - run->first_dts) / run->sample_delta);
+            }
+        }
+    }
+
+    return sample_index < timeline->sample_count ? (uint32_t)sample_index : timeline->sample_count - 1;
+}
+
+uint64_t demux_timeline_bytes(const demux_timeline_t* timeline){
+    return (uint64_t)timeline->run_count * sizeof(demux_timeline_run_t) + (uint64_t)timeline->ctts_count * sizeof(uint32_t);
+}
+
+void demux_timeline_free(demux_timeline_t* timeline){
+    if(timeline == NULL){
+        return;
+    }
+
+    free(timeline->runs);
+    free(timeline->ctts_first_sample);
+    timeline->runs = NULL;
+    timeline->ctts_first_sample = NULL;
+    timeline->run_count = 0;
+    timeline->ctts_count = 0;
+}
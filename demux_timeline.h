@@ -0,0 +1,55 @@
+#ifndef __DEMUX_TIMELINE_H
+#define __DEMUX_TIMELINE_H
+
+#include <stdint.h>
+#include "demux.h"
+
+/*
+ * 单个track的时间线: 时间单位为mdhd中的track timescale
+ * dts由stts按项前缀和得到, pts = dts + ctts中的偏移 + elst得到的显示偏移
+ * stts只有一项(恒定帧率)时dts直接按序号计算, ctts没有或只有一项时同样不建表, 不占逐sample的内存
+ */
+
+/* stts中的一项, first_dts为该项第一个sample的dts */
+typedef struct demux_timeline_run
+{
+    uint32_t first_sample;
+    uint32_t sample_count;
+    uint32_t sample_delta;
+    int64_t first_dts;
+}demux_timeline_run_t;
+
+typedef struct demux_timeline
+{
+    video_ctrl_t* track;
+    uint32_t timescale;
+    uint32_t sample_count;
+    int64_t end_dts;            // 最后一个sample的dts + duration
+
+    int cfr;                    // stts只有一项
+    uint32_t cfr_delta;
+    demux_timeline_run_t* runs; // cfr时为NULL
+    uint32_t run_count;
+
+    int32_t ctts_offset;        // ctts只有一项时的固定偏移
+    uint32_t* ctts_first_sample;    // ctts多项时每项的第一个sample, 二分查找
+    uint32_t ctts_count;
+    uint32_t ctts_sample_total; // ctts覆盖的sample数, 之后的sample没有偏移
+
+    int64_t pts_shift;          // elst: 显示时间 = pts + pts_shift
+}demux_timeline_t;
+
+/* elst得到的显示偏移, 不建时间线 */
+extern int64_t demux_timeline_edit_shift(demux_ctrl_t* demux_ctrl, int track_index);
+extern int demux_timeline_build(demux_timeline_t* timeline, demux_ctrl_t* demux_ctrl, int track_index);
+extern int64_t demux_timeline_dts(const demux_timeline_t* timeline, uint32_t sample_index);
+extern uint32_t demux_timeline_duration(const demux_timeline_t* timeline, uint32_t sample_index);
+/* 显示时间, 已经加上ctts和elst的偏移 */
+extern int64_t demux_timeline_pts(const demux_timeline_t* timeline, uint32_t sample_index);
+/* dts不大于dts的最后一个sample(sample_delta为0的一段取最后一个), dts早于第一个sample时返回0 */
+extern uint32_t demux_timeline_find(const demux_timeline_t* timeline, int64_t dts);
+/* 时间线额外占用的内存 */
+extern uint64_t demux_timeline_bytes(const demux_timeline_t* timeline);
+extern void demux_timeline_free(demux_timeline_t* timeline);
+
+#endif
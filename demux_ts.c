@@ -0,0 +1,566 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "demux_ts.h"
+
+/*
+ * mp4 -> mpeg-ts
+ * pat/pmt和每个pid的ts包头在open时生成好, 写包时只改continuity_counter
+ * ts包先写进批量缓存, 攒满DEMUX_TS_BATCH_PACKETS个后一次交给sink
+ */
+
+static const uint32_t demux_aac_sample_rates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+static uint32_t demux_ts_crc32(const uint8_t* data, uint32_t len){
+    uint32_t crc = 0xffffffff;
+    uint32_t i = 0;
+    int j = 0;
+
+    for(i = 0;i < len;i++){
+        crc ^= (uint32_t)data[i] << 24;
+        for(j = 0;j < 8;j++){
+            crc = (crc & 0x80000000) ? ((crc << 1) ^ 0x04c11db7) : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+static void demux_ts_write_crc(uint8_t* section, uint32_t len){
+    uint32_t crc = demux_ts_crc32(section, len);
+
+    section[len] = crc >> 24;
+    section[len + 1] = crc >> 16;
+    section[len + 2] = crc >> 8;
+    section[len + 3] = crc;
+}
+
+static void demux_ts_build_psi(demux_ts_t* ts){
+    uint8_t* p = NULL;
+    uint32_t section_len = 0;
+    int i = 0;
+
+    /* pat */
+    memset(ts->pat, 0xff, DEMUX_TS_PACKET_SIZE);
+    p = ts->pat;
+    p[0] = 0x47;
+    p[1] = 0x40 | (DEMUX_TS_PAT_PID >> 8);
+    p[2] = DEMUX_TS_PAT_PID & 0xff;
+    p[3] = 0x10;
+    p[4] = 0x00;                        // pointer_field
+    p[5] = 0x00;                        // table_id
+    p[6] = 0xb0;
+    p[7] = 13;                          // section_length
+    p[8] = 0x00; p[9] = 0x01;           // transport_stream_id
+    p[10] = 0xc1;                       // version 0, current_next
+    p[11] = 0x00; p[12] = 0x00;
+    p[13] = 0x00; p[14] = 0x01;         // program_number
+    p[15] = 0xe0 | (DEMUX_TS_PMT_PID >> 8);
+    p[16] = DEMUX_TS_PMT_PID & 0xff;
+    demux_ts_write_crc(p + 5, 12);
+
+    /* pmt */
+    memset(ts->pmt, 0xff, DEMUX_TS_PACKET_SIZE);
+    p = ts->pmt;
+    section_len = 9 + 5 * ts->stream_count + 4;
+    p[0] = 0x47;
+    p[1] = 0x40 | (DEMUX_TS_PMT_PID >> 8);
+    p[2] = DEMUX_TS_PMT_PID & 0xff;
+    p[3] = 0x10;
+    p[4] = 0x00;
+    p[5] = 0x02;
+    p[6] = 0xb0 | (section_len >> 8);
+    p[7] = section_len & 0xff;
+    p[8] = 0x00; p[9] = 0x01;           // program_number
+    p[10] = 0xc1;
+    p[11] = 0x00; p[12] = 0x00;
+    p[13] = 0xe0 | (ts->pcr_pid >> 8);
+    p[14] = ts->pcr_pid & 0xff;
+    p[15] = 0xf0; p[16] = 0x00;         // program_info_length
+    p += 17;
+    for(i = 0;i < ts->stream_count;i++){
+        p[0] = ts->stream[i].stream_type;
+        p[1] = 0xe0 | (ts->stream[i].pid >> 8);
+        p[2] = ts->stream[i].pid & 0xff;
+        p[3] = 0xf0; p[4] = 0x00;
+        p += 5;
+    }
+    demux_ts_write_crc(ts->pmt + 5, 3 + section_len - 4);
+}
+
+static int demux_ts_flush_batch(demux_ts_t* ts){
+    int ret = 0;
+
+    if(ts->batch_count == 0){
+        return 0;
+    }
+
+    ret = demux_sink_write(ts->sink, ts->batch, ts->batch_count * DEMUX_TS_PACKET_SIZE);
+    ts->batch_count = 0;
+
+    return ret;
+}
+
+static uint8_t* demux_ts_next_slot(demux_ts_t* ts){
+    if(ts->batch_count == DEMUX_TS_BATCH_PACKETS){
+        if(demux_ts_flush_batch(ts) < 0){
+            return NULL;
+        }
+    }
+
+    ts->packet_count++;
+
+    return ts->batch + (ts->batch_count++) * DEMUX_TS_PACKET_SIZE;
+}
+
+static int demux_ts_write_psi(demux_ts_t* ts){
+    uint8_t* slot = NULL;
+
+    slot = demux_ts_next_slot(ts);
+    if(slot == NULL){
+        return -1;
+    }
+    memcpy(slot, ts->pat, DEMUX_TS_PACKET_SIZE);
+    slot[3] = 0x10 | (ts->pat_cc++ & 0x0f);
+
+    slot = demux_ts_next_slot(ts);
+    if(slot == NULL){
+        return -1;
+    }
+    memcpy(slot, ts->pmt, DEMUX_TS_PACKET_SIZE);
+    slot[3] = 0x10 | (ts->pmt_cc++ & 0x0f);
+
+    return 0;
+}
+
+static void demux_ts_write_timestamp(uint8_t* p, uint8_t prefix, int64_t ts){
+    p[0] = (prefix << 4) | (((ts >> 30) & 0x07) << 1) | 1;
+    p[1] = (ts >> 22) & 0xff;
+    p[2] = (((ts >> 15) & 0x7f) << 1) | 1;
+    p[3] = (ts >> 7) & 0xff;
+    p[4] = ((ts & 0x7f) << 1) | 1;
+}
+
+static void demux_ts_write_pcr(uint8_t* p, int64_t pcr){
+    int64_t base = pcr / 300;
+    int64_t ext = pcr % 300;
+
+    p[0] = base >> 25;
+    p[1] = base >> 17;
+    p[2] = base >> 9;
+    p[3] = base >> 1;
+    p[4] = ((base & 1) << 7) | 0x7e | (ext >> 8);
+    p[5] = ext & 0xff;
+}
+
+/* 把一个pes切成188字节的ts包, 第一个包带pes头, 需要时带pcr, 最后一个包用adaptation field填充 */
+static int demux_ts_write_pes(demux_ts_t* ts, demux_ts_stream_t* stream, const uint8_t* pes_header,
+                              uint32_t header_len, const uint8_t* payload, uint32_t payload_len, int64_t pcr){
+    uint8_t* slot = NULL;
+    uint32_t left = header_len + payload_len;
+    uint32_t space = 0;
+    uint32_t copy_len = 0;
+    uint32_t pos = 0;
+    int af_len = -1;
+    uint8_t af_flags = 0;
+    int first = 1;
+
+    while(left > 0){
+        slot = demux_ts_next_slot(ts);
+        if(slot == NULL){
+            return -1;
+        }
+
+        af_len = -1;
+        af_flags = 0;
+        if(first && pcr >= 0){
+            af_len = 7;
+            af_flags = 0x10;
+        }
+
+        space = 184 - (af_len >= 0 ? af_len + 1 : 0);
+        if(left < space){
+            if(af_len < 0){
+                af_len = space - left - 1;
+            }else{
+                af_len += space - left;
+            }
+            space = left;
+        }
+
+        memcpy(slot, stream->header, 4);
+        if(first){
+            slot[1] |= 0x40;
+        }
+        slot[3] = (af_len >= 0 ? 0x30 : 0x10) | (stream->cc++ & 0x0f);
+        pos = 4;
+
+        if(af_len >= 0){
+            slot[4] = af_len;
+            if(af_len > 0){
+                slot[5] = af_flags;
+                memset(slot + 6, 0xff, af_len - 1);
+                if(af_flags & 0x10){
+                    demux_ts_write_pcr(slot + 6, pcr);
+                }
+            }
+            pos += af_len + 1;
+        }
+
+        if(first){
+            memcpy(slot + pos, pes_header, header_len);
+            pos += header_len;
+            space -= header_len;
+            left -= header_len;
+        }
+
+        copy_len = space;
+        memcpy(slot + pos, payload, copy_len);
+        payload += copy_len;
+        left -= copy_len;
+        first = 0;
+    }
+
+    return 0;
+}
+
+static int demux_ts_reserve_pes_buf(demux_ts_t* ts, uint32_t size){
+    if(size <= ts->pes_buf_size){
+        return 0;
+    }
+
+    free(ts->pes_buf);
+    ts->pes_buf = (uint8_t*)malloc(size);
+    if(ts->pes_buf == NULL){
+        printf("pes_buf NULL\n");
+        ts->pes_buf_size = 0;
+        return -1;
+    }
+    ts->pes_buf_size = size;
+
+    return 0;
+}
+
+/* avcc -> annexb, 前面加aud, 关键帧前加sps/pps */
+static int demux_ts_build_h264_payload(demux_ts_t* ts, demux_ts_stream_t* stream, const demux_packet_t* pkt, uint32_t* payload_len){
+    static const uint8_t aud[6] = {0x00, 0x00, 0x00, 0x01, 0x09, 0xf0};
+    static const uint8_t start_code[4] = {0x00, 0x00, 0x00, 0x01};
+    video_ctrl_t* track = stream->track;
+    uint32_t nal_length_size = track->nal_length_size ? track->nal_length_size : 4;
+    uint32_t bound = sizeof(aud) + 8 + track->sps_len + track->pps_len + pkt->size + (pkt->size / nal_length_size + 1) * 4;
+    uint32_t nal_len = 0;
+    uint32_t pos = 0;
+    uint32_t len = 0;
+    uint8_t* p = NULL;
+    uint32_t i = 0;
+
+    if(demux_ts_reserve_pes_buf(ts, bound) < 0){
+        return -1;
+    }
+    p = ts->pes_buf;
+
+    memcpy(p + len, aud, sizeof(aud));
+    len += sizeof(aud);
+    if(pkt->keyframe){
+        memcpy(p + len, start_code, 4);
+        memcpy(p + len + 4, track->sps, track->sps_len);
+        len += 4 + track->sps_len;
+        memcpy(p + len, start_code, 4);
+        memcpy(p + len + 4, track->pps, track->pps_len);
+        len += 4 + track->pps_len;
+    }
+
+    while(pos + nal_length_size <= pkt->size){
+        nal_len = 0;
+        for(i = 0;i < nal_length_size;i++){
+            nal_len = (nal_len << 8) | pkt->data[pos + i];
+        }
+        pos += nal_length_size;
+        if(nal_len > pkt->size - pos){
+            printf("nal_len[%u] out of sample size[%u]\n", nal_len, pkt->size);
+            return -1;
+        }
+        /* 样本里自带的aud丢掉, 前面已经统一加过 */
+        if(nal_len > 0 && (pkt->data[pos] & 0x1f) != 9){
+            memcpy(p + len, start_code, 4);
+            memcpy(p + len + 4, pkt->data + pos, nal_len);
+            len += 4 + nal_len;
+        }
+        pos += nal_len;
+    }
+
+    *payload_len = len;
+
+    return 0;
+}
+
+static int demux_ts_build_aac_payload(demux_ts_t* ts, demux_ts_stream_t* stream, const demux_packet_t* pkt, uint32_t* payload_len){
+    uint32_t frame_len = pkt->size + sizeof(stream->adts);
+    uint8_t* p = NULL;
+
+    if(frame_len > 0x1fff){
+        printf("aac frame too large [%u]\n", frame_len);
+        return -1;
+    }
+    if(demux_ts_reserve_pes_buf(ts, frame_len) < 0){
+        return -1;
+    }
+    p = ts->pes_buf;
+
+    memcpy(p, stream->adts, sizeof(stream->adts));
+    p[3] |= (frame_len >> 11) & 0x03;
+    p[4] = (frame_len >> 3) & 0xff;
+    p[5] |= (frame_len & 0x07) << 5;
+    memcpy(p + sizeof(stream->adts), pkt->data, pkt->size);
+
+    *payload_len = frame_len;
+
+    return 0;
+}
+
+static int demux_ts_init_adts(demux_ts_stream_t* stream){
+    video_ctrl_t* track = stream->track;
+    uint8_t object_type = 2;
+    uint8_t freq_index = 0;
+    uint8_t channel_config = track->channel_count;
+    uint32_t i = 0;
+
+    if(track->audio_config_len >= 2){
+        object_type = track->audio_config[0] >> 3;
+        freq_index = ((track->audio_config[0] & 0x07) << 1) | (track->audio_config[1] >> 7);
+        channel_config = (track->audio_config[1] >> 3) & 0x0f;
+    }else{
+        for(i = 0;i < sizeof(demux_aac_sample_rates) / sizeof(demux_aac_sample_rates[0]);i++){
+            if(demux_aac_sample_rates[i] == track->sample_rate){
+                freq_index = i;
+                break;
+            }
+        }
+    }
+
+    if(object_type == 0 || object_type > 4 || freq_index > 12){
+        printf("aac object_type[%u] freq_index[%u] not support adts\n", object_type, freq_index);
+        return -1;
+    }
+
+    stream->adts[0] = 0xff;
+    stream->adts[1] = 0xf1;
+    stream->adts[2] = ((object_type - 1) << 6) | (freq_index << 2) | (channel_config >> 2);
+    stream->adts[3] = (channel_config & 0x03) << 6;
+    stream->adts[4] = 0x00;
+    stream->adts[5] = 0x1f;
+    stream->adts[6] = 0xfc;
+
+    return 0;
+}
+
+demux_ts_t* demux_ts_open(demux_ctrl_t* demux_ctrl, demux_sink_t* sink){
+    demux_ts_stream_t* stream = NULL;
+    video_ctrl_t* track = NULL;
+    demux_ts_t* ts = NULL;
+    int pcr_on_video = 0;
+    int i = 0;
+
+    if(demux_ctrl == NULL || sink == NULL){
+        printf("demux_ctrl[%p] sink[%p] NULL\n", demux_ctrl, sink);
+        return NULL;
+    }
+
+    ts = (demux_ts_t*)calloc(1, sizeof(demux_ts_t));
+    if(ts == NULL){
+        printf("ts NULL\n");
+        return NULL;
+    }
+    ts->sink = sink;
+    ts->last_psi_time = -1;
+    ts->batch = (uint8_t*)malloc(DEMUX_TS_BATCH_PACKETS * DEMUX_TS_PACKET_SIZE);
+    if(ts->batch == NULL){
+        printf("ts batch NULL\n");
+        free(ts);
+        return NULL;
+    }
+
+    for(i = 0;i < DEMUX_MAX_TRACK_NUM;i++){
+        ts->track_stream[i] = -1;
+    }
+
+    for(i = 0;i < demux_ctrl->track_count && ts->stream_count < DEMUX_TS_MAX_STREAM;i++){
+        track = demux_ctrl->track[i];
+        stream = &ts->stream[ts->stream_count];
+        stream->track_index = i;
+        stream->track = track;
+        stream->pid = DEMUX_TS_FIRST_PID + ts->stream_count;
+        stream->edit_shift = demux_timeline_edit_shift(demux_ctrl, i);
+
+        if(strcmp(track->codec, "avc1") == 0){
+            stream->stream_type = DEMUX_TS_STREAM_TYPE_H264;
+            stream->stream_id = 0xe0;
+            /* pcr优先放在视频pid上 */
+            if(!pcr_on_video){
+                ts->pcr_pid = stream->pid;
+                pcr_on_video = 1;
+            }
+        }else if(strcmp(track->codec, "mp4a") == 0){
+            stream->stream_type = DEMUX_TS_STREAM_TYPE_AAC;
+            stream->stream_id = 0xc0;
+            if(demux_ts_init_adts(stream) < 0){
+                continue;
+            }
+            if(ts->pcr_pid == 0){
+                ts->pcr_pid = stream->pid;
+            }
+        }else{
+            printf("track %u codec[%s] not support in ts, skip\n", track->track_id, track->codec);
+            continue;
+        }
+
+        stream->header[0] = 0x47;
+        stream->header[1] = stream->pid >> 8;
+        stream->header[2] = stream->pid & 0xff;
+        stream->header[3] = 0x10;
+        ts->track_stream[i] = ts->stream_count++;
+    }
+
+    if(ts->stream_count == 0){
+        printf("no stream for ts\n");
+        free(ts->batch);
+        free(ts);
+        return NULL;
+    }
+
+    demux_ts_build_psi(ts);
+
+    return ts;
+}
+
+int demux_ts_write_packet(demux_ts_t* ts, const demux_packet_t* pkt){
+    demux_ts_stream_t* stream = NULL;
+    uint8_t pes_header[19];
+    uint32_t header_len = 0;
+    uint32_t payload_len = 0;
+    uint32_t pes_len = 0;
+    int64_t dts = 0;
+    int64_t pts = 0;
+    int64_t pcr = -1;
+    int ret = 0;
+
+    if(ts == NULL || pkt == NULL || pkt->track_index < 0 || pkt->track_index >= DEMUX_MAX_TRACK_NUM){
+        printf("ts[%p] pkt[%p] error\n", ts, pkt);
+        return -1;
+    }
+
+    if(ts->track_stream[pkt->track_index] < 0){
+        return 0;
+    }
+    stream = &ts->stream[ts->track_stream[pkt->track_index]];
+
+    /* 换算到90kHz */
+    dts = (pkt->dts + stream->edit_shift) * 90000 / stream->track->timescale;
+    pts = pkt->pts * 90000 / stream->track->timescale;
+
+    if(ts->last_psi_time < 0 || dts - ts->last_psi_time >= DEMUX_TS_PSI_INTERVAL ||
+       (pkt->keyframe && stream->stream_type == DEMUX_TS_STREAM_TYPE_H264)){
+        ret = demux_ts_write_psi(ts);
+        if(ret < 0){
+            return -1;
+        }
+        ts->last_psi_time = dts;
+    }
+
+    if(stream->stream_type == DEMUX_TS_STREAM_TYPE_H264){
+        ret = demux_ts_build_h264_payload(ts, stream, pkt, &payload_len);
+    }else{
+        ret = demux_ts_build_aac_payload(ts, stream, pkt, &payload_len);
+    }
+    if(ret < 0){
+        return -1;
+    }
+
+    /* pes头 */
+    pes_header[0] = 0x00;
+    pes_header[1] = 0x00;
+    pes_header[2] = 0x01;
+    pes_header[3] = stream->stream_id;
+    pes_header[6] = 0x80;
+    if(pts != dts){
+        pes_header[7] = 0xc0;
+        pes_header[8] = 10;
+        demux_ts_write_timestamp(pes_header + 9, 0x03, pts + DEMUX_TS_DELAY);
+        demux_ts_write_timestamp(pes_header + 14, 0x01, dts + DEMUX_TS_DELAY);
+        header_len = 19;
+    }else{
+        pes_header[7] = 0x80;
+        pes_header[8] = 5;
+        demux_ts_write_timestamp(pes_header + 9, 0x02, pts + DEMUX_TS_DELAY);
+        header_len = 14;
+    }
+    /* 视频pes长度可能超过65535, 填0表示不限长度 */
+    pes_len = header_len - 6 + payload_len;
+    if(stream->stream_type == DEMUX_TS_STREAM_TYPE_H264 || pes_len > 0xffff){
+        pes_len = 0;
+    }
+    pes_header[4] = pes_len >> 8;
+    pes_header[5] = pes_len & 0xff;
+
+    /* elst平移后开头的dts可能为负, pcr从0开始 */
+    if(stream->pid == ts->pcr_pid){
+        pcr = dts > 0 ? dts * 300 : 0;
+    }
+
+    return demux_ts_write_pes(ts, stream, pes_header, header_len, ts->pes_buf, payload_len, pcr);
+}
+
+int demux_ts_close(demux_ts_t* ts){
+    int ret = 0;
+
+    if(ts == NULL){
+        return -1;
+    }
+
+    ret = demux_ts_flush_batch(ts);
+    if(ret >= 0){
+        ret = demux_sink_flush(ts->sink);
+    }
+
+    printf("ts output %lu packets\n", ts->packet_count);
+
+    free(ts->batch);
+    free(ts->pes_buf);
+    free(ts);
+
+    return ret;
+}
+
+int demux_remux_ts(demux_ctrl_t* demux_ctrl, demux_sink_t* sink){
+    demux_packet_reader_t reader;
+    demux_packet_t pkt;
+    demux_ts_t* ts = NULL;
+    int ret = 0;
+
+    ts = demux_ts_open(demux_ctrl, sink);
+    if(ts == NULL){
+        return -1;
+    }
+
+    ret = demux_packet_reader_init(&reader, demux_ctrl, DEMUX_PACKET_ALL_TRACK);
+    if(ret < 0){
+        demux_ts_close(ts);
+        return -1;
+    }
+
+    while((ret = demux_read_packet(&reader, &pkt)) > 0){
+        ret = demux_ts_write_packet(ts, &pkt);
+        if(ret < 0){
+            break;
+        }
+    }
+
+    demux_packet_reader_close(&reader);
+    if(demux_ts_close(ts) < 0){
+        ret = -1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,61 @@
+#ifndef __DEMUX_TS_H
+#define __DEMUX_TS_H
+
+#include <stdint.h>
+#include "demux.h"
+#include "demux_packet.h"
+
+#define DEMUX_TS_PACKET_SIZE 188
+#define DEMUX_TS_PAT_PID 0x0000
+#define DEMUX_TS_PMT_PID 0x1000
+#define DEMUX_TS_FIRST_PID 0x0100
+#define DEMUX_TS_MAX_STREAM 8
+#define DEMUX_TS_BATCH_PACKETS 4096         // 攒够这么多个ts包再交给sink
+#define DEMUX_TS_DELAY 63000                // pts/dts相对pcr的延迟, 0.7s
+#define DEMUX_TS_PSI_INTERVAL 9000          // pat/pmt至少每100ms重发一次
+
+#define DEMUX_TS_STREAM_TYPE_H264 0x1b
+#define DEMUX_TS_STREAM_TYPE_AAC 0x0f
+
+typedef struct demux_ts_stream
+{
+    int track_index;
+    video_ctrl_t* track;
+    uint16_t pid;
+    uint8_t stream_type;
+    uint8_t stream_id;
+    uint8_t cc;
+    uint8_t header[4];      // ts包头模板, 只需改pusi和cc
+    uint8_t adts[7];        // aac的adts头模板, 只需填frame_length
+    int64_t edit_shift;     // elst的显示偏移, pkt的pts已经带上, dts同样平移后再换算
+}demux_ts_stream_t;
+
+typedef struct demux_ts
+{
+    demux_sink_t* sink;
+    int stream_count;
+    demux_ts_stream_t stream[DEMUX_TS_MAX_STREAM];
+    int track_stream[DEMUX_MAX_TRACK_NUM];
+    uint16_t pcr_pid;
+
+    uint8_t pat[DEMUX_TS_PACKET_SIZE];
+    uint8_t pmt[DEMUX_TS_PACKET_SIZE];
+    uint8_t pat_cc;
+    uint8_t pmt_cc;
+    int64_t last_psi_time;
+
+    uint8_t* batch;
+    uint32_t batch_count;
+
+    uint8_t* pes_buf;
+    uint32_t pes_buf_size;
+
+    uint64_t packet_count;
+}demux_ts_t;
+
+extern demux_ts_t* demux_ts_open(demux_ctrl_t* demux_ctrl, demux_sink_t* sink);
+extern int demux_ts_write_packet(demux_ts_t* ts, const demux_packet_t* pkt);
+extern int demux_ts_close(demux_ts_t* ts);
+extern int demux_remux_ts(demux_ctrl_t* demux_ctrl, demux_sink_t* sink);
+
+#endif
@@ -2,20 +2,695 @@
 #include <stdint.h>
 #include <malloc.h>
 #include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "demux.h"
+#include "demux_ts.h"
+#include "demux_faststart.h"
+#include "demux_cut.h"
+#include "demux_range.h"
+#include "demux_push.h"
+#include "demux_follow.h"
+#include "demux_segment.h"
+#include "demux_probe.h"
+#include "demux_gop.h"
+#include "demux_daemon.h"
+#include "demux_keyframe.h"
+#include "demux_shared.h"
+#include "demux_pipeline.h"
+#include "demux_timeline.h"
+#include "demux_analytics.h"
+
+/* 整个文件读进内存, 模拟上传服务已经持有数据的情况 */
+static uint8_t* demux_load_file(const char* file_path, uint64_t* len){
+    uint8_t* data = NULL;
+    FILE* fp = fopen(file_path, "rb");
+
+    if(fp == NULL){
+        printf("open %s failed\n", file_path);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    data = (uint8_t*)malloc(*len ? *len : 1);
+    if(data != NULL && fread(data, 1, *len, fp) != *len){
+        printf("read %s failed\n", file_path);
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+
+    return data;
+}
+
+typedef struct demux_push_output
+{
+    int track_index;
+    demux_sink_t* sink;
+}demux_push_output_t;
+
+static int demux_push_on_track(void* user, demux_ctrl_t* demux_ctrl, int track_index){
+    demux_push_output_t* output = (demux_push_output_t*)user;
+    video_ctrl_t* track = demux_get_track(demux_ctrl, track_index);
+
+    printf("push track %u %s %s samples[%u]\n", track->track_id, track->handler_type, track->codec, track->sample_count);
+    if(output->track_index < 0 && strcmp(track->handler_type, "vide") == 0){
+        output->track_index = track_index;
+    }
+
+    return 0;
+}
+
+static int demux_push_on_packet(void* user, demux_packet_t* pkt){
+    demux_push_output_t* output = (demux_push_output_t*)user;
+
+    if(pkt->track_index != output->track_index){
+        return 0;
+    }
+
+    return demux_sink_write(output->sink, pkt->data, pkt->size);
+}
+
+/* 按小块把文件喂给推模式解析, 视频sample原样写到out.h264 */
+static int demux_push_file(const char* file_path, uint32_t chunk_size){
+    demux_push_output_t output = {-1, NULL};
+    demux_push_callback_t callback = {demux_push_on_track, demux_push_on_packet, &output};
+    demux_push_t* push = NULL;
+    uint8_t* buf = NULL;
+    FILE* fp = NULL;
+    size_t read_size = 0;
+    int ret = -1;
+
+    fp = fopen(file_path, "rb");
+    buf = (uint8_t*)malloc(chunk_size);
+    output.sink = demux_sink_open_file("out.h264");
+    push = demux_push_open(&callback);
+    if(fp == NULL || buf == NULL || output.sink == NULL || push == NULL){
+        printf("push open %s failed\n", file_path);
+        goto end;
+    }
+
+    while((read_size = fread(buf, 1, chunk_size, fp)) > 0){
+        if(demux_feed(push, buf, read_size) < 0){
+            goto end;
+        }
+    }
+    ret = demux_feed_end(push);
+
+end:
+    demux_push_close(push);
+    demux_sink_close(output.sink);
+    free(buf);
+    if(fp != NULL){
+        fclose(fp);
+    }
+
+    return ret;
+}
+
+/* 跟随还在录制的文件, 文件idle_seconds秒不再增长后退出, 视频sample原样写到out.h264 */
+static int demux_follow_file(const char* file_path, int idle_seconds){
+    demux_push_output_t output = {-1, NULL};
+    demux_follow_callback_t callback = {demux_push_on_track, demux_push_on_packet, &output};
+    demux_follow_t* follow = NULL;
+    int ret = -1;
+
+    output.sink = demux_sink_open_file("out.h264");
+    follow = demux_follow_open(file_path, &callback);
+    if(output.sink != NULL && follow != NULL){
+        ret = demux_follow_run(follow, idle_seconds * 1000);
+    }
+
+    demux_follow_close(follow);
+    demux_sink_close(output.sink);
+
+    return ret;
+}
+
+/* 按nal索引统计每种nal出现在多少个sample中 */
+static void demux_print_nal_index(const char* name, demux_nal_index_t* nal_index){
+    uint8_t types[] = {DEMUX_NAL_TYPE_IDR, DEMUX_NAL_TYPE_SEI, DEMUX_NAL_TYPE_AUD};
+    int64_t sample = 0;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    printf("%s: %u samples, %u nals\n", name, nal_index->sample_count, nal_index->nal_count);
+    for(i = 0;i < sizeof(types);i++){
+        count = 0;
+        sample = demux_nal_index_find(nal_index, 0, types[i]);
+        while(sample >= 0){
+            count++;
+            sample = demux_nal_index_find(nal_index, sample + 1, types[i]);
+        }
+        printf("  nal type %u in %u samples\n", types[i], count);
+    }
+}
+
+/* 输出的annexb文件整体作为一个sample, 用start code查找再建一次索引核对 */
+static void demux_check_annexb(const char* file_path){
+    demux_nal_index_t nal_index;
+    uint8_t* data = NULL;
+    uint64_t len = 0;
+
+    data = demux_load_file(file_path, &len);
+    if(data != NULL && demux_nal_index_init(&nal_index) == 0){
+        if(demux_nal_index_add_annexb(&nal_index, data, len) == 0){
+            demux_print_nal_index(file_path, &nal_index);
+        }
+        demux_nal_index_free(&nal_index);
+    }
+    free(data);
+}
+
+/* worker: 只按分片描述读取源文件, 不解析moov, 视频写到out.h264 */
+static int demux_shard_file(const char* shard_path){
+    demux_shard_t shard;
+    demux_sink_t* sink = NULL;
+    int ret = -1;
+
+    if(demux_shard_load(shard_path, &shard) < 0){
+        return -1;
+    }
+    sink = demux_sink_open_file("out.h264");
+    if(sink != NULL){
+        ret = demux_shard_output(&shard, sink);
+        demux_sink_close(sink);
+    }
+    demux_shard_free(&shard);
+
+    return ret;
+}
+
+/* 打印GOP列表, 给出out_dir时每个GOP写一个分片描述 */
+static int demux_gop_index(demux_ctrl_t* demux_ctrl, int track_index, const char* out_dir){
+    demux_gop_list_t list;
+    int ret = 0;
+
+    if(demux_gop_build(demux_ctrl, track_index, &list) < 0){
+        return -1;
+    }
+    demux_gop_print(&list);
+    if(out_dir != NULL){
+        ret = demux_gop_write_shards(demux_ctrl, &list, out_dir);
+    }
+    demux_gop_free(&list);
+
+    return ret;
+}
+
+static double demux_elapsed_us(struct timespec* start){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+/* demuxd客户端: probe, seek, 再按sample区间取回视频track, 用daemon传回的fd把sample原样拷贝到out.h264 */
+static int demux_query_daemon(const char* file_path, const char* sock_path){
+    demux_daemon_track_t tracks[DEMUX_DAEMON_MAX_TRACK];
+    demux_daemon_sample_t* samples = NULL;
+    demux_sink_t* sink = NULL;
+    struct timespec start;
+    char path[DEMUX_DAEMON_PATH_LENGTH] = {0};
+    uint32_t first_sample = 0;
+    int track_count = 0;
+    int track_index = -1;
+    int sock = -1;
+    int data_fd = -1;
+    int count = 0;
+    int ret = -1;
+    int i = 0;
+
+    /* daemon的工作目录和客户端不同, 传绝对路径 */
+    if(realpath(file_path, path) == NULL){
+        printf("realpath %s failed\n", file_path);
+        return -1;
+    }
+    sock = demux_daemon_connect(sock_path);
+    samples = (demux_daemon_sample_t*)malloc(DEMUX_DAEMON_MAX_SAMPLES * sizeof(demux_daemon_sample_t));
+    sink = demux_sink_open_file("out.h264");
+    if(sock < 0 || samples == NULL || sink == NULL){
+        goto end;
+    }
+
+    for(i = 0;i < 2;i++){
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        track_count = demux_daemon_probe(sock, path, tracks, DEMUX_DAEMON_MAX_TRACK);
+        printf("probe %d tracks, %.1f us\n", track_count, demux_elapsed_us(&start));
+    }
+    for(i = 0;i < track_count;i++){
+        printf("track %u %s %s timescale[%u] samples[%u] keyframes[%u] %ux%u\n", tracks[i].track_id, tracks[i].handler_type,
+            tracks[i].codec, tracks[i].timescale, tracks[i].sample_count, tracks[i].keyframe_count, tracks[i].width, tracks[i].height);
+        if(track_index < 0 && strcmp(tracks[i].handler_type, "vide") == 0){
+            track_index = i;
+        }
+    }
+    if(track_index < 0){
+        goto end;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    count = demux_daemon_seek(sock, path, track_index, 2.0, &samples[0]);
+    printf("seek 2.0s -> sample %d dts[%ld], %.1f us\n", count, samples[0].dts, demux_elapsed_us(&start));
+
+    ret = 0;
+    while(ret >= 0 && first_sample < tracks[track_index].sample_count){
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        count = demux_daemon_samples(sock, path, track_index, first_sample, DEMUX_DAEMON_MAX_SAMPLES, samples, &data_fd);
+        printf("samples [%u, %u), %.1f us\n", first_sample, first_sample + (count > 0 ? count : 0), demux_elapsed_us(&start));
+        if(count <= 0 || data_fd < 0){
+            ret = -1;
+            break;
+        }
+        for(i = 0;ret >= 0 && i < count;i++){
+            ret = demux_sink_copy_range(sink, data_fd, samples[i].offset, samples[i].size);
+        }
+        close(data_fd);
+        first_sample += count;
+    }
+    if(ret >= 0){
+        ret = demux_sink_flush(sink);
+    }
+
+end:
+    demux_sink_close(sink);
+    free(samples);
+    if(sock >= 0){
+        close(sock);
+    }
+
+    return ret;
+}
+
+#define DEMUX_CLIP_MAX_THREAD 64
+
+typedef struct demux_clip_worker
+{
+    pthread_t tid;
+    demux_shared_t* shared;
+    int track_index;
+    double time;
+    demux_sink_t* sink;         // 不为NULL时把读到的sample原样写出
+    uint32_t first_sample;
+    uint32_t sample_count;
+    uint64_t bytes;
+    uint32_t checksum;
+    int ret;
+}demux_clip_worker_t;
+
+/* 每个线程用自己的cursor从time开始读到结尾 */
+static void* demux_clip_thread(void* arg){
+    demux_clip_worker_t* worker = (demux_clip_worker_t*)arg;
+    demux_cursor_t* cursor = demux_cursor_open(worker->shared, worker->track_index);
+    demux_packet_t pkt;
+    uint32_t i = 0;
+    int ret = 0;
+
+    if(cursor == NULL){
+        worker->ret = -1;
+        return NULL;
+    }
+    worker->first_sample = demux_cursor_seek(cursor, worker->time);
+    while((ret = demux_cursor_read(cursor, &pkt)) > 0){
+        for(i = 0;i < pkt.size;i++){
+            worker->checksum = worker->checksum * 31 + pkt.data[i];
+        }
+        worker->sample_count++;
+        worker->bytes += pkt.size;
+        if(worker->sink != NULL && demux_sink_write(worker->sink, pkt.data, pkt.size) < 0){
+            ret = -1;
+            break;
+        }
+    }
+    worker->ret = ret;
+    demux_cursor_close(cursor);
+
+    return NULL;
+}
+
+/* 只解析一次, 多个线程共享sample表同时从不同时间点读视频track, 第0个线程从头读并原样写到out.h264 */
+static int demux_clip_file(const char* file_path, int thread_count){
+    demux_clip_worker_t workers[DEMUX_CLIP_MAX_THREAD];
+    demux_shared_t* shared = NULL;
+    video_ctrl_t* track = NULL;
+    int track_index = -1;
+    int ret = 0;
+    int i = 0;
+
+    if(thread_count <= 0 || thread_count > DEMUX_CLIP_MAX_THREAD){
+        thread_count = 4;
+    }
+    shared = demux_shared_open(file_path);
+    if(shared == NULL){
+        return -1;
+    }
+    track_index = demux_find_track(shared->demux_ctrl, "vide");
+    track = demux_get_track(shared->demux_ctrl, track_index);
+    if(track == NULL || track->timescale == 0){
+        demux_shared_unref(shared);
+        return -1;
+    }
+
+    memset(workers, 0, sizeof(workers));
+    for(i = 0;i < thread_count;i++){
+        workers[i].shared = shared;
+        workers[i].track_index = track_index;
+        workers[i].time = (double)track->duration / track->timescale * i / thread_count;
+        if(i == 0){
+            workers[i].sink = demux_sink_open_file("out.h264");
+        }
+        if(pthread_create(&workers[i].tid, NULL, demux_clip_thread, &workers[i]) != 0){
+            printf("pthread_create failed\n");
+            thread_count = i;
+            ret = -1;
+            break;
+        }
+    }
+    for(i = 0;i < thread_count;i++){
+        pthread_join(workers[i].tid, NULL);
+        printf("thread %d seek %.3f -> sample %u, read %u samples %lu bytes checksum %08x ret %d\n", i, workers[i].time,
+            workers[i].first_sample, workers[i].sample_count, workers[i].bytes, workers[i].checksum, workers[i].ret);
+        if(workers[i].ret < 0){
+            ret = -1;
+        }
+    }
+    if(workers[0].sink != NULL){
+        demux_sink_flush(workers[0].sink);
+        demux_sink_close(workers[0].sink);
+    }
+    demux_shared_unref(shared);
+
+    return ret;
+}
+
+#define DEMUX_POOL_BENCH_INFLIGHT 8
+
+/* 一遍读完所有track, 同时最多保留inflight个packet(模拟解码队列), sink不为NULL时写出video_index的sample */
+static int demux_pool_pass(demux_ctrl_t* demux_ctrl, demux_pool_t* pool, int video_index, demux_sink_t* sink, uint32_t* count){
+    demux_packet_reader_t reader;
+    demux_packet_t inflight[DEMUX_POOL_BENCH_INFLIGHT];
+    demux_packet_t pkt;
+    int ret = 0;
+    int i = 0;
+
+    memset(inflight, 0, sizeof(inflight));
+    *count = 0;
+    if(demux_packet_reader_init(&reader, demux_ctrl, DEMUX_PACKET_ALL_TRACK) < 0){
+        return -1;
+    }
+    demux_packet_reader_set_pool(&reader, pool);
+    while((ret = demux_read_packet(&reader, &pkt)) > 0){
+        if(sink != NULL && pkt.track_index == video_index && demux_sink_write(sink, pkt.data, pkt.size) < 0){
+            demux_pool_free(pool, pkt.buf);
+            ret = -1;
+            break;
+        }
+        i = *count % DEMUX_POOL_BENCH_INFLIGHT;
+        demux_pool_free(pool, inflight[i].buf);
+        inflight[i] = pkt;
+        (*count)++;
+    }
+    for(i = 0;i < DEMUX_POOL_BENCH_INFLIGHT;i++){
+        demux_pool_free(pool, inflight[i].buf);
+    }
+    demux_packet_reader_close(&reader);
+
+    return ret;
+}
+
+/* 第一遍预热缓冲池, 第二遍不应再有malloc; 第二遍的视频sample原样写到out.h264 */
+static int demux_pool_bench(demux_ctrl_t* demux_ctrl, int video_index){
+    demux_pool_t pool;
+    demux_sink_t* sink = NULL;
+    struct timespec start;
+    uint64_t warm_malloc = 0;
+    uint32_t count = 0;
+    int ret = 0;
+    int pass = 0;
+
+    if(demux_pool_init(&pool) < 0){
+        return -1;
+    }
+    for(pass = 0;ret >= 0 && pass < 2;pass++){
+        sink = pass == 1 ? demux_sink_open_file("out.h264") : NULL;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ret = demux_pool_pass(demux_ctrl, &pool, video_index, sink, &count);
+        printf("pass %d: %u packets, %.1f us, pool alloc[%lu] malloc[%lu] malloc_bytes[%lu]\n", pass, count,
+            demux_elapsed_us(&start), pool.alloc_count, pool.malloc_count, pool.malloc_bytes);
+        if(sink != NULL){
+            demux_sink_flush(sink);
+            demux_sink_close(sink);
+        }
+        if(pass == 0){
+            warm_malloc = demux_pool_malloc_count(&pool);
+        }
+    }
+    if(ret >= 0 && demux_pool_malloc_count(&pool) != warm_malloc){
+        printf("steady state malloc %lu, expect 0\n", demux_pool_malloc_count(&pool) - warm_malloc);
+        ret = -1;
+    }else if(ret >= 0){
+        printf("steady state malloc 0\n");
+    }
+    demux_pool_destroy(&pool);
+
+    return ret;
+}
+
+/* 打印每个track的时间线, 并和packet reader逐sample得到的dts/pts核对 */
+static int demux_print_timeline(demux_ctrl_t* demux_ctrl){
+    demux_timeline_t timeline;
+    demux_packet_reader_t reader;
+    demux_packet_t pkt;
+    video_ctrl_t* track = NULL;
+    uint32_t mismatch = 0;
+    uint32_t found = 0;
+    int ret = 0;
+    int i = 0;
+
+    for(i = 0;ret >= 0 && i < demux_get_track_count(demux_ctrl);i++){
+        track = demux_get_track(demux_ctrl, i);
+        if(demux_timeline_build(&timeline, demux_ctrl, i) < 0){
+            return -1;
+        }
+        printf("track %u %s timescale[%u] samples[%u] %s runs[%u] ctts[%u] pts_shift[%ld] end_dts[%ld] %.3fs, %lu bytes\n",
+            track->track_id, track->handler_type, timeline.timescale, timeline.sample_count, timeline.cfr ? "cfr" : "vfr",
+            timeline.run_count, track->ctts_entry_count, timeline.pts_shift, timeline.end_dts,
+            timeline.timescale ? (double)timeline.end_dts / timeline.timescale : 0, demux_timeline_bytes(&timeline));
+
+        mismatch = 0;
+        ret = demux_packet_reader_init(&reader, demux_ctrl, 1u << i);
+        while(ret >= 0 && demux_read_packet_info(&reader, &pkt) > 0){
+            /* find要返回dts相同(sample_delta为0)的一段中的最后一个 */
+            found = demux_timeline_find(&timeline, pkt.dts);
+            if(pkt.dts != demux_timeline_dts(&timeline, pkt.sample_index) ||
+               pkt.pts != demux_timeline_pts(&timeline, pkt.sample_index) ||
+               pkt.duration != demux_timeline_duration(&timeline, pkt.sample_index) ||
+               found < pkt.sample_index || demux_timeline_dts(&timeline, found) != pkt.dts ||
+               (found + 1 < timeline.sample_count && demux_timeline_dts(&timeline, found + 1) <= pkt.dts)){
+                mismatch++;
+            }
+            if(pkt.sample_index < 4){
+                printf("  sample %u dts[%ld] pts[%ld] %.3fs\n", pkt.sample_index, demux_timeline_dts(&timeline, pkt.sample_index),
+                    demux_timeline_pts(&timeline, pkt.sample_index),
+                    timeline.timescale ? (double)demux_timeline_pts(&timeline, pkt.sample_index) / timeline.timescale : 0);
+            }
+        }
+        demux_packet_reader_close(&reader);
+        printf("  check with packet reader: %u mismatch\n", mismatch);
+        demux_timeline_free(&timeline);
+    }
+
+    return ret;
+}
+
+/* 只用sample表统计每个track的码率和GOP, 视频track另写到analytics.json */
+static int demux_print_analytics(demux_ctrl_t* demux_ctrl, int track_index){
+    demux_analytics_t analytics;
+    FILE* fp = NULL;
+    int i = 0;
+
+    for(i = 0;i < demux_get_track_count(demux_ctrl);i++){
+        if(demux_analytics_build(demux_ctrl, i, &analytics) < 0){
+            continue;
+        }
+        demux_analytics_print(&analytics);
+        if(i == track_index){
+            fp = fopen("analytics.json", "w");
+            if(fp != NULL){
+                demux_analytics_dump_json(&analytics, fp);
+                fclose(fp);
+            }
+        }
+        demux_analytics_free(&analytics);
+    }
+
+    return 0;
+}
+
+/* sink模式的消费者: ring sink从ring取数据, pipe sink从pipe读端取数据, 写到out.h264 */
+typedef struct demux_sink_drain
+{
+    pthread_t tid;
+    demux_sink_t* ring;
+    int fd;
+    FILE* fp;
+    int ret;
+}demux_sink_drain_t;
+
+static void* demux_sink_drain_thread(void* arg){
+    demux_sink_drain_t* drain = (demux_sink_drain_t*)arg;
+    uint8_t buf[64 * 1024];
+    int64_t read_size = 0;
+
+    while(1){
+        if(drain->ring != NULL){
+            read_size = demux_sink_ring_read(drain->ring, buf, sizeof(buf));
+        }else{
+            read_size = read(drain->fd, buf, sizeof(buf));
+        }
+        if(read_size <= 0){
+            break;
+        }
+        if(fwrite(buf, 1, read_size, drain->fp) != (size_t)read_size){
+            read_size = -1;
+            break;
+        }
+    }
+    drain->ret = read_size < 0 ? -1 : 0;
+
+    return NULL;
+}
+
+static int demux_sink_file_callback(const struct iovec* iov, int iov_count, void* user){
+    FILE* fp = (FILE*)user;
+    int i = 0;
+
+    for(i = 0;i < iov_count;i++){
+        if(fwrite(iov[i].iov_base, 1, iov[i].iov_len, fp) != iov[i].iov_len){
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* 用ring/callback/pipe sink输出视频track, 结果和默认的文件sink一致 */
+static int demux_sink_output(demux_ctrl_t* demux_ctrl, int track_index, const char* kind){
+    demux_sink_drain_t drain;
+    demux_sink_t* sink = NULL;
+    int pipe_fd[2] = {-1, -1};
+    int started = 0;
+    int ret = -1;
+
+    memset(&drain, 0, sizeof(demux_sink_drain_t));
+    drain.fd = -1;
+    drain.fp = fopen("out.h264", "wb");
+    if(drain.fp == NULL){
+        printf("open out.h264 failed\n");
+        return -1;
+    }
+
+    if(strcmp(kind, "callback") == 0){
+        sink = demux_sink_open_callback(demux_sink_file_callback, drain.fp);
+    }else if(strcmp(kind, "ring") == 0){
+        sink = demux_sink_open_ring(DEMUX_SINK_PIPE_BUFFER_BYTES);
+        drain.ring = sink;
+    }else if(strcmp(kind, "pipe") == 0 && pipe(pipe_fd) == 0){
+        sink = demux_sink_open_pipe(pipe_fd[1]);
+        drain.fd = pipe_fd[0];
+    }
+    if(sink == NULL){
+        printf("sink[%s] open failed\n", kind);
+        goto end;
+    }
+    if(drain.ring != NULL || drain.fd >= 0){
+        if(pthread_create(&drain.tid, NULL, demux_sink_drain_thread, &drain) != 0){
+            printf("pthread_create failed\n");
+            goto end;
+        }
+        started = 1;
+    }
+
+    ret = demux_output_track(demux_ctrl, track_index, sink);
+    printf("sink[%s] %lu bytes, %lu writes\n", kind, sink->write_bytes, sink->write_calls);
+
+end:
+    /* 先让消费者看到结束: ring标记finish, pipe关闭写端, 再等它取完 */
+    if(drain.ring != NULL){
+        demux_sink_ring_finish(sink);
+    }else if(sink != NULL){
+        demux_sink_close(sink);
+        sink = NULL;
+    }
+    if(pipe_fd[1] >= 0){
+        close(pipe_fd[1]);
+    }
+    if(started){
+        pthread_join(drain.tid, NULL);
+        if(drain.ret < 0){
+            ret = -1;
+        }
+    }
+    demux_sink_close(sink);
+    if(pipe_fd[0] >= 0){
+        close(pipe_fd[0]);
+    }
+    fclose(drain.fp);
+
+    return ret;
+}
 
 int main(int argc, char** argv){
     char* file_path = NULL;
     uint32_t path_len = 0;
-    FILE* fp = NULL;
+    uint8_t* file_data = NULL;
+    uint64_t file_len = 0;
     char box_type[8] = {0};
     int ret = 0;
+    int track_index = -1;
+    demux_sink_t* sink = NULL;
+    demux_nal_index_t nal_index;
+    int nal_mode = 0;
+    demux_stats_t stats;
+    FILE* stats_fp = NULL;
+    demux_keyframe_opt_t keyframe_opt = {0, 0};
+    demux_pipeline_opt_t pipeline_opt = {0, DEMUX_PIPELINE_WAIT_SPIN};
+    demux_pipeline_stats_t pipeline_stats;
 
     if(argc < 2){
         printf("arg error\n");
         return -1;
     }
     
+    if(argc > 3 && strcmp(argv[2], "faststart") == 0){
+        return demux_faststart(argv[1], argv[3]);
+    }
+    if(argc > 2 && strcmp(argv[2], "push") == 0){
+        return demux_push_file(argv[1], argc > 3 ? atoi(argv[3]) : 4096);
+    }
+    if(argc > 2 && strcmp(argv[2], "follow") == 0){
+        return demux_follow_file(argv[1], argc > 3 ? atoi(argv[3]) : 5);
+    }
+    if(argc > 2 && strcmp(argv[2], "shard") == 0){
+        return demux_shard_file(argv[1]);
+    }
+    if(argc > 2 && strcmp(argv[2], "demuxd") == 0){
+        /* sock demuxd [root] */
+        return demux_daemon_run(argv[1], argc > 3 ? argv[3] : NULL);
+    }
+    if(argc > 3 && strcmp(argv[2], "query") == 0){
+        return demux_query_daemon(argv[1], argv[3]);
+    }
+    if(argc > 2 && strcmp(argv[2], "clip") == 0){
+        return demux_clip_file(argv[1], argc > 3 ? atoi(argv[3]) : 4);
+    }
+
     path_len = strlen(argv[1]);
     file_path = (char*)calloc(1, path_len + 1);
     strcpy(file_path, argv[1]);
@@ -26,13 +701,106 @@ int main(int argc, char** argv){
     if(demux_ctrl == NULL){
         printf("demux_ctrl NULL\n");
     }
-    demux_init(demux_ctrl, file_path, strlen(file_path));
+    if(argc > 2 && strcmp(argv[2], "fetch") == 0){
+        /* 用本地文件模拟range请求的远端输入 */
+        demux_init_io(demux_ctrl, demux_io_open_fetch(demux_fetch_open_file(file_path),
+                      DEMUX_RANGE_GAP_THRESHOLD, DEMUX_RANGE_MAX_REQUEST));
+    }else if(argc > 2 && strcmp(argv[2], "mmap") == 0){
+        demux_init_io(demux_ctrl, demux_io_open_mmap(file_path));
+    }else if(argc > 2 && strcmp(argv[2], "mem") == 0){
+        file_data = demux_load_file(file_path, &file_len);
+        demux_init_io(demux_ctrl, demux_io_open_memory(file_data, file_len));
+    }else{
+        demux_init(demux_ctrl, file_path, strlen(file_path));
+    }
+
+    if(argc > 2 && strcmp(argv[2], "raw") == 0){
+        demux_set_output_mode(demux_ctrl, DEMUX_OUTPUT_RAW);
+    }
+    if(argc > 2 && strcmp(argv[2], "nal") == 0 && demux_nal_index_init(&nal_index) == 0){
+        nal_mode = 1;
+        demux_set_nal_index(demux_ctrl, &nal_index);
+    }
+
+    if(argc > 2 && strcmp(argv[2], "threads") == 0){
+        demux_set_parse_threads(demux_ctrl, argc > 3 ? atoi(argv[3]) : 0);
+    }
+
+    /* 先用头尾两次读定位moov, 找不到时从头逐个box遍历 */
+    if(demux_probe(demux_ctrl, DEMUX_PROBE_WINDOW) < 0){
+        while(ret >= 0){
+            ret = demux_handle_box_body(demux_ctrl);
+        }
+    }
 
-    while(ret >= 0){
-        ret = demux_handle_box_body(demux_ctrl);
+    /* box解析完后再按track输出 */
+    track_index = demux_find_track(demux_ctrl, "vide");
+    if(argc > 5 && strcmp(argv[2], "cut") == 0){
+        demux_cut(demux_ctrl, atof(argv[3]), atof(argv[4]), argv[5]);
+    }else if(argc > 4 && strcmp(argv[2], "segment") == 0){
+        demux_segment(demux_ctrl, atof(argv[3]), argv[4]);
+    }else if(argc > 2 && strcmp(argv[2], "gop") == 0){
+        demux_gop_index(demux_ctrl, track_index, argc > 3 ? argv[3] : NULL);
+    }else if(argc > 2 && strcmp(argv[2], "keyframe") == 0 && track_index >= 0){
+        /* keyframe [每N个取一个] [间隔秒数] */
+        keyframe_opt.every_n = argc > 3 ? atoi(argv[3]) : 0;
+        keyframe_opt.interval = argc > 4 ? atof(argv[4]) : 0;
+        sink = demux_sink_open_file("out.h264");
+        if(sink != NULL){
+            demux_output_keyframes(demux_ctrl, track_index, &keyframe_opt, sink);
+            demux_sink_close(sink);
+        }
+    }else if(argc > 2 && strcmp(argv[2], "pipeline") == 0 && track_index >= 0){
+        /* pipeline [深度] [sleep] */
+        pipeline_opt.depth = argc > 3 ? atoi(argv[3]) : 0;
+        pipeline_opt.wait = argc > 4 && strcmp(argv[4], "sleep") == 0 ? DEMUX_PIPELINE_WAIT_SLEEP : DEMUX_PIPELINE_WAIT_SPIN;
+        sink = demux_sink_open_file("out.h264");
+        if(sink != NULL && demux_pipeline_output(demux_ctrl, track_index, &pipeline_opt, sink, &pipeline_stats) == 0){
+            printf("latency avg %.1f us max %.1f us jitter %.1f us, wait reader[%lu] converter[%lu] writer[%lu]\n",
+                pipeline_stats.latency_avg_us, pipeline_stats.latency_max_us, pipeline_stats.latency_jitter_us,
+                pipeline_stats.reader_wait, pipeline_stats.converter_wait, pipeline_stats.writer_wait);
+        }
+        demux_sink_close(sink);
+    }else if(argc > 2 && strcmp(argv[2], "timeline") == 0){
+        demux_print_timeline(demux_ctrl);
+    }else if(argc > 2 && strcmp(argv[2], "analytics") == 0){
+        demux_print_analytics(demux_ctrl, track_index);
+    }else if(argc > 2 && strcmp(argv[2], "pool") == 0){
+        demux_pool_bench(demux_ctrl, track_index);
+    }else if(argc > 3 && strcmp(argv[2], "sink") == 0 && track_index >= 0){
+        /* sink ring|callback|pipe */
+        demux_sink_output(demux_ctrl, track_index, argv[3]);
+    }else if(argc > 2 && strcmp(argv[2], "ts") == 0){
+        sink = demux_sink_open_file("out.ts");
+        if(sink != NULL){
+            demux_remux_ts(demux_ctrl, sink);
+            demux_sink_close(sink);
+        }
+    }else if(track_index >= 0){
+        sink = demux_sink_open_file("out.h264");
+        if(sink != NULL){
+            demux_output_track(demux_ctrl, track_index, sink);
+            demux_sink_close(sink);
+        }
+    }
+    if(argc > 2 && strcmp(argv[2], "stats") == 0){
+        /* 默认输出之后把计数写到stats.json */
+        stats_fp = fopen("stats.json", "w");
+        if(stats_fp != NULL && demux_get_stats(demux_ctrl, &stats) == 0){
+            demux_stats_dump_json(&stats, stats_fp);
+        }
+        if(stats_fp != NULL){
+            fclose(stats_fp);
+        }
+    }
+    if(nal_mode){
+        demux_print_nal_index("out.h264 samples", &nal_index);
+        demux_check_annexb("out.h264");
+        demux_nal_index_free(&nal_index);
     }
 
     demux_close(demux_ctrl);
+    free(file_data);
     free(file_path);
 
     return 0;